@@ -0,0 +1,201 @@
+// ========================================
+// HOST BENCHMARK: CLIENT STREAM PARSING
+// ========================================
+//
+// Feeds recorded server output (bench/recorded_traffic.txt: ACK batches,
+// list responses, simple and structured blob frames) through
+// BlobStreamParser and through a copy of the old line/vector based parsing,
+// and reports throughput plus heap allocations made while parsing.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++11 -I. bench/blob_client_bench.cpp -o blob_client_bench
+//   ./blob_client_bench bench/recorded_traffic.txt
+
+#include "blob_stream_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// ========================================
+// ALLOCATION COUNTER
+// ========================================
+
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+// ========================================
+// LEGACY PARSER (readUntilEnd + parseCSV)
+// ========================================
+
+struct LegacyBlob {
+  int region_id;
+  std::string color;
+  int x, y, size;
+};
+
+static std::vector<std::string> legacySplit(const std::string& line) {
+  std::vector<std::string> tokens;
+  size_t start = 0;
+  while (start < line.size()) {
+    size_t comma = line.find(',', start);
+    if (comma == std::string::npos) {
+      tokens.push_back(line.substr(start));
+      break;
+    }
+    tokens.push_back(line.substr(start, comma - start));
+    start = comma + 1;
+  }
+  return tokens;
+}
+
+static size_t legacyParse(const std::string& traffic) {
+  size_t blobs = 0;
+  std::vector<std::string> lines;
+  std::string line;
+  
+  for (char c : traffic) {
+    if (c == '\r') continue;
+    if (c != '\n') {
+      line += c;
+      continue;
+    }
+    
+    if (line != "END") {
+      lines.push_back(line);
+      line.clear();
+      continue;
+    }
+    line.clear();
+    
+    std::vector<LegacyBlob> results;
+    for (const std::string& l : lines) {
+      if (l.size() > 1 && l[0] == 'R' && l.find(',') != std::string::npos) {
+        std::vector<std::string> tokens = legacySplit(l.substr(1));
+        if (tokens.size() >= 5) {
+          results.push_back({atoi(tokens[0].c_str()), tokens[1], atoi(tokens[2].c_str()),
+                             atoi(tokens[3].c_str()), atoi(tokens[4].c_str())});
+        }
+      }
+    }
+    blobs += results.size();
+    lines.clear();
+  }
+  return blobs;
+}
+
+// ========================================
+// BENCHMARK DRIVER
+// ========================================
+
+struct FrameCounter {
+  size_t frames;
+  size_t blobs;
+  size_t acks;
+};
+
+static void countAck(void* ctx, uint16_t, bool, const char*) {
+  static_cast<FrameCounter*>(ctx)->acks++;
+}
+
+static void countFrame(void* ctx, const BlobResult*, int count) {
+  FrameCounter* c = static_cast<FrameCounter*>(ctx);
+  c->frames++;
+  c->blobs += count;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runParser(const std::string& traffic, size_t chunk, int iterations) {
+  ColorTable colors;
+  BlobStreamParser* parser = new BlobStreamParser(&colors);
+  FrameCounter counter = {0, 0, 0};
+  
+  BlobStreamHandler handler;
+  handler.on_ack = countAck;
+  handler.on_frame = countFrame;
+  handler.on_hsv = nullptr;
+  handler.on_line = nullptr;
+  handler.ctx = &counter;
+  parser->setHandler(handler);
+  
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(traffic.data());
+  size_t allocations_before = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+  
+  for (int it = 0; it < iterations; it++) {
+    for (size_t pos = 0; pos < traffic.size(); pos += chunk) {
+      size_t n = traffic.size() - pos < chunk ? traffic.size() - pos : chunk;
+      parser->feed(data + pos, n);
+    }
+  }
+  
+  double seconds = secondsSince(start);
+  size_t allocations = g_allocations - allocations_before;
+  double bytes = static_cast<double>(traffic.size()) * iterations;
+  
+  printf("stream parser  chunk %4zu: %8.1f MB/s %10.0f frames/s %11.0f blobs/s  %zu allocs\n",
+         chunk, bytes / seconds / 1e6, counter.frames / seconds, counter.blobs / seconds, allocations);
+  delete parser;
+}
+
+static void runLegacy(const std::string& traffic, int iterations) {
+  size_t blobs = 0;
+  size_t allocations_before = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+  
+  for (int it = 0; it < iterations; it++) {
+    blobs += legacyParse(traffic);
+  }
+  
+  double seconds = secondsSince(start);
+  size_t allocations = g_allocations - allocations_before;
+  double bytes = static_cast<double>(traffic.size()) * iterations;
+  
+  printf("legacy parser            : %8.1f MB/s %29.0f blobs/s  %.1f allocs/KB\n",
+         bytes / seconds / 1e6, blobs / seconds, allocations / (bytes / 1024.0));
+}
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : "bench/recorded_traffic.txt";
+  int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+  
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return 1;
+  }
+  std::string traffic;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) traffic.append(buf, n);
+  fclose(f);
+  
+  printf("%s: %zu bytes x %d iterations\n", path, traffic.size(), iterations);
+  
+  const size_t chunks[] = {1, 16, 64, 256};
+  for (size_t chunk : chunks) {
+    runParser(traffic, chunk, iterations);
+  }
+  runLegacy(traffic, iterations);
+  return 0;
+}
\ No newline at end of file
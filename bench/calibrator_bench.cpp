@@ -0,0 +1,211 @@
+// ========================================
+// HOST BENCHMARK: THRESHOLD CALIBRATION
+// ========================================
+//
+// Synthetic QQVGA frames with one probe region holding a known hue band
+// plus grey (low S, high V) and dark (low V) background pixels at hues far
+// from the band; outside the region every pixel is a saturated decoy that
+// must never be sampled. Each case runs ThresholdCalibrator over a few
+// frames, checks the box finish() returns, sets it with setColor and
+// checks that the color admits the band and none of the background:
+//   band       hue 60..75, no wrap
+//   wrap       hue 170..179 + 0..5, the arc crosses 179 -> 0 (h_min > h_max)
+//   circle     every hue at keep 100%, the arc is the whole circle (0..179)
+//   outside    region off the image, nothing sampled, finish() fails
+// In the band and wrap cases 3% of the band sits in a V bin just above the
+// rest; the background outside the hue arc is 9% of the samples, so V
+// chosen over all samples would have to take that bin in, while V chosen
+// from the samples inside the arc leaves it out. Reports the time per
+// addFrame. Any mismatch is fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -I. -Imain bench/calibrator_bench.cpp -o calibrator_bench
+//   ./calibrator_bench [frames]
+
+#include <Arduino.h>
+#include "threshold_calibrator.h"
+
+#include <chrono>
+#include <vector>
+
+#define BENCH_WIDTH 160
+#define BENCH_HEIGHT 120
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static int randomIn(int lo, int hi) {
+  return lo + int(nextRandom() % uint32_t(hi - lo + 1));
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum PixelKind { PIXEL_BAND, PIXEL_TAIL, PIXEL_GREY, PIXEL_DARK, PIXEL_DECOY };
+
+struct Case {
+  const char* name;
+  int hue_first;                  // Band hues, counted around the circle
+  int hue_count;
+  int keep_pct;
+  bool background;                // Grey / dark pixels and the V tail
+  ColorThresholds expected;
+};
+
+// Draw one frame; kinds records what every pixel is
+static void drawFrame(HSVImage& hsv, const DetectionRegion& probe, const Case& c, std::vector<uint8_t>& kinds) {
+  for (int y = 0; y < BENCH_HEIGHT; y++) {
+    for (int x = 0; x < BENCH_WIDTH; x++) {
+      int i = y * BENCH_WIDTH + x;
+      uint8_t kind = PIXEL_BAND;
+      uint8_t h, s, v;
+      int roll = nextRandom() % 100;
+      
+      if (!probe.contains(x, y)) {
+        kind = PIXEL_DECOY;
+        h = randomIn(20, 40);
+        s = 255;
+        v = 255;
+      } else if (c.background && roll >= 95) {
+        kind = PIXEL_DARK;
+        h = randomIn(140, 159);
+        s = randomIn(0, 255);
+        v = randomIn(0, 23);
+      } else if (c.background && roll >= 91) {
+        kind = PIXEL_GREY;
+        h = randomIn(100, 119);
+        s = randomIn(0, 15);
+        v = randomIn(200, 255);
+      } else {
+        h = (c.hue_first + randomIn(0, c.hue_count - 1)) % 180;
+        s = randomIn(c.expected.s_min, c.expected.s_max);
+        v = randomIn(c.expected.v_min, c.expected.v_max);
+        if (c.background && nextRandom() % 100 < 3) {
+          kind = PIXEL_TAIL;
+          v = randomIn(c.expected.v_max + 1, c.expected.v_max + CALIB_SV_BIN);
+        }
+      }
+      
+      hsv.h_data[i] = h;
+      hsv.s_data[i] = s;
+      hsv.v_data[i] = v;
+      kinds[i] = kind;
+    }
+  }
+}
+
+static bool sameBox(const ColorThresholds& a, const ColorThresholds& b) {
+  return a.h_min == b.h_min && a.h_max == b.h_max && a.s_min == b.s_min && a.s_max == b.s_max &&
+         a.v_min == b.v_min && a.v_max == b.v_max;
+}
+
+static bool run(const Case& c, int frames, const DetectionRegion& probe) {
+  getRegionManager().setRegionSet("probe", {probe});
+  RegionSetId set_id = getRegionManager().findRegionSet("probe");
+  
+  HSVImage hsv;
+  hsv.width = BENCH_WIDTH;
+  hsv.height = BENCH_HEIGHT;
+  hsv.h_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.s_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.v_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  std::vector<uint8_t> kinds(BENCH_WIDTH * BENCH_HEIGHT);
+  
+  // Every frame is drawn anew, so the samples are several frames' worth
+  ThresholdCalibrator calibrator;
+  calibrator.begin(set_id, frames, c.keep_pct);
+  double add_us = 0;
+  bool done = false;
+  for (int f = 0; f < frames; f++) {
+    drawFrame(hsv, probe, c, kinds);
+    double start = nowMicros();
+    done = calibrator.addFrame(hsv);
+    add_us += nowMicros() - start;
+  }
+  if (!done || calibrator.isActive()) {
+    printf("%s: still active after %d frames\n", c.name, frames);
+    return false;
+  }
+  
+  std::vector<ColorThresholds> ranges;
+  bool ok = calibrator.finish(ranges);
+  const DetectionRegion clipped = clipRegion(probe, BENCH_WIDTH, BENCH_HEIGHT);
+  const int covered = clipped.width * clipped.height;
+  if (covered == 0) {
+    hsv.clear();
+    if (ok || !ranges.empty() || calibrator.sampleCount() != 0) {
+      printf("%s: nothing was sampled, yet finish() gave a range\n", c.name);
+      return false;
+    }
+    printf("  %-8s nothing sampled, refused\n", c.name);
+    return true;
+  }
+  if (!ok || ranges.size() != 1 || calibrator.sampleCount() != uint32_t(covered) * frames) {
+    printf("%s: finish() gave %d ranges from %u samples\n", c.name, int(ranges.size()), calibrator.sampleCount());
+    return false;
+  }
+  
+  const ColorThresholds& got = ranges[0];
+  const ColorThresholds& want = c.expected;
+  if (!sameBox(got, want)) {
+    printf("%s: H %d..%d S %d..%d V %d..%d, expected H %d..%d S %d..%d V %d..%d\n", c.name,
+           got.h_min, got.h_max, got.s_min, got.s_max, got.v_min, got.v_max,
+           want.h_min, want.h_max, want.s_min, want.s_max, want.v_min, want.v_max);
+    return false;
+  }
+  
+  // As CALIBRATE does: the box becomes the color, which must take in the
+  // band of the last frame and none of its background
+  getColorManager().setColor("CALIBRATED", ranges);
+  ColorId color = getColorManager().findColor("CALIBRATED");
+  ColorSnapshot colors = getColorManager().snapshot();
+  long counts[5] = {0}, matched[5] = {0};
+  for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++) {
+    counts[kinds[i]]++;
+    matched[kinds[i]] += colors->matchesColor(hsv.h_data[i], hsv.s_data[i], hsv.v_data[i], color);
+  }
+  hsv.clear();
+  
+  if (matched[PIXEL_BAND] != counts[PIXEL_BAND] || matched[PIXEL_TAIL] || matched[PIXEL_GREY] ||
+      matched[PIXEL_DARK] || matched[PIXEL_DECOY]) {
+    printf("%s: color matched %ld / %ld band, %ld tail, %ld grey, %ld dark, %ld decoy pixels\n", c.name,
+           matched[PIXEL_BAND], counts[PIXEL_BAND], matched[PIXEL_TAIL], matched[PIXEL_GREY],
+           matched[PIXEL_DARK], matched[PIXEL_DECOY]);
+    return false;
+  }
+  
+  printf("  %-8s H %3d..%-3d S %3d..%-3d V %3d..%-3d  %6u samples  addFrame %6.1f us\n", c.name,
+         got.h_min, got.h_max, got.s_min, got.s_max, got.v_min, got.v_max, calibrator.sampleCount(),
+         add_us / frames);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 5;
+  
+  // The decoy hues 20..40 sit between the band and the wrap arc, so a
+  // sampled decoy would move the arc as well as fail the color check
+  const DetectionRegion probe(30, 20, 100, 80);
+  const Case cases[] = {
+    {"band", 60, 16, 90, true, ColorThresholds(60, 75, 128, 191, 96, 159)},
+    {"wrap", 170, 16, 90, true, ColorThresholds(170, 5, 128, 191, 96, 159)},
+    {"circle", 0, 180, 100, false, ColorThresholds(0, 179, 0, 31, 192, 255)},
+  };
+  
+  printf("%dx%d, probe %dx%d, %d frames, bins H %d S/V %d:\n", BENCH_WIDTH, BENCH_HEIGHT, probe.width,
+         probe.height, frames, CALIB_H_BIN, CALIB_SV_BIN);
+  for (const Case& c : cases) {
+    if (!run(c, frames, probe)) return 1;
+  }
+  Case outside = cases[0];
+  outside.name = "outside";
+  if (!run(outside, frames, DetectionRegion(BENCH_WIDTH + 10, 0, 20, 20))) return 1;
+  printf("every box and color matched its band\n");
+  return 0;
+}
\ No newline at end of file
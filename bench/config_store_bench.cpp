@@ -0,0 +1,243 @@
+// ========================================
+// HOST BENCHMARK: PERSISTENT CONFIGURATION STORE
+// ========================================
+//
+// Builds configurations of growing size (colors with one to three ranges,
+// region sets of rectangles, polygons and masks, all four change
+// subscriptions), saves each through ConfigStore into a FileStorage file,
+// scrambles the live colors, regions and subscriptions, loads it back and
+// checks that the restored state encodes to the saved image byte for byte,
+// that every ColorId / RegionSetId handle still names the same entry, and
+// that shapes and subscriptions came back intact. Then every single-byte
+// flip and every truncation of the image must be refused by decode(), and
+// a damaged file must leave the live state alone. Reports per size:
+//   image      bytes of the stored image
+//   encode     ConfigStore::encode of the published snapshots
+//   save       encode + write to the file (tmp + rename)
+//   decode     decode alone, shapes rebuilt
+//   load       read + decode + publish the snapshots (the boot path)
+// Any mismatch is fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -I. -Imain bench/config_store_bench.cpp -o config_store_bench
+//   ./config_store_bench [iterations] [file]
+
+#include <Arduino.h>
+#include "file_storage.h"
+
+#include <chrono>
+#include <vector>
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<uint8_t> currentImage(const ChangeReporter* reporter) {
+  std::vector<uint8_t> image;
+  ConfigStore::encode(*getColorManager().snapshot(), *getRegionManager().snapshot(), reporter, image);
+  return image;
+}
+
+// Colors C0..C<colors-1>, sets S0..S<sets-1> of one to three regions each
+// (rectangle, polygon or 32x32 disc mask), and all subscription slots
+static void buildConfig(int colors, int sets, ChangeReporter& reporter) {
+  ColorThresholdManager& color_manager = getColorManager();
+  RegionManager& region_manager = getRegionManager();
+  
+  for (int c = 0; c < colors; c++) {
+    std::vector<ColorThresholds> ranges;
+    int count = 1 + nextRandom() % 3;
+    for (int i = 0; i < count; i++) {
+      int h = nextRandom() % 180, s = nextRandom() % 128, v = nextRandom() % 128;
+      ranges.push_back(ColorThresholds(h, (h + 10 + nextRandom() % 40) % 180, s, s + 100, v, v + 120));
+    }
+    color_manager.setColor("C" + std::to_string(c), ranges);
+  }
+  
+  uint8_t disc[32 * 32];
+  for (int y = 0; y < 32; y++) {
+    for (int x = 0; x < 32; x++) disc[y * 32 + x] = (x - 16) * (x - 16) + (y - 16) * (y - 16) < 256;
+  }
+  
+  for (int s = 0; s < sets; s++) {
+    std::vector<DetectionRegion> regions;
+    int count = 1 + nextRandom() % 3;
+    for (int i = 0; i < count; i++) {
+      int x = nextRandom() % 280, y = nextRandom() % 200;
+      switch ((s + i) % 3) {
+        case 0:
+          regions.push_back(DetectionRegion(x, y, 20 + nextRandom() % 100, 20 + nextRandom() % 80));
+          break;
+        case 1:
+          regions.push_back(polygonRegion({{x, y}, {x + 60, y + 5}, {x + 40, y + 50}, {x - 10, y + 35}}));
+          break;
+        default:
+          regions.push_back(maskRegion(x, y, 32, 32, disc));
+          break;
+      }
+    }
+    region_manager.setRegionSet("S" + std::to_string(s), regions);
+  }
+  region_manager.setImageSize(320, 240);
+  
+  for (int slot = 0; slot < CHANGE_MAX_SUBSCRIPTIONS && slot < sets; slot++) {
+    std::vector<ColorId> subscribed;
+    for (int c = slot; c < colors && subscribed.size() < 2; c += 3) {
+      subscribed.push_back(color_manager.findColor("C" + std::to_string(c)));
+    }
+    reporter.subscribe(region_manager.findRegionSet("S" + std::to_string(slot)), subscribed,
+                       1 + slot, 5 * slot, slot == 0 ? 0 : 100 * slot);
+  }
+}
+
+// Replace everything a load has to bring back
+static void scramble(int colors, int sets) {
+  for (int c = 0; c < colors; c += 2) getColorManager().deleteColor("C" + std::to_string(c));
+  getColorManager().setColor("SCRAMBLED", ColorThresholds(1, 2, 3, 4, 5, 6));
+  for (int s = 0; s < sets; s += 2) getRegionManager().deleteRegionSet("S" + std::to_string(s));
+  getRegionManager().setRegionSet("SCRAMBLED", DetectionRegion(0, 0, 1, 1));
+  getRegionManager().setImageSize(640, 480);
+}
+
+static bool sameSubscriptions(const ChangeReporter& a, const ChangeReporter& b) {
+  for (int slot = 0; slot < CHANGE_MAX_SUBSCRIPTIONS; slot++) {
+    const Subscription& x = a.subscription(slot);
+    const Subscription& y = b.subscription(slot);
+    if (x.active != y.active) return false;
+    if (!x.active) continue;
+    if (x.region_set != y.region_set || x.colors != y.colors || x.move_px != y.move_px ||
+        x.size_pct != y.size_pct || x.keyframe_interval != y.keyframe_interval) return false;
+  }
+  return true;
+}
+
+static bool run(int colors, int sets, int iterations, const std::string& path) {
+  FileStorage storage(path);
+  storage.erase();
+  ConfigStore store(&storage);
+  rng_state = 12345 + colors * 131 + sets;
+  
+  ChangeReporter reporter;
+  buildConfig(colors, sets, reporter);
+  const std::vector<uint8_t> saved = currentImage(&reporter);
+  
+  // Handles and shapes as they were before the save
+  std::vector<ColorId> color_ids;
+  for (int c = 0; c < colors; c++) color_ids.push_back(getColorManager().findColor("C" + std::to_string(c)));
+  std::vector<RegionSetId> set_ids;
+  std::vector<int> shape_pixels;
+  for (int s = 0; s < sets; s++) {
+    std::string name = "S" + std::to_string(s);
+    set_ids.push_back(getRegionManager().findRegionSet(name));
+    for (const DetectionRegion& region : getRegionManager().getRegions(name)) {
+      shape_pixels.push_back(region.shape ? region.shape->pixels : -1);
+    }
+  }
+  
+  double encode_us = 0, save_us = 0, decode_us = 0, load_us = 0;
+  std::vector<uint8_t> image;
+  ConfigImage decoded;
+  for (int i = 0; i < iterations; i++) {
+    double start = nowMicros();
+    currentImage(&reporter).swap(image);
+    encode_us += nowMicros() - start;
+    
+    start = nowMicros();
+    bool saved_ok = store.save(&reporter);
+    save_us += nowMicros() - start;
+    
+    start = nowMicros();
+    bool decoded_ok = ConfigStore::decode(image.data(), image.size(), decoded);
+    decode_us += nowMicros() - start;
+    if (!saved_ok || !decoded_ok || image != saved) {
+      printf("SAVE / DECODE FAILED at iteration %d\n", i);
+      return false;
+    }
+    
+    scramble(colors, sets);
+    ChangeReporter restored;
+    start = nowMicros();
+    bool loaded = store.load(&restored);
+    load_us += nowMicros() - start;
+    
+    if (!loaded || currentImage(&restored) != saved || !sameSubscriptions(reporter, restored)) {
+      printf("ROUND TRIP MISMATCH at iteration %d\n", i);
+      return false;
+    }
+  }
+  
+  // Handles name the same entries, shapes rebuilt with the same pixels
+  if (getColorManager().hasColor("SCRAMBLED") || getRegionManager().hasRegionSet("SCRAMBLED")) {
+    printf("SCRAMBLED STATE SURVIVED THE LOAD\n");
+    return false;
+  }
+  for (int c = 0; c < colors; c++) {
+    if (getColorManager().findColor("C" + std::to_string(c)) != color_ids[c]) {
+      printf("COLOR HANDLE MOVED: C%d\n", c);
+      return false;
+    }
+  }
+  size_t shape_index = 0;
+  for (int s = 0; s < sets; s++) {
+    std::string name = "S" + std::to_string(s);
+    if (getRegionManager().findRegionSet(name) != set_ids[s]) {
+      printf("REGION SET HANDLE MOVED: %s\n", name.c_str());
+      return false;
+    }
+    for (const DetectionRegion& region : getRegionManager().getRegions(name)) {
+      if ((region.shape ? region.shape->pixels : -1) != shape_pixels[shape_index++]) {
+        printf("SHAPE MISMATCH in %s\n", name.c_str());
+        return false;
+      }
+    }
+  }
+  
+  // Damage: every flip and every truncation is refused
+  for (size_t i = 0; i < saved.size(); i++) {
+    std::vector<uint8_t> damaged = saved;
+    damaged[i] ^= 1 << (i % 8);
+    if (ConfigStore::decode(damaged.data(), damaged.size(), decoded) ||
+        ConfigStore::decode(saved.data(), i, decoded)) {
+      printf("DAMAGED IMAGE ACCEPTED at byte %zu\n", i);
+      return false;
+    }
+  }
+  
+  // A damaged file leaves the live state alone
+  storage.write(saved.data(), saved.size() - 1);
+  getColorManager().setColor("SCRAMBLED", ColorThresholds(1, 2, 3, 4, 5, 6));
+  ChangeReporter untouched;
+  if (store.load(&untouched) || !getColorManager().hasColor("SCRAMBLED") || untouched.hasSubscriptions()) {
+    printf("DAMAGED FILE LOADED\n");
+    return false;
+  }
+  getColorManager().deleteColor("SCRAMBLED");
+  
+  printf("  %2d colors %2d sets  image %6zu B  encode %7.1f us  save %7.1f us  decode %7.1f us  load %7.1f us\n",
+         colors, sets, saved.size(), encode_us / iterations, save_us / iterations,
+         decode_us / iterations, load_us / iterations);
+  storage.erase();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 50;
+  std::string path = argc > 2 ? argv[2] : "/tmp/config_store_bench.bin";
+  
+  printf("%d save / load rounds per size, %d subscription slots, %s:\n", iterations,
+         CHANGE_MAX_SUBSCRIPTIONS, path.c_str());
+  const int sizes[][2] = {{4, 2}, {16, 8}, {48, 32}};
+  for (const auto& size : sizes) {
+    if (!run(size[0], size[1], iterations, path)) return 1;
+  }
+  printf("every single-byte flip and truncation refused\n");
+  return 0;
+}
\ No newline at end of file
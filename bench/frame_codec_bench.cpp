@@ -0,0 +1,121 @@
+// ========================================
+// HOST BENCHMARK: INTER-FRAME YUV CODEC
+// ========================================
+//
+// Encodes a synthetic 160x120 YUV422 sequence (static background, moving
+// objects, optional sensor noise) with FrameEncoder, decodes it with
+// FrameDecoder and reports, per keyframe interval and noise level:
+//   ratio        raw bytes / encoded bytes
+//   KB/frame     average encoded size
+//   skipped      tiles sent as "unchanged"
+//   encode/decode  microseconds per frame on this machine
+// Every decoded frame is compared with the original; any mismatch is fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -Imain bench/frame_codec_bench.cpp -o frame_codec_bench
+//   ./frame_codec_bench [frames]
+
+#include <Arduino.h>
+#include "frame_codec.h"
+
+#include <chrono>
+#include <vector>
+
+#define BENCH_WIDTH 160
+#define BENCH_HEIGHT 120
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+// Gradient background with two moving squares. noise_pct of the pixels get
+// +-1 on Y, like a sensor in moderate light.
+static void drawFrame(uint8_t* yuv, int frame, int noise_pct) {
+  for (int y = 0; y < BENCH_HEIGHT; y++) {
+    for (int x = 0; x < BENCH_WIDTH; x += 2) {
+      uint8_t* p = yuv + (y * BENCH_WIDTH + x) * 2;
+      p[0] = 40 + x / 2 + y / 4;
+      p[1] = 128;
+      p[2] = 40 + x / 2 + y / 4;
+      p[3] = 128;
+    }
+  }
+  
+  int squares[][5] = {  // x, y, size, u, v
+    {10 + frame % 100, 20, 16, 90, 200},
+    {80, 60 + (frame / 2) % 40, 20, 60, 80}
+  };
+  for (const auto& sq : squares) {
+    for (int y = sq[1]; y < sq[1] + sq[2] && y < BENCH_HEIGHT; y++) {
+      for (int x = sq[0] & ~1; x < sq[0] + sq[2] && x < BENCH_WIDTH; x += 2) {
+        uint8_t* p = yuv + (y * BENCH_WIDTH + x) * 2;
+        p[0] = p[2] = 150;
+        p[1] = sq[3];
+        p[3] = sq[4];
+      }
+    }
+  }
+  
+  if (noise_pct > 0) {
+    for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++) {
+      if (int(nextRandom() % 100) < noise_pct) {
+        uint8_t& luma = yuv[i * 2];   // Y of pixel i in Y0 U Y1 V
+        luma += (nextRandom() & 1) ? 1 : -1;
+      }
+    }
+  }
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool run(int frames, int keyframe_interval, int noise_pct) {
+  const size_t frame_bytes = BENCH_WIDTH * BENCH_HEIGHT * 2;
+  std::vector<uint8_t> yuv(frame_bytes);
+  FrameEncoder encoder(keyframe_interval);
+  FrameDecoder decoder;
+  double decode_us = 0;
+  rng_state = 12345;
+  
+  for (int f = 0; f < frames; f++) {
+    drawFrame(yuv.data(), f, noise_pct);
+    size_t size = encoder.encode(yuv.data(), BENCH_WIDTH, BENCH_HEIGHT, f);
+    
+    double start = nowMicros();
+    bool ok = decoder.decode(encoder.data(), size);
+    decode_us += nowMicros() - start;
+    
+    if (!ok || memcmp(decoder.data(), yuv.data(), frame_bytes) != 0) {
+      printf("MISMATCH at frame %d (key interval %d, noise %d%%)\n", f, keyframe_interval, noise_pct);
+      return false;
+    }
+  }
+  
+  const FrameCodecStats& s = encoder.stats();
+  printf("  key %3d  noise %2d%%   ratio %6.2fx  %6.2f KB/frame  skipped %5.1f%%  "
+         "encode %6.1f us  decode %6.1f us\n",
+         keyframe_interval, noise_pct, s.ratio(), s.bytes_out / 1024.0 / s.frames,
+         100.0 * s.skipped_tiles / s.tiles, s.usPerFrame(), decode_us / frames);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 300;
+  
+  printf("%d frames of %dx%d YUV422 (%d bytes raw), %dx%d tiles:\n", frames, BENCH_WIDTH,
+         BENCH_HEIGHT, BENCH_WIDTH * BENCH_HEIGHT * 2, FRAME_CODEC_TILE_W, FRAME_CODEC_TILE_H);
+  
+  const int intervals[] = {1, 10, 30, 0};
+  const int noise[] = {0, 2, 10};
+  for (int n : noise) {
+    for (int k : intervals) {
+      if (!run(frames, k, n)) return 1;
+    }
+  }
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+// ========================================
+// HOST BENCHMARK: FRAME-DIFFERENCE DETECTION GATE
+// ========================================
+//
+// A conveyor-like QVGA scene: a static noisy background with fixed RED /
+// GREEN parts, plus a few parts moving along one belt lane. The frame is
+// split into a 4x4 region grid plus one region overlapping the belt lane,
+// and detected with DetectionGate and, for reference, with
+// detectBlobsStructured on the same compiled set every frame (a blob in the
+// overlap must be reported once). Reports per noise level:
+//   reused     region / color results taken from the cache
+//   changed    average fraction of changed tiles
+//   time       microseconds per frame for the gate (diff + detect) and reference
+//   allocs     heap allocations per gated frame (detect into a reused
+//              DetectionResults) once past the first 10 frames
+// Without noise, any result that differs from the reference is fatal. The
+// gate's /metrics lines are printed at the end.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -Imain bench/gate_bench.cpp -o gate_bench
+//   ./gate_bench [frames]
+
+#include <Arduino.h>
+#include "detection_gate.h"
+
+#include <chrono>
+#include <vector>
+
+#define BENCH_WIDTH 320
+#define BENCH_HEIGHT 240
+#define BENCH_WARMUP 10
+
+// ========================================
+// ALLOCATION COUNTER
+// ========================================
+
+static size_t g_allocations = 0;
+
+// Out of line: inlined into the containers, GCC takes the malloc / free
+// pairs for mismatched new / delete (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void fillRect(std::vector<uint8_t>& yuv, int x0, int y0, int size, uint8_t y, uint8_t u, uint8_t v) {
+  for (int py = std::max(0, y0); py < std::min(BENCH_HEIGHT, y0 + size); py++) {
+    for (int px = std::max(0, x0) & ~1; px < std::min(BENCH_WIDTH, x0 + size); px += 2) {
+      uint8_t* p = &yuv[(py * BENCH_WIDTH + px) * 2];
+      p[0] = p[2] = y;
+      p[1] = u;
+      p[3] = v;
+    }
+  }
+}
+
+// Noise hits noise_pct of the pixels with +-1..3 on Y, like a sensor in low light
+static void drawFrame(std::vector<uint8_t>& yuv, int frame, int noise_pct) {
+  for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i += 2) {
+    uint8_t* p = &yuv[i * 2];
+    p[0] = p[2] = 110;
+    p[1] = p[3] = 128;
+  }
+  
+  fillRect(yuv, 20, 20, 20, 82, 90, 240);     // Parked RED parts
+  fillRect(yuv, 250, 30, 16, 82, 90, 240);
+  fillRect(yuv, 40, 180, 24, 120, 70, 60);    // Parked GREEN part
+  
+  for (int k = 0; k < 3; k++) {               // Belt lane at y = 110
+    int x = (frame * 3 + k * 110) % (BENCH_WIDTH + 40) - 20;
+    if (k == 1) fillRect(yuv, x, 110, 18, 120, 70, 60);
+    else fillRect(yuv, x, 110, 18, 82, 90, 240);
+  }
+  
+  if (noise_pct > 0) {
+    for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++) {
+      if (int(nextRandom() % 100) < noise_pct) {
+        int d = 1 + nextRandom() % 3;
+        uint8_t& luma = yuv[i * 2];
+        luma = (nextRandom() & 1) ? std::min(255, luma + d) : std::max(0, luma - d);
+      }
+    }
+  }
+}
+
+static bool sameResults(const std::vector<RegionResults>& a, const std::vector<RegionResults>& b,
+                        const std::vector<ColorId>& colors) {
+  if (a.size() != b.size()) return false;
+  for (size_t r = 0; r < a.size(); r++) {
+    for (ColorId color : colors) {
+      const auto& x = a[r].getBlobsForColor(color);
+      const auto& y = b[r].getBlobsForColor(color);
+      if (x.size() != y.size()) return false;
+      for (size_t i = 0; i < x.size(); i++) {
+        if (x[i].center_x != y[i].center_x || x[i].center_y != y[i].center_y ||
+            x[i].pixel_count != y[i].pixel_count) return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool run(int frames, int noise_pct) {
+  const std::vector<ColorId> colors = resolveColors({"RED", "GREEN"});
+  std::vector<DetectionRegion> regions;
+  for (int ry = 0; ry < 4; ry++) {
+    for (int rx = 0; rx < 4; rx++) {
+      regions.push_back(DetectionRegion(rx * 80, ry * 60, 80, 60));
+    }
+  }
+  regions.push_back(DetectionRegion(60, 90, 140, 60));
+  getRegionManager().setRegionSet("grid", regions);
+  RegionSetId set_id = getRegionManager().findRegionSet("grid");
+  auto compiled = getRegionManager().getCompiledRegionSet(set_id, BENCH_WIDTH, BENCH_HEIGHT);
+  
+  std::vector<uint8_t> yuv(BENCH_WIDTH * BENCH_HEIGHT * 2);
+  DetectionGate gate;
+  DetectionResults gate_results;
+  size_t allocations = 0;
+  uint32_t hits0 = getMetrics().gate_hits.get(), misses0 = getMetrics().gate_misses.get();
+  double gate_us = 0, full_us = 0, changed = 0;
+  rng_state = 12345;
+  
+  for (int f = 0; f < frames; f++) {
+    drawFrame(yuv, f, noise_pct);
+    HSVImage hsv;
+    yuv422ToHSV(yuv.data(), BENCH_WIDTH, BENCH_HEIGHT, hsv);
+    
+    double start = nowMicros();
+    auto expected = detectBlobsStructured(hsv, set_id, colors);
+    full_us += nowMicros() - start;
+    
+    size_t allocations_before = g_allocations;
+    start = nowMicros();
+    gate.update(yuv.data(), BENCH_WIDTH, BENCH_HEIGHT);
+    gate.detect(hsv, compiled, colors, gate_results);
+    gate_us += nowMicros() - start;
+    if (f >= BENCH_WARMUP) allocations += g_allocations - allocations_before;
+    auto results = gate_results.toRegionResults();
+    changed += getMetrics().gate_changed_tiles.get();
+    hsv.clear();
+    
+    // The gate answers for the frame it last refreshed each tile from, so
+    // noise below the threshold may legitimately shift a blob by a pixel;
+    // without noise the results must be identical
+    if (noise_pct == 0 && !sameResults(results, expected, colors)) {
+      printf("MISMATCH at frame %d\n", f);
+      return false;
+    }
+  }
+  
+  uint32_t hits = getMetrics().gate_hits.get() - hits0;
+  uint32_t misses = getMetrics().gate_misses.get() - misses0;
+  printf("  noise %2d%%   reused %5.1f%%  changed %5.1f%% of tiles  gate %6.0f us/frame  full %6.0f us/frame"
+         "  %.2f allocs/frame\n",
+         noise_pct, 100.0 * hits / (hits + misses), 100.0 * changed / frames, gate_us / frames, full_us / frames,
+         frames > BENCH_WARMUP ? double(allocations) / (frames - BENCH_WARMUP) : 0.0);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 200;
+  
+  printf("%d frames of %dx%d, 4x4 regions + 1 overlapping, %dx%d tiles, noise floor %d, tile SAD %d:\n", frames,
+         BENCH_WIDTH, BENCH_HEIGHT, GATE_TILE, GATE_TILE, GATE_NOISE_FLOOR, GATE_TILE_SAD);
+  const int noise[] = {0, 5, 20};
+  for (int n : noise) {
+    if (!run(frames, n)) return 1;
+  }
+  
+  String body;
+  getMetrics().render(body);
+  int from = body.indexOf("# HELP " METRICS_PREFIX "gate_");
+  int to = body.indexOf("# HELP " METRICS_PREFIX "serial_");
+  if (from >= 0 && to > from) printf("\n%s", body.substring(from, to).c_str());
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,258 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ========================================
+// MINIMAL ARDUINO CORE FOR HOST BUILDS
+// ========================================
+//
+// Just enough of String / Print / Stream / HardwareSerial, millis() and
+// delay() to compile the firmware and client headers on Linux for the
+// benchmarks in bench/. Serial writes to stdout; Serial1/Serial2 are inert.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+
+template<typename T> T max(T a, T b) { return a > b ? a : b; }
+template<typename T> T min(T a, T b) { return a < b ? a : b; }
+
+inline unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {
+  std::this_thread::yield();
+}
+
+// ========================================
+// STRING
+// ========================================
+
+class String {
+private:
+  std::string s;
+
+public:
+  String() {}
+  String(const char* str) : s(str ? str : "") {}
+  String(const std::string& str) : s(str) {}
+  String(char c) : s(1, c) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned int v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+  String(double v, int decimals = 2) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s = buf;
+  }
+  
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t p = s.find(c, from);
+    return p == std::string::npos ? -1 : static_cast<int>(p);
+  }
+  
+  int indexOf(const String& str, unsigned int from = 0) const {
+    size_t p = s.find(str.s, from);
+    return p == std::string::npos ? -1 : static_cast<int>(p);
+  }
+  
+  String substring(unsigned int from) const {
+    return from >= s.size() ? String() : String(s.substr(from));
+  }
+  
+  String substring(unsigned int from, unsigned int to) const {
+    if (from >= s.size() || to <= from) return String();
+    return String(s.substr(from, to - from));
+  }
+  
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) {
+      s.clear();
+      return;
+    }
+    size_t b = s.find_last_not_of(" \t\r\n");
+    s = s.substr(a, b - a + 1);
+  }
+  
+  void toUpperCase() {
+    for (char& c : s) c = toupper(c);
+  }
+  
+  long toInt() const { return atol(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  
+  bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String& suffix) const {
+    return s.size() >= suffix.s.size() &&
+           s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+  bool equals(const String& other) const { return s == other.s; }
+  bool operator==(const String& other) const { return s == other.s; }
+  bool operator!=(const String& other) const { return s != other.s; }
+  bool operator==(const char* other) const { return s == other; }
+  bool operator!=(const char* other) const { return s != other; }
+  
+  String& operator+=(const String& other) { s += other.s; return *this; }
+  String& operator+=(const char* other) { s += other; return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  
+  void reserve(unsigned int size) { s.reserve(size); }
+  
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+};
+
+// ========================================
+// PRINT / STREAM
+// ========================================
+
+class Print {
+public:
+  virtual ~Print() {}
+  
+  virtual size_t write(uint8_t c) = 0;
+  
+  virtual size_t write(const uint8_t* data, size_t length) {
+    size_t n = 0;
+    while (n < length && write(data[n])) n++;
+    return n;
+  }
+  
+  size_t write(const char* str) {
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+  
+  virtual void flush() {}
+  
+  size_t print(const String& s) { return write(reinterpret_cast<const uint8_t*>(s.c_str()), s.length()); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  
+  template<typename T>
+  size_t println(const T& v) { return print(v) + println(); }
+  size_t println() { return write("\r\n"); }
+  
+  size_t printf(const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    return write(reinterpret_cast<const uint8_t*>(buf), min(static_cast<size_t>(len), sizeof(buf) - 1));
+  }
+};
+
+class Stream : public Print {
+protected:
+  unsigned long timeout_ms;
+  
+  // Wait up to the stream timeout for one byte, like the Arduino core
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) return c;
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    } while (millis() - start < timeout_ms);
+    return -1;
+  }
+
+public:
+  Stream() : timeout_ms(1000) {}
+  
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  
+  void setTimeout(unsigned long timeout) { timeout_ms = timeout; }
+  
+  String readStringUntil(char terminator) {
+    std::string line;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+      line += static_cast<char>(c);
+      c = timedRead();
+    }
+    return String(line);
+  }
+  
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      int c = timedRead();
+      if (c < 0) break;
+      buffer[n++] = static_cast<uint8_t>(c);
+    }
+    return n;
+  }
+};
+
+// ========================================
+// SERIAL PORTS
+// ========================================
+
+// Serial prints to stdout, other ports accept and drop everything
+class HardwareSerial : public Stream {
+private:
+  bool console;
+
+public:
+  HardwareSerial(bool is_console = false) : console(is_console) {}
+  
+  void begin(unsigned long) {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  
+  size_t write(uint8_t c) override {
+    if (console) fputc(c, stdout);
+    return 1;
+  }
+  
+  size_t write(const uint8_t* data, size_t length) override {
+    if (console) fwrite(data, 1, length, stdout);
+    return length;
+  }
+  
+  using Print::write;
+};
+
+inline HardwareSerial Serial(true);
+inline HardwareSerial Serial1;
+inline HardwareSerial Serial2;
+
+#endif // HOST_ARDUINO_H
\ No newline at end of file
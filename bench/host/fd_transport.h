@@ -0,0 +1,252 @@
+#ifndef FD_TRANSPORT_H
+#define FD_TRANSPORT_H
+
+#include <Arduino.h>
+#include "../../main/transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+// ========================================
+// FILE DESCRIPTOR TRANSPORT (LINUX)
+// ========================================
+
+// Transport over a pty, a pair of pipes/FIFOs or a Unix socket. Reads never
+// block. With a non-zero baud rate every write is held back for the time the
+// bytes would take on a UART (10 bits per byte), so both ends see the same
+// arrival times as on the real link.
+class FdTransport : public Transport {
+private:
+  int read_fd;
+  int write_fd;
+  unsigned long baud;
+  std::chrono::steady_clock::time_point wire_free;
+  
+  uint8_t rx_buf[4096];
+  size_t rx_head;
+  size_t rx_tail;
+  
+  size_t bytes_sent;
+  size_t bytes_received;
+  
+  bool fill() {
+    if (rx_head < rx_tail) return true;
+    if (read_fd < 0) return false;
+    
+    ssize_t n = ::read(read_fd, rx_buf, sizeof(rx_buf));
+    if (n <= 0) return false;
+    rx_head = 0;
+    rx_tail = n;
+    bytes_received += n;
+    return true;
+  }
+  
+  void pace(size_t length) {
+    if (baud == 0) return;
+    
+    auto now = std::chrono::steady_clock::now();
+    if (wire_free < now) wire_free = now;
+    wire_free += std::chrono::microseconds(length * 10 * 1000000ULL / baud);
+    std::this_thread::sleep_until(wire_free);
+  }
+  
+  static void makeRaw(int fd) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+  }
+  
+  static void makeNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+
+public:
+  FdTransport() : read_fd(-1), write_fd(-1), baud(0), rx_head(0), rx_tail(0),
+                  bytes_sent(0), bytes_received(0) {}
+  
+  ~FdTransport() {
+    close();
+  }
+  
+  // Take ownership of already opened descriptors (may be the same one)
+  void attach(int rfd, int wfd) {
+    close();
+    read_fd = rfd;
+    write_fd = wfd;
+    makeNonBlocking(read_fd);
+  }
+  
+  void close() {
+    if (read_fd >= 0) ::close(read_fd);
+    if (write_fd >= 0 && write_fd != read_fd) ::close(write_fd);
+    read_fd = write_fd = -1;
+    rx_head = rx_tail = 0;
+  }
+  
+  bool isOpen() const {
+    return read_fd >= 0 && write_fd >= 0;
+  }
+  
+  // ========================================
+  // OPENING
+  // ========================================
+  
+  // Both ends of an in-process link
+  static bool socketPair(FdTransport& a, FdTransport& b) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+    a.attach(fds[0], fds[0]);
+    b.attach(fds[1], fds[1]);
+    return true;
+  }
+  
+  // New pty; this end is the master, slave_path is for the other side
+  bool openPty(char* slave_path, size_t size) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0) return false;
+    if (grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, slave_path, size) != 0) {
+      ::close(fd);
+      return false;
+    }
+    makeRaw(fd);
+    attach(fd, fd);
+    return true;
+  }
+  
+  // A tty / pty slave
+  bool openDevice(const char* path) {
+    int fd = ::open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return false;
+    makeRaw(fd);
+    attach(fd, fd);
+    return true;
+  }
+  
+  // Two FIFOs (created if missing); the other side swaps the paths
+  bool openPipes(const char* read_path, const char* write_path) {
+    mkfifo(read_path, 0600);
+    mkfifo(write_path, 0600);
+    // O_RDWR keeps open() from blocking until the peer shows up
+    int rfd = ::open(read_path, O_RDWR);
+    int wfd = ::open(write_path, O_RDWR);
+    if (rfd < 0 || wfd < 0) {
+      if (rfd >= 0) ::close(rfd);
+      if (wfd >= 0) ::close(wfd);
+      return false;
+    }
+    attach(rfd, wfd);
+    return true;
+  }
+  
+  // Unix socket: listen on path and wait for one peer
+  bool acceptUnix(const char* path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    
+    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv < 0) return false;
+    unlink(path);
+    if (bind(srv, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(srv, 1) != 0) {
+      ::close(srv);
+      return false;
+    }
+    int fd = accept(srv, nullptr, nullptr);
+    ::close(srv);
+    if (fd < 0) return false;
+    attach(fd, fd);
+    return true;
+  }
+  
+  bool connectUnix(const char* path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+      ::close(fd);
+      return false;
+    }
+    attach(fd, fd);
+    return true;
+  }
+  
+  // ========================================
+  // TRANSPORT
+  // ========================================
+  
+  // Simulated baud rate, 0 = as fast as the descriptor allows
+  void begin(unsigned long baud_rate) override {
+    baud = baud_rate;
+    wire_free = std::chrono::steady_clock::now();
+  }
+  
+  int available() override {
+    int queued = 0;
+    if (read_fd >= 0) ioctl(read_fd, FIONREAD, &queued);
+    return static_cast<int>(rx_tail - rx_head) + queued;
+  }
+  
+  int read() override {
+    if (!fill()) return -1;
+    return rx_buf[rx_head++];
+  }
+  
+  int peek() override {
+    if (!fill()) return -1;
+    return rx_buf[rx_head];
+  }
+  
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+  
+  size_t write(const uint8_t* data, size_t length) override {
+    if (write_fd < 0) return 0;
+    pace(length);
+    
+    size_t done = 0;
+    while (done < length) {
+      ssize_t n = ::write(write_fd, data + done, length - done);
+      if (n > 0) {
+        done += n;
+      } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        struct pollfd pfd = {write_fd, POLLOUT, 0};
+        ::poll(&pfd, 1, 10);
+      } else {
+        break;
+      }
+    }
+    bytes_sent += done;
+    return done;
+  }
+  
+  using Transport::write;
+  
+  // ========================================
+  // COUNTERS
+  // ========================================
+  
+  size_t bytesSent() const {
+    return bytes_sent;
+  }
+  
+  size_t bytesReceived() const {
+    return bytes_received;
+  }
+};
+
+#endif // FD_TRANSPORT_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef FILE_STORAGE_H
+#define FILE_STORAGE_H
+
+#include "../../main/config_store.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+
+// ========================================
+// FILE CONFIGURATION STORAGE (LINUX)
+// ========================================
+
+// The configuration image in one file, standing in for NVS on the host.
+// A save goes to <path>.tmp first and is renamed over the old file, so
+// like NVS an interrupted save leaves the previous image.
+class FileStorage : public ConfigStorage {
+private:
+  std::string path;
+
+public:
+  FileStorage(const std::string& file) : path(file) {}
+  
+  bool read(std::vector<uint8_t>& out) override {
+    out.clear();
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) out.insert(out.end(), chunk, chunk + n);
+    fclose(f);
+    return !out.empty();
+  }
+  
+  bool write(const uint8_t* data, size_t length) override {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+      remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+  
+  bool erase() override {
+    return remove(path.c_str()) == 0 || errno == ENOENT;
+  }
+};
+
+#endif // FILE_STORAGE_H
\ No newline at end of file
@@ -0,0 +1,215 @@
+// ========================================
+// HOST BENCHMARK: HSV_DUMP ENCODINGS
+// ========================================
+//
+// BlobCommandInterface::sendHSVRegions on QVGA scenes, in RAW, RLE and
+// DELTA, into a capturing transport; the wire bytes are decoded with the
+// client's BlobStreamParser and every H, S and V plane is compared byte for
+// byte with the source. Scenes:
+//   flat       solid squares on a flat background (the transport bench scene)
+//   gradient   smooth ramps along the rows
+//   noisy      a camera-like frame, every pixel jittered by a few levels
+// The region set has the whole frame, a small window and one region hanging
+// over the bottom-right corner (clipped by the server). Reports bytes per
+// frame of each encoding against the text format it replaced
+// ("H,S,V H,S,V ..." per row) and the encode time. Any mismatch is fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -I. -Imain bench/hsv_dump_bench.cpp -o hsv_dump_bench
+//   ./hsv_dump_bench [frames]
+
+#include <Arduino.h>
+#include "blob_command_interface.h"
+#include "blob_stream_parser.h"
+
+#include <chrono>
+#include <vector>
+
+#define BENCH_WIDTH 320
+#define BENCH_HEIGHT 240
+#define BENCH_MAX_REGIONS 4
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps everything written to it
+class CaptureTransport : public Transport {
+public:
+  std::vector<uint8_t> bytes;
+  
+  void begin(unsigned long) override {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t length) override {
+    bytes.insert(bytes.end(), data, data + length);
+    return length;
+  }
+  void flush() override {}
+};
+
+enum Scene { SCENE_FLAT, SCENE_GRADIENT, SCENE_NOISY };
+
+static void drawScene(HSVImage& hsv, Scene scene) {
+  for (int y = 0; y < BENCH_HEIGHT; y++) {
+    for (int x = 0; x < BENCH_WIDTH; x++) {
+      int i = y * BENCH_WIDTH + x;
+      switch (scene) {
+        case SCENE_FLAT:
+          hsv.h_data[i] = 0;
+          hsv.s_data[i] = 10;
+          hsv.v_data[i] = 128;
+          break;
+        case SCENE_GRADIENT:
+          hsv.h_data[i] = (x * 180 / BENCH_WIDTH + y / 8) % 180;
+          hsv.s_data[i] = 60 + x / 4;
+          hsv.v_data[i] = 40 + y / 2 + x / 16;
+          break;
+        case SCENE_NOISY:
+          hsv.h_data[i] = 90 + nextRandom() % 6;
+          hsv.s_data[i] = 30 + nextRandom() % 8;
+          hsv.v_data[i] = 110 + nextRandom() % 12;
+          break;
+      }
+    }
+  }
+  
+  int squares[][4] = {{20, 20, 30, 5}, {120, 60, 40, 60}, {240, 150, 50, 115}};  // x, y, size, hue
+  for (const auto& sq : squares) {
+    for (int y = sq[1]; y < sq[1] + sq[2]; y++) {
+      for (int x = sq[0]; x < sq[0] + sq[2]; x++) {
+        int i = y * BENCH_WIDTH + x;
+        hsv.h_data[i] = sq[3] + (scene == SCENE_NOISY ? nextRandom() % 3 : 0);
+        hsv.s_data[i] = 200;
+        hsv.v_data[i] = 180;
+      }
+    }
+  }
+}
+
+static int decimalDigits(int value) {
+  return value >= 100 ? 3 : value >= 10 ? 2 : 1;
+}
+
+// Size of the same regions in the old text dump:
+// REGION / <id> / x,y,w,h, then one "H,S,V H,S,V ..." line per row, HSV_END
+static size_t textDumpBytes(const HSVImage& hsv, const std::vector<DetectionRegion>& regions) {
+  size_t bytes = 0;
+  for (size_t r = 0; r < regions.size(); r++) {
+    const DetectionRegion& region = regions[r];
+    int x0 = std::max(0, region.x), y0 = std::max(0, region.y);
+    int x1 = std::min(hsv.width, region.x + region.width), y1 = std::min(hsv.height, region.y + region.height);
+    bytes += 8 + String(int(r)).length() + 2;
+    bytes += (String(x0) + "," + String(y0) + "," + String(x1 - x0) + "," + String(y1 - y0)).length() + 2;
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) {
+        int i = y * hsv.width + x;
+        bytes += decimalDigits(hsv.h_data[i]) + decimalDigits(hsv.s_data[i]) + decimalDigits(hsv.v_data[i]) + 3;
+      }
+      bytes += 1;  // no space after the last pixel, but \r\n
+    }
+  }
+  return bytes + 9;
+}
+
+// Decode the wire bytes and compare every plane with the source
+static bool roundTrip(const std::vector<uint8_t>& wire, const HSVImage& hsv,
+                      const std::vector<DetectionRegion>& regions) {
+  static std::vector<uint8_t> buffer(BENCH_MAX_REGIONS * BENCH_WIDTH * BENCH_HEIGHT * 3);
+  HSVRegionData decoded[BENCH_MAX_REGIONS];
+  ColorTable table;
+  BlobStreamParser parser(&table);
+  parser.setHSVBuffer(buffer.data(), buffer.size(), decoded, BENCH_MAX_REGIONS);
+  parser.feed(wire.data(), wire.size());
+  if (!parser.hsvReady()) return false;
+  
+  int expected = 0;
+  for (const DetectionRegion& region : regions) {
+    int w = std::min(hsv.width, region.x + region.width) - std::max(0, region.x);
+    int h = std::min(hsv.height, region.y + region.height) - std::max(0, region.y);
+    if (w > 0 && h > 0) expected++;
+  }
+  if (parser.hsvRegionCount() != expected) return false;
+  
+  for (int r = 0; r < parser.hsvRegionCount(); r++) {
+    const HSVRegionData& got = parser.hsvRegions()[r];
+    const uint8_t* planes[3] = {hsv.h_data, hsv.s_data, hsv.v_data};
+    const uint8_t* decoded_planes[3] = {got.h, got.s, got.v};
+    for (int p = 0; p < 3; p++) {
+      for (int y = 0; y < got.height; y++) {
+        if (memcmp(decoded_planes[p] + y * got.width, planes[p] + (got.y + y) * hsv.width + got.x, got.width)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 50;
+  
+  std::vector<DetectionRegion> regions = {
+    DetectionRegion(0, 0, BENCH_WIDTH, BENCH_HEIGHT),
+    DetectionRegion(100, 40, 64, 48),
+    DetectionRegion(BENCH_WIDTH - 40, BENCH_HEIGHT - 30, 80, 60),
+  };
+  getRegionManager().setRegionSet("dump", regions);
+  RegionSetId set_id = getRegionManager().findRegionSet("dump");
+  
+  HSVImage hsv;
+  hsv.width = BENCH_WIDTH;
+  hsv.height = BENCH_HEIGHT;
+  hsv.h_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.s_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.v_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  
+  CaptureTransport link;
+  BlobCommandInterface server(&link);
+  
+  const char* scene_names[3] = {"flat", "gradient", "noisy"};
+  const char* encoding_names[3] = {"RAW", "RLE", "DELTA"};
+  
+  printf("%dx%d, %d regions (one clipped), %d frames per encoding:\n", BENCH_WIDTH, BENCH_HEIGHT,
+         int(regions.size()), frames);
+  for (int scene = SCENE_FLAT; scene <= SCENE_NOISY; scene++) {
+    rng_state = 12345;
+    drawScene(hsv, Scene(scene));
+    size_t text_bytes = textDumpBytes(hsv, regions);
+    printf("  %-8s  text %7zu bytes/frame\n", scene_names[scene], text_bytes);
+    
+    for (uint8_t encoding = HSV_ENC_RAW; encoding <= HSV_ENC_DELTA; encoding++) {
+      double best_us = 1e30;
+      for (int f = 0; f < frames; f++) {
+        link.bytes.clear();
+        double start = nowMicros();
+        server.sendHSVRegions(hsv, set_id, encoding);
+        best_us = std::min(best_us, nowMicros() - start);
+      }
+      
+      if (!roundTrip(link.bytes, hsv, regions)) {
+        printf("MISMATCH: %s scene, %s encoding\n", scene_names[scene], encoding_names[encoding]);
+        return 1;
+      }
+      printf("            %-5s %7zu bytes/frame  %5.1f%% of text  encode %7.1f us\n", encoding_names[encoding],
+             link.bytes.size(), 100.0 * link.bytes.size() / text_bytes, best_us);
+    }
+  }
+  
+  printf("every plane decoded byte for byte\n");
+  hsv.clear();
+  return 0;
+}
\ No newline at end of file
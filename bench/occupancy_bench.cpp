@@ -0,0 +1,250 @@
+// ========================================
+// HOST BENCHMARK: OCCUPANCY INDEX AGAINST BRUTE FORCE
+// ========================================
+//
+// Random scenes of RED / GREEN / BLUE discs on a noisy background at frame
+// sizes that are and are not multiples of the 32 x OCCUPANCY_TILE_H tiles,
+// down to a single pixel. Each frame is indexed twice: OccupancyIndex::build
+// (the standalone COUNT path) and detectBlobsInto with an index over a set
+// of a rectangle, a polygon and a mask region (pixels outside the set count
+// as no match). Every count is compared with a per-pixel count of the
+// classified frame:
+//   rectangles   random, partly or wholly outside the frame, empty, and
+//                with edges on and next to tile boundaries
+//   regions      random rectangles, polygons and masks through
+//                count(ColorId, region), as COUNT,<color>,<region_set> asks
+//   owned        the compiled set's owned shapes through count(index, shape)
+// plus a color that is not defined, which must count nothing. Reports the
+// time per rectangle count against the per-pixel count. Any mismatch is
+// fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -I. -Imain bench/occupancy_bench.cpp -o occupancy_bench
+//   ./occupancy_bench [queries per size]
+
+#include <Arduino.h>
+#include "blob_detector_ccl.h"
+
+#include <chrono>
+#include <vector>
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static int randomIn(int lo, int hi) {
+  return lo + int(nextRandom() % uint32_t(hi - lo + 1));
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void drawScene(HSVImage& hsv) {
+  const int pixels = hsv.width * hsv.height;
+  for (int i = 0; i < pixels; i++) {
+    hsv.h_data[i] = 90 + nextRandom() % 20;
+    hsv.s_data[i] = 20 + nextRandom() % 20;
+    hsv.v_data[i] = 100 + nextRandom() % 40;
+    // Lone matching pixels, so edges and sparse words are exercised too
+    if (nextRandom() % 50 == 0) {
+      hsv.h_data[i] = 5;
+      hsv.s_data[i] = 200;
+      hsv.v_data[i] = 180;
+    }
+  }
+  
+  static const uint8_t hues[3] = {5, 60, 115};
+  int discs = 1 + pixels / 2000;
+  for (int d = 0; d < discs; d++) {
+    int radius = 1 + nextRandom() % 20;
+    int cx = nextRandom() % hsv.width;
+    int cy = nextRandom() % hsv.height;
+    uint8_t hue = hues[nextRandom() % 3];
+    for (int y = std::max(0, cy - radius); y <= std::min(hsv.height - 1, cy + radius); y++) {
+      for (int x = std::max(0, cx - radius); x <= std::min(hsv.width - 1, cx + radius); x++) {
+        if ((x - cx) * (x - cx) + (y - cy) * (y - cy) > radius * radius) continue;
+        int i = y * hsv.width + x;
+        hsv.h_data[i] = hue;
+        hsv.s_data[i] = 200;
+        hsv.v_data[i] = 180;
+      }
+    }
+  }
+}
+
+// A rectangle, polygon or mask region somewhere around the frame
+static DetectionRegion randomRegion(int width, int height) {
+  int x = randomIn(-10, width), y = randomIn(-10, height);
+  int w = randomIn(1, width + 10), h = randomIn(1, height + 10);
+  switch (nextRandom() % 3) {
+    case 0:
+      return DetectionRegion(x, y, w, h);
+    case 1:
+      return polygonRegion({{x, y}, {x + w, y + h / 3}, {x + w / 2, y + h}, {x - w / 4, y + h / 2}});
+    default: {
+      std::vector<uint8_t> bits(w * h);
+      for (uint8_t& b : bits) b = nextRandom() % 3 != 0;
+      return maskRegion(x, y, w, h, bits.data());
+    }
+  }
+}
+
+// Matching pixels of reference inside the region, clipped to the frame
+static uint32_t bruteCount(const std::vector<uint8_t>& reference, int width, int height,
+                           const DetectionRegion& region) {
+  uint32_t total = 0;
+  for (int y = std::max(0, region.y); y < std::min(height, region.y + region.height); y++) {
+    for (int x = std::max(0, region.x); x < std::min(width, region.x + region.width); x++) {
+      if (region.contains(x, y)) total += reference[y * width + x];
+    }
+  }
+  return total;
+}
+
+static bool run(int width, int height, int queries) {
+  HSVImage hsv;
+  hsv.width = width;
+  hsv.height = height;
+  hsv.h_data = (uint8_t*)malloc(width * height);
+  hsv.s_data = (uint8_t*)malloc(width * height);
+  hsv.v_data = (uint8_t*)malloc(width * height);
+  rng_state = 12345 + width * 7 + height;
+  drawScene(hsv);
+  
+  // Every defined color, and a handle whose color was deleted
+  getColorManager().setColor("DELETED", ColorThresholds(0, 179, 0, 255, 0, 255));
+  ColorId deleted = getColorManager().findColor("DELETED");
+  getColorManager().deleteColor("DELETED");
+  std::vector<ColorId> colors = getColorManager().getAllColorIds();
+  colors.push_back(deleted);
+  
+  // Per color: the classified frame, and the same limited to the set
+  std::vector<DetectionRegion> set_regions = {
+    DetectionRegion(width / 8, height / 8, width / 2 + 1, height / 2 + 1),
+    polygonRegion({{width / 3, 0}, {width, height / 2}, {width / 2, height}, {0, height / 3}}),
+  };
+  {
+    std::vector<uint8_t> disc(16 * 16);
+    for (int y = 0; y < 16; y++) {
+      for (int x = 0; x < 16; x++) disc[y * 16 + x] = (x - 8) * (x - 8) + (y - 8) * (y - 8) < 64;
+    }
+    set_regions.push_back(maskRegion(width - 12, height - 12, 16, 16, disc.data()));
+  }
+  CompiledRegionSet compiled;
+  compileRegionSet(set_regions, width, height, compiled);
+  
+  ColorSnapshot color_set = getColorManager().snapshot();
+  std::vector<std::vector<uint8_t>> full(colors.size()), in_set(colors.size());
+  for (size_t c = 0; c < colors.size(); c++) {
+    full[c].resize(width * height);
+    in_set[c].resize(width * height);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        int i = y * width + x;
+        full[c][i] = color_set->hasColor(colors[c]) &&
+                     color_set->matchesColor(hsv.h_data[i], hsv.s_data[i], hsv.v_data[i], colors[c]);
+        bool covered = false;
+        for (const DetectionRegion& r : compiled.regions) covered = covered || r.contains(x, y);
+        in_set[c][i] = full[c][i] && covered;
+      }
+    }
+  }
+  
+  OccupancyIndex built, detected;
+  double start = nowMicros();
+  built.build(hsv, colors);
+  double build_us = nowMicros() - start;
+  DetectionResults results;
+  detectBlobsInto(hsv, compiled, colors, results, true, 10, &detected);
+  
+  const OccupancyIndex* indexes[2] = {&built, &detected};
+  const std::vector<std::vector<uint8_t>>* references[2] = {&full, &in_set};
+  long checks = 0;
+  double index_us = 0, brute_us = 0;
+  
+  for (int which = 0; which < 2; which++) {
+    const OccupancyIndex& index = *indexes[which];
+    const char* name = which == 0 ? "build" : "detectBlobsInto";
+    
+    for (size_t c = 0; c < colors.size(); c++) {
+      const std::vector<uint8_t>& reference = (*references[which])[c];
+      
+      // Rectangles: random, and with edges on or next to tile boundaries
+      for (int q = 0; q < queries; q++) {
+        int x, y, w, h;
+        if (q % 2) {
+          x = randomIn(-40, width + 8);
+          y = randomIn(-20, height + 4);
+          w = randomIn(0, width + 40);
+          h = randomIn(0, height + 20);
+        } else {
+          x = 32 * randomIn(0, width / 32 + 1) + randomIn(-1, 1);
+          y = OCCUPANCY_TILE_H * randomIn(0, height / OCCUPANCY_TILE_H + 1) + randomIn(-1, 1);
+          w = 32 * randomIn(0, width / 32 + 1) + randomIn(-1, 1);
+          h = OCCUPANCY_TILE_H * randomIn(0, height / OCCUPANCY_TILE_H + 1) + randomIn(-1, 1);
+        }
+        
+        double t0 = nowMicros();
+        uint32_t got = index.count(int(c), x, y, w, h);
+        double t1 = nowMicros();
+        uint32_t expected = w > 0 && h > 0 ? bruteCount(reference, width, height, DetectionRegion(x, y, w, h)) : 0;
+        double t2 = nowMicros();
+        index_us += t1 - t0;
+        brute_us += t2 - t1;
+        checks++;
+        if (got != expected) {
+          printf("RECTANGLE MISMATCH %dx%d %s color %d: %d,%d %dx%d gave %u, expected %u\n", width, height,
+                 name, int(c), x, y, w, h, got, expected);
+          return false;
+        }
+      }
+      
+      // Rectangles, polygons and masks, as COUNT on a region set
+      for (int q = 0; q < queries / 8 + 1; q++) {
+        DetectionRegion region = randomRegion(width, height);
+        uint32_t got = index.count(colors[c], region);
+        uint32_t expected = index.colorIndex(colors[c]) < 0 ? 0 : bruteCount(reference, width, height, region);
+        checks++;
+        if (got != expected) {
+          printf("REGION MISMATCH %dx%d %s color %d: %s region at %d,%d gave %u, expected %u\n", width,
+                 height, name, int(c), region.shape ? "shaped" : "rectangle", region.x, region.y, got, expected);
+          return false;
+        }
+      }
+      
+      // The set's owned shapes, as detectBlobsInto skips regions with them
+      for (size_t r = 0; r < compiled.owned.size(); r++) {
+        uint32_t got = index.count(int(c), compiled.owned[r]);
+        uint32_t expected = bruteCount(reference, width, height, compiled.owned_regions[r]);
+        checks++;
+        if (got != expected) {
+          printf("OWNED SHAPE MISMATCH %dx%d %s color %d region %d: %u, expected %u\n", width, height,
+                 name, int(c), int(r), got, expected);
+          return false;
+        }
+      }
+    }
+  }
+  
+  printf("  %4dx%-4d  %7ld counts  build %8.1f us  rectangle %6.3f us  per-pixel %8.3f us\n", width, height,
+         checks, build_us, index_us / (2 * colors.size() * queries), brute_us / (2 * colors.size() * queries));
+  hsv.clear();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int queries = argc > 1 ? atoi(argv[1]) : 400;
+  
+  printf("%d rectangle queries per color and index, tiles of 32x%d:\n", queries, OCCUPANCY_TILE_H);
+  const int sizes[][2] = {{320, 240}, {640, 480}, {176, 144}, {97, 53}, {33, 9}, {31, 7}, {200, 1}, {1, 1}};
+  for (const auto& size : sizes) {
+    if (!run(size[0], size[1], queries)) return 1;
+  }
+  printf("every count matched the per-pixel count\n");
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,182 @@
+// ========================================
+// HOST BENCHMARK: PYRAMID VS FULL-RESOLUTION DETECTION
+// ========================================
+//
+// Draws random RED / GREEN discs (radius 1..14) on a noisy grey YUV422
+// frame, detects them with yuv422ToHSV + detectBlobsStructured over the
+// whole frame (reference) and with PyramidDetector at factor 2 and 4, and
+// reports per resolution and factor:
+//   recall     reference blobs (>= min_size) found with the same size and center
+//   extra      pyramid blobs with no reference counterpart
+//   work       pyramid pixel work / full-resolution pixel work
+//   time       microseconds per frame, reference and pyramid
+//   allocs     heap allocations per pyramid frame (setFrame + detect into a
+//              reused DetectionResults) once past the first 10 frames
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -Imain bench/pyramid_bench.cpp -o pyramid_bench
+//   ./pyramid_bench [frames]
+
+#include <Arduino.h>
+#include "pyramid_detector.h"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#define BENCH_MIN_SIZE 10
+#define BENCH_WARMUP 10
+
+// ========================================
+// ALLOCATION COUNTER
+// ========================================
+
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// BT.601 studio swing, the inverse of the converter's math
+static void rgbToYuv(int r, int g, int b, uint8_t& y, uint8_t& u, uint8_t& v) {
+  y = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+  u = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+  v = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+}
+
+// Chroma is per pixel pair, like the sensor; only luma carries the noise
+static void drawScene(std::vector<uint8_t>& yuv, int width, int height, int discs) {
+  std::vector<uint8_t> y(width * height), u(width * height), v(width * height);
+  for (int i = 0; i < width * height; i++) {
+    rgbToYuv(110, 115, 120, y[i], u[i], v[i]);
+  }
+  
+  for (int d = 0; d < discs; d++) {
+    int radius = 1 + nextRandom() % 14;
+    int cx = nextRandom() % width;
+    int cy = nextRandom() % height;
+    bool red = nextRandom() & 1;
+    uint8_t dy, du, dv;
+    if (red) rgbToYuv(200, 30, 35, dy, du, dv);
+    else rgbToYuv(30, 170, 50, dy, du, dv);
+    
+    for (int py = cy - radius; py <= cy + radius; py++) {
+      for (int px = cx - radius; px <= cx + radius; px++) {
+        if (px < 0 || py < 0 || px >= width || py >= height) continue;
+        if ((px - cx) * (px - cx) + (py - cy) * (py - cy) > radius * radius) continue;
+        int i = py * width + px;
+        y[i] = dy; u[i] = du; v[i] = dv;
+      }
+    }
+  }
+  
+  for (int i = 0; i < width * height; i += 2) {
+    uint8_t* p = &yuv[i * 2];
+    int n0 = int(nextRandom() % 13) - 6;
+    int n1 = int(nextRandom() % 13) - 6;
+    p[0] = std::min(255, std::max(0, y[i] + n0));
+    p[1] = u[i];
+    p[2] = std::min(255, std::max(0, y[i + 1] + n1));
+    p[3] = v[i];
+  }
+}
+
+static bool sameBlob(const Blob& a, const Blob& b) {
+  return std::abs(a.center_x - b.center_x) <= 1 && std::abs(a.center_y - b.center_y) <= 1 &&
+         std::abs(a.pixel_count - b.pixel_count) * 20 <= a.pixel_count;
+}
+
+static void run(int width, int height, int discs, int frames) {
+  const std::vector<ColorId> colors = resolveColors({"RED", "GREEN"});
+  const std::vector<DetectionRegion> regions = {DetectionRegion(0, 0, width, height)};
+  std::vector<uint8_t> yuv(width * height * 2);
+  PyramidDetector pyramids[2] = {PyramidDetector(2), PyramidDetector(4)};
+  DetectionResults arenas[2];
+  size_t allocations[2] = {0, 0};
+  long found[2] = {0, 0}, extra[2] = {0, 0}, reference = 0;
+  double pyramid_us[2] = {0, 0}, full_us = 0;
+  rng_state = 12345;
+  
+  for (int f = 0; f < frames; f++) {
+    drawScene(yuv, width, height, discs);
+    
+    double start = nowMicros();
+    HSVImage hsv;
+    yuv422ToHSV(yuv.data(), width, height, hsv);
+    auto expected = detectBlobsStructured(hsv, regions, colors, true, BENCH_MIN_SIZE);
+    hsv.clear();
+    full_us += nowMicros() - start;
+    
+    for (ColorId color : colors) reference += expected[0].getBlobsForColor(color).size();
+    
+    for (int p = 0; p < 2; p++) {
+      size_t allocations_before = g_allocations;
+      start = nowMicros();
+      pyramids[p].setFrame(yuv.data(), width, height);
+      pyramids[p].detect(regions, colors, arenas[p], true, BENCH_MIN_SIZE);
+      pyramid_us[p] += nowMicros() - start;
+      if (f >= BENCH_WARMUP) allocations[p] += g_allocations - allocations_before;
+      auto results = arenas[p].toRegionResults();
+      
+      for (ColorId color : colors) {
+        const auto& want = expected[0].getBlobsForColor(color);
+        const auto& got = results[0].getBlobsForColor(color);
+        for (const Blob& b : want) {
+          for (const Blob& g : got) {
+            if (sameBlob(b, g)) { found[p]++; break; }
+          }
+        }
+        for (const Blob& g : got) {
+          bool known = false;
+          for (const Blob& b : want) known = known || sameBlob(b, g);
+          if (!known) extra[p]++;
+        }
+      }
+    }
+  }
+  
+  printf("%dx%d, %d discs, %ld reference blobs, full %.0f us/frame\n",
+         width, height, discs, reference, full_us / frames);
+  for (int p = 0; p < 2; p++) {
+    const PyramidStats& s = pyramids[p].stats();
+    printf("  factor %d   recall %5.1f%%  extra %4ld  work %5.1f%%  windows %4.1f/frame  %6.0f us/frame"
+           "  %.2f allocs/frame\n",
+           pyramids[p].getFactor(), reference ? 100.0 * found[p] / reference : 100.0, extra[p],
+           100.0 * s.workRatio(), double(s.windows) / s.frames, pyramid_us[p] / frames,
+           frames > BENCH_WARMUP ? double(allocations[p]) / (frames - BENCH_WARMUP) : 0.0);
+  }
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 200;
+  
+  run(160, 120, 4, frames);
+  run(160, 120, 12, frames);
+  run(320, 240, 4, frames);
+  run(320, 240, 12, frames);
+  run(640, 480, 8, frames / 4 + 1);
+  return 0;
+}
\ No newline at end of file
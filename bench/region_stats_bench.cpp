@@ -0,0 +1,221 @@
+// ========================================
+// HOST BENCHMARK: REGION STATISTICS VS FULL DETECTION
+// ========================================
+//
+// A QVGA scene of random RED, GREEN and (undefined) blue discs on a noisy
+// grey background, covered by a 4x4 region grid short of its last cell
+// plus one region over its middle, listed first so it owns the pixels it
+// shares with the grid (16 regions, the most the client keeps).
+// Per frame, with every defined color, it times:
+//   stats      computeRegionStats alone (frames with no detection)
+//   detect     detectBlobsInto into a reused arena
+//   + stats    the same with the statistics folded into its classification
+// checks every coverage count, channel sum and histogram bin of both
+// statistics paths against a plain per-pixel count over the pixels each
+// region owns, checks that folding leaves the blobs alone, and decodes the
+// binary RSTATS records with the client's BlobStreamParser. Any mismatch
+// is fatal.
+//
+// Build & run from the repository root:
+//   g++ -O2 -std=c++17 -Ibench/host -I. -Imain bench/region_stats_bench.cpp -o region_stats_bench
+//   ./region_stats_bench [frames]
+
+#include <Arduino.h>
+#include "blob_detector_ccl.h"
+#include "blob_stream_parser.h"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#define BENCH_WIDTH 320
+#define BENCH_HEIGHT 240
+
+static uint32_t rng_state = 12345;
+
+static uint32_t nextRandom() {
+  rng_state = rng_state * 1664525 + 1013904223;
+  return rng_state >> 8;
+}
+
+static double nowMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void drawScene(HSVImage& hsv, int discs) {
+  const int pixels = BENCH_WIDTH * BENCH_HEIGHT;
+  for (int i = 0; i < pixels; i++) {
+    hsv.h_data[i] = 90 + nextRandom() % 20;
+    hsv.s_data[i] = 20 + nextRandom() % 20;
+    hsv.v_data[i] = 100 + nextRandom() % 40;
+  }
+  
+  static const uint8_t hues[3] = {5, 60, 115};
+  for (int d = 0; d < discs; d++) {
+    int radius = 2 + nextRandom() % 14;
+    int cx = nextRandom() % BENCH_WIDTH;
+    int cy = nextRandom() % BENCH_HEIGHT;
+    uint8_t hue = hues[nextRandom() % 3];
+    
+    for (int y = std::max(0, cy - radius); y <= std::min(BENCH_HEIGHT - 1, cy + radius); y++) {
+      for (int x = std::max(0, cx - radius); x <= std::min(BENCH_WIDTH - 1, cx + radius); x++) {
+        if ((x - cx) * (x - cx) + (y - cy) * (y - cy) > radius * radius) continue;
+        int i = y * BENCH_WIDTH + x;
+        hsv.h_data[i] = hue;
+        hsv.s_data[i] = 200;
+        hsv.v_data[i] = 180;
+      }
+    }
+  }
+}
+
+// Decode the wire form with the client parser and compare it to the source
+static bool roundTrip(const std::vector<RegionStats>& stats, const std::vector<ColorId>& colors) {
+  String header = "RSTATS," + String(int(stats.size()));
+  for (ColorId color : colors) header += String(",") + getColorManager().colorName(color).c_str();
+  header += "\n";
+  
+  std::vector<uint8_t> wire(header.c_str(), header.c_str() + header.length());
+  appendRegionStatsBinary(stats, wire);
+  
+  ColorTable table;
+  BlobStreamParser parser(&table);
+  parser.feed(wire.data(), wire.size());
+  if (!parser.statsReady() || parser.regionStatsCount() != int(stats.size())) return false;
+  
+  for (size_t r = 0; r < stats.size(); r++) {
+    const RegionStatsResult& got = parser.regionStats()[r];
+    if (got.pixels != stats[r].pixels || got.mean_h != stats[r].meanH() ||
+        got.mean_s != stats[r].meanS() || got.mean_v != stats[r].meanV()) return false;
+    for (size_t c = 0; c < colors.size(); c++) {
+      uint8_t id = table.find(getColorManager().colorName(colors[c]).c_str());
+      if (std::fabs(got.coverageOf(id) - stats[r].coverage(c)) > 1.0f / 65535) return false;
+    }
+  }
+  return true;
+}
+
+static bool sameStats(const RegionStats& a, const RegionStats& b) {
+  return a.pixels == b.pixels && a.sum_h == b.sum_h && a.sum_s == b.sum_s && a.sum_v == b.sum_v &&
+         memcmp(a.hist_h, b.hist_h, sizeof(a.hist_h)) == 0 &&
+         memcmp(a.hist_s, b.hist_s, sizeof(a.hist_s)) == 0 &&
+         memcmp(a.hist_v, b.hist_v, sizeof(a.hist_v)) == 0 && a.color_pixels == b.color_pixels;
+}
+
+static bool run(int frames, int discs) {
+  std::vector<DetectionRegion> grid;
+  grid.push_back(DetectionRegion(100, 50, 120, 100));
+  for (int ry = 0; ry < 4; ry++) {
+    for (int rx = 0; rx < 4 && ry * 4 + rx < 15; rx++) grid.push_back(DetectionRegion(rx * 80, ry * 60, 80, 60));
+  }
+  getRegionManager().setRegionSet("grid", grid);
+  RegionSetId set_id = getRegionManager().findRegionSet("grid");
+  const std::vector<ColorId> colors = getColorManager().getAllColorIds();
+  std::shared_ptr<const CompiledRegionSet> compiled =
+    getRegionManager().getCompiledRegionSet(set_id, BENCH_WIDTH, BENCH_HEIGHT);
+  
+  HSVImage hsv;
+  hsv.width = BENCH_WIDTH;
+  hsv.height = BENCH_HEIGHT;
+  hsv.h_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.s_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  hsv.v_data = (uint8_t*)malloc(BENCH_WIDTH * BENCH_HEIGHT);
+  
+  std::vector<RegionStats> stats, folded;
+  RegionStatsWorkspace work;
+  DetectionResults results, folded_results;
+  ColorSnapshot color_set = getColorManager().snapshot();
+  double stats_us = 0, detect_us = 0, folded_us = 0;
+  rng_state = 12345;
+  
+  for (int f = 0; f < frames; f++) {
+    drawScene(hsv, discs);
+    
+    double start = nowMicros();
+    computeRegionStats(hsv, set_id, colors, stats, work);
+    stats_us += nowMicros() - start;
+    
+    start = nowMicros();
+    detectBlobsInto(hsv, set_id, colors, results);
+    detect_us += nowMicros() - start;
+    
+    start = nowMicros();
+    detectBlobsInto(hsv, set_id, colors, folded_results, true, 10, nullptr, &folded);
+    folded_us += nowMicros() - start;
+    
+    if (folded.size() != stats.size() || folded_results.blobCount() != results.blobCount()) {
+      printf("FOLDED DETECTION MISMATCH at frame %d\n", f);
+      return false;
+    }
+    for (size_t r = 0; r < grid.size(); r++) {
+      const DetectionRegion& region = compiled->regions[r];
+      const DetectionRegion& owned = compiled->owned_regions[r];
+      if (!sameStats(stats[r], folded[r])) {
+        printf("FOLDED STATS MISMATCH at frame %d, region %d\n", f, int(r));
+        return false;
+      }
+      
+      RegionStats expected;
+      expected.reset(0);
+      for (int y = region.y; y < region.y + region.height; y++) {
+        for (int x = region.x; x < region.x + region.width; x++) {
+          if (!owned.contains(x, y)) continue;
+          int i = y * BENCH_WIDTH + x;
+          expected.pixels++;
+          expected.sum_h += hsv.h_data[i];
+          expected.sum_s += hsv.s_data[i];
+          expected.sum_v += hsv.v_data[i];
+          expected.hist_h[std::min(hsv.h_data[i] * STATS_BINS / 180, STATS_BINS - 1)]++;
+          expected.hist_s[hsv.s_data[i] >> 4]++;
+          expected.hist_v[hsv.v_data[i] >> 4]++;
+        }
+      }
+      if (stats[r].pixels != expected.pixels || stats[r].sum_h != expected.sum_h ||
+          stats[r].sum_s != expected.sum_s || stats[r].sum_v != expected.sum_v ||
+          memcmp(stats[r].hist_h, expected.hist_h, sizeof(expected.hist_h)) != 0 ||
+          memcmp(stats[r].hist_s, expected.hist_s, sizeof(expected.hist_s)) != 0 ||
+          memcmp(stats[r].hist_v, expected.hist_v, sizeof(expected.hist_v)) != 0) {
+        printf("HISTOGRAM MISMATCH at frame %d, region %d\n", f, int(r));
+        return false;
+      }
+      
+      for (size_t c = 0; c < colors.size(); c++) {
+        uint32_t expected = 0;
+        for (int y = region.y; y < region.y + region.height; y++) {
+          for (int x = region.x; x < region.x + region.width; x++) {
+            if (!owned.contains(x, y)) continue;
+            int i = y * BENCH_WIDTH + x;
+            expected += color_set->matchesColor(hsv.h_data[i], hsv.s_data[i], hsv.v_data[i], colors[c]);
+          }
+        }
+        if (stats[r].color_pixels[c] != expected) {
+          printf("COVERAGE MISMATCH at frame %d, region %d\n", f, int(r));
+          return false;
+        }
+      }
+    }
+    if (!roundTrip(stats, colors)) {
+      printf("ROUND TRIP MISMATCH at frame %d\n", f);
+      return false;
+    }
+  }
+  
+  printf("  %2d discs   stats %5.0f us (%4.1f%%)  detect %5.0f us  + stats %5.0f us (+%4.1f%%)  %zu bytes/frame\n",
+         discs, stats_us / frames, 100.0 * stats_us / detect_us, detect_us / frames, folded_us / frames,
+         100.0 * (folded_us - detect_us) / detect_us, grid.size() * regionStatsRecordSize(colors.size()));
+  hsv.clear();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 100;
+  
+  printf("%d frames of %dx%d, 15 grid regions + 1 overlapping, %d colors, %d histogram bins:\n", frames,
+         BENCH_WIDTH, BENCH_HEIGHT, int(getColorManager().getAllColorIds().size()), STATS_BINS);
+  const int discs[] = {4, 16, 48};
+  for (int d : discs) {
+    if (!run(frames, d)) return 1;
+  }
+  return 0;
+}
\ No newline at end of file
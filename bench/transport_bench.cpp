@@ -0,0 +1,356 @@
+// ========================================
+// HOST HARNESS: SERVER <-> CLIENT OVER A TRANSPORT
+// ========================================
+//
+// Runs BlobCommandInterface (firmware side) and Camera (client side) against
+// each other over FdTransport and reports:
+//   latency      blocking COLOR_SET round trips (min / avg / p99)
+//   commands/s   pipelined COLOR_SET, CAMERA_MAX_INFLIGHT in flight
+//   results/s    DETECT_ALL on a synthetic scene, detections and blobs per second
+//   changes      SUBSCRIBE on the same scene at 30 fps with slight jitter:
+//                wire bytes per frame against full DETECT_ALL results
+//   tracks       TRACK on the same scene: distinct track ids seen (as many
+//                as blobs per frame when ids are stable) and wire bytes per frame;
+//                then again on a set of two overlapping regions, where a blob
+//                in both must still get one id (fatal otherwise)
+// Each link direction is paced to the given baud rate (0 = unthrottled).
+//
+// Build from the repository root:
+//   g++ -O2 -std=c++17 -pthread -Ibench/host -I. -Imain bench/transport_bench.cpp -o transport_bench
+//
+// One process, server on a second thread:
+//   ./transport_bench                     socketpair, 115200 / 921600 / unthrottled
+//   ./transport_bench loop pty 921600     through a pty master/slave pair
+//   ./transport_bench loop pipe 0         through two FIFOs in /tmp
+//
+// Two processes:
+//   ./transport_bench server pty 921600           prints the slave path
+//   ./transport_bench client /dev/pts/N 921600
+//   ./transport_bench server unix:/tmp/blob.sock 921600
+//   ./transport_bench client unix:/tmp/blob.sock 921600
+
+#include <Arduino.h>
+#include "fd_transport.h"
+#include "blob_command_interface.h"
+#include "blob_client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#define SCENE_WIDTH 160
+#define SCENE_HEIGHT 120
+#define SCENE_FRAME_MS 33
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ========================================
+// SERVER SIDE
+// ========================================
+
+// A few solid squares in the default RED / GREEN / BLUE ranges on grey.
+// Frames jitter the first square by a pixel and slowly move the last one.
+static void drawScene(HSVImage& hsv, int frame) {
+  memset(hsv.h_data, 0, SCENE_WIDTH * SCENE_HEIGHT);
+  memset(hsv.s_data, 10, SCENE_WIDTH * SCENE_HEIGHT);
+  memset(hsv.v_data, 128, SCENE_WIDTH * SCENE_HEIGHT);
+  
+  int squares[][4] = {  // x, y, size, hue
+    {10, 10, 12, 5}, {60, 20, 16, 60}, {120, 15, 10, 115},
+    {20, 80, 14, 60}, {90, 70, 20, 5}, {135, 95, 8, 115}
+  };
+  squares[0][0] += frame % 2;
+  squares[5][0] = 100 + (frame / 4) % 50;
+  for (const auto& sq : squares) {
+    for (int y = sq[1]; y < sq[1] + sq[2]; y++) {
+      for (int x = sq[0]; x < sq[0] + sq[2]; x++) {
+        int i = y * SCENE_WIDTH + x;
+        hsv.h_data[i] = sq[3];
+        hsv.s_data[i] = 200;
+        hsv.v_data[i] = 200;
+      }
+    }
+  }
+}
+
+static void serve(Transport* link, const std::atomic<bool>* stop) {
+  HSVImage scene;
+  scene.width = SCENE_WIDTH;
+  scene.height = SCENE_HEIGHT;
+  scene.h_data = static_cast<uint8_t*>(malloc(SCENE_WIDTH * SCENE_HEIGHT));
+  scene.s_data = static_cast<uint8_t*>(malloc(SCENE_WIDTH * SCENE_HEIGHT));
+  scene.v_data = static_cast<uint8_t*>(malloc(SCENE_WIDTH * SCENE_HEIGHT));
+  drawScene(scene, 0);
+  
+  BlobCommandInterface server(link);
+  int frame = 0;
+  unsigned long last_frame = millis();
+  while (!stop || !*stop) {
+    server.processCommands();
+    if (server.hasPendingRequest()) server.servicePendingRequest(scene);
+
+    if ((server.hasSubscriptions() || server.isTracking()) && millis() - last_frame >= SCENE_FRAME_MS) {
+      last_frame = millis();
+      drawScene(scene, ++frame);
+      if (server.hasSubscriptions()) server.reportChanges(scene);
+      if (server.isTracking()) server.reportTracks(scene);
+    }
+  }
+  scene.clear();
+}
+
+// ========================================
+// CLIENT SIDE
+// ========================================
+
+static void measureLatency(Camera& cam, int rounds) {
+  std::vector<double> samples;
+  for (int i = 0; i < rounds; i++) {
+    double start = nowSeconds();
+    if (!cam.setColor("LAT", 0, 10, 50, 255, 50, 255)) {
+      printf("  latency     : command failed (%s)\n", cam.lastError());
+      return;
+    }
+    samples.push_back((nowSeconds() - start) * 1000.0);
+  }
+  
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double s : samples) sum += s;
+  printf("  latency     : min %.2f ms  avg %.2f ms  p99 %.2f ms  (%d round trips)\n",
+         samples.front(), sum / samples.size(), samples[samples.size() * 99 / 100], rounds);
+}
+
+static void measureCommands(Camera& cam, int total) {
+  int submitted = 0;
+  double start = nowSeconds();
+  while (submitted < total) {
+    if (cam.submit("COLOR_SET,PIPE,0,10,50,255,50,255")) {
+      submitted++;
+    } else {
+      cam.poll();
+    }
+  }
+  bool ok = cam.waitAll(10000);
+  double seconds = nowSeconds() - start;
+  
+  printf("  commands/s  : %.0f  (%d pipelined%s)\n", total / seconds, total,
+         ok ? "" : ", some unanswered");
+}
+
+static int countFrame_frames = 0;
+
+static void countFrame(void*, const BlobResult*, int) {
+  countFrame_frames++;
+}
+
+// Bytes received per reported frame: full DETECT_ALL results vs SUBSCRIBE
+static void measureChanges(Camera& cam, FdTransport* link, double duration) {
+  size_t before = link->bytesReceived();
+  int full_frames = 0;
+  double start = nowSeconds();
+  while (nowSeconds() - start < duration / 2) {
+    if (cam.detectAll("main", 5000) < 0) break;
+    full_frames++;
+  }
+  double full_bytes = full_frames ? double(link->bytesReceived() - before) / full_frames : 0;
+
+  cam.onBlobs(countFrame);
+  countFrame_frames = 0;
+  before = link->bytesReceived();
+  start = nowSeconds();
+  cam.subscribe("main", 2, 20, 30);
+  while (nowSeconds() - start < duration / 2) {
+    cam.poll();
+    delay(1);
+  }
+  cam.unsubscribe("main");
+  cam.onBlobs(nullptr);
+
+  int frames = static_cast<int>((nowSeconds() - start) * 1000 / SCENE_FRAME_MS);
+  double change_bytes = frames ? double(link->bytesReceived() - before) / frames : 0;
+  printf("  changes     : %.0f B/frame full, %.1f B/frame change-only (%d reports in %d frames)\n",
+         full_bytes, change_bytes, countFrame_frames, frames);
+}
+
+static std::vector<uint16_t> trackFrame_ids;
+static int trackFrame_blobs = 0;
+
+static void trackFrame(void*, const BlobResult* blobs, int count) {
+  countFrame_frames++;
+  trackFrame_blobs = count;
+  for (int i = 0; i < count; i++) {
+    if (std::find(trackFrame_ids.begin(), trackFrame_ids.end(), blobs[i].track_id) == trackFrame_ids.end()) {
+      trackFrame_ids.push_back(blobs[i].track_id);
+    }
+  }
+}
+
+// Track ids stay put across frames: one id per blob of the scene. Returns
+// the number of distinct ids.
+static int measureTracks(Camera& cam, FdTransport* link, double duration, const char* region_set) {
+  cam.onBlobs(trackFrame);
+  countFrame_frames = 0;
+  trackFrame_ids.clear();
+  trackFrame_blobs = 0;
+  size_t before = link->bytesReceived();
+  double start = nowSeconds();
+  cam.track(region_set, 10);
+  while (nowSeconds() - start < duration) {
+    cam.poll();
+    delay(1);
+  }
+  cam.untrack();
+  cam.onBlobs(nullptr);
+
+  printf("  tracks      : %d distinct ids for %d blobs per frame, %.1f B/frame (%d reports, %s)\n",
+         static_cast<int>(trackFrame_ids.size()), trackFrame_blobs,
+         countFrame_frames ? double(link->bytesReceived() - before) / countFrame_frames : 0.0,
+         countFrame_frames, region_set);
+  return trackFrame_ids.size();
+}
+
+static void measureResults(Camera& cam, double duration) {
+  int detections = 0;
+  long blobs = 0;
+  double start = nowSeconds();
+  while (nowSeconds() - start < duration) {
+    int n = cam.detectAll("main", 5000);
+    if (n < 0) {
+      printf("  results/s   : DETECT_ALL timed out\n");
+      return;
+    }
+    detections++;
+    blobs += n;
+  }
+  double seconds = nowSeconds() - start;
+  
+  printf("  results/s   : %.0f blobs/s  %.1f detections/s  (%ld blobs per detection)\n",
+         blobs / seconds, detections / seconds, detections ? blobs / detections : 0L);
+}
+
+static bool runClient(FdTransport* link, unsigned long baud) {
+  Camera cam(link);
+  cam.setupDefaultColors();
+  if (!cam.setupFullScreen("main", SCENE_WIDTH, SCENE_HEIGHT)) {
+    printf("  server does not answer\n");
+    return false;
+  }
+  
+  bool slow = baud != 0 && baud < 200000;
+  measureLatency(cam, slow ? 50 : 200);
+  measureCommands(cam, slow ? 500 : 5000);
+  measureResults(cam, slow ? 3.0 : 1.0);
+  measureChanges(cam, link, 4.0);
+  int ids = measureTracks(cam, link, 2.0, "main");
+  int blobs = trackFrame_blobs;
+
+  // The whole frame, then its middle again: every blob in the middle lies
+  // in both regions and belongs to the first
+  const int pair[][4] = {{0, 0, SCENE_WIDTH, SCENE_HEIGHT}, {40, 0, 80, SCENE_HEIGHT}};
+  if (!cam.setMultiRegion("pair", pair, 2)) {
+    printf("  tracks      : REGION_MULTI failed (%s)\n", cam.lastError());
+    return false;
+  }
+  if (measureTracks(cam, link, 2.0, "pair") != ids || trackFrame_blobs != blobs) {
+    printf("  tracks      : OVERLAPPING REGIONS REPORTED A BLOB TWICE\n");
+    return false;
+  }
+  return true;
+}
+
+// ========================================
+// DRIVER
+// ========================================
+
+static bool openPair(const char* kind, FdTransport& server_end, FdTransport& client_end) {
+  if (strcmp(kind, "socket") == 0) {
+    return FdTransport::socketPair(server_end, client_end);
+  }
+  if (strcmp(kind, "pty") == 0) {
+    char slave[64];
+    return server_end.openPty(slave, sizeof(slave)) && client_end.openDevice(slave);
+  }
+  if (strcmp(kind, "pipe") == 0) {
+    return server_end.openPipes("/tmp/blob_bench_c2s", "/tmp/blob_bench_s2c") &&
+           client_end.openPipes("/tmp/blob_bench_s2c", "/tmp/blob_bench_c2s");
+  }
+  return false;
+}
+
+static bool runLoopback(const char* kind, unsigned long baud) {
+  FdTransport server_end, client_end;
+  if (!openPair(kind, server_end, client_end)) {
+    printf("cannot open %s link\n", kind);
+    return false;
+  }
+  server_end.begin(baud);
+  client_end.begin(baud);
+  
+  printf("%s link, %s:\n", kind, baud ? String(baud).c_str() : "unthrottled");
+  
+  std::atomic<bool> stop(false);
+  std::thread server_thread(serve, &server_end, &stop);
+  bool ok = runClient(&client_end, baud);
+  stop = true;
+  server_thread.join();
+  
+  printf("  wire bytes  : %zu client->server, %zu server->client\n",
+         client_end.bytesSent(), server_end.bytesSent());
+  return ok;
+}
+
+// "unix:<path>" or a tty path
+static bool openEndpoint(FdTransport& link, const char* where, bool listen) {
+  if (strncmp(where, "unix:", 5) == 0) {
+    return listen ? link.acceptUnix(where + 5) : link.connectUnix(where + 5);
+  }
+  return link.openDevice(where);
+}
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : "loop";
+  const char* where = argc > 2 ? argv[2] : "socket";
+  unsigned long baud = argc > 3 ? strtoul(argv[3], nullptr, 10) : 0;
+  
+  if (strcmp(mode, "loop") == 0) {
+    if (argc > 3) return runLoopback(where, baud) ? 0 : 1;
+    const unsigned long rates[] = {115200, 921600, 0};
+    for (unsigned long rate : rates) {
+      if (!runLoopback(where, rate)) return 1;
+    }
+    return 0;
+  }
+  
+  FdTransport link;
+  if (strcmp(mode, "server") == 0) {
+    if (strcmp(where, "pty") == 0) {
+      char slave[64];
+      if (!link.openPty(slave, sizeof(slave))) return 1;
+      printf("serving on %s\n", slave);
+    } else {
+      printf("waiting on %s\n", where);
+      if (!openEndpoint(link, where, true)) return 1;
+    }
+    fflush(stdout);
+    link.begin(baud);
+    serve(&link, nullptr);
+    return 0;
+  }
+  
+  if (strcmp(mode, "client") == 0) {
+    if (!openEndpoint(link, where, false)) {
+      printf("cannot open %s\n", where);
+      return 1;
+    }
+    link.begin(baud);
+    printf("%s, %s:\n", where, baud ? String(baud).c_str() : "unthrottled");
+    return runClient(&link, baud) ? 0 : 1;
+  }
+  
+  printf("usage: %s [loop [socket|pty|pipe] [baud] | server pty|unix:<path> [baud] | client <tty>|unix:<path> [baud]]\n",
+         argv[0]);
+  return 1;
+}
\ No newline at end of file
@@ -2,121 +2,315 @@
 #define BLOB_CLIENT_H
 
 #include <Arduino.h>
-#include <vector>
-#include <string>
+#include "blob_stream_parser.h"
+#include "main/transport.h"
 
 // ========================================
 // CAMERA CLIENT
 // ========================================
 
-struct BlobResult {
-  int region_id;
-  std::string color;
-  int x, y;
-  int size;
-  
-  BlobResult(int r_id, const std::string& c, int px, int py, int s) 
-    : region_id(r_id), color(c), x(px), y(py), size(s) {}
-};
+// Commands that may be awaiting an ACK/NAK at the same time
+#define CAMERA_MAX_INFLIGHT 32
 
-struct HSVPixel {
-  uint8_t h, s, v;
-  HSVPixel(uint8_t hue, uint8_t sat, uint8_t val) : h(hue), s(sat), v(val) {}
-};
+// Longest command line built by the client
+#define CAMERA_CMD_LEN 256
+
+// Most CSV fields the camera takes in one line, the "#<seq>" prefix
+// included (CMD_MAX_TOKENS on the camera); longer lines are refused there
+#define CAMERA_CMD_MAX_FIELDS 32
+
+// A command unanswered for this long (lost line, camera reboot) gives up
+// its inflight slot to new commands
+#define CAMERA_INFLIGHT_TIMEOUT_MS 30000
 
-struct HSVRegionData {
-  int region_id;
-  int x, y, width, height;
-  std::vector<std::vector<HSVPixel>> pixels; // [row][col]
+enum CommandState : uint8_t {
+  CMD_FREE,     // Slot unused / sequence id unknown
+  CMD_PENDING,  // Sent, no answer yet
+  CMD_ACKED,    // Server acknowledged
+  CMD_FAILED    // Server answered NAK (see lastError())
 };
 
+// Called with every completed result frame (blobs stay valid until the next one)
+typedef void (*BlobFrameCallback)(void* ctx, const BlobResult* blobs, int count);
+
+// Called with every name of a COLOR_LIST / REGION_LIST response
+typedef void (*NameCallback)(void* ctx, const char* name);
+
 class Camera {
 private:
-  HardwareSerial* serial;
-  String last_response;
+  UartTransport uart;
+  Transport* serial;
+  ColorTable color_table;
+  BlobStreamParser parser;
+  char last_error[BLOB_CLIENT_LINE_LEN];
   bool debug_enabled;
   
-  // Send command and wait for ACK
-  bool sendCommand(const String& command) {
-    serial->println(command);
-    return waitForResponse("ACK:" + command.substring(0, command.indexOf(',')), 5000);
+  // Pipelined commands
+  bool batching;
+  bool batch_failed;
+  
+  struct InflightCommand {
+    uint16_t seq;
+    CommandState state;
+    unsigned long sent_ms;
+  };
+  
+  InflightCommand inflight[CAMERA_MAX_INFLIGHT];
+  uint16_t next_seq;
+  
+  // Tagged multi-line response currently being collected ("#<seq>,<header>" ... END).
+  // Only one is open at a time, see submitRequest().
+  uint16_t response_seq;
+  const char* response_header;
+  bool response_active;
+  bool response_done;
+  NameCallback response_sink;
+  void* response_ctx;
+  
+  // Last CALIBRATED / CALIBRATE_FAILED line, empty while a calibration runs
+  char calibration[BLOB_CLIENT_LINE_LEN];
+  
+  // A DETECT was answered; the next frame (or bare END) is its result
+  bool awaiting_frame;
+  
+  BlobFrameCallback frame_callback;
+  void* frame_ctx;
+  
+  InflightCommand* findInflight(uint16_t seq) {
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (inflight[i].state != CMD_FREE && inflight[i].seq == seq) {
+        return &inflight[i];
+      }
+    }
+    return nullptr;
   }
   
-  // Wait for specific response
-  bool waitForResponse(const String& expected, unsigned long timeout_ms = 5000) {
-    unsigned long start = millis();
-    while (millis() - start < timeout_ms) {
-      if (serial->available()) {
-        last_response = serial->readStringUntil('\n');
-        last_response.trim();
-        
-        if (debug_enabled) {
-          Serial.println("RX: " + last_response);
-        }
-        
-        if (last_response.startsWith(expected)) {
-          return true;
-        }
-        
-        if (last_response.startsWith("ERROR:")) {
-          if (debug_enabled) {
-            Serial.println("Server Error: " + last_response.substring(6));
-          }
-          return false;
-        }
+  InflightCommand* allocInflight() {
+    // Prefer never-used slots, then recycle answered ones
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (inflight[i].state == CMD_FREE) return &inflight[i];
+    }
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (inflight[i].state != CMD_PENDING) return &inflight[i];
+    }
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (millis() - inflight[i].sent_ms >= CAMERA_INFLIGHT_TIMEOUT_MS) return &inflight[i];
+    }
+    return nullptr;
+  }
+  
+  // Give up on a command that is still unanswered; its id reads CMD_FREE
+  void expire(uint16_t seq) {
+    InflightCommand* cmd = findInflight(seq);
+    if (cmd && cmd->state == CMD_PENDING) cmd->state = CMD_FREE;
+  }
+  
+  // A response announced by submitRequest() that may still arrive or is arriving
+  bool responseOpen() {
+    if (!response_header || response_done) return false;
+    return response_active || commandState(response_seq) == CMD_PENDING;
+  }
+  
+  // Stop collecting the response of seq, dropping the command if unanswered
+  void endRequest(uint16_t seq) {
+    response_header = nullptr;
+    response_active = false;
+    expire(seq);
+  }
+  
+  // ========================================
+  // PARSER CALLBACKS
+  // ========================================
+  
+  static void onAck(void* ctx, uint16_t seq, bool ok, const char* message) {
+    Camera* self = static_cast<Camera*>(ctx);
+    InflightCommand* cmd = self->findInflight(seq);
+    if (cmd) cmd->state = ok ? CMD_ACKED : CMD_FAILED;
+    
+    if (!ok) {
+      self->batch_failed = true;
+      strncpy(self->last_error, message, sizeof(self->last_error) - 1);
+      self->last_error[sizeof(self->last_error) - 1] = '\0';
+      if (self->debug_enabled) {
+        Serial.print("Server Error: ");
+        Serial.println(self->last_error);
       }
-      delay(1);
     }
-    return false;
   }
   
-  // Read lines until END or timeout
-  std::vector<String> readUntilEnd(unsigned long timeout_ms = 10000) {
-    std::vector<String> lines;
-    unsigned long start = millis();
+  static void onFrame(void* ctx, const BlobResult* blobs, int count) {
+    Camera* self = static_cast<Camera*>(ctx);
+    self->awaiting_frame = false;
+    if (self->frame_callback) self->frame_callback(self->frame_ctx, blobs, count);
+  }
+  
+  static void onLine(void* ctx, const char* line, size_t /*length*/) {
+    Camera* self = static_cast<Camera*>(ctx);
     
-    while (millis() - start < timeout_ms) {
-      if (serial->available()) {
-        String line = serial->readStringUntil('\n');
-        line.trim();
-        
-        if (debug_enabled) {
-          Serial.println("RX: " + line);
-        }
-        
-        if (line == "END") {
-          break;
-        }
-        
-        lines.push_back(line);
+    if (self->debug_enabled) {
+      Serial.print("RX: ");
+      Serial.println(line);
+    }
+    
+    if (self->response_active) {
+      if (strcmp(line, "END") == 0) {
+        self->response_active = false;
+        self->response_done = true;
+      } else if (self->response_sink) {
+        self->response_sink(self->response_ctx, line);
       }
-      delay(1);
+      return;
+    }
+    
+    if (line[0] == '#' && self->response_header) {
+      // "#<seq>,<header>"
+      char* end = nullptr;
+      long seq = strtol(line + 1, &end, 10);
+      if (end && *end == ',' && seq == self->response_seq &&
+          strcmp(end + 1, self->response_header) == 0) {
+        InflightCommand* cmd = self->findInflight(self->response_seq);
+        if (cmd) cmd->state = CMD_ACKED;
+        self->response_active = true;
+      }
+      return;
+    }
+    
+    if (strncmp(line, "CALIBRATED,", 11) == 0 || strncmp(line, "CALIBRATE_FAILED,", 17) == 0) {
+      strncpy(self->calibration, line, sizeof(self->calibration) - 1);
+      self->calibration[sizeof(self->calibration) - 1] = '\0';
+      return;
     }
     
-    return lines;
+    if (self->awaiting_frame && strcmp(line, "END") == 0) {
+      // Simple format with no blobs is just "END"
+      self->parser.closeEmptyFrame();
+    }
   }
   
-  // Parse CSV line into tokens
-  std::vector<String> parseCSV(const String& line) {
-    std::vector<String> tokens;
-    int start = 0;
-    
-    while (start < line.length()) {
-      int comma = line.indexOf(',', start);
-      if (comma == -1) {
-        tokens.push_back(line.substring(start));
-        break;
-      } else {
-        tokens.push_back(line.substring(start, comma));
-        start = comma + 1;
+  // ========================================
+  // COMMAND HELPERS
+  // ========================================
+  
+  // Whether a command of fields CSV fields, plus its "#<seq>", is short
+  // enough for the camera to take
+  bool fieldsFit(int fields) const {
+    if (fields + 1 <= CAMERA_CMD_MAX_FIELDS) return true;
+    if (debug_enabled) Serial.printf("Command of %d fields is over the camera's %d\n", fields + 1, CAMERA_CMD_MAX_FIELDS);
+    return false;
+  }
+  
+  // Send command and wait for its ACK (inside a batch: queue it and return)
+  bool sendCommand(const char* command, unsigned long timeout_ms = 5000) {
+    uint16_t seq = submit(command);
+    
+    if (batching) {
+      // Window full: wait only until the oldest command is answered
+      unsigned long start = millis();
+      while (seq == 0 && millis() - start < timeout_ms) {
+        poll();
+        delay(1);
+        seq = submit(command);
       }
+      return seq != 0;
+    }
+    
+    if (seq == 0) return false;
+    return waitForCommand(seq, timeout_ms);
+  }
+  
+  // Non-blocking: send a command answered by "#<seq>,<header>" ... END.
+  // Returns 0 while the response of an earlier request is still open: the
+  // body lines are routed by that one header.
+  uint16_t submitRequest(const char* command, const char* header, NameCallback sink, void* ctx) {
+    if (responseOpen()) return 0;
+    uint16_t seq = submit(command);
+    if (seq == 0) return 0;
+    
+    response_seq = seq;
+    response_header = header;
+    response_active = false;
+    response_done = false;
+    response_sink = sink;
+    response_ctx = ctx;
+    return seq;
+  }
+  
+  // Blocking wrapper around submitRequest()
+  bool request(const char* command, const char* header, NameCallback sink, void* ctx,
+               unsigned long timeout_ms = 5000) {
+    uint16_t seq = submitRequest(command, header, sink, ctx);
+    if (seq == 0) return false;
+    
+    unsigned long start = millis();
+    while (!response_done && commandState(seq) != CMD_FAILED && millis() - start < timeout_ms) {
+      poll();
+      delay(1);
     }
     
-    return tokens;
+    bool done = response_done;
+    endRequest(seq);
+    return done;
+  }
+  
+  // "DETECT,<region>,<color>,..." into a fixed buffer
+  static bool buildDetect(char* buf, size_t size, const char* region_name,
+                          const char* const* colors, int color_count) {
+    int len = snprintf(buf, size, "DETECT,%s", region_name);
+    for (int i = 0; i < color_count && len > 0 && (size_t)len < size; i++) {
+      len += snprintf(buf + len, size - len, ",%s", colors[i]);
+    }
+    return len > 0 && (size_t)len < size;
+  }
+  
+  // Block until the result frame of the last DETECT arrives
+  int waitForFrame(unsigned long timeout_ms) {
+    unsigned long start = millis();
+    while (!parser.frameReady() && millis() - start < timeout_ms) {
+      poll();
+      delay(1);
+    }
+    if (!parser.frameReady()) return -1;
+    
+    parser.consumeFrame();
+    return parser.blobCount();
+  }
+  
+  static void printName(void* /*ctx*/, const char* name) {
+    Serial.println(name);
   }
 
 public:
-  Camera(HardwareSerial* ser = &Serial1) : serial(ser), debug_enabled(false) {}
+  Camera(HardwareSerial* ser = &Serial1) : Camera(static_cast<Transport*>(nullptr)) {
+    uart = UartTransport(ser);
+    serial = &uart;
+  }
+  
+  // Any byte link, e.g. a pty or socket when running on a host
+  Camera(Transport* transport)
+    : serial(transport), parser(&color_table), debug_enabled(false), batching(false),
+      batch_failed(false), next_seq(1), response_seq(0), response_header(nullptr),
+      response_active(false), response_done(false), response_sink(nullptr),
+      response_ctx(nullptr), awaiting_frame(false), frame_callback(nullptr),
+      frame_ctx(nullptr) {
+    last_error[0] = '\0';
+    calibration[0] = '\0';
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      inflight[i].seq = 0;
+      inflight[i].state = CMD_FREE;
+      inflight[i].sent_ms = 0;
+    }
+    
+    BlobStreamHandler handler;
+    handler.on_ack = onAck;
+    handler.on_frame = onFrame;
+    handler.on_line = onLine;
+    handler.ctx = this;
+    parser.setHandler(handler);
+  }
+  
+  // serial may point at our own uart, and the parser calls back into this
+  Camera(const Camera&) = delete;
+  Camera& operator=(const Camera&) = delete;
   
   // ========================================
   // INITIALIZATION
@@ -137,197 +331,632 @@ public:
     debug_enabled = enabled;
   }
   
+  // ========================================
+  // PIPELINED COMMANDS
+  // ========================================
+  
+  // Send a command tagged with a fresh sequence id without waiting.
+  // Returns the id (never 0), or 0 if CAMERA_MAX_INFLIGHT commands are pending.
+  uint16_t submit(const char* command) {
+    InflightCommand* slot = allocInflight();
+    if (!slot) return 0;
+    
+    uint16_t seq = next_seq++;
+    if (next_seq == 0) next_seq = 1;
+    
+    slot->seq = seq;
+    slot->state = CMD_PENDING;
+    slot->sent_ms = millis();
+    
+    char prefix[8];
+    int len = snprintf(prefix, sizeof(prefix), "#%u,", seq);
+    serial->write(reinterpret_cast<const uint8_t*>(prefix), len);
+    serial->write(reinterpret_cast<const uint8_t*>(command), strlen(command));
+    serial->write(reinterpret_cast<const uint8_t*>("\r\n"), 2);
+    return seq;
+  }
+  
+  // Non-blocking: parse whatever bytes are buffered right now.
+  // Updates command states and completes result frames; never allocates.
+  void poll() {
+    int pending = serial->available();
+    while (pending > 0) {
+      // Raw HSV payload goes from the UART straight into the dump buffer
+      size_t want = 0;
+      uint8_t* window = parser.rawWindow(want);
+      if (window) {
+        size_t chunk = want < (size_t)pending ? want : (size_t)pending;
+        size_t got = serial->readBytes(window, chunk);
+        if (got == 0) break;
+        parser.commitRaw(got);
+        pending -= got;
+        continue;
+      }
+      
+      int c = serial->read();
+      if (c < 0) break;
+      parser.feed(static_cast<char>(c));
+      pending--;
+    }
+  }
+  
+  CommandState commandState(uint16_t seq) {
+    InflightCommand* cmd = findInflight(seq);
+    return cmd ? cmd->state : CMD_FREE;
+  }
+  
+  int pendingCount() const {
+    int count = 0;
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (inflight[i].state == CMD_PENDING) count++;
+    }
+    return count;
+  }
+  
+  // Block until one command is answered; true if it was acknowledged.
+  // On timeout the command is given up and its slot freed.
+  bool waitForCommand(uint16_t seq, unsigned long timeout_ms = 5000) {
+    unsigned long start = millis();
+    while (commandState(seq) == CMD_PENDING && millis() - start < timeout_ms) {
+      poll();
+      delay(1);
+    }
+    expire(seq);
+    return commandState(seq) == CMD_ACKED;
+  }
+  
+  // Block until nothing is pending; true if no command is left unanswered.
+  // Commands still unanswered at the timeout are given up.
+  bool waitAll(unsigned long timeout_ms = 5000) {
+    unsigned long start = millis();
+    while (pendingCount() > 0 && millis() - start < timeout_ms) {
+      poll();
+      delay(1);
+    }
+    bool all = pendingCount() == 0;
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) {
+      if (inflight[i].state == CMD_PENDING) inflight[i].state = CMD_FREE;
+    }
+    return all;
+  }
+  
+  // Forget every pending command and any half-received response or frame,
+  // e.g. after the camera rebooted. Their ids read CMD_FREE from now on.
+  void reset() {
+    for (int i = 0; i < CAMERA_MAX_INFLIGHT; i++) inflight[i].state = CMD_FREE;
+    response_header = nullptr;
+    response_active = false;
+    response_done = false;
+    awaiting_frame = false;
+    batch_failed = false;
+    parser.reset();
+  }
+  
+  // Between beginBatch() and endBatch() the set/delete methods below only
+  // queue their command, so a whole profile costs a single round trip.
+  void beginBatch() {
+    batching = true;
+    batch_failed = false;
+  }
+  
+  // Wait for every queued command; true if all of them were acknowledged
+  bool endBatch(unsigned long timeout_ms = 5000) {
+    batching = false;
+    return waitAll(timeout_ms) && !batch_failed;
+  }
+  
+  // Message of the most recent NAK
+  const char* lastError() const {
+    return last_error;
+  }
+  
   // ========================================
   // SYSTEM CONTROL
   // ========================================
   
   bool startCapture() {
     if (debug_enabled) Serial.println("Starting capture...");
-    return sendCommand("START") && waitForResponse("CAPTURE_STARTED");
+    return sendCommand("START");
   }
   
   bool stopCapture() {
     if (debug_enabled) Serial.println("Stopping capture...");
-    return sendCommand("STOP") && waitForResponse("CAPTURE_STOPPED");
+    return sendCommand("STOP");
   }
   
   bool getStatus() {
     if (debug_enabled) Serial.println("Getting status...");
-    if (!sendCommand("STATUS")) return false;
-    
-    if (waitForResponse("STATUS")) {
-      auto lines = readUntilEnd();
-      if (debug_enabled) {
-        Serial.println("=== STATUS ===");
-        for (const auto& line : lines) {
-          Serial.println(line);
-        }
-        Serial.println("=============");
-      }
-      return true;
-    }
-    return false;
+    return request("STATUS", "STATUS", debug_enabled ? printName : nullptr, nullptr);
   }
   
   // ========================================
   // COLOR MANAGEMENT
   // ========================================
   
-  bool setColor(const String& name, int h_min, int h_max, int s_min, int s_max, int v_min, int v_max) {
-    String command = "COLOR_SET," + name + "," + 
-                    String(h_min) + "," + String(h_max) + "," +
-                    String(s_min) + "," + String(s_max) + "," +
-                    String(v_min) + "," + String(v_max);
+  bool setColor(const char* name, int h_min, int h_max, int s_min, int s_max, int v_min, int v_max) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "COLOR_SET,%s,%d,%d,%d,%d,%d,%d",
+             name, h_min, h_max, s_min, s_max, v_min, v_max);
     
-    if (debug_enabled) Serial.println("Setting color: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+    if (debug_enabled) Serial.printf("Setting color: %s\n", name);
+    color_table.intern(name);
+    return sendCommand(command);
   }
   
-  bool setColorDual(const String& name, 
+  bool setColorDual(const char* name,
                    int h1_min, int h1_max, int s1_min, int s1_max, int v1_min, int v1_max,
                    int h2_min, int h2_max, int s2_min, int s2_max, int v2_min, int v2_max) {
-    String command = "COLOR_SET2," + name + "," + 
-                    String(h1_min) + "," + String(h1_max) + "," + String(s1_min) + "," + String(s1_max) + "," + String(v1_min) + "," + String(v1_max) + "," +
-                    String(h2_min) + "," + String(h2_max) + "," + String(s2_min) + "," + String(s2_max) + "," + String(v2_min) + "," + String(v2_max);
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "COLOR_SET2,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d", name,
+             h1_min, h1_max, s1_min, s1_max, v1_min, v1_max,
+             h2_min, h2_max, s2_min, s2_max, v2_min, v2_max);
+    
+    if (debug_enabled) Serial.printf("Setting dual-range color: %s\n", name);
+    color_table.intern(name);
+    return sendCommand(command);
+  }
+  
+  // Any number of HSV boxes, ranges[i] = {h_min, h_max, s_min, s_max, v_min, v_max}.
+  // h_min > h_max wraps through 179 -> 0, so RED is {160, 10, 50, 255, 50, 255}.
+  // The camera merges overlapping boxes; false if the line would not fit.
+  bool setColorRanges(const char* name, const int (*ranges)[6], int count) {
+    if (!fieldsFit(2 + count)) return false;
+    char command[CAMERA_CMD_LEN];
+    int len = snprintf(command, sizeof(command), "COLOR_SETN,%s", name);
+    
+    for (int i = 0; i < count; i++) {
+      if (len <= 0 || (size_t)len >= sizeof(command)) return false;
+      len += snprintf(command + len, sizeof(command) - len, ",%d:%d:%d:%d:%d:%d", ranges[i][0],
+                      ranges[i][1], ranges[i][2], ranges[i][3], ranges[i][4], ranges[i][5]);
+    }
+    if (count <= 0 || len <= 0 || (size_t)len >= sizeof(command)) return false;
     
-    if (debug_enabled) Serial.println("Setting dual-range color: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+    if (debug_enabled) Serial.printf("Setting %d-range color: %s\n", count, name);
+    color_table.intern(name);
+    return sendCommand(command);
   }
   
-  bool deleteColor(const String& name) {
-    String command = "COLOR_DEL," + name;
-    if (debug_enabled) Serial.println("Deleting color: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+  bool deleteColor(const char* name) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "COLOR_DEL,%s", name);
+    if (debug_enabled) Serial.printf("Deleting color: %s\n", name);
+    return sendCommand(command);
   }
   
-  std::vector<String> listColors() {
-    std::vector<String> colors;
+  // The camera samples the pixels of a region set over frames frames (about
+  // a second at the default) and sets the color to the tightest ranges that
+  // hold keep_pct of them (h_min > h_max when the hue wraps, like RED). Aim the
+  // regions at the object only. Blocks until the result arrives; true if
+  // the color was set, and calibrationResult() holds the CALIBRATED line.
+  bool calibrate(const char* name, const char* region_name, int frames = 10, int keep_pct = 95,
+                 unsigned long timeout_ms = 15000) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "CALIBRATE,%s,%s,%d,%d", name, region_name, frames, keep_pct);
+    if (debug_enabled) Serial.printf("Calibrating color: %s\n", name);
+    
+    calibration[0] = '\0';
+    color_table.intern(name);
+    if (!sendCommand(command)) return false;
     
+    unsigned long start = millis();
+    while (calibration[0] == '\0' && millis() - start < timeout_ms) {
+      poll();
+      delay(1);
+    }
+    return strncmp(calibration, "CALIBRATED,", 11) == 0;
+  }
+  
+  // CALIBRATED,<color>,<h_min>,<h_max>,<s_min>,<s_max>,<v_min>,<v_max>
+  // or CALIBRATE_FAILED,<color>,<reason>; empty if none arrived
+  const char* calibrationResult() const {
+    return calibration;
+  }
+  
+  // Every listed name is also interned, so colorId() works for all of them.
+  // Returns the number of colors, -1 on failure.
+  int listColors(NameCallback callback = nullptr, void* ctx = nullptr) {
     if (debug_enabled) Serial.println("Listing colors...");
-    if (!sendCommand("COLOR_LIST")) return colors;
     
-    if (waitForResponse("COLORS")) {
-      colors = readUntilEnd();
-    }
+    struct Collector {
+      ColorTable* table;
+      NameCallback callback;
+      void* ctx;
+      int count;
+      static void add(void* p, const char* name) {
+        Collector* c = static_cast<Collector*>(p);
+        c->table->intern(name);
+        if (c->callback) c->callback(c->ctx, name);
+        c->count++;
+      }
+    } collector = {&color_table, callback, ctx, 0};
     
-    return colors;
+    if (!request("COLOR_LIST", "COLORS", Collector::add, &collector)) return -1;
+    return collector.count;
+  }
+  
+  // Interned id used in BlobResult::color_id (BLOB_COLOR_UNKNOWN if never seen)
+  uint8_t colorId(const char* name) const {
+    return color_table.find(name);
+  }
+  
+  const char* colorName(uint8_t color_id) const {
+    return color_table.name(color_id);
   }
   
   // ========================================
   // REGION MANAGEMENT
   // ========================================
   
-  bool setRegion(const String& name, int x, int y, int width, int height) {
-    String command = "REGION_SET," + name + "," + 
-                    String(x) + "," + String(y) + "," + 
-                    String(width) + "," + String(height);
+  bool setRegion(const char* name, int x, int y, int width, int height) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "REGION_SET,%s,%d,%d,%d,%d", name, x, y, width, height);
     
-    if (debug_enabled) Serial.println("Setting region: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+    if (debug_enabled) Serial.printf("Setting region: %s\n", name);
+    return sendCommand(command);
   }
   
-  bool setMultiRegion(const String& name, const std::vector<std::vector<int>>& regions) {
-    String command = "REGION_MULTI," + name + "," + String(regions.size());
+  // regions[i] = {x, y, width, height}; at most 7 regions per line
+  bool setMultiRegion(const char* name, const int (*regions)[4], int count) {
+    if (!fieldsFit(3 + 4 * count)) return false;
+    char command[CAMERA_CMD_LEN];
+    int len = snprintf(command, sizeof(command), "REGION_MULTI,%s,%d", name, count);
     
-    for (const auto& region : regions) {
-      if (region.size() != 4) return false; // Must have x,y,w,h
-      command += "," + String(region[0]) + "," + String(region[1]) + "," + 
-                String(region[2]) + "," + String(region[3]);
+    for (int i = 0; i < count; i++) {
+      if (len <= 0 || (size_t)len >= sizeof(command)) return false;
+      len += snprintf(command + len, sizeof(command) - len, ",%d,%d,%d,%d",
+                      regions[i][0], regions[i][1], regions[i][2], regions[i][3]);
     }
+    if (len <= 0 || (size_t)len >= sizeof(command)) return false;
     
-    if (debug_enabled) Serial.println("Setting multi-region: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+    if (debug_enabled) Serial.printf("Setting multi-region: %s\n", name);
+    return sendCommand(command);
   }
   
-  bool deleteRegion(const String& name) {
-    String command = "REGION_DEL," + name;
-    if (debug_enabled) Serial.println("Deleting region: " + name);
-    return sendCommand(command) && waitForResponse("OK");
+  // One polygon region; points[i] = {x, y}. A pixel is inside when its
+  // center is, so polygons sharing an edge never share pixels. At most 14
+  // points per line.
+  bool setPolygonRegion(const char* name, const int (*points)[2], int count) {
+    if (!fieldsFit(3 + 2 * count)) return false;
+    char command[CAMERA_CMD_LEN];
+    int len = snprintf(command, sizeof(command), "REGION_POLY,%s,%d", name, count);
+    
+    for (int i = 0; i < count; i++) {
+      if (len <= 0 || (size_t)len >= sizeof(command)) return false;
+      len += snprintf(command + len, sizeof(command) - len, ",%d,%d", points[i][0], points[i][1]);
+    }
+    if (len <= 0 || (size_t)len >= sizeof(command)) return false;
+    
+    if (debug_enabled) Serial.printf("Setting polygon region: %s\n", name);
+    return sendCommand(command);
   }
   
-  std::vector<String> listRegions() {
-    std::vector<String> regions;
-    
+  bool deleteRegion(const char* name) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "REGION_DEL,%s", name);
+    if (debug_enabled) Serial.printf("Deleting region: %s\n", name);
+    return sendCommand(command);
+  }
+  
+  // Returns the number of region sets, -1 on failure
+  int listRegions(NameCallback callback, void* ctx = nullptr) {
     if (debug_enabled) Serial.println("Listing regions...");
-    if (!sendCommand("REGION_LIST")) return regions;
     
-    if (waitForResponse("REGIONS")) {
-      regions = readUntilEnd();
-    }
+    struct Counter {
+      NameCallback callback;
+      void* ctx;
+      int count;
+      static void add(void* p, const char* name) {
+        Counter* c = static_cast<Counter*>(p);
+        if (c->callback) c->callback(c->ctx, name);
+        c->count++;
+      }
+    } counter = {callback, ctx, 0};
     
-    return regions;
+    if (!request("REGION_LIST", "REGIONS", Counter::add, &counter)) return -1;
+    return counter.count;
   }
   
   // ========================================
-  // BLOB DETECTION
+  // BLOB DETECTION (NON-BLOCKING)
   // ========================================
   
-  std::vector<BlobResult> detect(const String& region_name, const std::vector<String>& colors) {
-    std::vector<BlobResult> results;
+  // Called from poll() for every completed result frame
+  void onBlobs(BlobFrameCallback callback, void* ctx = nullptr) {
+    frame_callback = callback;
+    frame_ctx = ctx;
+  }
+  
+  // Queue a detection; results arrive through poll() / frameReady()
+  uint16_t requestDetect(const char* region_name, const char* const* colors, int color_count) {
+    char command[CAMERA_CMD_LEN];
+    if (!buildDetect(command, sizeof(command), region_name, colors, color_count)) return 0;
     
-    String command = "DETECT," + region_name;
-    for (const auto& color : colors) {
-      command += "," + color;
+    for (int i = 0; i < color_count; i++) {
+      color_table.intern(colors[i]);
     }
     
-    if (debug_enabled) Serial.println("Detecting blobs in region: " + region_name);
-    if (!sendCommand(command)) return results;
+    uint16_t seq = submitRequest(command, "DETECT_READY", nullptr, nullptr);
+    if (seq) awaiting_frame = true;
+    return seq;
+  }
+  
+  uint16_t requestDetectAll(const char* region_name) {
+    char command[CAMERA_CMD_LEN];
+    snprintf(command, sizeof(command), "DETECT_ALL,%s", region_name);
     
-    if (!waitForResponse("DETECT_READY")) return results;
+    uint16_t seq = submitRequest(command, "DETECT_ALL_READY", nullptr, nullptr);
+    if (seq) awaiting_frame = true;
+    return seq;
+  }
+  
+  // True once per received result frame until consumeFrame()
+  bool frameReady() const {
+    return parser.frameReady();
+  }
+  
+  void consumeFrame() {
+    parser.consumeFrame();
+  }
+  
+  // Latest complete frame; valid until the next frame completes
+  const BlobResult* blobs() const {
+    return parser.blobs();
+  }
+  
+  int blobCount() const {
+    return parser.blobCount();
+  }
+  
+  uint32_t droppedBlobs() const {
+    return parser.droppedBlobs();
+  }
+  
+  // ========================================
+  // BLOB DETECTION (BLOCKING WRAPPERS)
+  // ========================================
+  
+  // Returns the number of blobs now in blobs(), -1 on failure/timeout
+  int detect(const char* region_name, const char* const* colors, int color_count,
+             unsigned long timeout_ms = 10000) {
+    if (debug_enabled) Serial.printf("Detecting blobs in region: %s\n", region_name);
     
-    // Read detection setup confirmation
-    auto setup_lines = readUntilEnd(3000);
+    parser.consumeFrame();
+    if (requestDetect(region_name, colors, color_count) == 0) return -1;
+    return waitForFrame(timeout_ms);
+  }
+  
+  int detectAll(const char* region_name, unsigned long timeout_ms = 10000) {
+    if (debug_enabled) Serial.printf("Detecting all colors in region: %s\n", region_name);
     
-    // Wait for blob results
-    if (waitForResponse("BLOBS_START", 10000)) {
-      auto lines = readUntilEnd(15000);
-      results = parseBlobResults(lines);
+    parser.consumeFrame();
+    if (requestDetectAll(region_name) == 0) return -1;
+    return waitForFrame(timeout_ms);
+  }
+  
+  // ========================================
+  // CHANGE-ONLY REPORTING
+  // ========================================
+  
+  // The server re-detects on every frame but only sends blobs that appeared,
+  // vanished, or moved more than move_px / resized more than size_pct, plus a
+  // full keyframe every keyframe_frames frames. Each report arrives as a normal
+  // frame (onBlobs / frameReady) holding every blob currently known.
+  // No colors = all colors.
+  bool subscribe(const char* region_name, int move_px, int size_pct, int keyframe_frames,
+                 const char* const* colors = nullptr, int color_count = 0) {
+    char cmd[CAMERA_CMD_LEN];
+    int len = snprintf(cmd, sizeof(cmd), "SUBSCRIBE,%s,%d,%d,%d", region_name,
+                       move_px, size_pct, keyframe_frames);
+    for (int i = 0; i < color_count && len > 0 && (size_t)len < sizeof(cmd); i++) {
+      len += snprintf(cmd + len, sizeof(cmd) - len, ",%s", colors[i]);
     }
-    
-    return results;
+    if (len <= 0 || (size_t)len >= sizeof(cmd)) return false;
+    return sendCommand(cmd);
+  }
+  
+  bool unsubscribe(const char* region_name) {
+    char cmd[CAMERA_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "UNSUBSCRIBE,%s", region_name);
+    return sendCommand(cmd);
+  }
+  
+  // ========================================
+  // TRACKING
+  // ========================================
+  
+  // The server follows the blobs of one region set from frame to frame and
+  // reports every frame as a normal frame whose blobs carry a stable
+  // track_id and a velocity (vx, vy in 1/10 px per frame). Between full
+  // scans, every rescan_frames frames, it only searches around the tracks.
+  // No colors = all colors.
+  bool track(const char* region_name, int rescan_frames,
+             const char* const* colors = nullptr, int color_count = 0) {
+    char cmd[CAMERA_CMD_LEN];
+    int len = snprintf(cmd, sizeof(cmd), "TRACK,%s,%d", region_name, rescan_frames);
+    for (int i = 0; i < color_count && len > 0 && (size_t)len < sizeof(cmd); i++) {
+      len += snprintf(cmd + len, sizeof(cmd) - len, ",%s", colors[i]);
+    }
+    if (len <= 0 || (size_t)len >= sizeof(cmd)) return false;
+    return sendCommand(cmd);
+  }
+  
+  bool untrack() {
+    return sendCommand("UNTRACK");
   }
   
-  std::vector<BlobResult> detectAll(const String& region_name) {
-    std::vector<BlobResult> results;
+  // ========================================
+  // OCCUPANCY QUERIES
+  // ========================================
+  
+  // The server indexes the matches of these colors on every frame (at most
+  // 4), so countPixels() / countPerRegion() are answered without detecting.
+  // No colors = stop indexing.
+  bool occupancy(const char* const* colors, int color_count) {
+    char cmd[CAMERA_CMD_LEN];
+    int len = snprintf(cmd, sizeof(cmd), "OCCUPANCY");
+    for (int i = 0; i < color_count && len > 0 && (size_t)len < sizeof(cmd); i++) {
+      len += snprintf(cmd + len, sizeof(cmd) - len, ",%s", colors[i]);
+    }
+    if (len <= 0 || (size_t)len >= sizeof(cmd)) return false;
+    return sendCommand(cmd);
+  }
+  
+  // Pixels of an indexed color in a rectangle of the last frame, -1 on failure
+  long countPixels(const char* color, int x, int y, int width, int height) {
+    char cmd[CAMERA_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "COUNT,%s,%d,%d,%d,%d", color, x, y, width, height);
     
-    String command = "DETECT_ALL," + region_name;
+    long count = -1;
+    auto parse = [](void* p, const char* line) { *static_cast<long*>(p) = atol(line); };
+    if (!request(cmd, "COUNT", parse, &count)) return -1;
+    return count;
+  }
+  
+  // Pixels of an indexed color per region of a set, into counts (up to
+  // max_regions). Returns the number of regions, -1 on failure.
+  int countPerRegion(const char* color, const char* region_name, uint32_t* counts, int max_regions) {
+    char cmd[CAMERA_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "COUNT,%s,%s", color, region_name);
+    
+    struct Collector {
+      uint32_t* counts;
+      int max;
+      int count;
+      static void add(void* p, const char* line) {
+        Collector* c = static_cast<Collector*>(p);
+        if (c->count < c->max) c->counts[c->count] = strtoul(line, nullptr, 10);
+        c->count++;
+      }
+    } collector = {counts, max_regions, 0};
     
-    if (debug_enabled) Serial.println("Detecting all colors in region: " + region_name);
-    if (!sendCommand(command)) return results;
+    if (!request(cmd, "COUNT", Collector::add, &collector)) return -1;
+    return collector.count;
+  }
+  
+  // ========================================
+  // HSV REGION DUMP
+  // ========================================
+  
+  // Decoded planes land in buffer (3 * width * height bytes per region)
+  void setHSVBuffer(uint8_t* buffer, size_t size, HSVRegionData* regions, int max_regions) {
+    parser.setHSVBuffer(buffer, size, regions, max_regions);
+  }
+  
+  // Non-blocking: ask for a binary dump of every region in the set.
+  // The server announces it with HSV_DUMP_READY; the dump itself follows
+  // once the application on the camera side captured an image.
+  uint16_t requestHSVDump(const char* region_name, uint8_t encoding = HSV_ENC_RLE) {
+    static const char* const names[] = {"RAW", "RLE", "DELTA"};
+    if (encoding > HSV_ENC_DELTA) return 0;
     
-    if (!waitForResponse("DETECT_ALL_READY")) return results;
+    char cmd[CAMERA_CMD_LEN];
+    snprintf(cmd, sizeof(cmd), "HSV_DUMP,%s,%s", region_name, names[encoding]);
+    if (debug_enabled) Serial.printf("Requesting HSV dump for region: %s\n", region_name);
     
-    // Read detection setup confirmation
-    auto setup_lines = readUntilEnd(3000);
+    parser.consumeHSV();
+    return submitRequest(cmd, "HSV_DUMP_READY", nullptr, nullptr);
+  }
+  
+  bool hsvReady() const {
+    return parser.hsvReady();
+  }
+  
+  const HSVRegionData* hsvRegions() const {
+    return parser.hsvRegions();
+  }
+  
+  int hsvRegionCount() const {
+    return parser.hsvRegionCount();
+  }
+  
+  // Blocking: request a dump and wait for it. Returns the number of regions
+  // decoded into hsvRegions(), -1 on failure/timeout.
+  int getHSVData(const char* region_name, uint8_t encoding = HSV_ENC_RLE,
+                 unsigned long timeout_ms = 10000) {
+    uint16_t seq = requestHSVDump(region_name, encoding);
+    if (seq == 0) return -1;
     
-    // Wait for blob results
-    if (waitForResponse("BLOBS_START", 10000)) {
-      auto lines = readUntilEnd(15000);
-      results = parseBlobResults(lines);
+    unsigned long start = millis();
+    while (!parser.hsvReady() && commandState(seq) != CMD_FAILED &&
+           millis() - start < timeout_ms) {
+      poll();
+      delay(1);
     }
+    endRequest(seq);
     
-    return results;
+    if (!parser.hsvReady()) return -1;
+    parser.consumeHSV();
+    return parser.hsvRegionCount();
   }
   
   // ========================================
-  // HSV SERVER MODE
+  // REGION STATISTICS
   // ========================================
   
-  bool startServer(const String& region_name) {
-    String command = "SERVER," + region_name;
-    if (debug_enabled) Serial.println("Starting HSV server for region: " + region_name);
-    return sendCommand(command) && waitForResponse("SERVER_STARTED");
+  // Non-blocking: ask for coverage of the colors (none = all colors), mean
+  // HSV and H / S / V histograms of every region in the set. Much cheaper
+  // than an HSV dump on both sides; the answer is one binary record per
+  // region, sent once the camera side captured an image.
+  uint16_t requestRegionStats(const char* region_name, const char* const* colors = nullptr,
+                              int color_count = 0) {
+    char cmd[CAMERA_CMD_LEN];
+    int len = snprintf(cmd, sizeof(cmd), "REGION_STATS,%s", region_name);
+    for (int i = 0; i < color_count && len > 0 && (size_t)len < sizeof(cmd); i++) {
+      len += snprintf(cmd + len, sizeof(cmd) - len, ",%s", colors[i]);
+    }
+    if (len <= 0 || (size_t)len >= sizeof(cmd)) return 0;
+    
+    parser.consumeStats();
+    return submitRequest(cmd, "REGION_STATS_READY", nullptr, nullptr);
+  }
+  
+  bool statsReady() const {
+    return parser.statsReady();
+  }
+  
+  // Coverage is looked up with colorId(), e.g. stats[0].coverageOf(colorId("RED"))
+  const RegionStatsResult* regionStats() const {
+    return parser.regionStats();
+  }
+  
+  int regionStatsCount() const {
+    return parser.regionStatsCount();
   }
   
-  std::vector<HSVRegionData> getHSVData(unsigned long timeout_ms = 10000) {
-    std::vector<HSVRegionData> hsv_data;
+  // Blocking: request statistics and wait for them. Returns the number of
+  // regions in regionStats(), -1 on failure/timeout.
+  int getRegionStats(const char* region_name, const char* const* colors = nullptr, int color_count = 0,
+                     unsigned long timeout_ms = 10000) {
+    uint16_t seq = requestRegionStats(region_name, colors, color_count);
+    if (seq == 0) return -1;
     
-    if (waitForResponse("HSV_START", timeout_ms)) {
-      auto lines = readUntilEnd(timeout_ms);
-      hsv_data = parseHSVData(lines);
+    unsigned long start = millis();
+    while (!parser.statsReady() && commandState(seq) != CMD_FAILED &&
+           millis() - start < timeout_ms) {
+      poll();
+      delay(1);
     }
+    endRequest(seq);
     
-    return hsv_data;
+    if (!parser.statsReady()) return -1;
+    parser.consumeStats();
+    return parser.regionStatsCount();
+  }
+  
+  // ========================================
+  // STORED CONFIGURATION
+  // ========================================
+  
+  // Keep the current colors, region sets and subscriptions on the camera.
+  // It restores them when it boots, so after a power cycle results start
+  // arriving without the setup commands being sent again.
+  bool saveConfig() {
+    return sendCommand("CONFIG_SAVE");
+  }
+  
+  // The camera boots with its defaults from now on
+  bool clearConfig() {
+    return sendCommand("CONFIG_CLEAR");
   }
   
   // ========================================
@@ -335,7 +964,8 @@ public:
   // ========================================
   
   // Quick setup for common colors
-  void setupDefaultColors() {
+  bool setupDefaultColors() {
+    beginBatch();
     setColor("RED", 0, 10, 50, 255, 50, 255);
     setColorDual("RED_FULL", 0, 10, 50, 255, 50, 255, 160, 179, 50, 255, 50, 255);
     setColor("GREEN", 40, 80, 50, 255, 50, 255);
@@ -343,131 +973,31 @@ public:
     setColor("YELLOW", 20, 30, 50, 255, 50, 255);
     setColor("BLACK", 0, 179, 0, 255, 0, 50);
     setColor("WHITE", 0, 179, 0, 50, 200, 255);
+    return endBatch();
   }
   
   // Quick region setup
-  bool setupFullScreen(const String& name = "FULL", int width = 640, int height = 480) {
+  bool setupFullScreen(const char* name = "FULL", int width = 640, int height = 480) {
     return setRegion(name, 0, 0, width, height);
   }
   
-  bool setupQuadrants(const String& base_name = "Q", int width = 640, int height = 480) {
+  bool setupQuadrants(const char* base_name = "Q", int width = 640, int height = 480) {
     int hw = width / 2;
     int hh = height / 2;
     
-    std::vector<std::vector<int>> quadrants = {
+    const int quadrants[4][4] = {
       {0, 0, hw, hh},      // Top-left
-      {hw, 0, hw, hh},     // Top-right  
+      {hw, 0, hw, hh},     // Top-right
       {0, hh, hw, hh},     // Bottom-left
       {hw, hh, hw, hh}     // Bottom-right
     };
     
-    return setMultiRegion(base_name, quadrants);
+    return setMultiRegion(base_name, quadrants, 4);
   }
   
   // Simple detection with single color
-  std::vector<BlobResult> findColor(const String& region_name, const String& color) {
-    return detect(region_name, {color});
-  }
-
-private:
-  // ========================================
-  // RESULT PARSERS
-  // ========================================
-  
-  std::vector<BlobResult> parseBlobResults(const std::vector<String>& lines) {
-    std::vector<BlobResult> results;
-    
-    int i = 0;
-    while (i < lines.size()) {
-      if (lines[i] == "BLOBS_END") break;
-      
-      if (lines[i].startsWith("R") && lines[i].indexOf(',') > 0) {
-        // Simple format: R{region_id},{color},{x},{y},{size}
-        auto tokens = parseCSV(lines[i].substring(1)); // Remove 'R'
-        if (tokens.size() >= 5) {
-          results.emplace_back(tokens[0].toInt(), tokens[1].c_str(), 
-                             tokens[2].toInt(), tokens[3].toInt(), tokens[4].toInt());
-        }
-        i++;
-      }
-      else if (i + 1 < lines.size() && lines[i+1] == "REGION") {
-        // Structured format parsing would go here
-        // Skip for now - implement if needed
-        i += 2;
-      }
-      else {
-        i++;
-      }
-    }
-    
-    return results;
-  }
-  
-  std::vector<HSVRegionData> parseHSVData(const std::vector<String>& lines) {
-    std::vector<HSVRegionData> hsv_regions;
-    
-    int i = 0;
-    while (i < lines.size() && lines[i] != "HSV_END") {
-      if (lines[i] == "REGION" && i + 2 < lines.size()) {
-        HSVRegionData region_data;
-        region_data.region_id = lines[i+1].toInt();
-        
-        // Parse region bounds: x,y,width,height
-        auto bounds = parseCSV(lines[i+2]);
-        if (bounds.size() >= 4) {
-          region_data.x = bounds[0].toInt();
-          region_data.y = bounds[1].toInt();
-          region_data.width = bounds[2].toInt();
-          region_data.height = bounds[3].toInt();
-          
-          // Initialize pixel array
-          region_data.pixels.resize(region_data.height);
-          for (auto& row : region_data.pixels) {
-            row.reserve(region_data.width);
-          }
-          
-          i += 3;
-          
-          // Read HSV pixel data
-          int row = 0;
-          while (i < lines.size() && lines[i] != "REGION" && lines[i] != "HSV_END") {
-            if (row >= region_data.height) break;
-            
-            // Parse HSV pixels: "H,S,V H,S,V H,S,V..."
-            String line = lines[i];
-            int pos = 0;
-            
-            while (pos < line.length() && region_data.pixels[row].size() < region_data.width) {
-              int space = line.indexOf(' ', pos);
-              String pixel_str = (space == -1) ? line.substring(pos) : line.substring(pos, space);
-              
-              auto hsv_tokens = parseCSV(pixel_str);
-              if (hsv_tokens.size() >= 3) {
-                region_data.pixels[row].emplace_back(
-                  hsv_tokens[0].toInt(), hsv_tokens[1].toInt(), hsv_tokens[2].toInt()
-                );
-              }
-              
-              pos = (space == -1) ? line.length() : space + 1;
-            }
-            
-            if (region_data.pixels[row].size() >= region_data.width) {
-              row++;
-            }
-            
-            i++;
-          }
-          
-          hsv_regions.push_back(region_data);
-        } else {
-          i += 3;
-        }
-      } else {
-        i++;
-      }
-    }
-    
-    return hsv_regions;
+  int findColor(const char* region_name, const char* color) {
+    return detect(region_name, &color, 1);
   }
 };
 
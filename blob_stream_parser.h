@@ -0,0 +1,914 @@
+#ifndef BLOB_STREAM_PARSER_H
+#define BLOB_STREAM_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ========================================
+// CONFIGURATION
+// ========================================
+
+#define BLOB_CLIENT_MAX_BLOBS 64       // Blobs kept per result frame
+#define BLOB_CLIENT_MAX_COLORS 16      // Distinct color names interned
+#define BLOB_CLIENT_NAME_LEN 16        // Including terminator
+#define BLOB_CLIENT_LINE_LEN 128       // Longest protocol line accepted
+#define BLOB_COLOR_UNKNOWN 0xFF        // Color table full / name too long
+#define BLOB_CLIENT_MAX_STAT_REGIONS 16  // Regions kept per REGION_STATS answer
+#define BLOB_CLIENT_MAX_STAT_COLORS 8    // Coverage values kept per region
+#define BLOB_CLIENT_STAT_BINS 16         // Histogram bins (STATS_BINS in region_stats.h)
+
+// HSV dump row encodings (same values as blob_command_interface.h)
+#define HSV_ENC_RAW 0      // Plain bytes
+#define HSV_ENC_RLE 1      // Literal / repeat runs, runs never cross rows
+#define HSV_ENC_DELTA 2    // Byte deltas along the row, then RLE
+
+// ========================================
+// RESULT STRUCTURES
+// ========================================
+
+struct BlobResult {
+  int region_id;
+  uint8_t color_id;   // Index into ColorTable
+  int x, y;
+  int size;
+  uint16_t track_id;  // Tracker id (TRACKS frames), 0 otherwise
+  int vx, vy;         // Tracker velocity in 1/10 px per frame, 0 otherwise
+};
+
+struct HSVPixel {
+  uint8_t h, s, v;
+  HSVPixel(uint8_t hue, uint8_t sat, uint8_t val) : h(hue), s(sat), v(val) {}
+};
+
+// One region of a binary HSV dump. The planes are views into the buffer
+// given to setHSVBuffer(): [h plane][s plane][v plane], width*height each.
+struct HSVRegionData {
+  int region_id;
+  int x, y, width, height;
+  uint8_t* h;
+  uint8_t* s;
+  uint8_t* v;
+  
+  HSVPixel pixel(int col, int row) const {
+    int i = row * width + col;
+    return HSVPixel(h[i], s[i], v[i]);
+  }
+};
+
+// One region of a REGION_STATS answer. Histogram bins and coverage are
+// shares of the region's pixels, 65535 = all of them.
+struct RegionStatsResult {
+  int region_id;
+  uint32_t pixels;
+  uint8_t mean_h, mean_s, mean_v;
+  uint16_t hist_h[BLOB_CLIENT_STAT_BINS];   // Bin b: H from b * 180 / 16
+  uint16_t hist_s[BLOB_CLIENT_STAT_BINS];   // Bin b: S from b * 16
+  uint16_t hist_v[BLOB_CLIENT_STAT_BINS];
+  uint8_t color_count;
+  uint8_t color_id[BLOB_CLIENT_MAX_STAT_COLORS];   // Index into ColorTable
+  uint16_t coverage[BLOB_CLIENT_MAX_STAT_COLORS];
+  
+  // Covered share of the color, 0..1; 0 if it was not in the answer
+  float coverageOf(uint8_t color) const {
+    for (int i = 0; i < color_count; i++) {
+      if (color_id[i] == color) return coverage[i] / 65535.0f;
+    }
+    return 0.0f;
+  }
+};
+
+// ========================================
+// COLOR NAME INTERNING
+// ========================================
+
+class ColorTable {
+private:
+  char names[BLOB_CLIENT_MAX_COLORS][BLOB_CLIENT_NAME_LEN];
+  uint8_t count;
+
+public:
+  ColorTable() : count(0) {}
+  
+  // Id of an existing name, BLOB_COLOR_UNKNOWN if not interned
+  uint8_t find(const char* name, size_t len) const {
+    for (uint8_t i = 0; i < count; i++) {
+      if (strncmp(names[i], name, len) == 0 && names[i][len] == '\0') return i;
+    }
+    return BLOB_COLOR_UNKNOWN;
+  }
+  
+  uint8_t find(const char* name) const {
+    return find(name, strlen(name));
+  }
+  
+  // Id for name, adding it on first use
+  uint8_t intern(const char* name, size_t len) {
+    uint8_t id = find(name, len);
+    if (id != BLOB_COLOR_UNKNOWN) return id;
+    if (count >= BLOB_CLIENT_MAX_COLORS || len >= BLOB_CLIENT_NAME_LEN) return BLOB_COLOR_UNKNOWN;
+    
+    memcpy(names[count], name, len);
+    names[count][len] = '\0';
+    return count++;
+  }
+  
+  uint8_t intern(const char* name) {
+    return intern(name, strlen(name));
+  }
+  
+  const char* name(uint8_t id) const {
+    return id < count ? names[id] : "?";
+  }
+  
+  uint8_t size() const {
+    return count;
+  }
+  
+  void clear() {
+    count = 0;
+  }
+};
+
+// ========================================
+// INCREMENTAL PROTOCOL PARSER
+// ========================================
+
+/**
+ * Byte-at-a-time parser for the blob command interface output.
+ * Never allocates: lines are assembled in a fixed buffer and blob frames are
+ * decoded into one of two fixed arrays (the other one holds the last
+ * complete frame). Understands both result formats:
+ *   simple:     R<region>,<color>,<x>,<y>,<size> ... END
+ *   structured: BLOBS_START, n, REGION, id, n, COLOR, name, n, x,y,size ... BLOBS_END
+ *   changes:    SUB,<slot>,K|D, +/~/- blob lines ... END; applied to the held
+ *               blob set, which is then published as a complete frame
+ *   tracks:     TRACKS,<n>, T<id>,<region>,<color>,<x>,<y>,<size>,<vx>,<vy> ... END
+ * Binary HSV dumps (HSVB_START ... HSVB_END) are decoded straight into the
+ * caller's buffer, binary region statistics (RSTATS) into a fixed array.
+ * ACK/NAK lines are reported through on_ack, every other
+ * line through on_line.
+ */
+struct BlobStreamHandler {
+  void (*on_ack)(void* ctx, uint16_t seq, bool ok, const char* message);
+  void (*on_frame)(void* ctx, const BlobResult* blobs, int count);
+  void (*on_hsv)(void* ctx, const HSVRegionData* regions, int count);
+  void (*on_line)(void* ctx, const char* line, size_t length);
+  void* ctx;
+};
+
+class BlobStreamParser {
+private:
+  enum Expect : uint8_t {
+    EXPECT_ANY,
+    EXPECT_REGION_COUNT,
+    EXPECT_REGION_ID,
+    EXPECT_COLOR_COUNT,
+    EXPECT_COLOR_NAME,
+    EXPECT_BLOB_COUNT,
+    EXPECT_BLOB
+  };
+  
+  char line[BLOB_CLIENT_LINE_LEN];
+  size_t line_len;
+  bool line_overflow;
+  
+  BlobResult frames[2][BLOB_CLIENT_MAX_BLOBS];
+  uint8_t front;            // frames[front] = last complete frame
+  int front_count;
+  int back_count;
+  bool frame_open;
+  bool frame_ready;
+  uint32_t frame_counter;
+  uint32_t dropped_blobs;
+  
+  // Structured format state
+  Expect expect;
+  int struct_region;
+  uint8_t struct_color;
+  int struct_remaining;
+  
+  ColorTable* colors;
+  BlobStreamHandler handler;
+  
+  // Binary HSV dump state
+  uint8_t* dump_buffer;
+  size_t dump_capacity;
+  size_t dump_used;
+  HSVRegionData* dump_regions;
+  int dump_max_regions;
+  int dump_count;
+  bool dump_ready;
+  uint32_t dump_skipped_regions;
+  
+  bool bin_active;          // Payload bytes are being consumed
+  uint8_t* bin_dest;        // nullptr = region did not fit, discard
+  size_t bin_total;
+  size_t bin_pos;
+  int bin_width;
+  int bin_col;
+  uint8_t bin_encoding;
+  uint8_t bin_literals;     // RLE literal bytes still to come
+  uint8_t bin_run;          // RLE repeat count, applied to the next byte
+  uint8_t bin_prev;         // Delta accumulator
+  
+  // Binary region statistics state
+  RegionStatsResult stats[BLOB_CLIENT_MAX_STAT_REGIONS];
+  int stats_count;
+  bool stats_ready;
+  int stats_total;          // Records announced by the header
+  int stats_remaining;      // Records still to come, 0 = not in a stats block
+  int stats_colors;         // Colors per record as sent
+  uint8_t stats_color_ids[BLOB_CLIENT_MAX_STAT_COLORS];
+  uint8_t stats_record[8 + 6 * BLOB_CLIENT_STAT_BINS + 2 * BLOB_CLIENT_MAX_STAT_COLORS];
+  size_t stats_record_size; // Bytes of one record on the wire
+  size_t stats_pos;
+  
+  // Change-only subscriptions: blobs reported by the server and not yet removed
+  struct LiveBlob {
+    uint16_t id;
+    uint8_t slot;
+    BlobResult blob;
+  };
+  
+  LiveBlob live[BLOB_CLIENT_MAX_BLOBS];
+  int live_count;
+  bool change_open;         // Inside a SUB,... block
+  uint8_t change_slot;
+  
+  static bool parseInt(const char*& p, const char* end, int& value) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+      negative = true;
+      p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') return false;
+    
+    int v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      v = v * 10 + (*p - '0');
+      p++;
+    }
+    value = negative ? -v : v;
+    return true;
+  }
+  
+  static bool startsWith(const char* s, size_t len, const char* prefix) {
+    size_t n = strlen(prefix);
+    return len >= n && memcmp(s, prefix, n) == 0;
+  }
+  
+  static bool equals(const char* s, size_t len, const char* word) {
+    return strlen(word) == len && memcmp(s, word, len) == 0;
+  }
+  
+  void openFrame() {
+    frame_open = true;
+    back_count = 0;
+  }
+  
+  void addBlob(int region_id, uint8_t color_id, int x, int y, int size,
+               uint16_t track_id = 0, int vx = 0, int vy = 0) {
+    if (back_count >= BLOB_CLIENT_MAX_BLOBS) {
+      dropped_blobs++;
+      return;
+    }
+    BlobResult& blob = frames[front ^ 1][back_count++];
+    blob.region_id = region_id;
+    blob.color_id = color_id;
+    blob.x = x;
+    blob.y = y;
+    blob.size = size;
+    blob.track_id = track_id;
+    blob.vx = vx;
+    blob.vy = vy;
+  }
+  
+  void closeFrame() {
+    front ^= 1;
+    front_count = back_count;
+    back_count = 0;
+    frame_open = false;
+    frame_ready = true;
+    frame_counter++;
+    expect = EXPECT_ANY;
+    
+    if (handler.on_frame) handler.on_frame(handler.ctx, frames[front], front_count);
+  }
+  
+  // ACK,<seq>,<seq>,...   NAK,<seq>,<message>
+  bool handleAck(const char* s, size_t len) {
+    const char* end = s + len;
+    
+    if (startsWith(s, len, "ACK,")) {
+      const char* p = s + 4;
+      int seq;
+      while (parseInt(p, end, seq)) {
+        if (handler.on_ack) handler.on_ack(handler.ctx, static_cast<uint16_t>(seq), true, "");
+        if (p < end && *p == ',') p++;
+      }
+      return true;
+    }
+    
+    if (startsWith(s, len, "NAK,")) {
+      const char* p = s + 4;
+      int seq;
+      if (parseInt(p, end, seq)) {
+        if (p < end && *p == ',') p++;
+        if (handler.on_ack) handler.on_ack(handler.ctx, static_cast<uint16_t>(seq), false, p);
+      }
+      return true;
+    }
+    
+    return false;
+  }
+  
+  void emitValue(uint8_t value) {
+    if (bin_encoding == HSV_ENC_DELTA) {
+      if (bin_col == 0) bin_prev = 0;
+      value = static_cast<uint8_t>(bin_prev + value);
+      bin_prev = value;
+    }
+    if (++bin_col == bin_width) bin_col = 0;
+    
+    if (bin_dest) bin_dest[bin_pos] = value;
+    if (++bin_pos >= bin_total) bin_active = false;
+  }
+  
+  void feedBinary(uint8_t b) {
+    if (bin_encoding == HSV_ENC_RAW) {
+      emitValue(b);
+      return;
+    }
+    
+    // Control byte c < 128: c + 1 literal bytes follow; otherwise the next
+    // byte repeats c - 125 times (frameRleEncode on the device)
+    if (bin_literals > 0) {
+      bin_literals--;
+      emitValue(b);
+      return;
+    }
+    if (bin_run > 0) {
+      uint8_t count = bin_run;
+      bin_run = 0;
+      while (count-- > 0 && bin_active) emitValue(b);
+      return;
+    }
+    if (b < 128) {
+      bin_literals = b + 1;
+    } else {
+      bin_run = b - 125;
+    }
+  }
+  
+  // HSVB_START,<n>   HSVB_REGION,<id>,<x>,<y>,<w>,<h>,<encoding>   HSVB_END
+  bool handleDump(const char* s, size_t len) {
+    if (startsWith(s, len, "HSVB_START")) {
+      dump_used = 0;
+      dump_count = 0;
+      dump_ready = false;
+      return true;
+    }
+    
+    if (equals(s, len, "HSVB_END")) {
+      dump_ready = true;
+      if (handler.on_hsv) handler.on_hsv(handler.ctx, dump_regions, dump_count);
+      return true;
+    }
+    
+    if (!startsWith(s, len, "HSVB_REGION,")) return false;
+    
+    const char* end = s + len;
+    const char* p = s + 12;
+    int v[6];
+    for (int i = 0; i < 6; i++) {
+      if (!parseInt(p, end, v[i])) return true;
+      if (p < end && *p == ',') p++;
+    }
+    
+    size_t pixels = static_cast<size_t>(v[3]) * v[4];
+    if (pixels == 0 || v[5] > HSV_ENC_DELTA) return true;
+    
+    bin_active = true;
+    bin_total = pixels * 3;
+    bin_pos = 0;
+    bin_width = v[3];
+    bin_col = 0;
+    bin_encoding = static_cast<uint8_t>(v[5]);
+    bin_literals = 0;
+    bin_run = 0;
+    bin_prev = 0;
+    bin_dest = nullptr;
+    
+    if (dump_buffer && dump_count < dump_max_regions && dump_used + bin_total <= dump_capacity) {
+      bin_dest = dump_buffer + dump_used;
+      HSVRegionData& region = dump_regions[dump_count++];
+      region.region_id = v[0];
+      region.x = v[1];
+      region.y = v[2];
+      region.width = v[3];
+      region.height = v[4];
+      region.h = bin_dest;
+      region.s = bin_dest + pixels;
+      region.v = bin_dest + pixels * 2;
+      dump_used += bin_total;
+    } else {
+      dump_skipped_regions++;
+    }
+    return true;
+  }
+  
+  static uint16_t readU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+  }
+  
+  // RSTATS,<regions>[,<color>,...]   then <regions> binary records
+  bool handleStats(const char* s, size_t len) {
+    if (!startsWith(s, len, "RSTATS,")) return false;
+    
+    const char* end = s + len;
+    const char* p = s + 7;
+    int regions;
+    if (!parseInt(p, end, regions)) return true;
+    
+    stats_colors = 0;
+    while (p < end && *p == ',') {
+      const char* name = ++p;
+      while (p < end && *p != ',') p++;
+      if (stats_colors < BLOB_CLIENT_MAX_STAT_COLORS) {
+        stats_color_ids[stats_colors] = colors->intern(name, p - name);
+      }
+      stats_colors++;
+    }
+    
+    stats_record_size = 8 + 6 * BLOB_CLIENT_STAT_BINS + 2 * stats_colors;
+    stats_pos = 0;
+    stats_count = 0;
+    stats_ready = false;
+    stats_total = regions;
+    stats_remaining = regions;
+    if (regions <= 0) stats_ready = true;
+    return true;
+  }
+  
+  void feedStats(uint8_t b) {
+    if (stats_pos < sizeof(stats_record)) stats_record[stats_pos] = b;
+    if (++stats_pos < stats_record_size) return;
+    
+    int region_id = stats_total - stats_remaining;
+    if (stats_count < BLOB_CLIENT_MAX_STAT_REGIONS) {
+      RegionStatsResult& r = stats[stats_count++];
+      const uint8_t* q = stats_record;
+      r.region_id = region_id;
+      r.pixels = q[0] | (q[1] << 8) | (uint32_t(q[2]) << 16) | (uint32_t(q[3]) << 24);
+      r.mean_h = q[4];
+      r.mean_s = q[5];
+      r.mean_v = q[6];
+      q += 8;
+      for (int i = 0; i < BLOB_CLIENT_STAT_BINS; i++, q += 2) r.hist_h[i] = readU16(q);
+      for (int i = 0; i < BLOB_CLIENT_STAT_BINS; i++, q += 2) r.hist_s[i] = readU16(q);
+      for (int i = 0; i < BLOB_CLIENT_STAT_BINS; i++, q += 2) r.hist_v[i] = readU16(q);
+      r.color_count = stats_colors < BLOB_CLIENT_MAX_STAT_COLORS ? stats_colors : BLOB_CLIENT_MAX_STAT_COLORS;
+      for (int i = 0; i < r.color_count; i++, q += 2) {
+        r.color_id[i] = stats_color_ids[i];
+        r.coverage[i] = readU16(q);
+      }
+    }
+    
+    stats_pos = 0;
+    if (--stats_remaining == 0) stats_ready = true;
+  }
+  
+  LiveBlob* findLive(uint16_t id) {
+    for (int i = 0; i < live_count; i++) {
+      if (live[i].id == id) return &live[i];
+    }
+    return nullptr;
+  }
+  
+  void removeLive(int index) {
+    live[index] = live[--live_count];
+  }
+  
+  // SUB,<slot>,K|D   then +<id>,<region>,<color>,<x>,<y>,<size>   ~<id>,<x>,<y>,<size>   -<id>   END
+  bool handleChange(const char* s, size_t len) {
+    const char* end = s + len;
+    const char* p = s + 1;
+    int id, x, y, size;
+    
+    if (startsWith(s, len, "SUB,")) {
+      int slot;
+      p = s + 4;
+      if (!parseInt(p, end, slot) || p + 1 >= end) return true;
+      
+      change_open = true;
+      change_slot = static_cast<uint8_t>(slot);
+      if (p[1] == 'K') {
+        for (int i = live_count - 1; i >= 0; i--) {
+          if (live[i].slot == change_slot) removeLive(i);
+        }
+      }
+      return true;
+    }
+    
+    if (!change_open) return false;
+    
+    if (equals(s, len, "END")) {
+      // Publish the whole current set as an ordinary frame
+      change_open = false;
+      openFrame();
+      for (int i = 0; i < live_count; i++) {
+        const BlobResult& b = live[i].blob;
+        addBlob(b.region_id, b.color_id, b.x, b.y, b.size);
+      }
+      closeFrame();
+      return true;
+    }
+    
+    if (s[0] == '+') {
+      int region_id;
+      if (!parseInt(p, end, id) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, region_id) || p >= end || *p++ != ',') return true;
+      const char* name = p;
+      while (p < end && *p != ',') p++;
+      if (p >= end) return true;
+      uint8_t color_id = colors->intern(name, p - name);
+      p++;
+      if (!parseInt(p, end, x) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, y) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, size)) return true;
+      
+      LiveBlob* entry = findLive(static_cast<uint16_t>(id));
+      if (!entry) {
+        if (live_count >= BLOB_CLIENT_MAX_BLOBS) {
+          dropped_blobs++;
+          return true;
+        }
+        entry = &live[live_count++];
+      }
+      entry->id = static_cast<uint16_t>(id);
+      entry->slot = change_slot;
+      entry->blob.region_id = region_id;
+      entry->blob.color_id = color_id;
+      entry->blob.x = x;
+      entry->blob.y = y;
+      entry->blob.size = size;
+      return true;
+    }
+    
+    if (s[0] == '~') {
+      if (!parseInt(p, end, id) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, x) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, y) || p >= end || *p++ != ',') return true;
+      if (!parseInt(p, end, size)) return true;
+      
+      LiveBlob* entry = findLive(static_cast<uint16_t>(id));
+      if (entry) {
+        entry->blob.x = x;
+        entry->blob.y = y;
+        entry->blob.size = size;
+      }
+      return true;
+    }
+    
+    if (s[0] == '-') {
+      if (!parseInt(p, end, id)) return true;
+      for (int i = 0; i < live_count; i++) {
+        if (live[i].id == id) {
+          removeLive(i);
+          break;
+        }
+      }
+      return true;
+    }
+    
+    return false;
+  }
+  
+  // TRACKS,<n>   then T<id>,<region>,<color>,<x>,<y>,<size>,<vx>,<vy>   END
+  bool handleTrack(const char* s, size_t len) {
+    if (startsWith(s, len, "TRACKS,")) {
+      openFrame();
+      return true;
+    }
+    if (!frame_open || len < 2 || s[0] != 'T' || s[1] < '0' || s[1] > '9') return false;
+    
+    const char* end = s + len;
+    const char* p = s + 1;
+    int id, region_id, x, y, size, vx, vy;
+    if (!parseInt(p, end, id) || p >= end || *p++ != ',') return true;
+    if (!parseInt(p, end, region_id) || p >= end || *p++ != ',') return true;
+    const char* name = p;
+    while (p < end && *p != ',') p++;
+    if (p >= end) return true;
+    uint8_t color_id = colors->intern(name, p - name);
+    p++;
+    if (!parseInt(p, end, x) || p >= end || *p++ != ',') return true;
+    if (!parseInt(p, end, y) || p >= end || *p++ != ',') return true;
+    if (!parseInt(p, end, size) || p >= end || *p++ != ',') return true;
+    if (!parseInt(p, end, vx) || p >= end || *p++ != ',') return true;
+    if (!parseInt(p, end, vy)) return true;
+    
+    addBlob(region_id, color_id, x, y, size, static_cast<uint16_t>(id), vx, vy);
+    return true;
+  }
+  
+  // R<region>,<color>,<x>,<y>,<size>
+  bool handleSimpleBlob(const char* s, size_t len) {
+    if (len < 2 || s[0] != 'R' || s[1] < '0' || s[1] > '9') return false;
+    
+    const char* end = s + len;
+    const char* p = s + 1;
+    int region_id, x, y, size;
+    if (!parseInt(p, end, region_id) || p >= end || *p != ',') return false;
+    
+    const char* name = ++p;
+    while (p < end && *p != ',') p++;
+    if (p >= end) return false;
+    uint8_t color_id = colors->intern(name, p - name);
+    p++;
+    
+    if (!parseInt(p, end, x) || p >= end || *p++ != ',') return false;
+    if (!parseInt(p, end, y) || p >= end || *p++ != ',') return false;
+    if (!parseInt(p, end, size)) return false;
+    
+    if (!frame_open) openFrame();
+    addBlob(region_id, color_id, x, y, size);
+    return true;
+  }
+  
+  // Returns true if the line belonged to a structured frame
+  bool handleStructured(const char* s, size_t len) {
+    const char* end = s + len;
+    const char* p = s;
+    int value;
+    
+    switch (expect) {
+      case EXPECT_ANY:
+        if (equals(s, len, "BLOBS_START")) {
+          openFrame();
+          expect = EXPECT_REGION_COUNT;
+          return true;
+        }
+        if (!frame_open) return false;
+        if (equals(s, len, "REGION")) {
+          expect = EXPECT_REGION_ID;
+          return true;
+        }
+        if (equals(s, len, "COLOR")) {
+          expect = EXPECT_COLOR_NAME;
+          return true;
+        }
+        if (equals(s, len, "BLOBS_END")) {
+          closeFrame();
+          return true;
+        }
+        return false;
+      
+      case EXPECT_REGION_COUNT:
+        expect = EXPECT_ANY;
+        return true;
+      
+      case EXPECT_REGION_ID:
+        struct_region = parseInt(p, end, value) ? value : -1;
+        expect = EXPECT_COLOR_COUNT;
+        return true;
+      
+      case EXPECT_COLOR_COUNT:
+        expect = EXPECT_ANY;
+        return true;
+      
+      case EXPECT_COLOR_NAME:
+        struct_color = colors->intern(s, len);
+        expect = EXPECT_BLOB_COUNT;
+        return true;
+      
+      case EXPECT_BLOB_COUNT:
+        struct_remaining = parseInt(p, end, value) ? value : 0;
+        expect = struct_remaining > 0 ? EXPECT_BLOB : EXPECT_ANY;
+        return true;
+      
+      case EXPECT_BLOB: {
+        int x, y, size;
+        if (parseInt(p, end, x) && p < end && *p++ == ',' &&
+            parseInt(p, end, y) && p < end && *p++ == ',' &&
+            parseInt(p, end, size)) {
+          addBlob(struct_region, struct_color, x, y, size);
+        }
+        if (--struct_remaining <= 0) expect = EXPECT_ANY;
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  void handleLine(const char* s, size_t len) {
+    if (len == 0) return;
+    if (handleAck(s, len)) return;
+    if (handleDump(s, len)) return;
+    if (handleStats(s, len)) return;
+    if (handleChange(s, len)) return;
+    if (handleTrack(s, len)) return;
+    if (handleStructured(s, len)) return;
+    if (handleSimpleBlob(s, len)) return;
+    
+    if (frame_open && equals(s, len, "END")) {
+      closeFrame();
+      return;
+    }
+    
+    if (handler.on_line) handler.on_line(handler.ctx, s, len);
+  }
+
+public:
+  BlobStreamParser(ColorTable* color_table)
+    : line_len(0), line_overflow(false), front(0), front_count(0), back_count(0),
+      frame_open(false), frame_ready(false), frame_counter(0), dropped_blobs(0),
+      expect(EXPECT_ANY), struct_region(0), struct_color(BLOB_COLOR_UNKNOWN),
+      struct_remaining(0), colors(color_table), dump_buffer(nullptr), dump_capacity(0),
+      dump_used(0), dump_regions(nullptr), dump_max_regions(0), dump_count(0),
+      dump_ready(false), dump_skipped_regions(0), bin_active(false), bin_dest(nullptr),
+      bin_total(0), bin_pos(0), bin_width(1), bin_col(0), bin_encoding(HSV_ENC_RAW),
+      bin_literals(0), bin_run(0), bin_prev(0), stats_count(0), stats_ready(false), stats_total(0), stats_remaining(0),
+      stats_colors(0), stats_record_size(0), stats_pos(0), live_count(0), change_open(false),
+      change_slot(0) {
+    handler.on_ack = nullptr;
+    handler.on_frame = nullptr;
+    handler.on_hsv = nullptr;
+    handler.on_line = nullptr;
+    handler.ctx = nullptr;
+  }
+  
+  void setHandler(const BlobStreamHandler& h) {
+    handler = h;
+  }
+  
+  // Feed one received byte
+  void feed(char c) {
+    if (bin_active) {
+      feedBinary(static_cast<uint8_t>(c));
+      return;
+    }
+    if (stats_remaining > 0) {
+      feedStats(static_cast<uint8_t>(c));
+      return;
+    }
+    
+    if (c == '\r') return;
+    
+    if (c != '\n') {
+      if (line_len < BLOB_CLIENT_LINE_LEN - 1) {
+        line[line_len++] = c;
+      } else {
+        line_overflow = true;
+      }
+      return;
+    }
+    
+    if (!line_overflow) {
+      // Trim trailing blanks, lines are short so this stays cheap
+      while (line_len > 0 && line[line_len - 1] == ' ') line_len--;
+      line[line_len] = '\0';
+      handleLine(line, line_len);
+    }
+    line_len = 0;
+    line_overflow = false;
+  }
+  
+  // Feed a chunk of received bytes
+  void feed(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      feed(static_cast<char>(data[i]));
+    }
+  }
+  
+  // ========================================
+  // POLL ACCESS
+  // ========================================
+  
+  // True once per completed frame until consumeFrame()
+  bool frameReady() const {
+    return frame_ready;
+  }
+  
+  void consumeFrame() {
+    frame_ready = false;
+  }
+  
+  const BlobResult* blobs() const {
+    return frames[front];
+  }
+  
+  int blobCount() const {
+    return front_count;
+  }
+  
+  uint32_t frameCount() const {
+    return frame_counter;
+  }
+  
+  // Blobs discarded because a frame exceeded BLOB_CLIENT_MAX_BLOBS
+  uint32_t droppedBlobs() const {
+    return dropped_blobs;
+  }
+  
+  // Treat an empty "END" as a complete frame (simple format, nothing found)
+  void closeEmptyFrame() {
+    if (!frame_open) openFrame();
+    closeFrame();
+  }
+  
+  // ========================================
+  // BINARY HSV DUMP
+  // ========================================
+  
+  // Memory for decoded dumps: 3 * width * height bytes per region
+  void setHSVBuffer(uint8_t* buffer, size_t size, HSVRegionData* regions, int max_regions) {
+    dump_buffer = buffer;
+    dump_capacity = size;
+    dump_regions = regions;
+    dump_max_regions = max_regions;
+    dump_used = 0;
+    dump_count = 0;
+  }
+  
+  // Raw payload bytes can be read from the UART straight into place.
+  // Returns the destination and how many bytes it still expects, or nullptr.
+  uint8_t* rawWindow(size_t& count) {
+    if (!bin_active || bin_encoding != HSV_ENC_RAW || !bin_dest) {
+      count = 0;
+      return nullptr;
+    }
+    count = bin_total - bin_pos;
+    return bin_dest + bin_pos;
+  }
+  
+  // Bytes written into rawWindow() by the caller
+  void commitRaw(size_t count) {
+    bin_pos += count;
+    if (bin_pos >= bin_total) bin_active = false;
+  }
+  
+  // True once a complete dump was decoded, until consumeHSV()
+  bool hsvReady() const {
+    return dump_ready;
+  }
+  
+  void consumeHSV() {
+    dump_ready = false;
+  }
+  
+  const HSVRegionData* hsvRegions() const {
+    return dump_regions;
+  }
+  
+  int hsvRegionCount() const {
+    return dump_count;
+  }
+  
+  // Regions discarded because the buffer or region array was full
+  uint32_t skippedHSVRegions() const {
+    return dump_skipped_regions;
+  }
+  
+  // ========================================
+  // BINARY REGION STATISTICS
+  // ========================================
+  
+  // True once a complete RSTATS answer was decoded, until consumeStats()
+  bool statsReady() const {
+    return stats_ready;
+  }
+  
+  void consumeStats() {
+    stats_ready = false;
+  }
+  
+  // Regions beyond BLOB_CLIENT_MAX_STAT_REGIONS are read and dropped
+  const RegionStatsResult* regionStats() const {
+    return stats;
+  }
+  
+  int regionStatsCount() const {
+    return stats_count;
+  }
+  
+  // Blobs currently held for change-only subscriptions
+  int liveCount() const {
+    return live_count;
+  }
+  
+  void reset() {
+    bin_active = false;
+    stats_remaining = 0;
+    change_open = false;
+    live_count = 0;
+    line_len = 0;
+    line_overflow = false;
+    frame_open = false;
+    back_count = 0;
+    expect = EXPECT_ANY;
+  }
+};
+
+#endif // BLOB_STREAM_PARSER_H
\ No newline at end of file
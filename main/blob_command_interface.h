@@ -5,6 +5,12 @@
 #include "color_threshold_manager.h"
 #include "region_manager.h"
 #include "blob_detector_ccl.h"
+#include "change_reporter.h"
+#include "blob_tracker.h"
+#include "region_stats.h"
+#include "threshold_calibrator.h"
+#include "config_store.h"
+#include "frame_codec.h"
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -13,11 +19,95 @@
 // BLOB DETECTION COMMAND INTERFACE
 // ========================================
 
+// Maximum CSV fields in one command line, the "#<seq>" prefix included
+// (#<seq> + REGION_MULTI with 7 regions = 32); longer lines are refused
+#define CMD_MAX_TOKENS 32
+
+// Commands handled per processCommands() call before acks are flushed
+#define CMD_MAX_BATCH 32
+
+// Largest REGION_MASK box, in pixels
+#define CMD_MAX_MASK_PIXELS (640 * 480)
+
+// Colors OCCUPANCY may index at once; each costs a whole-frame classification
+// pass per frame and a bit per pixel (about 38 KB at VGA)
+#define CMD_MAX_OCCUPANCY_COLORS 4
+
+// Most frames one CALIBRATE may sample
+#define CMD_MAX_CALIBRATE_FRAMES 100
+
+// Sequenced acks buffered before a forced flush
+#define CMD_MAX_PENDING_ACKS 16
+
+// HSV dump row encodings (same values as the client's blob_stream_parser.h)
+#define HSV_ENC_RAW 0      // Plain bytes
+#define HSV_ENC_RLE 1      // Literal / repeat runs (frameRleEncode), runs never cross rows
+#define HSV_ENC_DELTA 2    // Byte deltas along the row, then RLE
+
 class BlobCommandInterface {
 private:
   SimpleSerialReceiver receiver;
   SimpleSerialSender sender;
   
+  // Sequence id of the command being executed (-1 = legacy, unsequenced)
+  long current_seq;
+  
+  // Sequenced commands that succeeded but have not been acknowledged yet
+  uint16_t pending_acks[CMD_MAX_PENDING_ACKS];
+  int pending_ack_count;
+  
+  // Last DETECT / DETECT_ALL / HSV_DUMP / REGION_STATS still waiting for an image
+  enum PendingRequest { REQUEST_NONE, REQUEST_DETECT, REQUEST_DETECT_ALL, REQUEST_HSV_DUMP, REQUEST_REGION_STATS };
+  PendingRequest pending_request;
+  RegionSetId pending_region_set;
+  std::vector<ColorId> pending_colors;
+  uint8_t pending_encoding;
+  
+  // SUBSCRIBE'd region sets, reported as changes only
+  ChangeReporter reporter;
+  
+  // TRACK'ed region set (REGION_SET_NONE = not tracking), reported as tracks every frame
+  BlobTracker tracker;
+  RegionSetId track_region_set;
+  std::vector<ColorId> track_colors;       // Empty = all colors
+  
+  // Results of detectAndSend(), reused every frame
+  DetectionResults frame_results;
+  
+  // OCCUPANCY colors (empty = off), indexed every frame for COUNT
+  OccupancyIndex occupancy;
+  std::vector<ColorId> occupancy_colors;
+  
+  // CALIBRATE in progress, sampled every frame
+  ThresholdCalibrator calibrator;
+  ColorId calibrate_color;
+  
+  // Where CONFIG_SAVE stores colors, region sets and subscriptions
+  ConfigStore config_store;
+  
+  // Statistics, threshold table and wire bytes of sendRegionStats(), reused every frame
+  std::vector<RegionStats> region_stats;
+  RegionStatsWorkspace stats_work;
+  std::vector<uint8_t> stats_bytes;
+  
+  // Encoded row of sendHSVRegions(), sized for the widest frame seen
+  std::vector<uint8_t> hsv_row;
+  
+  // Detect latency and blobs found, for /metrics
+  void recordDetection(const DetectionResults& results, unsigned long start_us) {
+    getMetrics().observeStage(STAGE_DETECT, start_us);
+    getMetrics().blobs_per_frame.observe(results.blobCount());
+  }
+  
+  void recordDetection(const std::vector<RegionResults>& results, unsigned long start_us) {
+    getMetrics().observeStage(STAGE_DETECT, start_us);
+    uint32_t blobs = 0;
+    for (const auto& region : results) {
+      for (const auto& entry : region.color_blobs) blobs += entry.blobs.size();
+    }
+    getMetrics().blobs_per_frame.observe(blobs);
+  }
+  
   // Parse helpers
   bool parseInts(const String* tokens, int count, int* values, int expected) {
     if (count < expected) return false;
@@ -27,16 +117,62 @@ private:
     return true;
   }
   
+  // Send all buffered acks as one line: ACK,<seq>,<seq>,...
+  void flushAcks() {
+    if (pending_ack_count == 0) return;
+    
+    String line = "ACK";
+    for (int i = 0; i < pending_ack_count; i++) {
+      line += "," + String(pending_acks[i]);
+    }
+    sender.send(line);
+    pending_ack_count = 0;
+  }
+  
   void sendError(const String& message) {
-    sender.send("ERROR: " + message);
+    if (current_seq < 0) {
+      sender.send("ERROR: " + message);
+      return;
+    }
+    
+    // Keep ordering: everything acked so far goes out before the NAK
+    flushAcks();
+    sender.send("NAK," + String(current_seq) + "," + message);
   }
   
   void sendOK() {
-    sender.send("OK");
+    if (current_seq < 0) {
+      sender.send("OK");
+      return;
+    }
+    
+    pending_acks[pending_ack_count++] = static_cast<uint16_t>(current_seq);
+    if (pending_ack_count >= CMD_MAX_PENDING_ACKS) {
+      flushAcks();
+    }
+  }
+  
+  // First line of a multi-line response; tagged "#<seq>,<header>" when sequenced
+  void beginResponse(const String& header) {
+    if (current_seq < 0) {
+      sender.send(header);
+      return;
+    }
+    
+    flushAcks();
+    sender.send("#" + String(current_seq) + "," + header);
   }
 
 public:
-  BlobCommandInterface(HardwareSerial* ser = &Serial) : receiver(ser), sender(ser) {}
+  BlobCommandInterface(HardwareSerial* ser = &Serial)
+    : receiver(ser), sender(ser), current_seq(-1), pending_ack_count(0),
+      pending_request(REQUEST_NONE), pending_region_set(REGION_SET_NONE), pending_encoding(HSV_ENC_RLE),
+      track_region_set(REGION_SET_NONE), calibrate_color(COLOR_NONE) {}
+  
+  BlobCommandInterface(Transport* transport)
+    : receiver(transport), sender(transport), current_seq(-1), pending_ack_count(0),
+      pending_request(REQUEST_NONE), pending_region_set(REGION_SET_NONE), pending_encoding(HSV_ENC_RLE),
+      track_region_set(REGION_SET_NONE), calibrate_color(COLOR_NONE) {}
   
   void begin(unsigned long baud = 115200) {
     receiver.begin(baud);
@@ -44,16 +180,59 @@ public:
   }
   
   // Process incoming commands
+  // Drains every complete line that is already buffered, then acknowledges
+  // all sequenced commands of the batch with a single ACK line. A line whose
+  // '\n' has not arrived yet stays in the receiver until a later call.
   void processCommands() {
     if (!receiver.receiveLine(10)) return; // Quick 10ms timeout
     
-    String input = receiver.getString();
+    int handled = 0;
+    do {
+      processLine(receiver.getString());
+      handled++;
+    } while (handled < CMD_MAX_BATCH && receiver.pollLine());
+    
+    getMetrics().commands.add(handled);
+    getMetrics().command_queue_depth.set(handled);
+    flushAcks();
+  }
+
+private:
+  // Execute one command line, optionally prefixed with "#<seq>,"
+  void processLine(const String& input) {
     if (input.length() == 0) return;
     
-    String tokens[10];
-    int token_count = receiver.parseCSV(tokens, 10);
+    // One spare field tells a line at the limit from a cut-off one
+    String all_tokens[CMD_MAX_TOKENS + 1];
+    int token_count = receiver.parseCSV(all_tokens, CMD_MAX_TOKENS + 1);
     if (token_count == 0) return;
     
+    String* tokens = all_tokens;
+    bool too_long = token_count > CMD_MAX_TOKENS;
+    current_seq = -1;
+    
+    if (tokens[0].startsWith("#")) {
+      current_seq = tokens[0].substring(1).toInt() & 0xFFFF;
+      tokens++;
+      token_count--;
+      if (token_count == 0) {
+        sendError("Missing command");
+        current_seq = -1;
+        return;
+      }
+    }
+    
+    if (too_long) {
+      sendError("Too many fields (max " + String(CMD_MAX_TOKENS) + " with #<seq>)");
+      current_seq = -1;
+      return;
+    }
+    
+    executeCommand(tokens, token_count);
+    current_seq = -1;
+  }
+  
+  void executeCommand(String* tokens, int token_count) {
     String cmd = tokens[0];
     cmd.toUpperCase();
     
@@ -75,7 +254,10 @@ public:
       }
       
       ColorThresholds threshold(values[0], values[1], values[2], values[3], values[4], values[5]);
-      getColorManager().setColor(std::string(tokens[1].c_str()), threshold);
+      if (!getColorManager().setColor(std::string(tokens[1].c_str()), threshold)) {
+        sendError("Too many colors");
+        return;
+      }
       sendOK();
     }
     
@@ -96,7 +278,30 @@ public:
         ColorThresholds(values[0], values[1], values[2], values[3], values[4], values[5]),
         ColorThresholds(values[6], values[7], values[8], values[9], values[10], values[11])
       };
-      getColorManager().setColor(std::string(tokens[1].c_str()), thresholds);
+      if (!getColorManager().setColor(std::string(tokens[1].c_str()), thresholds)) {
+        sendError("Too many colors");
+        return;
+      }
+      sendOK();
+    }
+    
+    else if (cmd == "COLOR_SETN") {
+      // COLOR_SETN,name,h_min:h_max:s_min:s_max:v_min:v_max,...   one token per box
+      // h_min > h_max wraps through 179 -> 0; overlapping boxes are merged
+      std::vector<ColorThresholds> thresholds;
+      ColorThresholds box;
+      for (int i = 2; i < token_count && parseColorBox(tokens[i].c_str(), box); i++) {
+        thresholds.push_back(box);
+      }
+      
+      if (thresholds.empty() || int(thresholds.size()) != token_count - 2) {
+        sendError("COLOR_SETN needs: name,h_min:h_max:s_min:s_max:v_min:v_max,... (one or more boxes)");
+        return;
+      }
+      if (!getColorManager().setColor(std::string(tokens[1].c_str()), thresholds)) {
+        sendError("Too many colors");
+        return;
+      }
       sendOK();
     }
     
@@ -114,10 +319,38 @@ public:
       }
     }
     
+    else if (cmd == "CALIBRATE") {
+      // CALIBRATE,color,region_set[,frames[,keep_pct]]
+      int values[2] = {CALIB_DEFAULT_FRAMES, CALIB_DEFAULT_KEEP_PCT};
+      for (int i = 3; i < token_count && i < 5; i++) values[i - 3] = tokens[i].toInt();
+      if (token_count < 3 || values[0] < 1 || values[0] > CMD_MAX_CALIBRATE_FRAMES || values[1] < 50 || values[1] > 100) {
+        sendError("CALIBRATE needs: color,region_set[,frames 1.." + String(CMD_MAX_CALIBRATE_FRAMES) +
+                  "[,keep_pct 50..100]]");
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[2].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[2]);
+        return;
+      }
+      
+      ColorId color = getColorManager().colorId(std::string(tokens[1].c_str()));
+      if (color == COLOR_NONE) {
+        sendError("Too many colors");
+        return;
+      }
+      
+      // The result follows as CALIBRATED,... once interface.calibrateFrame() sampled enough frames
+      calibrate_color = color;
+      calibrator.begin(set_id, values[0], values[1]);
+      sendOK();
+    }
+    
     else if (cmd == "COLOR_LIST") {
       // COLOR_LIST
       std::vector<std::string> colors = getColorManager().getAllColorNames();
-      sender.send("COLORS");
+      beginResponse("COLORS");
       for (const auto& color : colors) {
         sender.send(color.c_str());
       }
@@ -136,13 +369,16 @@ public:
       }
       
       int values[4];
-      if (!parseInts(&tokens[2], 4, values, 4)) {
+      if (!parseInts(&tokens[2], 4, values, 4) || !regionBoxValid(values[0], values[1], values[2], values[3])) {
         sendError("Invalid region values");
         return;
       }
       
       DetectionRegion region(values[0], values[1], values[2], values[3]);
-      getRegionManager().setRegionSet(std::string(tokens[1].c_str()), region);
+      if (!getRegionManager().setRegionSet(std::string(tokens[1].c_str()), region)) {
+        sendError("Too many region sets");
+        return;
+      }
       sendOK();
     }
     
@@ -165,14 +401,88 @@ public:
       for (int i = 0; i < region_count; i++) {
         int offset = 3 + (i * 4);
         int values[4];
-        if (!parseInts(&tokens[offset], 4, values, 4)) {
+        if (!parseInts(&tokens[offset], 4, values, 4) ||
+            !regionBoxValid(values[0], values[1], values[2], values[3])) {
           sendError("Invalid region values");
           return;
         }
         regions.emplace_back(values[0], values[1], values[2], values[3]);
       }
       
-      getRegionManager().setRegionSet(std::string(tokens[1].c_str()), regions);
+      if (!getRegionManager().setRegionSet(std::string(tokens[1].c_str()), regions)) {
+        sendError("Too many region sets");
+        return;
+      }
+      sendOK();
+    }
+    
+    else if (cmd == "REGION_POLY") {
+      // REGION_POLY,name,n1,x,y,...,n2,x,y,...   one region per polygon
+      std::vector<DetectionRegion> regions;
+      int offset = 2;
+      while (offset < token_count) {
+        int points = tokens[offset].toInt();
+        if (points < 3 || points > (token_count - offset - 1) / 2) break;
+        
+        std::vector<int> coords(points * 2);
+        if (!parseInts(&tokens[offset + 1], points * 2, coords.data(), points * 2)) break;
+        std::vector<RegionPoint> polygon(points);
+        for (int i = 0; i < points; i++) polygon[i] = {coords[i * 2], coords[i * 2 + 1]};
+        
+        DetectionRegion region = polygonRegion(polygon);
+        if (region.width == 0) break;
+        regions.push_back(region);
+        offset += 1 + points * 2;
+      }
+      
+      if (regions.empty() || offset != token_count) {
+        sendError("REGION_POLY needs: name,count,x1,y1,x2,y2,x3,y3,... (3+ points within +-" + String(REGION_COORD_LIMIT) + ", nonzero area)");
+        return;
+      }
+      if (!getRegionManager().setRegionSet(std::string(tokens[1].c_str()), regions)) {
+        sendError("Too many region sets");
+        return;
+      }
+      sendOK();
+    }
+    
+    else if (cmd == "REGION_MASK") {
+      // REGION_MASK,name,x,y,width,height,runs
+      // runs: row-major lengths separated by ':', alternately outside and
+      // inside, starting outside, adding up to width * height
+      int values[4];
+      if (token_count < 7 || !parseInts(&tokens[2], 4, values, 4) ||
+          values[2] <= 0 || values[3] <= 0 || !regionBoxValid(values[0], values[1], values[2], values[3]) ||
+          int64_t(values[2]) * values[3] > CMD_MAX_MASK_PIXELS) {
+        sendError("REGION_MASK needs: name,x,y,width,height,runs");
+        return;
+      }
+      
+      std::vector<uint8_t> mask(values[2] * values[3], 0);
+      const char* p = tokens[6].c_str();
+      size_t pos = 0;
+      bool inside = false;
+      while (*p) {
+        char* end;
+        long run = strtol(p, &end, 10);
+        if (end == p || run < 0 || pos + run > mask.size()) break;
+        p = end;
+        if (inside) memset(mask.data() + pos, 1, run);
+        pos += run;
+        inside = !inside;
+        if (*p != ':') break;
+        p++;
+      }
+      
+      DetectionRegion region = maskRegion(values[0], values[1], values[2], values[3], mask.data());
+      if (*p || pos != mask.size() || region.width == 0) {
+        sendError("Invalid mask runs");
+        return;
+      }
+      if (!getRegionManager().setRegionSet(std::string(tokens[1].c_str()), region)) {
+        sendError("Too many region sets");
+        return;
+      }
       sendOK();
     }
     
@@ -193,7 +503,7 @@ public:
     else if (cmd == "REGION_LIST") {
       // REGION_LIST
       std::vector<std::string> region_sets = getRegionManager().getAllRegionSetNames();
-      sender.send("REGIONS");
+      beginResponse("REGIONS");
       for (const auto& set_name : region_sets) {
         sender.send(set_name.c_str());
       }
@@ -211,20 +521,25 @@ public:
         return;
       }
       
-      std::vector<std::string> colors;
+      // Names are resolved here, once; unknown ones simply find nothing
+      std::vector<ColorId> colors;
       for (int i = 2; i < token_count; i++) {
-        colors.push_back(std::string(tokens[i].c_str()));
+        colors.push_back(getColorManager().findColor(std::string(tokens[i].c_str())));
       }
       
       // Note: HSVImage would need to be provided from outside
       // This is a placeholder for the actual detection call
-      sender.send("DETECT_READY");
+      beginResponse("DETECT_READY");
       sender.send(tokens[1]); // region_set name
       sender.send(String(colors.size())); // number of colors
-      for (const auto& color : colors) {
-        sender.send(color.c_str());
+      for (int i = 2; i < token_count; i++) {
+        sender.send(tokens[i]);
       }
       sender.endTransmission();
+      
+      pending_request = REQUEST_DETECT;
+      pending_region_set = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+      pending_colors.swap(colors);
     }
     
     else if (cmd == "DETECT_ALL") {
@@ -234,15 +549,273 @@ public:
         return;
       }
       
-      sender.send("DETECT_ALL_READY");
+      beginResponse("DETECT_ALL_READY");
+      sender.send(tokens[1]); // region_set name
+      sender.endTransmission();
+      
+      pending_request = REQUEST_DETECT_ALL;
+      pending_region_set = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+    }
+    
+    else if (cmd == "HSV_DUMP") {
+      // HSV_DUMP,region_set[,RAW|RLE|DELTA]
+      if (token_count < 2) {
+        sendError("HSV_DUMP needs: region_set[,RAW|RLE|DELTA]");
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[1]);
+        return;
+      }
+      
+      int encoding = HSV_ENC_RLE;
+      if (token_count > 2) {
+        if (tokens[2] == "RAW") encoding = HSV_ENC_RAW;
+        else if (tokens[2] == "RLE") encoding = HSV_ENC_RLE;
+        else if (tokens[2] == "DELTA") encoding = HSV_ENC_DELTA;
+        else {
+          sendError("Unknown encoding: " + tokens[2]);
+          return;
+        }
+      }
+      
+      // The application answers with sendHSVRegions() on its next image
+      beginResponse("HSV_DUMP_READY");
       sender.send(tokens[1]); // region_set name
+      sender.send(String(encoding));
+      sender.endTransmission();
+      
+      pending_request = REQUEST_HSV_DUMP;
+      pending_region_set = set_id;
+      pending_encoding = encoding;
+    }
+    
+    else if (cmd == "REGION_STATS") {
+      // REGION_STATS,region_set[,color1,color2,...]   no colors = all colors
+      if (token_count < 2) {
+        sendError("REGION_STATS needs: region_set[,colors...]");
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[1]);
+        return;
+      }
+      
+      // Names are interned so the RSTATS header can list them even before they are set
+      std::vector<ColorId> colors;
+      for (int i = 2; i < token_count; i++) {
+        ColorId color = getColorManager().colorId(std::string(tokens[i].c_str()));
+        if (color == COLOR_NONE) {
+          sendError("Too many colors");
+          return;
+        }
+        colors.push_back(color);
+      }
+      if (colors.empty()) colors = getColorManager().getAllColorIds();
+      
+      // The application answers with sendRegionStats() on its next image
+      beginResponse("REGION_STATS_READY");
+      sender.send(tokens[1]); // region_set name
+      sender.endTransmission();
+      
+      pending_request = REQUEST_REGION_STATS;
+      pending_region_set = set_id;
+      pending_colors.swap(colors);
+    }
+    
+    // ========================================
+    // OCCUPANCY QUERIES
+    // ========================================
+    
+    else if (cmd == "OCCUPANCY") {
+      // OCCUPANCY[,color1,color2,...]   no colors = stop indexing
+      if (token_count - 1 > CMD_MAX_OCCUPANCY_COLORS) {
+        sendError("OCCUPANCY takes at most " + String(CMD_MAX_OCCUPANCY_COLORS) + " colors");
+        return;
+      }
+      
+      std::vector<ColorId> colors;
+      for (int i = 1; i < token_count; i++) {
+        ColorId color = getColorManager().colorId(std::string(tokens[i].c_str()));
+        if (color == COLOR_NONE) {
+          sendError("Too many colors");
+          return;
+        }
+        colors.push_back(color);
+      }
+      
+      occupancy_colors.swap(colors);
+      occupancy.begin(0, 0, {});
+      sendOK();
+    }
+    
+    else if (cmd == "COUNT") {
+      // COUNT,color,x,y,width,height  or  COUNT,color,region_set (one count per region)
+      int values[4];
+      bool rect = token_count >= 6 && parseInts(&tokens[2], token_count - 2, values, 4);
+      if (!rect && token_count != 3) {
+        sendError("COUNT needs: color,x,y,width,height or color,region_set");
+        return;
+      }
+      
+      ColorId color = getColorManager().findColor(std::string(tokens[1].c_str()));
+      if (color == COLOR_NONE ||
+          std::find(occupancy_colors.begin(), occupancy_colors.end(), color) == occupancy_colors.end()) {
+        sendError("Color not indexed: " + tokens[1]);
+        return;
+      }
+      int color_index = occupancy.colorIndex(color);
+      if (occupancy.isEmpty() || color_index < 0) {
+        sendError("No frame indexed yet");
+        return;
+      }
+      
+      if (rect) {
+        beginResponse("COUNT");
+        sender.send(String(occupancy.count(color_index, values[0], values[1], values[2], values[3])));
+        sender.endTransmission();
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[2].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[2]);
+        return;
+      }
+      
+      beginResponse("COUNT");
+      for (const DetectionRegion& region : getRegionManager().getRegions(set_id)) {
+        sender.send(String(occupancy.count(color, region)));
+      }
       sender.endTransmission();
     }
     
+    // ========================================
+    // CHANGE-ONLY REPORTING
+    // ========================================
+    
+    else if (cmd == "SUBSCRIBE") {
+      // SUBSCRIBE,region_set,move_px,size_pct,keyframe_frames[,color1,color2,...]
+      int values[3];
+      if (token_count < 5 || !parseInts(&tokens[2], token_count - 2, values, 3)) {
+        sendError("SUBSCRIBE needs: region_set,move_px,size_pct,keyframe_frames[,colors...]");
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[1]);
+        return;
+      }
+      
+      // Handles are reserved for colors not set yet, so they start matching once defined
+      std::vector<ColorId> colors;
+      for (int i = 5; i < token_count; i++) {
+        colors.push_back(getColorManager().colorId(std::string(tokens[i].c_str())));
+      }
+      
+      if (reporter.subscribe(set_id, colors, values[0], values[1], values[2]) < 0) {
+        sendError("Too many subscriptions");
+        return;
+      }
+      sendOK();
+    }
+    
+    else if (cmd == "UNSUBSCRIBE") {
+      // UNSUBSCRIBE,region_set
+      if (token_count < 2) {
+        sendError("UNSUBSCRIBE needs: region_set");
+        return;
+      }
+      
+      int slot = reporter.unsubscribe(getRegionManager().findRegionSet(std::string(tokens[1].c_str())));
+      if (slot < 0) {
+        sendError("Not subscribed: " + tokens[1]);
+        return;
+      }
+      
+      // Empty keyframe: the client drops the blobs it holds for this slot
+      sender.send("SUB," + String(slot) + ",K");
+      sender.endTransmission();
+      sendOK();
+    }
+    
+    // ========================================
+    // TRACKING
+    // ========================================
+    
+    else if (cmd == "TRACK") {
+      // TRACK,region_set,rescan_frames[,color1,color2,...]
+      int rescan;
+      if (token_count < 3 || !parseInts(&tokens[2], token_count - 2, &rescan, 1) || rescan < 1) {
+        sendError("TRACK needs: region_set,rescan_frames[,colors...]");
+        return;
+      }
+      
+      RegionSetId set_id = getRegionManager().findRegionSet(std::string(tokens[1].c_str()));
+      if (!getRegionManager().hasRegionSet(set_id)) {
+        sendError("Region set not found: " + tokens[1]);
+        return;
+      }
+      
+      track_colors.clear();
+      for (int i = 3; i < token_count; i++) {
+        track_colors.push_back(getColorManager().colorId(std::string(tokens[i].c_str())));
+      }
+      track_region_set = set_id;
+      tracker.reset();
+      tracker.setRescanInterval(rescan);
+      sendOK();
+    }
+    
+    else if (cmd == "UNTRACK") {
+      // UNTRACK
+      if (track_region_set == REGION_SET_NONE) {
+        sendError("Not tracking");
+        return;
+      }
+      
+      track_region_set = REGION_SET_NONE;
+      tracker.reset();
+      sendOK();
+    }
+    
+    // ========================================
+    // STORED CONFIGURATION
+    // ========================================
+    
+    else if (cmd == "CONFIG_SAVE") {
+      // CONFIG_SAVE   (colors, region sets and subscriptions, restored by loadConfig())
+      if (!config_store.hasStorage()) {
+        sendError("No config storage");
+        return;
+      }
+      if (!config_store.save(&reporter)) {
+        sendError("Config write failed");
+        return;
+      }
+      sendOK();
+    }
+    
+    else if (cmd == "CONFIG_CLEAR") {
+      // CONFIG_CLEAR   (next boot starts from the defaults; nothing changes now)
+      if (!config_store.clear()) {
+        sendError("Config erase failed");
+        return;
+      }
+      sendOK();
+    }
+    
     else {
       sendError("Unknown command: " + cmd);
     }
   }
+
+public:
   
   // ========================================
   // BLOB DETECTION RESULTS SENDER
@@ -257,20 +830,19 @@ public:
       sender.send("REGION");
       sender.send(String(region_result.region_id));
       
-      // Get all colors that have blobs
-      std::vector<std::string> colors_with_blobs;
-      for (const auto& color_pair : region_result.color_blobs) {
-        if (!color_pair.second.empty()) {
-          colors_with_blobs.push_back(color_pair.first);
-        }
+      // Count colors that have blobs
+      int colors_with_blobs = 0;
+      for (const auto& entry : region_result.color_blobs) {
+        if (!entry.blobs.empty()) colors_with_blobs++;
       }
       
-      sender.send(String(colors_with_blobs.size())); // number of colors with blobs
+      sender.send(String(colors_with_blobs)); // number of colors with blobs
       
-      for (const std::string& color : colors_with_blobs) {
-        const auto& blobs = region_result.getBlobsForColor(color);
+      for (const auto& entry : region_result.color_blobs) {
+        const auto& blobs = entry.blobs;
+        if (blobs.empty()) continue;
         sender.send("COLOR");
-        sender.send(color.c_str());
+        sender.send(getColorManager().colorName(entry.color).c_str());
         sender.send(String(blobs.size())); // number of blobs for this color
         
         for (const auto& blob : blobs) {
@@ -286,15 +858,46 @@ public:
     sender.send("BLOBS_END");
   }
   
+  void sendBlobResults(const DetectionResults& results) {
+    sender.send("BLOBS_START");
+    sender.send(String(results.regionCount())); // number of regions
+    
+    for (int r = 0; r < results.regionCount(); r++) {
+      sender.send("REGION");
+      sender.send(String(r));
+      
+      int colors_with_blobs = 0;
+      for (int c = 0; c < results.colorCount(); c++) {
+        if (results.slot(r, c).count > 0) colors_with_blobs++;
+      }
+      sender.send(String(colors_with_blobs)); // number of colors with blobs
+      
+      for (int c = 0; c < results.colorCount(); c++) {
+        const DetectionResults::Slot& slot = results.slot(r, c);
+        if (slot.count == 0) continue;
+        sender.send("COLOR");
+        sender.send(getColorManager().colorName(results.colorAt(c)).c_str());
+        sender.send(String(slot.count)); // number of blobs for this color
+        
+        for (uint32_t i = slot.first; i < slot.first + slot.count; i++) {
+          sender.send(String(results.x(i)) + "," + String(results.y(i)) + "," + String(results.size(i)));
+        }
+      }
+    }
+    
+    sender.send("BLOBS_END");
+  }
+  
   // Simplified blob result sender (just coordinates)
   void sendSimpleBlobResults(const std::vector<RegionResults>& results) {
     for (const auto& region_result : results) {
-      for (const auto& color_pair : region_result.color_blobs) {
-        if (!color_pair.second.empty()) {
-          for (const auto& blob : color_pair.second) {
+      for (const auto& entry : region_result.color_blobs) {
+        if (!entry.blobs.empty()) {
+          const std::string& color_name = getColorManager().colorName(entry.color);
+          for (const auto& blob : entry.blobs) {
             // Format: R{region_id},{color},{x},{y},{size}
             String result = "R" + String(region_result.region_id) + "," +
-                           String(color_pair.first.c_str()) + "," +
+                           String(color_name.c_str()) + "," +
                            String(blob.center_x) + "," +
                            String(blob.center_y) + "," +
                            String(blob.pixel_count);
@@ -306,29 +909,309 @@ public:
     sender.endTransmission();
   }
   
+  void sendSimpleBlobResults(const DetectionResults& results) {
+    for (int r = 0; r < results.regionCount(); r++) {
+      for (int c = 0; c < results.colorCount(); c++) {
+        const DetectionResults::Slot& slot = results.slot(r, c);
+        if (slot.count == 0) continue;
+        
+        const std::string& color_name = getColorManager().colorName(results.colorAt(c));
+        for (uint32_t i = slot.first; i < slot.first + slot.count; i++) {
+          // Format: R{region_id},{color},{x},{y},{size}
+          sender.send("R" + String(r) + "," + String(color_name.c_str()) + "," +
+                      String(results.x(i)) + "," + String(results.y(i)) + "," + String(results.size(i)));
+        }
+      }
+    }
+    sender.endTransmission();
+  }
+  
+  // ========================================
+  // BINARY HSV REGION DUMP
+  // ========================================
+  
+  // Worst case of one encoded row: a control byte per 128 literals
+  static size_t encodedRowLimit(int width) {
+    return size_t(width) + (size_t(width) + 127) / 128;
+  }
+  
+  // One row in the literal / repeat runs of frameRleEncode(), so noise costs
+  // about a byte per pixel instead of two. With delta each value is first
+  // replaced by the difference to the previous pixel of the row, in scratch
+  // (width bytes). out needs room for encodedRowLimit(width) bytes.
+  static size_t encodeRow(const uint8_t* row, int width, bool delta, uint8_t* scratch, uint8_t* out) {
+    const uint8_t* in = row;
+    if (delta) {
+      uint8_t prev = 0;
+      for (int i = 0; i < width; i++) {
+        scratch[i] = static_cast<uint8_t>(row[i] - prev);
+        prev = row[i];
+      }
+      in = scratch;
+    }
+    return frameRleEncode(in, width, out, encodedRowLimit(width));
+  }
+  
+  // HSVB_START,<regions>
+  // HSVB_REGION,<id>,<x>,<y>,<w>,<h>,<encoding>  + binary H plane, S plane, V plane
+  // HSVB_END
+  // Regions are clipped to the image; every row is encoded on its own.
+  void sendHSVRegions(const HSVImage& hsv, RegionSetId region_set, uint8_t encoding = HSV_ENC_RLE) {
+    if (!hsv.isValid() || !getRegionManager().hasRegionSet(region_set)) {
+      sender.send("HSVB_START,0");
+      sender.send("HSVB_END");
+      return;
+    }
+    
+    const auto& regions = getRegionManager().getRegions(region_set);
+    const uint8_t* planes[3] = {hsv.h_data, hsv.s_data, hsv.v_data};
+    hsv_row.resize(size_t(hsv.width) + encodedRowLimit(hsv.width));
+    uint8_t* scratch = hsv_row.data();
+    uint8_t* row_buf = scratch + hsv.width;
+    
+    sender.send("HSVB_START," + String(regions.size()));
+    
+    for (size_t r = 0; r < regions.size(); r++) {
+      const DetectionRegion& region = regions[r];
+      int x0 = max(0, region.x);
+      int y0 = max(0, region.y);
+      int x1 = min(hsv.width, region.x + region.width);
+      int y1 = min(hsv.height, region.y + region.height);
+      int w = max(0, x1 - x0);
+      int h = max(0, y1 - y0);
+      
+      sender.send("HSVB_REGION," + String(r) + "," + String(x0) + "," + String(y0) + "," +
+                  String(w) + "," + String(h) + "," + String(encoding));
+      if (w == 0 || h == 0) continue;
+      
+      for (int p = 0; p < 3; p++) {
+        for (int y = y0; y < y1; y++) {
+          const uint8_t* row = planes[p] + y * hsv.width + x0;
+          if (encoding == HSV_ENC_RAW) {
+            sender.sendBytes(row, w);
+          } else {
+            sender.sendBytes(row_buf, encodeRow(row, w, encoding == HSV_ENC_DELTA, scratch, row_buf));
+          }
+        }
+      }
+    }
+    
+    sender.send("HSVB_END");
+  }
+  
+  void sendHSVRegions(const HSVImage& hsv, const std::string& region_set_name,
+                      uint8_t encoding = HSV_ENC_RLE) {
+    sendHSVRegions(hsv, getRegionManager().findRegionSet(region_set_name), encoding);
+  }
+  
+  // ========================================
+  // BINARY REGION STATISTICS
+  // ========================================
+  
+  // RSTATS,<regions>[,<color>,...]  + one binary record per region (see
+  // appendRegionStatsBinary), coverage in the order of the listed colors.
+  // Colors that are not defined are listed and cover nothing. This is the
+  // pass of its own, for frames with no detection; detectAndSendStats()
+  // takes the statistics from the detection instead.
+  void sendRegionStats(const HSVImage& hsv, RegionSetId region_set, const std::vector<ColorId>& colors) {
+    unsigned long start = micros();
+    computeRegionStats(hsv, region_set, colors, region_stats, stats_work);
+    getMetrics().observeStage(STAGE_STATS, start);
+    sendRegionStatsRecords(colors);
+  }
+  
+  // The RSTATS answer of region_stats
+  void sendRegionStatsRecords(const std::vector<ColorId>& colors) {
+    String header = "RSTATS," + String(region_stats.size());
+    for (ColorId color : colors) {
+      header += ",";
+      header += getColorManager().colorName(color).c_str();
+    }
+    sender.send(header);
+    
+    stats_bytes.clear();
+    appendRegionStatsBinary(region_stats, stats_bytes);
+    sender.sendBytes(stats_bytes.data(), stats_bytes.size());
+  }
+  
+  void sendRegionStats(const HSVImage& hsv, const std::string& region_set_name,
+                       const std::vector<std::string>& colors) {
+    sendRegionStats(hsv, getRegionManager().findRegionSet(region_set_name), resolveColors(colors));
+  }
+  
   // ========================================
   // CONVENIENCE METHODS
   // ========================================
   
   // Perform detection and send results
-  void detectAndSend(const HSVImage& hsv, const std::string& region_set_name, 
-                    const std::vector<std::string>& colors, bool simple_format = false) {
-    auto results = detectBlobsStructured(hsv, region_set_name, colors);
+  void detectAndSend(const HSVImage& hsv, RegionSetId region_set,
+                     const std::vector<ColorId>& colors, bool simple_format = false) {
+    unsigned long start = micros();
+    detectBlobsInto(hsv, region_set, colors, frame_results);
+    recordDetection(frame_results, start);
     if (simple_format) {
-      sendSimpleBlobResults(results);
+      sendSimpleBlobResults(frame_results);
     } else {
-      sendBlobResults(results);
+      sendBlobResults(frame_results);
     }
   }
   
+  void detectAndSend(const HSVImage& hsv, const std::string& region_set_name,
+                    const std::vector<std::string>& colors, bool simple_format = false) {
+    detectAndSend(hsv, getRegionManager().findRegionSet(region_set_name), resolveColors(colors), simple_format);
+  }
+  
+  // Detection results followed by the RSTATS answer of the same frame, the
+  // statistics gathered by the detection's own classification
+  void detectAndSendStats(const HSVImage& hsv, RegionSetId region_set, const std::vector<ColorId>& colors) {
+    unsigned long start = micros();
+    detectBlobsInto(hsv, region_set, colors, frame_results, true, 10, nullptr, &region_stats);
+    recordDetection(frame_results, start);
+    sendBlobResults(frame_results);
+    sendRegionStatsRecords(colors);
+  }
+  
   // Detect all colors and send results
+  void detectAllAndSend(const HSVImage& hsv, RegionSetId region_set, bool simple_format = false) {
+    detectAndSend(hsv, region_set, getColorManager().getAllColorIds(), simple_format);
+  }
+  
   void detectAllAndSend(const HSVImage& hsv, const std::string& region_set_name, bool simple_format = false) {
-    auto results = detectAllColorsStructured(hsv, region_set_name);
-    if (simple_format) {
-      sendSimpleBlobResults(results);
-    } else {
-      sendBlobResults(results);
+    detectAllAndSend(hsv, getRegionManager().findRegionSet(region_set_name), simple_format);
+  }
+  
+  // A DETECT, DETECT_ALL, HSV_DUMP or REGION_STATS was accepted and not answered yet
+  bool hasPendingRequest() const {
+    return pending_request != REQUEST_NONE;
+  }
+  
+  // Answer the pending request from this image (detections in simple format)
+  void servicePendingRequest(const HSVImage& hsv) {
+    switch (pending_request) {
+      case REQUEST_DETECT:
+        detectAndSend(hsv, pending_region_set, pending_colors, true);
+        break;
+      case REQUEST_DETECT_ALL:
+        detectAllAndSend(hsv, pending_region_set, true);
+        break;
+      case REQUEST_HSV_DUMP:
+        sendHSVRegions(hsv, pending_region_set, pending_encoding);
+        break;
+      case REQUEST_REGION_STATS:
+        sendRegionStats(hsv, pending_region_set, pending_colors);
+        break;
+      default:
+        break;
     }
+    pending_request = REQUEST_NONE;
+  }
+  
+  // OCCUPANCY active
+  bool hasOccupancy() const {
+    return !occupancy_colors.empty();
+  }
+  
+  // Call once per captured frame while OCCUPANCY is active; COUNT answers
+  // from the last frame indexed. This is the standalone path: it classifies
+  // the whole frame once per OCCUPANCY color, on top of any detection the
+  // application runs on the same frame.
+  void updateOccupancy(const HSVImage& hsv) {
+    if (occupancy_colors.empty()) return;
+    occupancy.build(hsv, occupancy_colors);
+  }
+  
+  // Any SUBSCRIBE active
+  bool hasSubscriptions() const {
+    return reporter.hasSubscriptions();
+  }
+  
+  // Call once per captured frame: sends only blobs that appeared, vanished,
+  // or moved / resized beyond their subscription's deadbands
+  void reportChanges(const HSVImage& hsv) {
+    reporter.report(hsv, sender);
+  }
+  
+  // TRACK active
+  bool isTracking() const {
+    return track_region_set != REGION_SET_NONE;
+  }
+  
+  // Call once per captured frame while tracking. One block per frame:
+  //   TRACKS,<count>
+  //   T<id>,<region>,<color>,<x>,<y>,<size>,<vx>,<vy>   velocity in 1/10 px per frame
+  //   END
+  // Only tracks matched in this frame are listed; ids stay the same while a
+  // blob is followed, across short dropouts too.
+  void reportTracks(const HSVImage& hsv) {
+    if (!getRegionManager().hasRegionSet(track_region_set)) return;
+    
+    unsigned long start = micros();
+    std::shared_ptr<const CompiledRegionSet> compiled =
+      getRegionManager().getCompiledRegionSet(track_region_set, hsv.width, hsv.height);
+    tracker.detect(hsv, *compiled, track_colors.empty() ? getColorManager().getAllColorIds() : track_colors,
+                   frame_results);
+    recordDetection(frame_results, start);
+    
+    int live = 0;
+    for (const Track& t : tracker.getTracks()) {
+      if (t.misses == 0) live++;
+    }
+    
+    sender.send("TRACKS," + String(live));
+    for (const Track& t : tracker.getTracks()) {
+      if (t.misses) continue;
+      sender.send("T" + String(t.id) + "," + String(t.region_id) + "," +
+                  String(getColorManager().colorName(t.color).c_str()) + "," +
+                  String(lroundf(t.x)) + "," + String(lroundf(t.y)) + "," + String(t.size) + "," +
+                  String(lroundf(t.vx * 10)) + "," + String(lroundf(t.vy * 10)));
+    }
+    sender.endTransmission();
+  }
+  
+  // CALIBRATE in progress
+  bool isCalibrating() const {
+    return calibrator.isActive();
+  }
+  
+  // Call once per captured frame while calibrating. After the last frame the
+  // color is set and announced in the field order of COLOR_SET:
+  //   CALIBRATED,<color>,<h_min>,<h_max>,<s_min>,<s_max>,<v_min>,<v_max>   (h_min > h_max: hue wraps)
+  //   CALIBRATE_FAILED,<color>,<reason>
+  void calibrateFrame(const HSVImage& hsv) {
+    if (!calibrator.isActive()) return;
+    
+    const std::string& name = getColorManager().colorName(calibrate_color);
+    if (!getRegionManager().hasRegionSet(calibrator.regionSet())) {
+      calibrator.cancel();
+      sender.send(String("CALIBRATE_FAILED,") + name.c_str() + ",Region set deleted");
+      return;
+    }
+    if (!calibrator.addFrame(hsv)) return;
+    
+    std::vector<ColorThresholds> ranges;
+    if (!calibrator.finish(ranges)) {
+      sender.send(String("CALIBRATE_FAILED,") + name.c_str() + ",Region set outside the image");
+      return;
+    }
+    getColorManager().setColor(name, ranges);
+    
+    String line = String("CALIBRATED,") + name.c_str();
+    for (const ColorThresholds& t : getColorManager().getThresholds(calibrate_color)) {
+      line += "," + String(t.h_min) + "," + String(t.h_max) + "," + String(t.s_min) + "," +
+              String(t.s_max) + "," + String(t.v_min) + "," + String(t.v_max);
+    }
+    sender.send(line);
+  }
+  
+  // Storage behind CONFIG_SAVE / CONFIG_CLEAR (none by default)
+  void setConfigStorage(ConfigStorage* storage) {
+    config_store.setStorage(storage);
+  }
+  
+  // Restore what CONFIG_SAVE stored: colors, region sets and subscriptions.
+  // Call once at boot, before the first command; false if nothing valid is stored.
+  bool loadConfig() {
+    return config_store.load(&reporter);
   }
   
   // Send status info
@@ -355,13 +1238,17 @@ inline BlobCommandInterface& getCommandInterface() {
 
 /*
 BlobCommandInterface interface(&Serial2);
+NvsStorage nvs;   // main/nvs_storage.h
 
 void setup() {
   Serial.begin(115200);
   interface.begin(115200);
   
-  // Setup default regions and colors as needed
-  getRegionManager().setRegionSet("main", DetectionRegion(0, 0, 320, 240));
+  // Colors, regions and subscriptions of the last CONFIG_SAVE, or defaults
+  interface.setConfigStorage(&nvs);
+  if (!interface.loadConfig()) {
+    getRegionManager().setRegionSet("main", DetectionRegion(0, 0, 320, 240));
+  }
 }
 
 void loop() {
@@ -372,18 +1259,66 @@ void loop() {
   // HSVImage hsv = ...; // Get your image
   // interface.detectAllAndSend(hsv, "main", true); // simple format
   
+  // Or answer the client's DETECT / DETECT_ALL / HSV_DUMP / REGION_STATS on demand
+  // if (interface.hasPendingRequest()) interface.servicePendingRequest(hsv);
+  
+  // And stream changes for SUBSCRIBE'd region sets
+  // if (interface.hasSubscriptions()) interface.reportChanges(hsv);
+  
+  // And tracks for the TRACK'ed region set
+  // if (interface.isTracking()) interface.reportTracks(hsv);
+  
+  // And samples for a CALIBRATE
+  // if (interface.isCalibrating()) interface.calibrateFrame(hsv);
+  
+  // And the occupancy index COUNT queries are answered from
+  // if (interface.hasOccupancy()) interface.updateOccupancy(hsv);
+  
   delay(10);
 }
 
 // COMMAND EXAMPLES:
 // COLOR_SET,RED,0,10,50,255,50,255
 // COLOR_SET2,RED,0,10,50,255,50,255,160,179,50,255,50,255
+// COLOR_SETN,RED,160:10:50:255:50:255    (one box, hue wraps through 179 -> 0)
+// COLOR_SETN,SKIN,0:20:40:160:80:255,0:20:160:200:120:255,170:179:40:160:80:255
+// CALIBRATE,PART,probe,10   (then interface.calibrateFrame(hsv) every frame; sets PART)
 // REGION_SET,main,0,0,320,240
 // REGION_MULTI,grid,4,0,0,160,120,160,0,160,120,0,120,160,120,160,120,160,120
+// REGION_POLY,lane,4,120,0,200,0,300,240,20,240     (skewed lane as one region)
+// REGION_MASK,dish,0,0,4,4,1:2:1:8:1:2:1   (4x4 disc, runs alternate out / in)
 // DETECT,main,RED,GREEN
 // DETECT_ALL,main
+// SUBSCRIBE,main,3,15,100,RED,GREEN   (then interface.reportChanges(hsv) every frame)
+// UNSUBSCRIBE,main
+// TRACK,main,10,RED,GREEN   (then interface.reportTracks(hsv) every frame)
+// UNTRACK
+// HSV_DUMP,main,RLE    (then interface.sendHSVRegions(hsv, "main", HSV_ENC_RLE))
+// REGION_STATS,grid,RED,GREEN   (coverage, mean HSV and histograms per region)
+// OCCUPANCY,RED,GREEN  (then interface.updateOccupancy(hsv) every frame)
+// COUNT,RED,0,0,160,120     (RED pixels in that rectangle of the last frame)
+// COUNT,RED,grid            (RED pixels per region of grid)
 // COLOR_LIST
 // REGION_LIST
+// CONFIG_SAVE    (restored at boot by interface.loadConfig())
+// CONFIG_CLEAR
+//
+// PIPELINED (SEQUENCED) COMMANDS:
+// Prefix any command with "#<seq>," (seq = 0..65535). The client may send
+// many of them without waiting; every sequenced command that succeeds in one
+// processCommands() batch is acknowledged by a single line, failures by NAK.
+// Multi-line responses carry the id on their header line.
+// -> #1,COLOR_SET,RED,0,10,50,255,50,255
+// -> #2,COLOR_SET,GREEN,40,80,50,255,50,255
+// -> #3,REGION_SET,main,0,0,160,120
+// -> #4,COLOR_DEL,PURPLE
+// -> #5,COLOR_LIST
+// <- ACK,1,2,3
+// <- NAK,4,Color not found
+// <- #5,COLORS
+// <- RED
+// <- GREEN
+// <- END
 */
 
 #endif // BLOB_COMMAND_INTERFACE_H
\ No newline at end of file
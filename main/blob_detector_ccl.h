@@ -4,7 +4,10 @@
 #include "simple_converter.h"
 #include "color_threshold_manager.h"
 #include "region_manager.h"
+#include "config_snapshot.h"
+#include "region_stats.h"
 #include <vector>
+#include <cstring>
 
 
 // ========================================
@@ -24,49 +27,69 @@ struct Blob {
 // REGION RESULTS STRUCTURE
 // ========================================
 
+struct ColorBlobs {
+  ColorId color;
+  std::vector<Blob> blobs;
+};
+
+// One entry per requested color, in request order; a handful at most, so a
+// linear scan over the handles beats any hashing
 struct RegionResults {
   int region_id;
-  std::unordered_map<std::string, std::vector<Blob>> color_blobs;
+  std::vector<ColorBlobs> color_blobs;
   
   RegionResults(int id) : region_id(id) {}
   
-  std::vector<Blob>& getBlobsForColor(const std::string& color) {
-    return color_blobs[color];
+  std::vector<Blob>& getBlobsForColor(ColorId color) {
+    for (auto& entry : color_blobs) {
+      if (entry.color == color) return entry.blobs;
+    }
+    color_blobs.push_back({color, {}});
+    return color_blobs.back().blobs;
   }
   
-  const std::vector<Blob>& getBlobsForColor(const std::string& color) const {
-    auto it = color_blobs.find(color);
-    if (it != color_blobs.end()) {
-      return it->second;
+  const std::vector<Blob>& getBlobsForColor(ColorId color) const {
+    for (const auto& entry : color_blobs) {
+      if (entry.color == color) return entry.blobs;
     }
     static const std::vector<Blob> empty_vector;
     return empty_vector;
   }
+  
+  // By name, for callers outside the detection path
+  const std::vector<Blob>& getBlobsForColor(const std::string& color) const {
+    return getBlobsForColor(getColorManager().findColor(color));
+  }
 };
 
 // ========================================
 // UNION-FIND FOR CCL
 // ========================================
 
+// Room for n elements, at least doubling the capacity: scratch reused for
+// regions and windows of varying size then reallocates a few times in all
+// rather than whenever a slightly larger one comes along
+template <typename T>
+inline void reserveGrowing(std::vector<T>& v, size_t n) {
+  if (n > v.capacity()) v.reserve(std::max(n, 2 * v.capacity()));
+}
+
 class UnionFind {
 private:
-  uint16_t* parent;
-  uint16_t* rank;
-  uint16_t max_labels;
-  
+  std::vector<uint16_t> parent;
+  std::vector<uint16_t> rank;
+
 public:
-  UnionFind(uint16_t max_size) : max_labels(max_size) {
-    parent = new uint16_t[max_size];
-    rank = new uint16_t[max_size];
-    for (uint16_t i = 0; i < max_size; i++) {
-      parent[i] = i;
-      rank[i] = 0;
-    }
-  }
-  
-  ~UnionFind() {
-    delete[] parent;
-    delete[] rank;
+  UnionFind() {}
+  UnionFind(uint16_t max_size) { reset(max_size); }
+  
+  // Every label its own set again; storage is kept across calls
+  void reset(uint16_t max_size) {
+    reserveGrowing(parent, max_size);
+    reserveGrowing(rank, max_size);
+    parent.resize(max_size);
+    rank.assign(max_size, 0);
+    for (uint16_t i = 0; i < max_size; i++) parent[i] = i;
   }
   
   uint16_t find(uint16_t x) {
@@ -119,166 +142,792 @@ struct BlobStats {
 };
 
 // ========================================
-// CORE CCL BLOB DETECTION
+// LABELLING WORKSPACE
 // ========================================
 
-inline std::vector<Blob> detectSingleColorCCL(const HSVImage& hsv, const DetectionRegion& region,
-                                              const std::string& color_name, int min_size = 10) {
-  if (!hsv.isValid() || !getColorManager().hasColor(color_name)) return {};
+// Scratch buffers of labelMaskRegion(), detectSingleColorInto() and
+// detectBlobsInto(). Each only grows, so a workspace reused every frame
+// (DetectionResults keeps one) stops allocating once it has seen the
+// largest region and frame.
+struct LabelWorkspace {
+  std::vector<uint8_t> mask;        // Classification of one color, whole frame or one region
+  std::vector<RowSpan> spans;       // Spans of the row being classified
+  std::vector<uint16_t> labels;     // One per pixel of the region being labelled
+  UnionFind uf;
+  std::vector<BlobStats> stats;     // One per provisional label
+  std::vector<Blob> found;          // Blobs of the region being labelled
+  ValueCounts values;               // Region statistics folded into the classification
+};
+
+// ========================================
+// RESULT ARENA
+// ========================================
+
+// All blobs of one frame in flat columns, with one slot per (region, color)
+// pointing at its run of blobs. begin() keeps the capacity of the columns,
+// so an arena reused every frame stops allocating once it has seen the
+// busiest frame. Slots are laid out region by region, colors in request
+// order, which is also the order results are sent in.
+class DetectionResults {
+public:
+  struct Slot {
+    uint32_t first;
+    uint32_t count;
+  };
+  
+  // One slot's blobs; a view into the arena, valid until the next begin()
+  class BlobRange {
+  private:
+    const DetectionResults* owner;
+    uint32_t first;
+    uint32_t count;
+
+  public:
+    class iterator {
+    private:
+      const DetectionResults* owner;
+      uint32_t index;
+    public:
+      iterator(const DetectionResults* o, uint32_t i) : owner(o), index(i) {}
+      Blob operator*() const { return owner->blob(index); }
+      iterator& operator++() { index++; return *this; }
+      bool operator!=(const iterator& other) const { return index != other.index; }
+    };
+    
+    BlobRange(const DetectionResults* o, uint32_t f, uint32_t n) : owner(o), first(f), count(n) {}
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Blob operator[](size_t i) const { return owner->blob(first + i); }
+    iterator begin() const { return iterator(owner, first); }
+    iterator end() const { return iterator(owner, first + count); }
+  };
+
+private:
+  int region_count;
+  std::vector<ColorId> colors;
+  std::vector<Slot> slots;          // region * colors.size() + color index
+  std::vector<int16_t> xs;
+  std::vector<int16_t> ys;
+  std::vector<uint32_t> sizes;
+  LabelWorkspace work;              // Mask and labelling buffers of detectBlobsInto()
+
+public:
+  DetectionResults() : region_count(0) {}
   
-  const int region_width = region.width;
-  const int region_height = region.height;
-  const int region_pixels = region_width * region_height;
+  LabelWorkspace& workspace() { return work; }
   
-  if (region_pixels == 0) return {};
+  void reserve(size_t blobs) {
+    xs.reserve(blobs);
+    ys.reserve(blobs);
+    sizes.reserve(blobs);
+  }
   
-  uint8_t* mask = new uint8_t[region_pixels];
-  uint16_t* labels = new uint16_t[region_pixels];
+  // Start a frame: every slot empty, columns cleared but not freed
+  void begin(int regions, const std::vector<ColorId>& colors_to_detect) {
+    region_count = regions;
+    colors = colors_to_detect;
+    slots.assign(size_t(regions) * colors.size(), Slot{0, 0});
+    xs.clear();
+    ys.clear();
+    sizes.clear();
+  }
   
-  // Create binary mask
-  int valid_pixels = 0;
-  for (int ry = 0; ry < region_height; ry++) {
-    int img_y = region.y + ry;
-    if (img_y >= hsv.height) break;
+  // Fill one slot; each slot is filled at most once per frame. With
+  // largest_only just the biggest blob is kept.
+  void setSlot(int region, int color_index, const std::vector<Blob>& blobs, bool largest_only = false) {
+    Slot& slot = slots[size_t(region) * colors.size() + color_index];
+    slot.first = xs.size();
+    slot.count = 0;
+    if (blobs.empty()) return;
     
-    for (int rx = 0; rx < region_width; rx++) {
-      int img_x = region.x + rx;
-      if (img_x >= hsv.width) break;
-      
-      int img_idx = img_y * hsv.width + img_x;
-      int region_idx = ry * region_width + rx;
-      
-      uint8_t h = hsv.h_data[img_idx];
-      uint8_t s = hsv.s_data[img_idx];
-      uint8_t v = hsv.v_data[img_idx];
-      
-      bool matches = getColorManager().matchesColor(h, s, v, color_name);
-      mask[region_idx] = matches ? 1 : 0;
-      labels[region_idx] = 0;
-      if (matches) valid_pixels++;
+    size_t from = 0, to = blobs.size();
+    if (largest_only) {
+      for (size_t i = 1; i < blobs.size(); i++) {
+        if (blobs[i].pixel_count > blobs[from].pixel_count) from = i;
+      }
+      to = from + 1;
+    }
+    for (size_t i = from; i < to; i++) {
+      xs.push_back(blobs[i].center_x);
+      ys.push_back(blobs[i].center_y);
+      sizes.push_back(blobs[i].pixel_count);
     }
+    slot.count = to - from;
   }
   
-  if (valid_pixels == 0) {
-    delete[] mask;
-    delete[] labels;
-    return {};
+  int regionCount() const { return region_count; }
+  int colorCount() const { return colors.size(); }
+  ColorId colorAt(int color_index) const { return colors[color_index]; }
+  
+  // First index of color in the request, -1 if it was not requested
+  int colorIndex(ColorId color) const {
+    for (size_t c = 0; c < colors.size(); c++) {
+      if (colors[c] == color) return c;
+    }
+    return -1;
+  }
+  
+  const Slot& slot(int region, int color_index) const {
+    return slots[size_t(region) * colors.size() + color_index];
   }
   
+  size_t blobCount() const { return xs.size(); }
+  
+  int x(size_t i) const { return xs[i]; }
+  int y(size_t i) const { return ys[i]; }
+  int size(size_t i) const { return sizes[i]; }
+  Blob blob(size_t i) const { return Blob(xs[i], ys[i], sizes[i]); }
+  
+  BlobRange blobs(int region, int color_index) const {
+    const Slot& s = slot(region, color_index);
+    return BlobRange(this, s.first, s.count);
+  }
+  
+  BlobRange getBlobsForColor(int region, ColorId color) const {
+    int c = colorIndex(color);
+    return c < 0 ? BlobRange(this, 0, 0) : blobs(region, c);
+  }
+  
+  // Blob records of the binary protocol, in slot order, little endian:
+  //   [region u8][color index u8][x u16][y u16][size u32]
+  // Returns the number of records appended.
+  size_t appendBinary(std::vector<uint8_t>& out) const {
+    size_t start = out.size();
+    out.resize(start + xs.size() * 10);
+    uint8_t* p = out.data() + start;
+    
+    for (int r = 0; r < region_count; r++) {
+      for (size_t c = 0; c < colors.size(); c++) {
+        const Slot& s = slot(r, c);
+        for (uint32_t i = s.first; i < s.first + s.count; i++) {
+          p[0] = r;
+          p[1] = c;
+          p[2] = xs[i] & 0xFF; p[3] = (xs[i] >> 8) & 0xFF;
+          p[4] = ys[i] & 0xFF; p[5] = (ys[i] >> 8) & 0xFF;
+          p[6] = sizes[i] & 0xFF; p[7] = (sizes[i] >> 8) & 0xFF;
+          p[8] = (sizes[i] >> 16) & 0xFF; p[9] = sizes[i] >> 24;
+          p += 10;
+        }
+      }
+    }
+    return xs.size();
+  }
+  
+  // The same results in the per-region layout older callers expect
+  std::vector<RegionResults> toRegionResults() const {
+    std::vector<RegionResults> results;
+    results.reserve(region_count);
+    for (int r = 0; r < region_count; r++) {
+      RegionResults region_result(r);
+      for (size_t c = 0; c < colors.size(); c++) {
+        std::vector<Blob>& out = region_result.getBlobsForColor(colors[c]);
+        out.clear();
+        for (const Blob& b : blobs(r, c)) out.push_back(b);
+      }
+      results.push_back(std::move(region_result));
+    }
+    return results;
+  }
+};
+
+// Handles for a list of names; unknown names map to COLOR_NONE, which
+// matches nothing but keeps its slot in the results
+inline std::vector<ColorId> resolveColors(const std::vector<std::string>& names) {
+  std::vector<ColorId> result;
+  result.reserve(names.size());
+  for (const auto& name : names) result.push_back(getColorManager().findColor(name));
+  return result;
+}
+
+// ========================================
+// CORE CCL BLOB DETECTION
+// ========================================
+
+// Two-pass CCL over one region of a binary mask. mask points at the pixel
+// of the region's top-left corner and rows are stride bytes apart; region
+// is in image coordinates and must lie inside the image.
+// Blobs are written to out, which is cleared first and keeps its capacity.
+// With spans (one row per row of the region) only the pixels on them are
+// read; the rest of the box counts as background. Labels, union-find and
+// statistics live in work.
+inline void labelMaskRegion(const uint8_t* mask, int stride, const DetectionRegion& region,
+                            int min_size, std::vector<Blob>& out, const RegionShape* spans,
+                            LabelWorkspace& work) {
+  const int region_width = region.width;
+  const int region_height = region.height;
+  const int region_pixels = region_width * region_height;
+  
+  out.clear();
+  if (region_pixels <= 0) return;
+  
+  reserveGrowing(work.labels, region_pixels);
+  work.labels.assign(region_pixels, 0);
+  uint16_t* labels = work.labels.data();
+  
   // Two-pass CCL
   uint16_t next_label = 1;
-  const uint16_t max_labels = (region_pixels / 4) + 1;
-  UnionFind uf(max_labels);
+  // Label 0 is background, so even a one-pixel region needs two entries
+  const uint16_t max_labels = static_cast<uint16_t>(std::min(region_pixels / 4 + 2, 0xFFFF));
+  UnionFind& uf = work.uf;
+  uf.reset(max_labels);
   
   // Pass 1: Initial labeling
-  for (int ry = 0; ry < region_height; ry++) {
-    for (int rx = 0; rx < region_width; rx++) {
-      int idx = ry * region_width + rx;
-      
-      if (mask[idx] == 0) continue;
-      
-      uint16_t min_neighbor_label = 0;
-      
-      if (rx > 0 && mask[idx - 1] && labels[idx - 1] > 0) {
-        min_neighbor_label = labels[idx - 1];
-      }
+  for (int ry = 0; ry < region_height && next_label < max_labels; ry++) {
+    const uint8_t* mask_row = mask + ry * stride;
+    int first = spans ? spans->row_first[ry] : 0;
+    int last = spans ? spans->row_first[ry + 1] : 1;
+    
+    for (int sp = first; sp < last && next_label < max_labels; sp++) {
+      int x0 = spans ? spans->spans[sp].x0 - region.x : 0;
+      int x1 = spans ? spans->spans[sp].x1 - region.x : region_width;
       
-      if (ry > 0 && mask[idx - region_width] && labels[idx - region_width] > 0) {
+      for (int rx = x0; rx < x1; rx++) {
+        int idx = ry * region_width + rx;
+        
+        if (mask_row[rx] == 0) continue;
+        
+        uint16_t min_neighbor_label = 0;
+        
+        if (rx > 0 && labels[idx - 1] > 0) {
+          min_neighbor_label = labels[idx - 1];
+        }
+        
+        if (ry > 0 && labels[idx - region_width] > 0) {
+          if (min_neighbor_label == 0) {
+            min_neighbor_label = labels[idx - region_width];
+          } else if (labels[idx - region_width] != min_neighbor_label) {
+            uf.unite(min_neighbor_label, labels[idx - region_width]);
+          }
+        }
+        
         if (min_neighbor_label == 0) {
-          min_neighbor_label = labels[idx - region_width];
-        } else if (labels[idx - region_width] != min_neighbor_label) {
-          uf.unite(min_neighbor_label, labels[idx - region_width]);
+          labels[idx] = next_label++;
+          if (next_label >= max_labels) break;
+        } else {
+          labels[idx] = min_neighbor_label;
         }
       }
-      
-      if (min_neighbor_label == 0) {
-        labels[idx] = next_label++;
-        if (next_label >= max_labels) break;
-      } else {
-        labels[idx] = min_neighbor_label;
-      }
     }
-    if (next_label >= max_labels) break;
   }
   
+  if (next_label == 1) return;
+  
   // Pass 2: Collect statistics
-  BlobStats* stats = new BlobStats[next_label];
+  reserveGrowing(work.stats, next_label);
+  work.stats.assign(next_label, BlobStats());
+  BlobStats* stats = work.stats.data();
   
   for (int ry = 0; ry < region_height; ry++) {
-    for (int rx = 0; rx < region_width; rx++) {
-      int idx = ry * region_width + rx;
-      
-      if (labels[idx] > 0) {
-        uint16_t root_label = uf.find(labels[idx]);
-        int img_x = region.x + rx;
-        int img_y = region.y + ry;
-        stats[root_label].add(img_x, img_y);
+    int first = spans ? spans->row_first[ry] : 0;
+    int last = spans ? spans->row_first[ry + 1] : 1;
+    
+    for (int sp = first; sp < last; sp++) {
+      int x0 = spans ? spans->spans[sp].x0 - region.x : 0;
+      int x1 = spans ? spans->spans[sp].x1 - region.x : region_width;
+      for (int rx = x0; rx < x1; rx++) {
+        int idx = ry * region_width + rx;
+        
+        if (labels[idx] > 0) {
+          uint16_t root_label = uf.find(labels[idx]);
+          int img_x = region.x + rx;
+          int img_y = region.y + ry;
+          stats[root_label].add(img_x, img_y);
+        }
       }
     }
   }
   
   // Create result blobs
-  std::vector<Blob> blobs;
   for (uint16_t i = 1; i < next_label; i++) {
     if (stats[i].count >= min_size) {
-      blobs.push_back(stats[i].toBlob());
+      out.push_back(stats[i].toBlob());
+    }
+  }
+}
+
+inline void labelMaskRegion(const uint8_t* mask, int stride, const DetectionRegion& region,
+                            int min_size, std::vector<Blob>& out, const RegionShape* spans = nullptr) {
+  LabelWorkspace work;
+  labelMaskRegion(mask, stride, region, min_size, out, spans, work);
+}
+
+inline std::vector<Blob> labelMaskRegion(const uint8_t* mask, int stride, const DetectionRegion& region,
+                                         int min_size = 10) {
+  std::vector<Blob> blobs;
+  labelMaskRegion(mask, stride, region, min_size, blobs);
+  return blobs;
+}
+
+// One color over one region into out (cleared first, keeps its capacity).
+// The region is clipped to the image first; parts outside are ignored, as
+// are pixels of a shaped region's box that are not in its shape. The mask
+// and labelling buffers come from work and the tables from colors, so a
+// caller looping over regions, windows and colors with one workspace and
+// one snapshot allocates nothing once it has seen the largest region.
+inline void detectSingleColorInto(const HSVImage& hsv, const DetectionRegion& region, ColorId color,
+                                  const ColorSet& colors, LabelWorkspace& work, std::vector<Blob>& out,
+                                  int min_size = 10) {
+  out.clear();
+  if (!hsv.isValid() || !colors.hasColor(color)) return;
+  
+  const DetectionRegion clipped = clipRegion(region, hsv.width, hsv.height);
+  const int region_pixels = clipped.width * clipped.height;
+  if (region_pixels == 0) return;
+  
+  reserveGrowing(work.mask, region_pixels);
+  work.mask.resize(region_pixels);
+  uint8_t* mask = work.mask.data();
+  if (clipped.shape) memset(mask, 0, region_pixels);
+  
+  uint32_t matches = 0;
+  for (int ry = 0; ry < clipped.height; ry++) {
+    work.spans.clear();
+    appendRowSpans(clipped, clipped.y + ry, work.spans);
+    
+    for (const RowSpan& span : work.spans) {
+      int idx = (clipped.y + ry) * hsv.width + span.x0;
+      matches += colors.classifySpan(hsv.h_data + idx, hsv.s_data + idx, hsv.v_data + idx, span.x1 - span.x0,
+                                     color, mask + ry * clipped.width + (span.x0 - clipped.x));
     }
   }
   
-  delete[] mask;
-  delete[] labels;
-  delete[] stats;
-  
+  if (matches > 0) labelMaskRegion(mask, clipped.width, clipped, min_size, out, nullptr, work);
+}
+
+inline std::vector<Blob> detectSingleColorCCL(const HSVImage& hsv, const DetectionRegion& region,
+                                              ColorId color, int min_size = 10) {
+  LabelWorkspace work;
+  std::vector<Blob> blobs;
+  detectSingleColorInto(hsv, region, color, *getColorManager().snapshot(), work, blobs, min_size);
   return blobs;
 }
 
+inline std::vector<Blob> detectSingleColorCCL(const HSVImage& hsv, const DetectionRegion& region,
+                                              const std::string& color_name, int min_size = 10) {
+  return detectSingleColorCCL(hsv, region, getColorManager().findColor(color_name), min_size);
+}
+
+// ========================================
+// BIT-PACKED COLOR MASKS
+// ========================================
+
+// Bytes in a 1 bpp mask: row-major, 8 pixels per byte, MSB first
+inline size_t packedMaskSize(int width, int height) {
+  return (static_cast<size_t>(width) * height + 7) / 8;
+}
+
+// The thresholded mask of one color over the whole image, exactly what the
+// detector matches against. out must hold packedMaskSize() bytes.
+inline void buildColorMask(const HSVImage& hsv, ColorId color, uint8_t* out) {
+  const int pixels = hsv.width * hsv.height;
+  memset(out, 0, packedMaskSize(hsv.width, hsv.height));
+  ColorSnapshot snapshot = getColorManager().snapshot();
+  const ColorSet& colors = *snapshot;
+  if (!hsv.isValid() || !colors.hasColor(color)) return;
+  
+  for (int i = 0; i < pixels; i++) {
+    if (colors.matchesColor(hsv.h_data[i], hsv.s_data[i], hsv.v_data[i], color)) {
+      out[i >> 3] |= 0x80 >> (i & 7);
+    }
+  }
+}
+
+inline void buildColorMask(const HSVImage& hsv, const std::string& color_name, uint8_t* out) {
+  buildColorMask(hsv, getColorManager().findColor(color_name), out);
+}
+
+// ========================================
+// OCCUPANCY INDEX
+// ========================================
+
+// Per-color match masks of one frame, packed one bit per pixel, with a
+// summed-area table over 32 x OCCUPANCY_TILE_H tiles of them. A rectangle's
+// count is four table lookups for the whole tiles inside it plus popcounts
+// of the mask words along its ragged edges, so "is there any RED in region
+// 3, and how much" needs no labelling at all. Each color costs about
+// width * height / 8 bytes (38 KB at VGA, 10 KB at QVGA); like
+// DetectionResults, an index reused every frame keeps its storage.
+#define OCCUPANCY_TILE_H 8   // Tile rows; a tile is one mask word (32 pixels) wide
+
+class OccupancyIndex {
+private:
+  int width;
+  int height;
+  int words;                        // Mask words per row, and tile columns
+  int tile_rows;
+  std::vector<ColorId> colors;
+  std::vector<uint32_t> bits;       // Color index * bitsSize(), row-major, pixel x is bit x & 31 of word x >> 5
+  std::vector<uint32_t> tiles;      // Color index * tilesSize(), summed tile counts, zero first row / column
+  
+  size_t bitsSize() const { return size_t(words) * height; }
+  size_t tilesSize() const { return size_t(words + 1) * (tile_rows + 1); }
+  
+  uint32_t lookup(int color_index, int tx, int ty) const {
+    return tiles[color_index * tilesSize() + size_t(ty) * (words + 1) + tx];
+  }
+  
+  // Matches of one row in [x0, x1), x0 < x1
+  uint32_t countRow(int color_index, int y, int x0, int x1) const {
+    const uint32_t* row = bits.data() + color_index * bitsSize() + size_t(y) * words;
+    int w0 = x0 >> 5, w1 = (x1 - 1) >> 5;
+    uint32_t first = ~0u << (x0 & 31);
+    uint32_t last = ~0u >> (31 - ((x1 - 1) & 31));
+    if (w0 == w1) return __builtin_popcount(row[w0] & first & last);
+    uint32_t total = __builtin_popcount(row[w0] & first);
+    for (int w = w0 + 1; w < w1; w++) total += __builtin_popcount(row[w]);
+    return total + __builtin_popcount(row[w1] & last);
+  }
+
+public:
+  OccupancyIndex() : width(0), height(0), words(0), tile_rows(0) {}
+  
+  OccupancyIndex(const OccupancyIndex&) = delete;
+  OccupancyIndex& operator=(const OccupancyIndex&) = delete;
+  
+  // Start a frame; every color must then get its setMask() or clearColor()
+  void begin(int w, int h, const std::vector<ColorId>& colors_to_index) {
+    width = w;
+    height = h;
+    words = (w + 31) / 32;
+    tile_rows = (h + OCCUPANCY_TILE_H - 1) / OCCUPANCY_TILE_H;
+    colors = colors_to_index;
+    bits.resize(colors.size() * bitsSize());
+    tiles.resize(colors.size() * tilesSize());
+  }
+  
+  // Index one color from a byte mask of the whole image (non-zero = match)
+  void setMask(int color_index, const uint8_t* mask) {
+    uint32_t* packed = bits.data() + color_index * bitsSize();
+    uint32_t* table = tiles.data() + color_index * tilesSize();
+    const int stride = words + 1;
+    memset(table, 0, tilesSize() * sizeof(uint32_t));
+    
+    // Pack the rows and sum each tile into table[ty + 1][tx + 1]
+    for (int y = 0; y < height; y++) {
+      const uint8_t* row = mask + y * width;
+      uint32_t* out = packed + size_t(y) * words;
+      uint32_t* tile = table + (y / OCCUPANCY_TILE_H + 1) * stride + 1;
+      for (int w = 0; w < words; w++) {
+        int x0 = w * 32, n = std::min(32, width - x0);
+        uint32_t word = 0;
+        for (int b = 0; b < n; b++) word |= uint32_t(row[x0 + b] != 0) << b;
+        out[w] = word;
+        tile[w] += __builtin_popcount(word);
+      }
+    }
+    
+    // Then turn the tile counts into sums over everything above and left
+    for (int ty = 1; ty <= tile_rows; ty++) {
+      uint32_t run = 0;
+      for (int tx = 1; tx <= words; tx++) {
+        run += table[ty * stride + tx];
+        table[ty * stride + tx] = table[(ty - 1) * stride + tx] + run;
+      }
+    }
+  }
+  
+  // No matches at all for one color
+  void clearColor(int color_index) {
+    std::fill(bits.begin() + color_index * bitsSize(), bits.begin() + (color_index + 1) * bitsSize(), 0);
+    std::fill(tiles.begin() + color_index * tilesSize(), tiles.begin() + (color_index + 1) * tilesSize(), 0);
+  }
+  
+  // Classify the whole image for each color and index it. This is the
+  // standalone path (OCCUPANCY without detection): it runs its own
+  // classification pass over every pixel, once per color. detectBlobsInto()
+  // with an index fills it from the classification it does anyway.
+  void build(const HSVImage& hsv, const std::vector<ColorId>& colors_to_index) {
+    begin(hsv.isValid() ? hsv.width : 0, hsv.isValid() ? hsv.height : 0, colors_to_index);
+    if (width == 0) return;
+    
+    ColorSnapshot snapshot = getColorManager().snapshot();
+    const ColorSet& color_set = *snapshot;
+    const int pixels = width * height;
+    std::vector<uint8_t> mask(pixels);
+    for (size_t c = 0; c < colors.size(); c++) {
+      if (!color_set.hasColor(colors[c])) {
+        clearColor(c);
+        continue;
+      }
+      for (int i = 0; i < pixels; i++) {
+        mask[i] = color_set.matchesColor(hsv.h_data[i], hsv.s_data[i], hsv.v_data[i], colors[c]);
+      }
+      setMask(c, mask.data());
+    }
+  }
+  
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  bool isEmpty() const { return width == 0 || colors.empty(); }
+  
+  // Index of color in the index, -1 if it was not indexed
+  int colorIndex(ColorId color) const {
+    for (size_t c = 0; c < colors.size(); c++) {
+      if (colors[c] == color) return c;
+    }
+    return -1;
+  }
+  
+  // Matches in a rectangle, clipped to the image: whole tiles from the
+  // table, the partial tiles around them row by row from the mask
+  uint32_t count(int color_index, int x, int y, int w, int h) const {
+    int x0 = std::max(0, x), y0 = std::max(0, y);
+    int x1 = std::min(width, x + w), y1 = std::min(height, y + h);
+    if (color_index < 0 || x1 <= x0 || y1 <= y0) return 0;
+    
+    int tx0 = (x0 + 31) / 32, tx1 = x1 / 32;
+    int ty0 = (y0 + OCCUPANCY_TILE_H - 1) / OCCUPANCY_TILE_H, ty1 = y1 / OCCUPANCY_TILE_H;
+    uint32_t total = 0;
+    if (tx0 >= tx1 || ty0 >= ty1) {
+      for (int row = y0; row < y1; row++) total += countRow(color_index, row, x0, x1);
+      return total;
+    }
+    
+    total = lookup(color_index, tx1, ty1) - lookup(color_index, tx0, ty1) -
+            lookup(color_index, tx1, ty0) + lookup(color_index, tx0, ty0);
+    int core_y0 = ty0 * OCCUPANCY_TILE_H, core_y1 = ty1 * OCCUPANCY_TILE_H;
+    for (int row = y0; row < core_y0; row++) total += countRow(color_index, row, x0, x1);
+    for (int row = core_y1; row < y1; row++) total += countRow(color_index, row, x0, x1);
+    for (int row = core_y0; row < core_y1; row++) {
+      if (x0 < tx0 * 32) total += countRow(color_index, row, x0, tx0 * 32);
+      if (tx1 * 32 < x1) total += countRow(color_index, row, tx1 * 32, x1);
+    }
+    return total;
+  }
+  
+  // Matches on a shape's spans, popcounted from the mask
+  uint32_t count(int color_index, const RegionShape& shape) const {
+    uint32_t total = 0;
+    for (int row = 0; row < shape.rows(); row++) {
+      for (int i = shape.row_first[row]; i < shape.row_first[row + 1]; i++) {
+        const RowSpan& span = shape.spans[i];
+        total += count(color_index, span.x0, shape.y0 + row, span.x1 - span.x0, 1);
+      }
+    }
+    return total;
+  }
+  
+  // Matches inside a region: table lookups plus its edges for a rectangle,
+  // one popcount run per span for a shaped region. 0 for a color that was
+  // not indexed.
+  uint32_t count(ColorId color, const DetectionRegion& region) const {
+    int c = colorIndex(color);
+    if (c < 0) return 0;
+    if (!region.shape) return count(c, region.x, region.y, region.width, region.height);
+    
+    DetectionRegion clipped = clipRegion(region, width, height);
+    std::vector<RowSpan> row_spans;
+    uint32_t total = 0;
+    for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+      row_spans.clear();
+      appendRowSpans(clipped, y, row_spans);
+      for (const RowSpan& span : row_spans) total += count(c, span.x0, y, span.x1 - span.x0, 1);
+    }
+    return total;
+  }
+};
+
+// ========================================
+// SEARCH WINDOWS
+// ========================================
+
+// Grow overlapping or touching windows into their common bounding box so no
+// blob is split between two of them. Windows must already be clipped; a
+// merged window keeps the shape of the first one (all windows of a search
+// come from the same region).
+inline void mergeSearchWindows(std::vector<DetectionRegion>& windows) {
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t a = 0; a < windows.size() && !merged; a++) {
+      for (size_t b = a + 1; b < windows.size() && !merged; b++) {
+        DetectionRegion& wa = windows[a];
+        const DetectionRegion& wb = windows[b];
+        if (wa.x > wb.x + wb.width || wb.x > wa.x + wa.width ||
+            wa.y > wb.y + wb.height || wb.y > wa.y + wa.height) continue;
+        
+        int x0 = std::min(wa.x, wb.x), y0 = std::min(wa.y, wb.y);
+        int x1 = std::max(wa.x + wa.width, wb.x + wb.width);
+        int y1 = std::max(wa.y + wa.height, wb.y + wb.height);
+        wa.x = x0;
+        wa.y = y0;
+        wa.width = x1 - x0;
+        wa.height = y1 - y0;
+        windows.erase(windows.begin() + b);
+        merged = true;
+      }
+    }
+  }
+}
+
 // ========================================
 // MAIN DETECTION FUNCTIONS
 // ========================================
 
-// Using region set name from RegionManager
-inline std::vector<RegionResults> detectBlobsStructured(
+// Using a compiled region set: each color is classified once along the
+// set's row spans into a shared mask, then every region is labelled from it.
+// Results go into an arena the caller keeps across frames; the mask and the
+// labelling buffers come from its workspace, so neither is allocated per
+// frame, region or color once the arena has seen the frame size. A color with no
+// match anywhere in the set is not labelled at all. With occupancy the
+// classification also fills that index (pixels outside the set count as
+// no match), and regions without a match are skipped before any labelling
+// state is allocated. With stats it also yields each region's statistics
+// (see region_stats.h): coverage per color of colors_to_detect from the
+// match counts, the value counts on the first color's pass.
+inline void detectBlobsInto(
     const HSVImage& hsv,
-    const std::string& region_set_name,
-    const std::vector<std::string>& colors_to_detect,
+    const CompiledRegionSet& compiled,
+    const std::vector<ColorId>& colors_to_detect,
+    DetectionResults& results,
     bool multi_blob_per_color = true,
-    int min_size = 10) {
-  
-  if (!getRegionManager().hasRegionSet(region_set_name)) {
-    return {};
+    int min_size = 10,
+    OccupancyIndex* occupancy = nullptr,
+    std::vector<RegionStats>* stats = nullptr) {
+  
+  results.begin(compiled.regions.size(), colors_to_detect);
+  
+  bool usable = hsv.isValid() && compiled.image_width == hsv.width && compiled.image_height == hsv.height;
+  LabelWorkspace& work = results.workspace();
+  uint8_t* mask = nullptr;
+  if (usable && compiled.covered_pixels > 0) {
+    work.mask.resize(size_t(hsv.width) * hsv.height);
+    mask = work.mask.data();
   }
+  std::vector<Blob>& found = work.found;
+  ColorSnapshot colors = getColorManager().snapshot();
   
-  const std::vector<DetectionRegion>& regions = getRegionManager().getRegions(region_set_name);
-  std::vector<RegionResults> results;
-  results.reserve(regions.size());
+  if (occupancy) {
+    occupancy->begin(usable ? hsv.width : 0, usable ? hsv.height : 0, colors_to_detect);
+    if (mask) memset(mask, 0, hsv.width * hsv.height);
+  }
+  if (stats) {
+    stats->resize(compiled.regions.size());
+    for (RegionStats& region_stats : *stats) region_stats.reset(colors_to_detect.size());
+  }
+  bool count_values = stats && mask;
   
-  for (size_t region_idx = 0; region_idx < regions.size(); region_idx++) {
-    RegionResults region_result(static_cast<int>(region_idx));
-    const DetectionRegion& region = regions[region_idx];
+  for (size_t c = 0; c < colors_to_detect.size(); c++) {
+    ColorId color = colors_to_detect[c];
+    if (!mask || !colors->hasColor(color)) {
+      if (occupancy) occupancy->clearColor(c);
+      continue;
+    }
     
-    for (const std::string& color : colors_to_detect) {
-      std::vector<Blob> color_blobs = detectSingleColorCCL(hsv, region, color, min_size);
-      
-      if (!multi_blob_per_color && !color_blobs.empty()) {
-        auto largest = std::max_element(color_blobs.begin(), color_blobs.end(),
-          [](const Blob& a, const Blob& b) { return a.pixel_count < b.pixel_count; });
-        color_blobs = {*largest};
+    // Classify along the spans each region owns, which together are the
+    // set's spans; nothing outside them is ever read
+    uint32_t matches = 0;
+    for (size_t region_idx = 0; region_idx < compiled.regions.size(); region_idx++) {
+      const RegionShape& owned = compiled.owned[region_idx];
+      uint32_t region_matches = 0;
+      for (int row = 0; row < owned.rows(); row++) {
+        const int line = (owned.y0 + row) * hsv.width;
+        for (int i = owned.row_first[row]; i < owned.row_first[row + 1]; i++) {
+          const int idx = line + owned.spans[i].x0;
+          const int count = owned.spans[i].x1 - owned.spans[i].x0;
+          region_matches += colors->classifySpan(hsv.h_data + idx, hsv.s_data + idx, hsv.v_data + idx,
+                                                 count, color, mask + idx);
+          if (count_values) work.values.add(hsv.h_data + idx, hsv.s_data + idx, hsv.v_data + idx, count);
+        }
       }
-      
-      region_result.getBlobsForColor(color) = std::move(color_blobs);
+      if (count_values) work.values.finish((*stats)[region_idx]);
+      if (stats) (*stats)[region_idx].color_pixels[c] = region_matches;
+      matches += region_matches;
     }
+    count_values = false;
     
-    results.push_back(std::move(region_result));
+    if (occupancy) occupancy->setMask(c, mask);
+    if (matches == 0) continue;
+    
+    for (size_t region_idx = 0; region_idx < compiled.regions.size(); region_idx++) {
+      const DetectionRegion& region = compiled.regions[region_idx];
+      if (region.width == 0 || compiled.owned[region_idx].pixels == 0) continue;
+      if (occupancy && occupancy->count(c, compiled.owned[region_idx]) == 0) continue;
+      
+      labelMaskRegion(mask + region.y * hsv.width + region.x, hsv.width, region, min_size, found,
+                      &compiled.owned[region_idx], work);
+      results.setSlot(region_idx, c, found, !multi_blob_per_color);
+    }
   }
   
-  return results;
+  // No color to classify: the value counts get a pass of their own
+  if (count_values) {
+    for (size_t region_idx = 0; region_idx < compiled.regions.size(); region_idx++) {
+      addShapeValues(hsv, compiled.owned[region_idx], work.values);
+      work.values.finish((*stats)[region_idx]);
+    }
+  }
+}
+
+inline void detectBlobsInto(
+    const HSVImage& hsv,
+    RegionSetId region_set,
+    const std::vector<ColorId>& colors_to_detect,
+    DetectionResults& results,
+    bool multi_blob_per_color = true,
+    int min_size = 10,
+    OccupancyIndex* occupancy = nullptr,
+    std::vector<RegionStats>* stats = nullptr) {
+  
+  if (!getRegionManager().hasRegionSet(region_set)) {
+    results.begin(0, colors_to_detect);
+    if (occupancy) occupancy->begin(0, 0, {});
+    if (stats) stats->clear();
+    return;
+  }
+  
+  std::shared_ptr<const CompiledRegionSet> compiled =
+    getRegionManager().getCompiledRegionSet(region_set, hsv.width, hsv.height);
+  detectBlobsInto(hsv, *compiled, colors_to_detect, results, multi_blob_per_color, min_size, occupancy, stats);
+}
+
+inline std::vector<RegionResults> detectBlobsStructured(
+    const HSVImage& hsv,
+    const CompiledRegionSet& compiled,
+    const std::vector<ColorId>& colors_to_detect,
+    bool multi_blob_per_color = true,
+    int min_size = 10) {
+  
+  DetectionResults results;
+  detectBlobsInto(hsv, compiled, colors_to_detect, results, multi_blob_per_color, min_size);
+  return results.toRegionResults();
+}
+
+// Using a region set handle from RegionManager
+inline std::vector<RegionResults> detectBlobsStructured(
+    const HSVImage& hsv,
+    RegionSetId region_set,
+    const std::vector<ColorId>& colors_to_detect,
+    bool multi_blob_per_color = true,
+    int min_size = 10) {
+  
+  if (!getRegionManager().hasRegionSet(region_set)) {
+    return {};
+  }
+  
+  std::shared_ptr<const CompiledRegionSet> compiled =
+    getRegionManager().getCompiledRegionSet(region_set, hsv.width, hsv.height);
+  return detectBlobsStructured(hsv, *compiled, colors_to_detect, multi_blob_per_color, min_size);
+}
+
+// Using region set and color names; resolved once, then as above
+inline std::vector<RegionResults> detectBlobsStructured(
+    const HSVImage& hsv,
+    const std::string& region_set_name,
+    const std::vector<std::string>& colors_to_detect,
+    bool multi_blob_per_color = true,
+    int min_size = 10) {
+  
+  return detectBlobsStructured(hsv, getRegionManager().findRegionSet(region_set_name),
+                               resolveColors(colors_to_detect), multi_blob_per_color, min_size);
 }
 
 // Legacy function - using explicit region vector (for backward compatibility)
 inline std::vector<RegionResults> detectBlobsStructured(
     const HSVImage& hsv,
     const std::vector<DetectionRegion>& regions,
-    const std::vector<std::string>& colors_to_detect,
+    const std::vector<ColorId>& colors_to_detect,
     bool multi_blob_per_color = true,
     int min_size = 10) {
   
@@ -289,7 +938,7 @@ inline std::vector<RegionResults> detectBlobsStructured(
     RegionResults region_result(static_cast<int>(region_idx));
     const DetectionRegion& region = regions[region_idx];
     
-    for (const std::string& color : colors_to_detect) {
+    for (ColorId color : colors_to_detect) {
       std::vector<Blob> color_blobs = detectSingleColorCCL(hsv, region, color, min_size);
       
       if (!multi_blob_per_color && !color_blobs.empty()) {
@@ -307,6 +956,16 @@ inline std::vector<RegionResults> detectBlobsStructured(
   return results;
 }
 
+inline std::vector<RegionResults> detectBlobsStructured(
+    const HSVImage& hsv,
+    const std::vector<DetectionRegion>& regions,
+    const std::vector<std::string>& colors_to_detect,
+    bool multi_blob_per_color = true,
+    int min_size = 10) {
+  
+  return detectBlobsStructured(hsv, regions, resolveColors(colors_to_detect), multi_blob_per_color, min_size);
+}
+
 // ========================================
 // CONVENIENCE FUNCTIONS
 // ========================================
@@ -318,8 +977,9 @@ inline std::vector<RegionResults> detectAllColorsStructured(
     bool multi_blob_per_color = true,
     int min_size = 10) {
   
-  std::vector<std::string> all_colors = getColorManager().getAllColorNames();
-  return detectBlobsStructured(hsv, region_set_name, all_colors, multi_blob_per_color, min_size);
+  std::vector<ColorId> all_colors = getColorManager().getAllColorIds();
+  return detectBlobsStructured(hsv, getRegionManager().findRegionSet(region_set_name), all_colors,
+                               multi_blob_per_color, min_size);
 }
 
 // Detect single color using region set name
@@ -330,7 +990,8 @@ inline std::vector<RegionResults> detectSingleColorStructured(
     bool multi_blob_per_color = true,
     int min_size = 10) {
   
-  return detectBlobsStructured(hsv, region_set_name, {color}, multi_blob_per_color, min_size);
+  return detectBlobsStructured(hsv, getRegionManager().findRegionSet(region_set_name),
+                               std::vector<ColorId>{getColorManager().findColor(color)}, multi_blob_per_color, min_size);
 }
 
 // Legacy functions - using explicit region vectors
@@ -340,7 +1001,7 @@ inline std::vector<RegionResults> detectAllColorsStructured(
     bool multi_blob_per_color = true,
     int min_size = 10) {
   
-  std::vector<std::string> all_colors = getColorManager().getAllColorNames();
+  std::vector<ColorId> all_colors = getColorManager().getAllColorIds();
   return detectBlobsStructured(hsv, regions, all_colors, multi_blob_per_color, min_size);
 }
 
@@ -351,7 +1012,8 @@ inline std::vector<RegionResults> detectSingleColorStructured(
     bool multi_blob_per_color = true,
     int min_size = 10) {
   
-  return detectBlobsStructured(hsv, regions, {color}, multi_blob_per_color, min_size);
+  return detectBlobsStructured(hsv, regions, std::vector<ColorId>{getColorManager().findColor(color)},
+                               multi_blob_per_color, min_size);
 }
 
 
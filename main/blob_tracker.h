@@ -0,0 +1,311 @@
+#ifndef BLOB_TRACKER_H
+#define BLOB_TRACKER_H
+
+#include "blob_detector_ccl.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// ========================================
+// MULTI-OBJECT BLOB TRACKER
+// ========================================
+
+// Gives the blobs of consecutive frames stable ids and a velocity estimate
+// (alpha-beta filter, constant velocity), and uses the predicted positions
+// to search the next frame only in small windows around the tracked blobs.
+// A full scan still runs every rescan_frames frames, when nothing is tracked
+// and right after a track was lost, so new blobs are picked up.
+
+#define TRACKER_MAX_TRACKS 32
+#define TRACKER_GATE_PX 24        // Furthest a blob may be from its prediction to match
+#define TRACKER_MAX_MISSES 3      // Frames a track coasts unmatched before it is dropped
+#define TRACKER_WINDOW_MARGIN 8   // Window slack around the predicted blob extent
+#define TRACKER_RESCAN_FRAMES 15
+#define TRACKER_ALPHA 0.7f        // Position gain
+#define TRACKER_BETA 0.35f        // Velocity gain
+
+struct Track {
+  uint16_t id;
+  int region_id;
+  ColorId color;
+  float x, y;        // Filtered center
+  float vx, vy;      // Pixels per frame
+  int size;          // Last measured pixel count
+  uint16_t hits;     // Frames matched so far
+  uint8_t misses;    // Consecutive frames not matched
+};
+
+struct TrackerStats {
+  uint32_t frames;
+  uint32_t full_scans;
+  uint32_t scanned_pixels;    // Pixels labelled, over all colors
+  uint32_t full_pixels;       // The same for a full scan of every frame
+  
+  TrackerStats() : frames(0), full_scans(0), scanned_pixels(0), full_pixels(0) {}
+  
+  float workRatio() const {
+    return full_pixels ? float(scanned_pixels) / full_pixels : 1.0f;
+  }
+};
+
+class BlobTracker {
+private:
+  struct Detection { int region_id; ColorId color; Blob blob; bool used; };
+  struct Candidate { size_t track; size_t detection; float dist; };
+  
+  std::vector<Track> tracks;
+  uint16_t next_id;
+  int rescan_frames;
+  int frames_since_scan;
+  bool lost_track;
+  TrackerStats counters;
+  
+  // Per-frame scratch, kept so a running tracker stops allocating
+  std::vector<Detection> detections;
+  std::vector<Candidate> pairs;
+  std::vector<uint8_t> matched;
+  std::vector<DetectionRegion> windows;
+  std::vector<Blob> region_blobs;
+  
+  uint16_t allocId() {
+    uint16_t id = next_id++;
+    if (next_id == 0) next_id = 1;
+    return id;
+  }
+  
+  static DetectionRegion clip(const DetectionRegion& r, int x0, int y0, int x1, int y1) {
+    int cx0 = std::max(r.x, x0), cy0 = std::max(r.y, y0);
+    int cx1 = std::min(r.x + r.width, x1), cy1 = std::min(r.y + r.height, y1);
+    if (cx1 <= cx0 || cy1 <= cy0) return DetectionRegion(0, 0, 0, 0);
+    return DetectionRegion(cx0, cy0, cx1 - cx0, cy1 - cy0);
+  }
+  
+  // Predicted extent of every track of this region and color, clipped to the
+  // region and merged where they touch, into windows
+  void searchWindows(int region_id, ColorId color, const DetectionRegion& bounds) {
+    windows.clear();
+    for (const Track& t : tracks) {
+      if (t.region_id != region_id || t.color != color) continue;
+      
+      float px = t.x + t.vx, py = t.y + t.vy;
+      int half = int(std::sqrt(float(t.size))) + TRACKER_WINDOW_MARGIN +
+                 int(std::max(std::fabs(t.vx), std::fabs(t.vy)));
+      DetectionRegion w = clip(DetectionRegion(int(px) - half, int(py) - half, 2 * half + 1, 2 * half + 1),
+                               bounds.x, bounds.y, bounds.x + bounds.width, bounds.y + bounds.height);
+      w.shape = bounds.shape;
+      if (w.width > 0) windows.push_back(w);
+    }
+    mergeSearchWindows(windows);
+  }
+  
+  // Match detections to the tracks
+  void match(bool full_scan) {
+    pairs.clear();
+    
+    // Every track / detection pair inside the gate, closest first. A coasting
+    // track is predicted over all the frames it missed.
+    for (size_t t = 0; t < tracks.size(); t++) {
+      const Track& track = tracks[t];
+      float steps = track.misses + 1;
+      float px = track.x + track.vx * steps, py = track.y + track.vy * steps;
+      float gate = TRACKER_GATE_PX + std::max(std::fabs(track.vx), std::fabs(track.vy)) * steps;
+      
+      for (size_t d = 0; d < detections.size(); d++) {
+        if (detections[d].region_id != track.region_id || detections[d].color != track.color) continue;
+        float dx = detections[d].blob.center_x - px;
+        float dy = detections[d].blob.center_y - py;
+        float dist = dx * dx + dy * dy;
+        if (dist <= gate * gate) pairs.push_back({t, d, dist});
+      }
+    }
+    std::sort(pairs.begin(), pairs.end(),
+              [](const Candidate& a, const Candidate& b) { return a.dist < b.dist; });
+    
+    matched.assign(tracks.size(), 0);
+    for (const Candidate& c : pairs) {
+      Detection& det = detections[c.detection];
+      if (matched[c.track] || det.used) continue;
+      matched[c.track] = 1;
+      det.used = true;
+      
+      Track& track = tracks[c.track];
+      float steps = track.misses + 1;
+      float px = track.x + track.vx * steps, py = track.y + track.vy * steps;
+      float rx = det.blob.center_x - px, ry = det.blob.center_y - py;
+      track.x = px + TRACKER_ALPHA * rx;
+      track.y = py + TRACKER_ALPHA * ry;
+      track.vx += TRACKER_BETA * rx / steps;
+      track.vy += TRACKER_BETA * ry / steps;
+      track.size = det.blob.pixel_count;
+      if (track.hits < 0xFFFF) track.hits++;
+      track.misses = 0;
+    }
+    
+    // Coast the unmatched, drop the ones gone too long
+    lost_track = false;
+    size_t keep = 0;
+    for (size_t t = 0; t < tracks.size(); t++) {
+      if (!matched[t]) {
+        lost_track = true;
+        if (++tracks[t].misses > TRACKER_MAX_MISSES) continue;
+      }
+      tracks[keep++] = tracks[t];
+    }
+    tracks.resize(keep);
+    
+    // Windowed frames only see blobs near existing tracks; anything new there
+    // is still a new object, so it gets a track as well
+    for (const Detection& det : detections) {
+      if (tracks.size() >= TRACKER_MAX_TRACKS) break;
+      if (det.used) continue;
+      tracks.push_back({allocId(), det.region_id, det.color, float(det.blob.center_x),
+                        float(det.blob.center_y), 0.0f, 0.0f, det.blob.pixel_count, 1, 0});
+    }
+    
+    frames_since_scan = full_scan ? 0 : frames_since_scan + 1;
+    counters.frames++;
+    if (full_scan) counters.full_scans++;
+  }
+
+public:
+  BlobTracker(int rescan = TRACKER_RESCAN_FRAMES)
+    : next_id(1), rescan_frames(1), frames_since_scan(0), lost_track(false) {
+    setRescanInterval(rescan);
+    tracks.reserve(TRACKER_MAX_TRACKS);
+  }
+  
+  BlobTracker(const BlobTracker&) = delete;
+  BlobTracker& operator=(const BlobTracker&) = delete;
+  
+  // Frames between full scans; 1 scans every frame in full
+  void setRescanInterval(int frames) {
+    rescan_frames = std::max(1, frames);
+  }
+  
+  int getRescanInterval() const { return rescan_frames; }
+  
+  // Forget all tracks; ids keep counting so old ones are never reused
+  void reset() {
+    tracks.clear();
+    frames_since_scan = 0;
+    lost_track = false;
+  }
+  
+  bool needsFullScan() const {
+    return tracks.empty() || lost_track || frames_since_scan + 1 >= rescan_frames;
+  }
+  
+  // Detect in full or in the predicted windows (see needsFullScan) into an
+  // arena the caller keeps across frames, and update the tracks. Labelling
+  // buffers are those of the arena.
+  void detect(const HSVImage& hsv, const std::vector<DetectionRegion>& regions,
+              const std::vector<ColorId>& colors, DetectionResults& results, int min_size = 10) {
+    bool full = needsFullScan();
+    results.begin(regions.size(), colors);
+    ColorSnapshot color_set = getColorManager().snapshot();
+    LabelWorkspace& work = results.workspace();
+    
+    for (size_t region_idx = 0; region_idx < regions.size(); region_idx++) {
+      DetectionRegion bounds = clipRegion(regions[region_idx], hsv.width, hsv.height);
+      
+      for (size_t c = 0; c < colors.size(); c++) {
+        counters.full_pixels += bounds.width * bounds.height;
+        if (bounds.width == 0) continue;
+        
+        if (full) {
+          detectSingleColorInto(hsv, bounds, colors[c], *color_set, work, region_blobs, min_size);
+          counters.scanned_pixels += bounds.width * bounds.height;
+        } else {
+          region_blobs.clear();
+          searchWindows(region_idx, colors[c], bounds);
+          for (const DetectionRegion& window : windows) {
+            detectSingleColorInto(hsv, window, colors[c], *color_set, work, work.found, min_size);
+            region_blobs.insert(region_blobs.end(), work.found.begin(), work.found.end());
+            counters.scanned_pixels += window.width * window.height;
+          }
+        }
+        results.setSlot(region_idx, c, region_blobs);
+      }
+    }
+    
+    update(results, full);
+  }
+  
+  // On a compiled set: each region is searched only where it owns the
+  // pixels, so a blob where regions overlap is reported once and gets one
+  // track, as with detectBlobsInto()
+  void detect(const HSVImage& hsv, const CompiledRegionSet& compiled,
+              const std::vector<ColorId>& colors, DetectionResults& results, int min_size = 10) {
+    detect(hsv, compiled.owned_regions, colors, results, min_size);
+  }
+  
+  // The same, with results in the layout of detectBlobsStructured()
+  std::vector<RegionResults> detect(const HSVImage& hsv, const std::vector<DetectionRegion>& regions,
+                                    const std::vector<ColorId>& colors, int min_size = 10) {
+    DetectionResults results;
+    detect(hsv, regions, colors, results, min_size);
+    return results.toRegionResults();
+  }
+  
+  std::vector<RegionResults> detect(const HSVImage& hsv, const CompiledRegionSet& compiled,
+                                    const std::vector<ColorId>& colors, int min_size = 10) {
+    return detect(hsv, compiled.owned_regions, colors, min_size);
+  }
+  
+  // Match one frame of detections to the tracks, for callers that detect on
+  // their own. full_scan says whether the whole region set was searched.
+  // A color listed twice is matched once.
+  void update(const DetectionResults& results, bool full_scan) {
+    detections.clear();
+    for (int r = 0; r < results.regionCount(); r++) {
+      for (int c = 0; c < results.colorCount(); c++) {
+        ColorId color = results.colorAt(c);
+        if (results.colorIndex(color) != c) continue;
+        for (const Blob& blob : results.blobs(r, c)) detections.push_back({r, color, blob, false});
+      }
+    }
+    match(full_scan);
+  }
+  
+  void update(const std::vector<RegionResults>& results, bool full_scan) {
+    detections.clear();
+    for (const auto& region_result : results) {
+      for (const auto& entry : region_result.color_blobs) {
+        for (const Blob& blob : entry.blobs) {
+          detections.push_back({region_result.region_id, entry.color, blob, false});
+        }
+      }
+    }
+    match(full_scan);
+  }
+  
+  // Live and coasting tracks; misses == 0 were seen in the last frame
+  const std::vector<Track>& getTracks() const { return tracks; }
+  
+  const TrackerStats& stats() const { return counters; }
+  
+  void resetStats() { counters = TrackerStats(); }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+BlobTracker tracker(10);   // Full scan at least every 10 frames
+std::vector<ColorId> colors = resolveColors({"RED", "GREEN"});
+DetectionResults results;  // Reused every frame
+
+void onFrame(const HSVImage& hsv) {
+  std::vector<DetectionRegion> regions = {DetectionRegion(0, 0, hsv.width, hsv.height)};
+  tracker.detect(hsv, regions, colors, results);
+  
+  for (const Track& t : tracker.getTracks()) {
+    if (t.misses) continue;
+    Serial.printf("#%u %s at %.0f,%.0f moving %.1f,%.1f px/frame\n",
+                  t.id, getColorManager().colorName(t.color).c_str(), t.x, t.y, t.vx, t.vy);
+  }
+}
+*/
+
+#endif // BLOB_TRACKER_H
\ No newline at end of file
@@ -28,6 +28,49 @@
 
 #define FLASH_GPIO_NUM 4
 
+// ========================================
+// FRAME SIZES
+// ========================================
+
+struct CameraResolution {
+  const char* name;
+  framesize_t frame_size;
+  int width;
+  int height;
+};
+
+// Sizes selectable at runtime; every frame buffer holds width * height * 2 bytes
+static const CameraResolution CAMERA_RESOLUTIONS[] = {
+  {"QQVGA", FRAMESIZE_QQVGA, 160, 120},
+  {"QCIF",  FRAMESIZE_QCIF,  176, 144},
+  {"HQVGA", FRAMESIZE_HQVGA, 240, 176},
+  {"QVGA",  FRAMESIZE_QVGA,  320, 240},
+  {"CIF",   FRAMESIZE_CIF,   400, 296},
+  {"VGA",   FRAMESIZE_VGA,   640, 480}
+};
+static const int CAMERA_RESOLUTION_COUNT = sizeof(CAMERA_RESOLUTIONS) / sizeof(CAMERA_RESOLUTIONS[0]);
+
+// Frame size the sensor currently runs at
+static const CameraResolution* camera_resolution = &CAMERA_RESOLUTIONS[0];
+
+/**
+ * Look up a frame size by name ("QVGA") or dimensions ("320x240")
+ * Returns nullptr if it is not one of CAMERA_RESOLUTIONS
+ */
+const CameraResolution* findResolution(const String& name) {
+  for (int i = 0; i < CAMERA_RESOLUTION_COUNT; i++) {
+    const CameraResolution& res = CAMERA_RESOLUTIONS[i];
+    if (name.equalsIgnoreCase(res.name) || name.equalsIgnoreCase(String(res.width) + "x" + String(res.height))) {
+      return &res;
+    }
+  }
+  return nullptr;
+}
+
+const CameraResolution& getResolution() {
+  return *camera_resolution;
+}
+
 // ========================================
 // CORE FUNCTIONS ONLY
 // ========================================
@@ -36,7 +79,7 @@
  * Initialize camera for YUV422 blob detection
  * Optimized settings for maximum speed and color detection
  */
-bool initCamera() {
+bool initCamera(const CameraResolution& resolution = CAMERA_RESOLUTIONS[0]) {
   camera_config_t config;
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer = LEDC_TIMER_0;
@@ -59,7 +102,7 @@ bool initCamera() {
   
   // Optimized for speed and color detection
   config.xclk_freq_hz = 20000000;
-  config.frame_size = FRAMESIZE_QQVGA;  // 160x120 for speed
+  config.frame_size = resolution.frame_size;  // QQVGA (160x120) for speed by default
   config.pixel_format = PIXFORMAT_YUV422; // Required for blob detection
   config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
   config.fb_location = CAMERA_FB_IN_PSRAM;
@@ -87,9 +130,26 @@ bool initCamera() {
   s->set_exposure_ctrl(s, 0);  // Disable auto exposure
 
   // Serial.println("Camera initialized for YUV422 blob detection");
+  camera_resolution = &resolution;
   return true;
 }
 
+/**
+ * Restart the sensor at another frame size
+ * The driver sizes its frame buffers at init, so this is a full deinit/init.
+ * No camera_fb_t may be held by the caller. On failure the previous size is
+ * restored and false is returned.
+ */
+bool reinitCamera(const CameraResolution& resolution) {
+  const CameraResolution& previous = *camera_resolution;
+  esp_camera_deinit();
+  if (initCamera(resolution)) return true;
+
+  esp_camera_deinit();
+  initCamera(previous);
+  return false;
+}
+
 /**
  * Capture image - optimized for speed
  * Returns raw camera frame buffer
@@ -106,11 +166,11 @@ camera_fb_t* captureImage() {
 }
 
 /**
- * Get current image dimensions (always 160x120)
+ * Get current image dimensions
  */
 void getImageDimensions(int* width, int* height) {
-  *width = 160;
-  *height = 120;
+  *width = camera_resolution->width;
+  *height = camera_resolution->height;
 }
 
 /**
@@ -0,0 +1,240 @@
+#ifndef CHANGE_REPORTER_H
+#define CHANGE_REPORTER_H
+
+#include "simple_serial_comm.h"
+#include "blob_detector_ccl.h"
+#include <string>
+#include <vector>
+
+// ========================================
+// CHANGE-ONLY RESULT REPORTING
+// ========================================
+
+// Concurrent subscriptions (one per region set)
+#define CHANGE_MAX_SUBSCRIPTIONS 4
+
+// A new blob this close to a previously sent one (same region and color)
+// is treated as the same blob
+#define CHANGE_MATCH_RADIUS 24
+
+// Wire format, one block per subscription and frame, only when something changed:
+//   SUB,<slot>,K                      keyframe: client forgets all blobs of this slot
+//   SUB,<slot>,D                      delta against what the client already has
+//   +<id>,<region>,<color>,<x>,<y>,<size>   blob appeared (keyframes list every blob)
+//   ~<id>,<x>,<y>,<size>              blob moved / resized beyond the deadbands
+//   -<id>                             blob disappeared
+//   END
+
+struct SentBlob {
+  uint16_t id;
+  int region_id;
+  ColorId color;
+  int x, y, size;   // Values the client currently holds
+  bool seen;
+};
+
+struct Subscription {
+  bool active;
+  RegionSetId region_set;
+  std::vector<ColorId> colors;       // Empty = all colors
+  int move_px;                       // Position deadband
+  int size_pct;                      // Size deadband, percent of the sent size
+  int keyframe_interval;             // Frames between keyframes, 0 = first frame only
+  int frames_since_keyframe;
+  bool need_keyframe;
+  std::vector<SentBlob> sent;
+  
+  Subscription() : active(false), region_set(REGION_SET_NONE), move_px(0), size_pct(0), keyframe_interval(0),
+                   frames_since_keyframe(0), need_keyframe(true) {}
+};
+
+class ChangeReporter {
+private:
+  Subscription subs[CHANGE_MAX_SUBSCRIPTIONS];
+  uint16_t next_id;
+  DetectionResults results;   // Reused for every subscription and frame
+  
+  uint16_t allocId() {
+    uint16_t id = next_id++;
+    if (next_id == 0) next_id = 1;
+    return id;
+  }
+  
+  int findSlot(RegionSetId region_set) const {
+    for (int i = 0; i < CHANGE_MAX_SUBSCRIPTIONS; i++) {
+      if (subs[i].active && subs[i].region_set == region_set) return i;
+    }
+    return -1;
+  }
+  
+  static bool exceedsDeadband(const Subscription& sub, const SentBlob& prev, const Blob& blob) {
+    if (abs(blob.center_x - prev.x) > sub.move_px || abs(blob.center_y - prev.y) > sub.move_px) {
+      return true;
+    }
+    return abs(blob.pixel_count - prev.size) * 100 > prev.size * sub.size_pct;
+  }
+  
+  // Closest not yet matched blob of the same region and color
+  static SentBlob* matchBlob(Subscription& sub, int region_id, ColorId color, const Blob& blob) {
+    SentBlob* best = nullptr;
+    int best_dist = CHANGE_MATCH_RADIUS * CHANGE_MATCH_RADIUS + 1;
+    for (auto& prev : sub.sent) {
+      if (prev.seen || prev.region_id != region_id || prev.color != color) continue;
+      int dx = blob.center_x - prev.x;
+      int dy = blob.center_y - prev.y;
+      int dist = dx * dx + dy * dy;
+      if (dist < best_dist) {
+        best_dist = dist;
+        best = &prev;
+      }
+    }
+    return best;
+  }
+  
+  static String addedLine(const SentBlob& blob) {
+    return "+" + String(blob.id) + "," + String(blob.region_id) + "," +
+           String(getColorManager().colorName(blob.color).c_str()) + "," +
+           String(blob.x) + "," + String(blob.y) + "," + String(blob.size);
+  }
+  
+  void sendKeyframe(int slot, Subscription& sub, SimpleSerialSender& sender) {
+    sub.sent.clear();
+    sender.send("SUB," + String(slot) + ",K");
+    
+    for (int r = 0; r < results.regionCount(); r++) {
+      for (int c = 0; c < results.colorCount(); c++) {
+        for (const Blob& blob : results.blobs(r, c)) {
+          SentBlob sent = {allocId(), r, results.colorAt(c),
+                           blob.center_x, blob.center_y, blob.pixel_count, false};
+          sender.send(addedLine(sent));
+          sub.sent.push_back(sent);
+        }
+      }
+    }
+    
+    sender.endTransmission();
+    sub.frames_since_keyframe = 0;
+    sub.need_keyframe = false;
+  }
+  
+  void sendDelta(int slot, Subscription& sub, SimpleSerialSender& sender) {
+    bool header_sent = false;
+    auto header = [&]() {
+      if (!header_sent) sender.send("SUB," + String(slot) + ",D");
+      header_sent = true;
+    };
+    
+    for (auto& prev : sub.sent) prev.seen = false;
+    
+    std::vector<SentBlob> added;
+    for (int r = 0; r < results.regionCount(); r++) {
+      for (int c = 0; c < results.colorCount(); c++) {
+        for (const Blob& blob : results.blobs(r, c)) {
+          SentBlob* prev = matchBlob(sub, r, results.colorAt(c), blob);
+          if (!prev) {
+            added.push_back({allocId(), r, results.colorAt(c),
+                             blob.center_x, blob.center_y, blob.pixel_count, true});
+            continue;
+          }
+          
+          prev->seen = true;
+          if (exceedsDeadband(sub, *prev, blob)) {
+            prev->x = blob.center_x;
+            prev->y = blob.center_y;
+            prev->size = blob.pixel_count;
+            header();
+            sender.send("~" + String(prev->id) + "," + String(prev->x) + "," +
+                        String(prev->y) + "," + String(prev->size));
+          }
+        }
+      }
+    }
+    
+    // Disappeared
+    size_t keep = 0;
+    for (size_t i = 0; i < sub.sent.size(); i++) {
+      if (!sub.sent[i].seen) {
+        header();
+        sender.send("-" + String(sub.sent[i].id));
+        continue;
+      }
+      sub.sent[keep++] = sub.sent[i];
+    }
+    sub.sent.resize(keep);
+    
+    for (const auto& blob : added) {
+      header();
+      sender.send(addedLine(blob));
+      sub.sent.push_back(blob);
+    }
+    
+    if (header_sent) sender.endTransmission();
+  }
+
+public:
+  ChangeReporter() : next_id(1) {}
+  
+  // Returns the slot used on the wire, -1 if all slots are taken.
+  // Subscribing again to the same region set replaces its settings.
+  int subscribe(RegionSetId region_set, const std::vector<ColorId>& colors,
+                int move_px, int size_pct, int keyframe_interval) {
+    int slot = findSlot(region_set);
+    for (int i = 0; slot < 0 && i < CHANGE_MAX_SUBSCRIPTIONS; i++) {
+      if (!subs[i].active) slot = i;
+    }
+    if (slot < 0) return -1;
+    
+    Subscription& sub = subs[slot];
+    sub.active = true;
+    sub.region_set = region_set;
+    sub.colors = colors;
+    sub.move_px = move_px;
+    sub.size_pct = size_pct;
+    sub.keyframe_interval = keyframe_interval;
+    sub.frames_since_keyframe = 0;
+    sub.need_keyframe = true;
+    return slot;
+  }
+  
+  // Returns the freed slot, -1 if the region set was not subscribed
+  int unsubscribe(RegionSetId region_set) {
+    int slot = findSlot(region_set);
+    if (slot >= 0) subs[slot] = Subscription();
+    return slot;
+  }
+  
+  // Settings of one slot; inactive slots have active == false
+  const Subscription& subscription(int slot) const {
+    return subs[slot];
+  }
+  
+  bool hasSubscriptions() const {
+    for (int i = 0; i < CHANGE_MAX_SUBSCRIPTIONS; i++) {
+      if (subs[i].active) return true;
+    }
+    return false;
+  }
+  
+  // Detect on this frame for every subscription and send what changed
+  void report(const HSVImage& hsv, SimpleSerialSender& sender) {
+    for (int slot = 0; slot < CHANGE_MAX_SUBSCRIPTIONS; slot++) {
+      Subscription& sub = subs[slot];
+      if (!sub.active) continue;
+      
+      detectBlobsInto(hsv, sub.region_set,
+                      sub.colors.empty() ? getColorManager().getAllColorIds() : sub.colors, results);
+      
+      bool keyframe = sub.need_keyframe ||
+        (sub.keyframe_interval > 0 && sub.frames_since_keyframe >= sub.keyframe_interval);
+      
+      if (keyframe) {
+        sendKeyframe(slot, sub, sender);
+      } else {
+        sendDelta(slot, sub, sender);
+      }
+      sub.frames_since_keyframe++;
+    }
+  }
+};
+
+#endif // CHANGE_REPORTER_H
\ No newline at end of file
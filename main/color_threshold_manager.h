@@ -1,6 +1,11 @@
 #ifndef COLOR_THRESHOLD_MANAGER_H
 #define COLOR_THRESHOLD_MANAGER_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -9,6 +14,8 @@
 // COLOR THRESHOLD STRUCTURE
 // ========================================
 
+// One HSV box. Hue is a circle of 0..179: h_min > h_max wraps through
+// 179 -> 0, so RED fits in one box (160..10).
 struct ColorThresholds {
   uint8_t h_min, h_max;
   uint8_t s_min, s_max;
@@ -18,107 +25,484 @@ struct ColorThresholds {
     : h_min(hmin), h_max(hmax), s_min(smin), s_max(smax), v_min(vmin), v_max(vmax) {}
     
   ColorThresholds() : h_min(0), h_max(179), s_min(0), s_max(255), v_min(0), v_max(255) {}
+  
+  bool containsHue(uint8_t h) const {
+    return h_min <= h_max ? (h >= h_min && h <= h_max) : (h >= h_min || h <= h_max);
+  }
+  
+  bool matches(uint8_t h, uint8_t s, uint8_t v) const {
+    return s >= s_min && s <= s_max && v >= v_min && v <= v_max && containsHue(h);
+  }
+  
+  // Hues covered, 1..180
+  int hueSpan() const {
+    return (h_max + 180 - h_min) % 180 + 1;
+  }
+  
+  // Every pixel b admits, a admits too
+  bool holds(const ColorThresholds& b) const {
+    bool hue = hueSpan() == 180 || (b.h_min + 180 - h_min) % 180 + b.hueSpan() <= hueSpan();
+    return hue && b.s_min >= s_min && b.s_max <= s_max && b.v_min >= v_min && b.v_max <= v_max;
+  }
 };
 
+// One box in the COLOR_SETN form "h_min:h_max:s_min:s_max:v_min:v_max"
+inline bool parseColorBox(const char* text, ColorThresholds& out) {
+  int values[6];
+  for (int n = 0; n < 6; n++) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || value < 0 || value > 255) return false;
+    values[n] = value;
+    text = end;
+    if (n < 5 && *text++ != ':') return false;
+  }
+  if (*text) return false;
+  out = ColorThresholds(values[0], values[1], values[2], values[3], values[4], values[5]);
+  return true;
+}
+
+// ========================================
+// RANGE MERGING
+// ========================================
+
+// Union of two boxes when that union is itself a box: one holds the other,
+// or they agree on two channels and overlap or touch on the third
+inline bool mergeColorBoxes(const ColorThresholds& a, const ColorThresholds& b, ColorThresholds& out) {
+  if (a.holds(b)) { out = a; return true; }
+  if (b.holds(a)) { out = b; return true; }
+  
+  bool same_s = a.s_min == b.s_min && a.s_max == b.s_max;
+  bool same_v = a.v_min == b.v_min && a.v_max == b.v_max;
+  out = a;
+  
+  if (same_s && same_v) {
+    // Shortest arc starting at either box that reaches over the other
+    int a_span = a.hueSpan(), b_span = b.hueSpan();
+    int b_offset = (b.h_min + 180 - a.h_min) % 180;
+    int a_offset = (a.h_min + 180 - b.h_min) % 180;
+    int span = 0;
+    if (b_offset <= a_span) span = b_offset + b_span;
+    if (a_offset <= b_span && (span == 0 || a_offset + a_span < span)) {
+      span = a_offset + a_span;
+      out.h_min = b.h_min;
+    }
+    if (span == 0) return false;
+    if (span >= 180) {
+      out.h_min = 0;
+      out.h_max = 179;
+    } else {
+      out.h_max = (out.h_min + span - 1) % 180;
+    }
+    return true;
+  }
+  
+  bool same_h = a.hueSpan() == b.hueSpan() && (a.hueSpan() == 180 || a.h_min == b.h_min);
+  if (!same_h) return false;
+  if (same_s && b.v_min <= a.v_max + 1 && a.v_min <= b.v_max + 1) {
+    out.v_min = std::min(a.v_min, b.v_min);
+    out.v_max = std::max(a.v_max, b.v_max);
+    return true;
+  }
+  if (same_v && b.s_min <= a.s_max + 1 && a.s_min <= b.s_max + 1) {
+    out.s_min = std::min(a.s_min, b.s_min);
+    out.s_max = std::max(a.s_max, b.s_max);
+    return true;
+  }
+  return false;
+}
+
+// Canonical form of a color's boxes: hue clamped to 0..179, boxes that
+// admit nothing dropped, and mergeable pairs merged until none are left.
+// The union of admitted pixels does not change.
+inline void mergeColorRanges(std::vector<ColorThresholds>& ranges) {
+  size_t keep = 0;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    ColorThresholds t = ranges[i];
+    if (t.s_min > t.s_max || t.v_min > t.v_max) continue;
+    t.h_min = std::min<uint8_t>(t.h_min, 179);
+    t.h_max = std::min<uint8_t>(t.h_max, 179);
+    if (t.hueSpan() == 180) {
+      t.h_min = 0;
+      t.h_max = 179;
+    }
+    ranges[keep++] = t;
+  }
+  ranges.resize(keep);
+  
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < ranges.size() && !merged; i++) {
+      for (size_t j = i + 1; j < ranges.size(); j++) {
+        ColorThresholds both;
+        if (!mergeColorBoxes(ranges[i], ranges[j], both)) continue;
+        ranges[i] = both;
+        ranges.erase(ranges.begin() + j);
+        merged = true;
+        break;
+      }
+    }
+  }
+}
+
+// ========================================
+// COLOR HANDLES
+// ========================================
+
+// Small integer standing for a color name. Names are resolved to handles
+// once, when a command is parsed; detection and results only use handles.
+// A handle stays bound to its name for good: deleting the color leaves it
+// undefined, and defining the name again revives the same handle.
+typedef uint8_t ColorId;
+
+#define COLOR_NONE 0xFF         // No handle: unknown name or table full
+#define COLOR_MAX_IDS 64        // Names ever interned
+
+// ========================================
+// COLOR SNAPSHOTS
+// ========================================
+
+// Every color definition at one moment. Once published it never changes:
+// the manager builds a new one for every change, so a reader holding a
+// ColorSnapshot (detection pins one per frame, see ConfigPin) can use it
+// on any core without a lock. The old set is freed with its last holder.
+class ColorSet {
+  friend class ColorThresholdManager;
+  friend class ConfigStore;
+  
+  struct ColorEntry {
+    std::string name;
+    std::vector<ColorThresholds> thresholds;
+    bool defined;
+  };
+  
+  std::vector<ColorEntry> entries;                 // Indexed by ColorId
+  std::unordered_map<std::string, ColorId> ids;    // Name -> handle, protocol side only
+  uint32_t change_count;   // Bumped by every set / edit / delete
+  
+  // Compiled classifier: bit k of channel_bits[h], [256 + s] and [512 + v]
+  // is set when range k admits that channel value, so a pixel lies in range
+  // k when bit k survives the AND of its three entries. Up to 64 ranges
+  // over all colors; past that matchesColor walks the boxes.
+  std::vector<uint64_t> channel_bits;
+  std::vector<uint64_t> color_bits;   // Ranges of each color, by ColorId
+  bool compiled;
+  
+  void compile() {
+    channel_bits.assign(3 * 256, 0);
+    color_bits.assign(entries.size(), 0);
+    compiled = false;
+    
+    int bit = 0;
+    for (size_t id = 0; id < entries.size(); id++) {
+      for (const ColorThresholds& t : entries[id].thresholds) {
+        if (bit == 64) return;
+        uint64_t mask = uint64_t(1) << bit++;
+        for (int h = 0; h < 256; h++) {
+          if (t.containsHue(h)) channel_bits[h] |= mask;
+        }
+        for (int s = t.s_min; s <= t.s_max; s++) channel_bits[256 + s] |= mask;
+        for (int v = t.v_min; v <= t.v_max; v++) channel_bits[512 + v] |= mask;
+        color_bits[id] |= mask;
+      }
+    }
+    compiled = true;
+  }
+
+public:
+  ColorSet() : change_count(0), compiled(false) {}
+  
+  // Handle of a name seen before, COLOR_NONE otherwise
+  ColorId findColor(const std::string& color_name) const {
+    auto it = ids.find(color_name);
+    return it != ids.end() ? it->second : COLOR_NONE;
+  }
+  
+  const std::string& colorName(ColorId id) const {
+    static const std::string unknown = "?";
+    return id < entries.size() ? entries[id].name : unknown;
+  }
+  
+  // Changes whenever any threshold does; cached detections compare it
+  uint32_t version() const {
+    return change_count;
+  }
+  
+  bool hasColor(ColorId id) const {
+    return id < entries.size() && entries[id].defined;
+  }
+  
+  bool hasColor(const std::string& color_name) const {
+    return hasColor(findColor(color_name));
+  }
+  
+  // Merged ranges of a color, empty if it is not defined
+  const std::vector<ColorThresholds>& getThresholds(ColorId id) const {
+    static const std::vector<ColorThresholds> none;
+    return id < entries.size() ? entries[id].thresholds : none;
+  }
+  
+  bool matchesColor(uint8_t h, uint8_t s, uint8_t v, ColorId id) const {
+    if (id >= entries.size()) return false;
+    if (compiled) {
+      const uint64_t* bits = channel_bits.data();
+      return (bits[h] & bits[256 + s] & bits[512 + v] & color_bits[id]) != 0;
+    }
+    
+    for (const auto& threshold : entries[id].thresholds) {
+      if (threshold.matches(h, s, v)) return true;
+    }
+    return false;
+  }
+  
+  // matchesColor over count pixels of planar H/S/V, 0 / 1 into out; returns
+  // the number of matches. The tables sit in locals, so the byte stores
+  // into out do not make the compiler reload them for every pixel.
+  uint32_t classifySpan(const uint8_t* h, const uint8_t* s, const uint8_t* v, int count,
+                        ColorId id, uint8_t* out) const {
+    uint32_t matches = 0;
+    if (!compiled || id >= entries.size()) {
+      for (int i = 0; i < count; i++) {
+        out[i] = matchesColor(h[i], s[i], v[i], id);
+        matches += out[i];
+      }
+      return matches;
+    }
+    
+    const uint64_t* bits = channel_bits.data();
+    const uint64_t wanted = color_bits[id];
+    for (int i = 0; i < count; i++) {
+      uint8_t hit = (bits[h[i]] & bits[256 + s[i]] & bits[512 + v[i]] & wanted) != 0;
+      out[i] = hit;
+      matches += hit;
+    }
+    return matches;
+  }
+  
+  bool matchesColor(uint8_t h, uint8_t s, uint8_t v, const std::string& color_name) const {
+    return matchesColor(h, s, v, findColor(color_name));
+  }
+  
+  // Handles of all defined colors, in the order they were first named
+  std::vector<ColorId> getAllColorIds() const {
+    std::vector<ColorId> result;
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (entries[i].defined) result.push_back(static_cast<ColorId>(i));
+    }
+    return result;
+  }
+  
+  std::vector<std::string> getAllColorNames() const {
+    std::vector<std::string> names;
+    for (const auto& entry : entries) {
+      if (entry.defined) names.push_back(entry.name);
+    }
+    return names;
+  }
+};
+
+typedef std::shared_ptr<const ColorSet> ColorSnapshot;
+
+// Snapshot a ConfigPin holds for this thread, null when none does
+inline const ColorSnapshot*& pinnedColorSet() {
+  static thread_local const ColorSnapshot* pinned = nullptr;
+  return pinned;
+}
+
 // ========================================
 // COLOR THRESHOLD MANAGER CLASS
 // ========================================
 
+// Publishes ColorSet snapshots. Writers copy the current set, change the
+// copy and swap it in with std::atomic_store; they queue on a mutex among
+// themselves, readers never wait. The read calls below look at the current
+// snapshot (the pinned one on a thread inside a ConfigPin) one call at a
+// time; per-pixel loops take snapshot() once instead.
 class ColorThresholdManager {
 private:
-  std::unordered_map<std::string, std::vector<ColorThresholds>> color_map;
+  ColorSnapshot current;   // Only replaced under writer
+  std::mutex writer;
+  
+  // Handle of name in set, appended there if new
+  static ColorId intern(ColorSet& set, const std::string& color_name) {
+    auto it = set.ids.find(color_name);
+    if (it != set.ids.end()) return it->second;
+    if (set.entries.size() >= COLOR_MAX_IDS) return COLOR_NONE;
+    
+    ColorId id = static_cast<ColorId>(set.entries.size());
+    set.entries.push_back({color_name, {}, false});
+    set.ids[color_name] = id;
+    return id;
+  }
+  
+  // Called with writer held
+  std::shared_ptr<ColorSet> edit() const {
+    return std::make_shared<ColorSet>(*current);
+  }
+  
+  void publish(std::shared_ptr<ColorSet> next) {
+    next->compile();
+    std::atomic_store(&current, ColorSnapshot(std::move(next)));
+  }
   
   void initializeDefaults() {
     // BLACK
-    color_map["BLACK"] = {ColorThresholds(0, 179, 0, 255, 0, 50)};
+    setColor("BLACK", ColorThresholds(0, 179, 0, 255, 0, 50));
     
-    // WHITE  
-    color_map["WHITE"] = {ColorThresholds(0, 179, 0, 50, 200, 255)};
+    // WHITE
+    setColor("WHITE", ColorThresholds(0, 179, 0, 50, 200, 255));
     
-    // RED (two ranges due to hue wraparound)
-    color_map["RED"] = {
-      ColorThresholds(0, 10, 50, 255, 50, 255),
-      ColorThresholds(160, 179, 50, 255, 50, 255)
-    };
+    // RED (hue wraps around: 160..179 and 0..10)
+    setColor("RED", ColorThresholds(160, 10, 50, 255, 50, 255));
     
     // GREEN
-    color_map["GREEN"] = {ColorThresholds(40, 80, 50, 255, 50, 255)};
+    setColor("GREEN", ColorThresholds(40, 80, 50, 255, 50, 255));
   }
-  
+
 public:
-  ColorThresholdManager() {
+  ColorThresholdManager() : current(std::make_shared<ColorSet>()) {
     initializeDefaults();
   }
   
+  ColorThresholdManager(const ColorThresholdManager&) = delete;
+  ColorThresholdManager& operator=(const ColorThresholdManager&) = delete;
+  
+  // The pinned snapshot inside a ConfigPin, the current one otherwise
+  ColorSnapshot snapshot() const {
+    const ColorSnapshot* pinned = pinnedColorSet();
+    return pinned ? *pinned : std::atomic_load(&current);
+  }
+  
+  // ========================================
+  // HANDLES
+  // ========================================
+  
+  // Handle for name, reserved now if the color is not defined yet, so a
+  // subscription can name a color that is only set later
+  ColorId colorId(const std::string& color_name) {
+    ColorId id = snapshot()->findColor(color_name);
+    if (id != COLOR_NONE) return id;
+    
+    std::lock_guard<std::mutex> lock(writer);
+    if (current->findColor(color_name) != COLOR_NONE) return current->findColor(color_name);
+    if (current->entries.size() >= COLOR_MAX_IDS) return COLOR_NONE;
+    std::shared_ptr<ColorSet> next = edit();
+    id = intern(*next, color_name);
+    publish(std::move(next));
+    return id;
+  }
+  
+  // Handle of a name seen before, COLOR_NONE otherwise
+  ColorId findColor(const std::string& color_name) const {
+    return snapshot()->findColor(color_name);
+  }
+  
+  std::string colorName(ColorId id) const {
+    return snapshot()->colorName(id);
+  }
+  
   // ========================================
   // ESSENTIAL OPERATIONS
   // ========================================
   
-  // Create/Add color
-  void setColor(const std::string& color_name, const ColorThresholds& threshold) {
-    color_map[color_name] = {threshold};
+  // Create/Add color; false only when the handle table is full. Boxes are
+  // merged (mergeColorRanges) before they are stored.
+  bool setColor(const std::string& color_name, const ColorThresholds& threshold) {
+    return setColor(color_name, std::vector<ColorThresholds>{threshold});
   }
   
-  void setColor(const std::string& color_name, const std::vector<ColorThresholds>& thresholds) {
-    color_map[color_name] = thresholds;
+  bool setColor(const std::string& color_name, const std::vector<ColorThresholds>& thresholds) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<ColorSet> next = edit();
+    ColorId id = intern(*next, color_name);
+    if (id == COLOR_NONE) return false;
+    next->entries[id].thresholds = thresholds;
+    mergeColorRanges(next->entries[id].thresholds);
+    next->entries[id].defined = true;
+    next->change_count++;
+    publish(std::move(next));
+    return true;
   }
   
   // Edit existing color
   bool editColor(const std::string& color_name, const ColorThresholds& threshold) {
-    auto it = color_map.find(color_name);
-    if (it != color_map.end()) {
-      it->second = {threshold};
-      return true;
-    }
-    return false;
+    return editColor(color_name, std::vector<ColorThresholds>{threshold});
   }
   
   bool editColor(const std::string& color_name, const std::vector<ColorThresholds>& thresholds) {
-    auto it = color_map.find(color_name);
-    if (it != color_map.end()) {
-      it->second = thresholds;
-      return true;
-    }
-    return false;
+    std::lock_guard<std::mutex> lock(writer);
+    ColorId id = current->findColor(color_name);
+    if (!current->hasColor(id)) return false;
+    std::shared_ptr<ColorSet> next = edit();
+    next->entries[id].thresholds = thresholds;
+    mergeColorRanges(next->entries[id].thresholds);
+    next->change_count++;
+    publish(std::move(next));
+    return true;
   }
   
   // Delete color
   bool deleteColor(const std::string& color_name) {
-    return color_map.erase(color_name) > 0;
+    std::lock_guard<std::mutex> lock(writer);
+    ColorId id = current->findColor(color_name);
+    if (!current->hasColor(id)) return false;
+    std::shared_ptr<ColorSet> next = edit();
+    next->entries[id].thresholds.clear();
+    next->entries[id].defined = false;
+    next->change_count++;
+    publish(std::move(next));
+    return true;
+  }
+  
+  // Replace every color at once with a set built elsewhere (ConfigStore).
+  // Its handles replace the current ones.
+  void restore(std::shared_ptr<ColorSet> set) {
+    std::lock_guard<std::mutex> lock(writer);
+    set->change_count = current->change_count + 1;
+    publish(std::move(set));
   }
   
   // ========================================
   // ACCESS FOR BLOB DETECTOR
   // ========================================
   
+  // Changes whenever any threshold does; cached detections compare it
+  uint32_t version() const {
+    return snapshot()->version();
+  }
+  
   // Check if color exists
+  bool hasColor(ColorId id) const {
+    return snapshot()->hasColor(id);
+  }
+  
   bool hasColor(const std::string& color_name) const {
-    return color_map.find(color_name) != color_map.end();
+    return snapshot()->hasColor(color_name);
+  }
+  
+  // Merged ranges of a color, empty if it is not defined
+  std::vector<ColorThresholds> getThresholds(ColorId id) const {
+    return snapshot()->getThresholds(id);
+  }
+  
+  // Match HSV values against color; per pixel, use a snapshot() instead
+  bool matchesColor(uint8_t h, uint8_t s, uint8_t v, ColorId id) const {
+    return snapshot()->matchesColor(h, s, v, id);
   }
   
-  // Match HSV values against color
   bool matchesColor(uint8_t h, uint8_t s, uint8_t v, const std::string& color_name) const {
-    auto it = color_map.find(color_name);
-    if (it == color_map.end()) return false;
-    
-    for (const auto& threshold : it->second) {
-      if (h >= threshold.h_min && h <= threshold.h_max &&
-          s >= threshold.s_min && s <= threshold.s_max &&
-          v >= threshold.v_min && v <= threshold.v_max) {
-        return true;
-      }
-    }
-    return false;
+    return snapshot()->matchesColor(h, s, v, color_name);
+  }
+  
+  // Handles of all defined colors, in the order they were first named
+  std::vector<ColorId> getAllColorIds() const {
+    return snapshot()->getAllColorIds();
   }
   
   // Get all color names
   std::vector<std::string> getAllColorNames() const {
-    std::vector<std::string> names;
-    names.reserve(color_map.size());
-    for (const auto& pair : color_map) {
-      names.push_back(pair.first);
-    }
-    return names;
+    return snapshot()->getAllColorNames();
   }
 };
 
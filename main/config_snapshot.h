@@ -0,0 +1,69 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include "color_threshold_manager.h"
+#include "region_manager.h"
+
+// ========================================
+// PINNED CONFIGURATION
+// ========================================
+
+// Colors and region sets are published as immutable snapshots (ColorSet,
+// RegionSetTable). A command on one core swaps in a new snapshot; it never
+// changes one that detection on the other core is reading.
+//
+// A ConfigPin takes both snapshots when it is created. Until it goes out
+// of scope, every lookup on its thread sees them: getColorManager() and
+// getRegionManager() reads, and all detection. One frame is then detected
+// against one configuration even if a COLOR_SET lands halfway through. The
+// snapshots are freed when the last pin or caller holding them lets go.
+//
+// Pin around detection, not around command handling: writes made on a
+// pinned thread only show up there once the pin is gone.
+class ConfigPin {
+private:
+  ColorSnapshot colors;
+  RegionSnapshot regions;
+  const ColorSnapshot* outer_colors;     // Pin this one is nested in, if any
+  const RegionSnapshot* outer_regions;
+
+public:
+  ConfigPin()
+    : colors(getColorManager().snapshot()), regions(getRegionManager().snapshot()),
+      outer_colors(pinnedColorSet()), outer_regions(pinnedRegionSets()) {
+    pinnedColorSet() = &colors;
+    pinnedRegionSets() = &regions;
+  }
+  
+  ~ConfigPin() {
+    pinnedColorSet() = outer_colors;
+    pinnedRegionSets() = outer_regions;
+  }
+  
+  ConfigPin(const ConfigPin&) = delete;
+  ConfigPin& operator=(const ConfigPin&) = delete;
+  
+  const ColorSet& colorSet() const { return *colors; }
+  const RegionSetTable& regionSets() const { return *regions; }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+// Core 1: detection. Core 0: BlobCommandInterface, free to run COLOR_SET
+// at any moment.
+void detectionTask(void*) {
+  DetectionResults results;
+  RegionSetId belt = getRegionManager().regionSetId("belt");
+  
+  for (;;) {
+    HSVImage hsv = nextFrame();
+    ConfigPin pin;                          // This frame's colors and regions
+    detectBlobsInto(hsv, belt, pin.colorSet().getAllColorIds(), results);
+    publishResults(results);
+  }                                         // Older snapshots freed here
+}
+*/
+
+#endif // CONFIG_SNAPSHOT_H
\ No newline at end of file
@@ -0,0 +1,401 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "color_threshold_manager.h"
+#include "region_manager.h"
+#include "change_reporter.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ========================================
+// CONFIGURATION STORAGE INTERFACE
+// ========================================
+
+// Where the configuration image lives: one blob, replaced as a whole.
+// Implementations: NvsStorage (main/nvs_storage.h) on the ESP32, and
+// FileStorage (bench/host/file_storage.h) on Linux.
+class ConfigStorage {
+public:
+  virtual ~ConfigStorage() {}
+  
+  // The stored image; false (and out empty) if there is none
+  virtual bool read(std::vector<uint8_t>& out) = 0;
+  
+  // Replace the stored image; false if it could not be written
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+  
+  virtual bool erase() = 0;
+};
+
+// ========================================
+// BINARY CONFIGURATION IMAGE
+// ========================================
+
+// Little endian throughout:
+//   header   "BCFG", version u16, payload bytes u32, CRC-32 of the payload u32
+//   payload  image width u16, image height u16
+//            colors u8, per ColorId:   name, defined u8, boxes u8, boxes x 6 u8 (h, h, s, s, v, v)
+//            sets u8, per RegionSetId: name, defined u8, regions u16, per region:
+//                                      x, y, width, height i16, shaped u8; a shape adds
+//                                      y0 i16, rows u16, spans per row u16, spans x (x0, x1 i16)
+//            subscriptions u8, each:   region set u8, move_px i32, size_pct i32,
+//                                      keyframe i32, colors u8, colors x ColorId u8
+//   name     length u8, bytes
+// Names keep their handle order, undefined ones included, so ColorId and
+// RegionSetId values (and the subscriptions that hold them) survive a
+// reboot. Colors are stored merged, exactly as published.
+#define CONFIG_MAGIC "BCFG"
+#define CONFIG_VERSION 1
+#define CONFIG_HEADER_SIZE 14
+
+// A subscription as it is stored; slots are given out again on load
+struct StoredSubscription {
+  RegionSetId region_set;
+  std::vector<ColorId> colors;
+  int32_t move_px;
+  int32_t size_pct;
+  int32_t keyframe_interval;
+};
+
+// A decoded image, not published yet
+struct ConfigImage {
+  std::shared_ptr<ColorSet> colors;
+  std::shared_ptr<RegionSetTable> regions;
+  std::vector<StoredSubscription> subscriptions;
+};
+
+// CRC-32 (IEEE 802.3, as zlib); bitwise, the image is a few KB at most
+inline uint32_t configCrc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+class ConfigWriter {
+private:
+  std::vector<uint8_t>& out;
+
+public:
+  ConfigWriter(std::vector<uint8_t>& buffer) : out(buffer) {}
+  
+  void u8(uint8_t value) { out.push_back(value); }
+  
+  void u16(uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+  }
+  
+  void u32(uint32_t value) {
+    u16(value & 0xFFFF);
+    u16(value >> 16);
+  }
+  
+  // Names longer than 255 bytes are cut; the protocol never makes one
+  void name(const std::string& s) {
+    size_t length = std::min<size_t>(s.size(), 255);
+    out.push_back(uint8_t(length));
+    out.insert(out.end(), s.begin(), s.begin() + length);
+  }
+};
+
+// Reads past the end return 0 and set failed, so a truncated image is
+// caught once at the end instead of at every field
+class ConfigReader {
+private:
+  const uint8_t* p;
+  const uint8_t* end;
+
+public:
+  bool failed;
+  
+  ConfigReader(const uint8_t* data, size_t length) : p(data), end(data + length), failed(false) {}
+  
+  uint8_t u8() {
+    if (p >= end) {
+      failed = true;
+      return 0;
+    }
+    return *p++;
+  }
+  
+  uint16_t u16() {
+    uint16_t lo = u8();
+    return lo | (uint16_t(u8()) << 8);
+  }
+  
+  uint32_t u32() {
+    uint32_t lo = u16();
+    return lo | (uint32_t(u16()) << 16);
+  }
+  
+  std::string name() {
+    size_t length = u8();
+    if (size_t(end - p) < length) {
+      failed = true;
+      return std::string();
+    }
+    std::string s(reinterpret_cast<const char*>(p), length);
+    p += length;
+    return s;
+  }
+  
+  bool atEnd() const { return p == end; }
+};
+
+// ========================================
+// CONFIGURATION STORE
+// ========================================
+
+// Saves colors, region sets and (optionally) a ChangeReporter's
+// subscriptions as one image, and puts them back at boot. Loading decodes
+// straight into a new ColorSet and RegionSetTable and publishes each once,
+// compiled for the stored image size, so the first frame after power-up
+// finds everything ready instead of waiting for the client to send its
+// setup commands again. A damaged, truncated or newer image is ignored and
+// the defaults stay.
+class ConfigStore {
+private:
+  ConfigStorage* storage;
+  
+  static void encodeRegion(ConfigWriter& w, const DetectionRegion& region) {
+    w.u16(uint16_t(region.x));
+    w.u16(uint16_t(region.y));
+    w.u16(uint16_t(region.width));
+    w.u16(uint16_t(region.height));
+    w.u8(region.shape ? 1 : 0);
+    if (!region.shape) return;
+    
+    const RegionShape& shape = *region.shape;
+    w.u16(uint16_t(shape.y0));
+    w.u16(uint16_t(shape.rows()));
+    for (int row = 0; row < shape.rows(); row++) {
+      w.u16(uint16_t(shape.row_first[row + 1] - shape.row_first[row]));
+    }
+    for (const RowSpan& span : shape.spans) {
+      w.u16(uint16_t(span.x0));
+      w.u16(uint16_t(span.x1));
+    }
+  }
+  
+  static bool decodeRegion(ConfigReader& r, std::vector<DetectionRegion>& out) {
+    int x = int16_t(r.u16()), y = int16_t(r.u16());
+    int width = int16_t(r.u16()), height = int16_t(r.u16());
+    if (!regionBoxValid(x, y, width, height)) return false;
+    DetectionRegion region(x, y, width, height);
+    
+    if (r.u8()) {
+      std::shared_ptr<RegionShape> shape = std::make_shared<RegionShape>();
+      shape->y0 = int16_t(r.u16());
+      int rows = r.u16();
+      if (!regionBoxValid(0, shape->y0, 0, rows)) return false;
+      shape->row_first.reserve(rows + 1);
+      shape->row_first.push_back(0);
+      for (int row = 0; row < rows && !r.failed; row++) {
+        shape->row_first.push_back(shape->row_first.back() + r.u16());
+      }
+      
+      size_t spans = shape->row_first.back();
+      for (size_t i = 0; i < spans && !r.failed; i++) {
+        RowSpan span;
+        span.x0 = int16_t(r.u16());
+        span.x1 = int16_t(r.u16());
+        if (span.x1 < span.x0) return false;
+        shape->pixels += span.x1 - span.x0;
+        shape->spans.push_back(span);
+      }
+      region.shape = std::move(shape);
+    }
+    
+    out.push_back(region);
+    return !r.failed;
+  }
+
+public:
+  ConfigStore(ConfigStorage* backend = nullptr) : storage(backend) {}
+  
+  ConfigStore(const ConfigStore&) = delete;
+  ConfigStore& operator=(const ConfigStore&) = delete;
+  
+  void setStorage(ConfigStorage* backend) {
+    storage = backend;
+  }
+  
+  bool hasStorage() const { return storage != nullptr; }
+  
+  // Image of these snapshots and, if given, the reporter's subscriptions
+  static void encode(const ColorSet& colors, const RegionSetTable& regions,
+                     const ChangeReporter* reporter, std::vector<uint8_t>& out) {
+    out.assign(CONFIG_HEADER_SIZE, 0);
+    ConfigWriter w(out);
+    
+    w.u16(uint16_t(regions.image_width));
+    w.u16(uint16_t(regions.image_height));
+    
+    w.u8(uint8_t(colors.entries.size()));
+    for (const auto& entry : colors.entries) {
+      w.name(entry.name);
+      w.u8(entry.defined);
+      w.u8(uint8_t(std::min<size_t>(entry.thresholds.size(), 255)));
+      for (size_t i = 0; i < entry.thresholds.size() && i < 255; i++) {
+        const ColorThresholds& t = entry.thresholds[i];
+        w.u8(t.h_min); w.u8(t.h_max);
+        w.u8(t.s_min); w.u8(t.s_max);
+        w.u8(t.v_min); w.u8(t.v_max);
+      }
+    }
+    
+    w.u8(uint8_t(regions.entries.size()));
+    for (const auto& entry : regions.entries) {
+      w.name(entry.name);
+      w.u8(entry.defined);
+      w.u16(uint16_t(entry.regions.size()));
+      for (const DetectionRegion& region : entry.regions) encodeRegion(w, region);
+    }
+    
+    size_t count_at = out.size();
+    w.u8(0);
+    for (int slot = 0; reporter && slot < CHANGE_MAX_SUBSCRIPTIONS; slot++) {
+      const Subscription& sub = reporter->subscription(slot);
+      if (!sub.active) continue;
+      out[count_at]++;
+      w.u8(sub.region_set);
+      w.u32(uint32_t(sub.move_px));
+      w.u32(uint32_t(sub.size_pct));
+      w.u32(uint32_t(sub.keyframe_interval));
+      w.u8(uint8_t(sub.colors.size()));
+      for (ColorId color : sub.colors) w.u8(color);
+    }
+    
+    // Header last, over the finished payload
+    size_t payload = out.size() - CONFIG_HEADER_SIZE;
+    std::vector<uint8_t> header;
+    ConfigWriter h(header);
+    for (int i = 0; i < 4; i++) h.u8(CONFIG_MAGIC[i]);
+    h.u16(CONFIG_VERSION);
+    h.u32(uint32_t(payload));
+    h.u32(configCrc32(out.data() + CONFIG_HEADER_SIZE, payload));
+    std::copy(header.begin(), header.end(), out.begin());
+  }
+  
+  // False for anything but a complete image of this version; image is
+  // only meaningful on success
+  static bool decode(const uint8_t* data, size_t length, ConfigImage& image) {
+    if (length < CONFIG_HEADER_SIZE || memcmp(data, CONFIG_MAGIC, 4) != 0) return false;
+    ConfigReader header(data + 4, CONFIG_HEADER_SIZE - 4);
+    uint16_t version = header.u16();
+    uint32_t payload = header.u32();
+    uint32_t crc = header.u32();
+    if (version != CONFIG_VERSION || payload != length - CONFIG_HEADER_SIZE ||
+        crc != configCrc32(data + CONFIG_HEADER_SIZE, payload)) return false;
+    
+    ConfigReader r(data + CONFIG_HEADER_SIZE, payload);
+    image.colors = std::make_shared<ColorSet>();
+    image.regions = std::make_shared<RegionSetTable>();
+    image.subscriptions.clear();
+    
+    image.regions->image_width = r.u16();
+    image.regions->image_height = r.u16();
+    
+    int colors = r.u8();
+    if (colors > COLOR_MAX_IDS) return false;
+    for (int id = 0; id < colors && !r.failed; id++) {
+      std::string name = r.name();
+      bool defined = r.u8() != 0;
+      std::vector<ColorThresholds> thresholds(r.u8());
+      for (ColorThresholds& t : thresholds) {
+        t.h_min = r.u8(); t.h_max = r.u8();
+        t.s_min = r.u8(); t.s_max = r.u8();
+        t.v_min = r.u8(); t.v_max = r.u8();
+      }
+      if (!image.colors->ids.emplace(name, ColorId(id)).second) return false;
+      image.colors->entries.push_back({name, std::move(thresholds), defined});
+    }
+    
+    int sets = r.u8();
+    if (sets > REGION_SET_MAX_IDS) return false;
+    for (int id = 0; id < sets && !r.failed; id++) {
+      std::string name = r.name();
+      bool defined = r.u8() != 0;
+      int count = r.u16();
+      std::vector<DetectionRegion> regions;
+      for (int i = 0; i < count && !r.failed; i++) {
+        if (!decodeRegion(r, regions)) return false;
+      }
+      if (!image.regions->ids.emplace(name, RegionSetId(id)).second) return false;
+      image.regions->entries.push_back({name, std::move(regions), nullptr, defined});
+    }
+    
+    int subscriptions = r.u8();
+    if (subscriptions > CHANGE_MAX_SUBSCRIPTIONS) return false;
+    for (int i = 0; i < subscriptions && !r.failed; i++) {
+      StoredSubscription sub;
+      sub.region_set = r.u8();
+      sub.move_px = int32_t(r.u32());
+      sub.size_pct = int32_t(r.u32());
+      sub.keyframe_interval = int32_t(r.u32());
+      sub.colors.resize(r.u8());
+      for (ColorId& color : sub.colors) {
+        color = r.u8();
+        if (color >= colors) return false;
+      }
+      if (sub.region_set >= sets) return false;
+      image.subscriptions.push_back(std::move(sub));
+    }
+    
+    return !r.failed && r.atEnd();
+  }
+  
+  // Store the published colors and region sets, plus reporter's subscriptions
+  bool save(const ChangeReporter* reporter = nullptr) {
+    if (!storage) return false;
+    std::vector<uint8_t> image;
+    encode(*getColorManager().snapshot(), *getRegionManager().snapshot(), reporter, image);
+    return storage->write(image.data(), image.size());
+  }
+  
+  // Replace every color and region set with the stored ones and subscribe
+  // reporter as saved. Call at boot, before any handles are handed out:
+  // the stored ColorId / RegionSetId values take over. False (nothing
+  // changed) without a valid image.
+  bool load(ChangeReporter* reporter = nullptr) {
+    std::vector<uint8_t> data;
+    ConfigImage image;
+    if (!storage || !storage->read(data) || !decode(data.data(), data.size(), image)) return false;
+    
+    getColorManager().restore(image.colors);
+    getRegionManager().restore(image.regions);
+    for (const StoredSubscription& sub : image.subscriptions) {
+      if (reporter) reporter->subscribe(sub.region_set, sub.colors, sub.move_px, sub.size_pct,
+                                        sub.keyframe_interval);
+    }
+    return true;
+  }
+  
+  bool clear() {
+    return storage && storage->erase();
+  }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+NvsStorage nvs;                         // main/nvs_storage.h
+ConfigStore config(&nvs);
+
+void setup() {
+  initCamera();
+  if (!config.load()) {                 // First boot: build the setup once
+    getColorManager().setColor("PART", ColorThresholds(100, 130, 80, 255, 40, 255));
+    getRegionManager().setRegionSet("belt", DetectionRegion(0, 60, 320, 120));
+    config.save();
+  }
+}
+*/
+
+#endif // CONFIG_STORE_H
\ No newline at end of file
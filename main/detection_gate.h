@@ -0,0 +1,284 @@
+#ifndef DETECTION_GATE_H
+#define DETECTION_GATE_H
+
+#include "blob_detector_ccl.h"
+#include "metrics.h"
+#include <string>
+#include <vector>
+
+// ========================================
+// FRAME-DIFFERENCE DETECTION GATE
+// ========================================
+
+// Compares the Y channel of each new YUV422 frame tile by tile (sum of
+// absolute differences) against the frame the cached detections were made
+// on. Region / color results whose region touches no changed tile are
+// reused; only the others run CCL again. A tile's reference is refreshed
+// when it changes, so slow drift still adds up to a change eventually.
+// Differences up to the noise floor are dropped per pixel before summing:
+// a mean over the tile would hide a small blob edge moving by a pixel.
+// Given a compiled region set, each region is labelled over the pixels it
+// owns, so the results are those of detectBlobsInto() on that set.
+
+#define GATE_TILE 16              // Tile edge in pixels
+#define GATE_NOISE_FLOOR 6        // |dY| per pixel treated as sensor noise
+#define GATE_TILE_SAD 48          // Summed |dY| beyond the floor that marks a tile changed
+#define GATE_MAX_CACHE 64         // Cached region / color results
+
+class DetectionGate {
+private:
+  struct CacheEntry {
+    DetectionRegion region;
+    int region_idx;
+    ColorId color;
+    int min_size;
+    std::vector<Blob> blobs;
+    uint32_t cost_us;             // What detecting it took
+  };
+  
+  int width;
+  int height;
+  int tiles_x;
+  int tiles_y;
+  int tile_sad;
+  std::vector<uint8_t> reference;   // Y plane the cached results belong to
+  std::vector<uint8_t> changed;     // Per tile, from the last update()
+  std::vector<CacheEntry> cache;
+  std::vector<std::vector<Blob>> spare;   // Blob lists of dropped entries, reused by new ones
+  std::shared_ptr<const CompiledRegionSet> cached_set;   // Set the cache is keyed by region index of
+  uint32_t color_version;
+  uint32_t saved_us;                // Below one ms, not yet in the metrics
+  
+  bool touchesChange(const DetectionRegion& r) const {
+    int tx0 = std::max(0, r.x / GATE_TILE);
+    int ty0 = std::max(0, r.y / GATE_TILE);
+    int tx1 = std::min(tiles_x - 1, (r.x + r.width - 1) / GATE_TILE);
+    int ty1 = std::min(tiles_y - 1, (r.y + r.height - 1) / GATE_TILE);
+    for (int ty = ty0; ty <= ty1; ty++) {
+      for (int tx = tx0; tx <= tx1; tx++) {
+        if (changed[ty * tiles_x + tx]) return true;
+      }
+    }
+    return false;
+  }
+  
+  // SAD of one tile against the reference; copies the tile in if it changed
+  bool diffTile(const uint8_t* yuv422, int tx, int ty) {
+    int x0 = tx * GATE_TILE, y0 = ty * GATE_TILE;
+    int x1 = std::min(width, x0 + GATE_TILE), y1 = std::min(height, y0 + GATE_TILE);
+    int sad = 0;
+    
+    for (int y = y0; y < y1 && sad <= tile_sad; y++) {
+      const uint8_t* src = yuv422 + (y * width + x0) * 2;
+      const uint8_t* ref = reference.data() + y * width + x0;
+      for (int x = 0; x < x1 - x0; x++) {
+        int d = int(src[x * 2]) - ref[x];
+        if (d < 0) d = -d;
+        if (d > GATE_NOISE_FLOOR) sad += d - GATE_NOISE_FLOOR;
+      }
+    }
+    if (sad <= tile_sad) return false;
+    
+    for (int y = y0; y < y1; y++) {
+      const uint8_t* src = yuv422 + (y * width + x0) * 2;
+      uint8_t* ref = reference.data() + y * width + x0;
+      for (int x = 0; x < x1 - x0; x++) ref[x] = src[x * 2];
+    }
+    return true;
+  }
+  
+  // Keep the blob list of an entry about to be dropped
+  void recycle(CacheEntry& entry) {
+    if (spare.size() < GATE_MAX_CACHE) spare.push_back(std::move(entry.blobs));
+  }
+  
+  void dropAll() {
+    for (CacheEntry& entry : cache) recycle(entry);
+    cache.clear();
+  }
+  
+  // Cached result of region_idx (by_index) or of an identical region
+  const CacheEntry* lookup(const DetectionRegion& region, int region_idx, bool by_index, ColorId color,
+                           int min_size) const {
+    for (const CacheEntry& entry : cache) {
+      if (entry.color != color || entry.min_size != min_size) continue;
+      if (by_index ? entry.region_idx == region_idx
+                   : entry.region.x == region.x && entry.region.y == region.y &&
+                     entry.region.width == region.width && entry.region.height == region.height &&
+                     entry.region.shape == region.shape) return &entry;
+    }
+    return nullptr;
+  }
+  
+  void detectRegions(const HSVImage& hsv, const std::vector<DetectionRegion>& regions, bool by_index,
+                     const std::vector<ColorId>& colors, DetectionResults& results, int min_size) {
+    results.begin(regions.size(), colors);
+    ColorSnapshot color_set = getColorManager().snapshot();
+    
+    for (size_t region_idx = 0; region_idx < regions.size(); region_idx++) {
+      const DetectionRegion& region = regions[region_idx];
+      
+      for (size_t c = 0; c < colors.size(); c++) {
+        ColorId color = colors[c];
+        const CacheEntry* hit = lookup(region, region_idx, by_index, color, min_size);
+        
+        if (hit) {
+          results.setSlot(region_idx, c, hit->blobs);
+          getMetrics().gate_hits.add();
+          saved_us += hit->cost_us;
+          continue;
+        }
+        
+        std::vector<Blob> blobs;
+        if (!spare.empty()) {
+          blobs = std::move(spare.back());
+          spare.pop_back();
+        }
+        unsigned long start = micros();
+        detectSingleColorInto(hsv, region, color, *color_set, results.workspace(), blobs, min_size);
+        uint32_t cost = micros() - start;
+        getMetrics().gate_misses.add();
+        
+        results.setSlot(region_idx, c, blobs);
+        if (cache.size() >= GATE_MAX_CACHE) {
+          recycle(cache.front());
+          cache.erase(cache.begin());
+        }
+        cache.push_back({region, int(region_idx), color, min_size, std::move(blobs), cost});
+      }
+    }
+    
+    getMetrics().gate_saved_ms.add(saved_us / 1000);
+    saved_us %= 1000;
+  }
+
+public:
+  DetectionGate(int threshold = GATE_TILE_SAD)
+    : width(0), height(0), tiles_x(0), tiles_y(0), tile_sad(threshold),
+      color_version(0), saved_us(0) {
+    cache.reserve(GATE_MAX_CACHE);
+    spare.reserve(GATE_MAX_CACHE);
+  }
+  
+  DetectionGate(const DetectionGate&) = delete;
+  DetectionGate& operator=(const DetectionGate&) = delete;
+  
+  // Summed |dY| beyond the noise floor that marks a tile changed
+  void setThreshold(int sad) { tile_sad = sad; }
+  
+  int getThreshold() const { return tile_sad; }
+  
+  // Drop every cached result; the next frame counts as changed everywhere
+  void reset() {
+    width = height = 0;
+    dropAll();
+    cached_set = nullptr;
+  }
+  
+  // Diff a new frame and drop the cached results it invalidates. Returns the
+  // number of changed tiles (all of them after a size or threshold change).
+  int update(const uint8_t* yuv422, int w, int h) {
+    unsigned long start = micros();
+    int count = 0;
+    
+    if (w != width || h != height || getColorManager().version() != color_version) {
+      width = w;
+      height = h;
+      tiles_x = (w + GATE_TILE - 1) / GATE_TILE;
+      tiles_y = (h + GATE_TILE - 1) / GATE_TILE;
+      reference.resize(size_t(w) * h);
+      for (size_t i = 0; i < reference.size(); i++) reference[i] = yuv422[i * 2];
+      changed.assign(tiles_x * tiles_y, 1);
+      dropAll();
+      color_version = getColorManager().version();
+      count = tiles_x * tiles_y;
+    } else {
+      for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+          bool diff = diffTile(yuv422, tx, ty);
+          changed[ty * tiles_x + tx] = diff;
+          count += diff;
+        }
+      }
+      
+      if (count > 0) {
+        size_t keep = 0;
+        for (size_t i = 0; i < cache.size(); i++) {
+          if (touchesChange(cache[i].region)) {
+            recycle(cache[i]);
+            continue;
+          }
+          if (keep != i) cache[keep] = std::move(cache[i]);
+          keep++;
+        }
+        cache.erase(cache.begin() + keep, cache.end());
+      }
+    }
+    
+    getMetrics().observeStage(STAGE_GATE, start);
+    int tiles = tiles_x * tiles_y;
+    getMetrics().gate_changed_tiles.set(tiles > 0 ? float(count) / tiles : 0.0f);
+    return count;
+  }
+  
+  // Any tile under this region changed in the last update()
+  bool regionChanged(const DetectionRegion& region) const {
+    return width == 0 || touchesChange(region);
+  }
+  
+  // detectBlobsInto() on hsv (converted from the frame given to the last
+  // update()) and a compiled set, reusing cached results where nothing
+  // changed. The cache is keyed by region index; another set, or the same
+  // one compiled again after an edit, starts it afresh.
+  void detect(const HSVImage& hsv, const std::shared_ptr<const CompiledRegionSet>& compiled,
+              const std::vector<ColorId>& colors, DetectionResults& results, int min_size = 10) {
+    if (compiled != cached_set) {
+      dropAll();
+      cached_set = compiled;
+    }
+    detectRegions(hsv, compiled->owned_regions, true, colors, results, min_size);
+  }
+  
+  std::vector<RegionResults> detect(const HSVImage& hsv, const std::shared_ptr<const CompiledRegionSet>& compiled,
+                                    const std::vector<ColorId>& colors, int min_size = 10) {
+    DetectionResults results;
+    detect(hsv, compiled, colors, results, min_size);
+    return results.toRegionResults();
+  }
+  
+  // Each region labelled on its own, like detectBlobsStructured() on a
+  // region list: a blob where regions overlap is reported by each of them
+  void detect(const HSVImage& hsv, const std::vector<DetectionRegion>& regions,
+              const std::vector<ColorId>& colors, DetectionResults& results, int min_size = 10) {
+    if (cached_set) {
+      dropAll();
+      cached_set = nullptr;
+    }
+    detectRegions(hsv, regions, false, colors, results, min_size);
+  }
+  
+  std::vector<RegionResults> detect(const HSVImage& hsv, const std::vector<DetectionRegion>& regions,
+                                    const std::vector<ColorId>& colors, int min_size = 10) {
+    DetectionResults results;
+    detect(hsv, regions, colors, results, min_size);
+    return results.toRegionResults();
+  }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+DetectionGate gate;
+RegionSetId belt = getRegionManager().regionSetId("belt");
+std::vector<ColorId> colors = resolveColors({"RED", "GREEN"});
+DetectionResults results;   // Reused every frame
+
+void onFrame(const uint8_t* yuv422, int width, int height, const HSVImage& hsv) {
+  gate.update(yuv422, width, height);
+  gate.detect(hsv, getRegionManager().getCompiledRegionSet(belt, width, height), colors, results);
+  // Regions over a still part of the belt came from the cache
+}
+*/
+
+#endif // DETECTION_GATE_H
\ No newline at end of file
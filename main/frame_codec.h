@@ -0,0 +1,432 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <Arduino.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// ========================================
+// INTER-FRAME YUV422 CODEC
+// ========================================
+
+// Lossless keyframe + delta coding of raw YUV422 frames. The frame is cut
+// into tiles; a delta frame skips tiles identical to the previous frame and
+// codes the others as raw bytes, RLE, or RLE of the byte-wise difference to
+// the previous frame, whichever is smallest. The decoder (FrameDecoder here,
+// decodeFrame() in the web page) restores every frame exactly.
+//
+// Encoded frame, little-endian:
+//   'Y' 'D' [type u8: 0 key, 1 delta][reserved u8][frame_id u32]
+//   [width u16][height u16][tile_w u8][tile_h u8]
+//   tile map: 2 bits per tile, row-major, 4 tiles per byte, first tile in the top bits
+//   tile payloads, in tile order, for every tile not marked SKIP
+//
+// RLE: control byte c < 128 -> c + 1 literal bytes follow;
+//      c >= 128 -> the next byte repeats c - 125 times (3..130).
+// A tile payload ends when the tile's byte count has been produced.
+
+#define FRAME_CODEC_TILE_W 16     // Pixels (32 bytes of YUV422)
+#define FRAME_CODEC_TILE_H 8      // Rows
+#define FRAME_CODEC_HEADER 14
+
+#define FRAME_TYPE_KEY   0
+#define FRAME_TYPE_DELTA 1
+
+#define TILE_SKIP      0   // Same as the previous frame
+#define TILE_RAW       1   // Tile bytes as they are
+#define TILE_RLE       2   // RLE of the tile bytes
+#define TILE_DELTA_RLE 3   // RLE of (byte - previous byte) mod 256
+
+struct FrameCodecStats {
+  uint32_t frames;
+  uint32_t keyframes;
+  uint32_t tiles;
+  uint32_t skipped_tiles;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t encode_us;
+  
+  FrameCodecStats() { reset(); }
+  
+  void reset() {
+    frames = keyframes = tiles = skipped_tiles = 0;
+    bytes_in = bytes_out = encode_us = 0;
+  }
+  
+  float ratio() const {
+    return bytes_out ? float(bytes_in) / float(bytes_out) : 0.0f;
+  }
+  
+  float usPerFrame() const {
+    return frames ? float(encode_us) / frames : 0.0f;
+  }
+};
+
+// ========================================
+// RLE HELPERS
+// ========================================
+
+// Returns the encoded size, or 0 if it would exceed limit
+inline size_t frameRleEncode(const uint8_t* in, size_t n, uint8_t* out, size_t limit) {
+  size_t o = 0;
+  size_t i = 0;
+  size_t literal_start = 0;
+  
+  auto flushLiterals = [&](size_t end) -> bool {
+    while (literal_start < end) {
+      size_t count = end - literal_start;
+      if (count > 128) count = 128;
+      if (o + 1 + count > limit) return false;
+      out[o++] = count - 1;
+      memcpy(out + o, in + literal_start, count);
+      o += count;
+      literal_start += count;
+    }
+    return true;
+  };
+  
+  while (i < n) {
+    size_t run = 1;
+    while (i + run < n && run < 130 && in[i + run] == in[i]) run++;
+    
+    if (run >= 3) {
+      if (!flushLiterals(i) || o + 2 > limit) return 0;
+      out[o++] = 125 + run;
+      out[o++] = in[i];
+      i += run;
+      literal_start = i;
+    } else {
+      i += run;
+    }
+  }
+  if (!flushLiterals(n)) return 0;
+  return o;
+}
+
+// Decode exactly n bytes; false on truncated or overlong input
+inline bool frameRleDecode(const uint8_t* in, size_t in_len, size_t* pos, uint8_t* out, size_t n) {
+  size_t o = 0;
+  while (o < n) {
+    if (*pos >= in_len) return false;
+    uint8_t c = in[(*pos)++];
+    if (c < 128) {
+      size_t count = c + 1;
+      if (o + count > n || *pos + count > in_len) return false;
+      memcpy(out + o, in + *pos, count);
+      *pos += count;
+      o += count;
+    } else {
+      size_t count = c - 125;
+      if (o + count > n || *pos >= in_len) return false;
+      memset(out + o, in[(*pos)++], count);
+      o += count;
+    }
+  }
+  return true;
+}
+
+// ========================================
+// ENCODER
+// ========================================
+
+class FrameEncoder {
+private:
+  uint8_t* reference;    // What the decoder currently holds
+  uint8_t* output;
+  size_t capacity;       // Frame bytes the buffers are sized for
+  int width;
+  int height;
+  int keyframe_interval;
+  int frames_since_key;
+  bool force_key;
+  FrameCodecStats counters;
+  
+  static size_t maxEncodedSize(size_t frame_bytes, int width, int height) {
+    size_t tiles = size_t((width + FRAME_CODEC_TILE_W - 1) / FRAME_CODEC_TILE_W) *
+                   ((height + FRAME_CODEC_TILE_H - 1) / FRAME_CODEC_TILE_H);
+    return FRAME_CODEC_HEADER + (tiles + 3) / 4 + frame_bytes;
+  }
+  
+  bool ensureCapacity(int w, int h) {
+    size_t frame_bytes = size_t(w) * h * 2;
+    if (w == width && h == height && reference) return true;
+    
+    if (frame_bytes > capacity || !reference) {
+      free(reference);
+      free(output);
+      reference = (uint8_t*)malloc(frame_bytes);
+      output = (uint8_t*)malloc(maxEncodedSize(frame_bytes, w, h));
+      if (!reference || !output) {
+        free(reference);
+        free(output);
+        reference = output = nullptr;
+        capacity = 0;
+        return false;
+      }
+      capacity = frame_bytes;
+    }
+    width = w;
+    height = h;
+    force_key = true;
+    return true;
+  }
+
+public:
+  FrameEncoder(int keyframe_frames = 30)
+    : reference(nullptr), output(nullptr), capacity(0), width(0), height(0),
+      keyframe_interval(keyframe_frames), frames_since_key(0), force_key(true) {}
+  
+  ~FrameEncoder() {
+    free(reference);
+    free(output);
+  }
+  
+  FrameEncoder(const FrameEncoder&) = delete;
+  FrameEncoder& operator=(const FrameEncoder&) = delete;
+  
+  // Frames between keyframes; 0 = only the first frame is a keyframe
+  void setKeyframeInterval(int frames) {
+    keyframe_interval = frames;
+  }
+  
+  // Next frame is a keyframe (new viewer, lost sync)
+  void requestKeyframe() {
+    force_key = true;
+  }
+  
+  // Encode one YUV422 frame; returns the encoded size (0 = out of memory).
+  // The result stays valid in data() until the next call.
+  size_t encode(const uint8_t* frame, int w, int h, uint32_t frame_id) {
+    unsigned long start = micros();
+    if (!ensureCapacity(w, h)) return 0;
+    
+    bool key = force_key || (keyframe_interval > 0 && frames_since_key >= keyframe_interval);
+    const int stride = w * 2;
+    const int tiles_x = (w + FRAME_CODEC_TILE_W - 1) / FRAME_CODEC_TILE_W;
+    const int tiles_y = (h + FRAME_CODEC_TILE_H - 1) / FRAME_CODEC_TILE_H;
+    const int tile_count = tiles_x * tiles_y;
+    const size_t map_bytes = (tile_count + 3) / 4;
+    
+    uint8_t* out = output;
+    out[0] = 'Y';
+    out[1] = 'D';
+    out[2] = key ? FRAME_TYPE_KEY : FRAME_TYPE_DELTA;
+    out[3] = 0;
+    for (int i = 0; i < 4; i++) out[4 + i] = (frame_id >> (8 * i)) & 0xFF;
+    out[8] = w & 0xFF;
+    out[9] = w >> 8;
+    out[10] = h & 0xFF;
+    out[11] = h >> 8;
+    out[12] = FRAME_CODEC_TILE_W;
+    out[13] = FRAME_CODEC_TILE_H;
+    
+    uint8_t* map = out + FRAME_CODEC_HEADER;
+    memset(map, 0, map_bytes);
+    size_t o = FRAME_CODEC_HEADER + map_bytes;
+    
+    uint8_t current[FRAME_CODEC_TILE_W * 2 * FRAME_CODEC_TILE_H];
+    uint8_t delta[sizeof(current)];
+    uint8_t coded[sizeof(current)];
+    
+    for (int tile = 0; tile < tile_count; tile++) {
+      int x0 = (tile % tiles_x) * FRAME_CODEC_TILE_W;
+      int y0 = (tile / tiles_x) * FRAME_CODEC_TILE_H;
+      int row_bytes = min(FRAME_CODEC_TILE_W, w - x0) * 2;
+      int rows = min(FRAME_CODEC_TILE_H, h - y0);
+      size_t n = size_t(row_bytes) * rows;
+      
+      bool same = !key;
+      for (int r = 0; r < rows; r++) {
+        const uint8_t* src = frame + (y0 + r) * stride + x0 * 2;
+        uint8_t* ref = reference + (y0 + r) * stride + x0 * 2;
+        memcpy(current + r * row_bytes, src, row_bytes);
+        if (same && memcmp(src, ref, row_bytes) != 0) same = false;
+        if (!key) {
+          for (int b = 0; b < row_bytes; b++) delta[r * row_bytes + b] = src[b] - ref[b];
+        }
+        memcpy(ref, src, row_bytes);
+      }
+      
+      if (same) {
+        counters.skipped_tiles++;
+        continue;
+      }
+      
+      uint8_t mode = TILE_RAW;
+      size_t best = n;
+      size_t size = frameRleEncode(current, n, coded, best - 1);
+      if (size) {
+        mode = TILE_RLE;
+        best = size;
+        memcpy(out + o, coded, size);
+      }
+      if (!key) {
+        size = frameRleEncode(delta, n, coded, best - 1);
+        if (size) {
+          mode = TILE_DELTA_RLE;
+          best = size;
+          memcpy(out + o, coded, size);
+        }
+      }
+      if (mode == TILE_RAW) memcpy(out + o, current, n);
+      
+      map[tile >> 2] |= mode << (6 - 2 * (tile & 3));
+      o += best;
+    }
+    
+    frames_since_key = key ? 1 : frames_since_key + 1;
+    force_key = false;
+    
+    counters.frames++;
+    if (key) counters.keyframes++;
+    counters.tiles += tile_count;
+    counters.bytes_in += size_t(w) * h * 2;
+    counters.bytes_out += o;
+    counters.encode_us += micros() - start;
+    return o;
+  }
+  
+  const uint8_t* data() const {
+    return output;
+  }
+  
+  const FrameCodecStats& stats() const {
+    return counters;
+  }
+  
+  void resetStats() {
+    counters.reset();
+  }
+};
+
+// ========================================
+// DECODER
+// ========================================
+
+class FrameDecoder {
+private:
+  uint8_t* frame;
+  size_t capacity;
+  int width;
+  int height;
+  bool synced;      // A keyframe has been seen
+  uint32_t last_id;
+  
+  bool fail() {
+    synced = false;
+    return false;
+  }
+
+public:
+  FrameDecoder() : frame(nullptr), capacity(0), width(0), height(0), synced(false), last_id(0) {}
+  
+  ~FrameDecoder() {
+    free(frame);
+  }
+  
+  FrameDecoder(const FrameDecoder&) = delete;
+  FrameDecoder& operator=(const FrameDecoder&) = delete;
+  
+  // Apply one encoded frame; false on malformed data or a delta before
+  // the first keyframe (the frame buffer is then not valid)
+  bool decode(const uint8_t* data, size_t len) {
+    if (len < FRAME_CODEC_HEADER || data[0] != 'Y' || data[1] != 'D') return false;
+    
+    bool key = data[2] == FRAME_TYPE_KEY;
+    uint32_t id = data[4] | (data[5] << 8) | (data[6] << 16) | (uint32_t(data[7]) << 24);
+    int w = data[8] | (data[9] << 8);
+    int h = data[10] | (data[11] << 8);
+    int tile_w = data[12];
+    int tile_h = data[13];
+    if (w == 0 || h == 0 || tile_w == 0 || tile_h == 0) return false;
+    if (tile_w * 2 * tile_h > FRAME_CODEC_TILE_W * 2 * FRAME_CODEC_TILE_H * 4) return false;
+    
+    if (key) {
+      size_t frame_bytes = size_t(w) * h * 2;
+      if (frame_bytes > capacity) {
+        free(frame);
+        frame = (uint8_t*)malloc(frame_bytes);
+        capacity = frame ? frame_bytes : 0;
+        if (!frame) return false;
+      }
+      width = w;
+      height = h;
+      synced = true;
+    } else if (!synced || w != width || h != height) {
+      synced = false;
+      return false;
+    }
+    
+    const int stride = w * 2;
+    const int tiles_x = (w + tile_w - 1) / tile_w;
+    const int tiles_y = (h + tile_h - 1) / tile_h;
+    const int tile_count = tiles_x * tiles_y;
+    const size_t map_bytes = (tile_count + 3) / 4;
+    if (len < FRAME_CODEC_HEADER + map_bytes) return fail();
+    
+    const uint8_t* map = data + FRAME_CODEC_HEADER;
+    size_t pos = FRAME_CODEC_HEADER + map_bytes;
+    uint8_t tile_buf[FRAME_CODEC_TILE_W * 2 * FRAME_CODEC_TILE_H * 4];
+    
+    for (int tile = 0; tile < tile_count; tile++) {
+      uint8_t mode = (map[tile >> 2] >> (6 - 2 * (tile & 3))) & 3;
+      if (mode == TILE_SKIP) {
+        if (key) return fail();
+        continue;
+      }
+      
+      int x0 = (tile % tiles_x) * tile_w;
+      int y0 = (tile / tiles_x) * tile_h;
+      int row_bytes = min(tile_w, w - x0) * 2;
+      int rows = min(tile_h, h - y0);
+      size_t n = size_t(row_bytes) * rows;
+      
+      if (mode == TILE_RAW) {
+        if (pos + n > len) return fail();
+        memcpy(tile_buf, data + pos, n);
+        pos += n;
+      } else if (!frameRleDecode(data, len, &pos, tile_buf, n)) {
+        return fail();
+      }
+      
+      for (int r = 0; r < rows; r++) {
+        uint8_t* dst = frame + (y0 + r) * stride + x0 * 2;
+        const uint8_t* src = tile_buf + r * row_bytes;
+        if (mode == TILE_DELTA_RLE) {
+          for (int b = 0; b < row_bytes; b++) dst[b] += src[b];
+        } else {
+          memcpy(dst, src, row_bytes);
+        }
+      }
+    }
+    
+    last_id = id;
+    return pos == len ? true : fail();
+  }
+  
+  const uint8_t* data() const { return synced ? frame : nullptr; }
+  int frameWidth() const { return width; }
+  int frameHeight() const { return height; }
+  uint32_t frameId() const { return last_id; }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+FrameEncoder encoder(30);                     // Keyframe every 30 frames
+
+size_t size = encoder.encode(yuv, 160, 120, frame_id);
+client.write(encoder.data(), size);
+
+Serial.printf("ratio %.1fx, %.0f us/frame\n",
+              encoder.stats().ratio(), encoder.stats().usPerFrame());
+
+FrameDecoder decoder;                         // Receiving side
+if (decoder.decode(data, size)) {
+  const uint8_t* frame = decoder.data();      // Exact copy of yuv
+}
+*/
+
+#endif // FRAME_CODEC_H
\ No newline at end of file
@@ -1,27 +1,154 @@
 #include "cam_setup.h"
+#include "dual_core.h"
+#include "ws_channel.h"
+#include "frame_codec.h"
+#include "metrics.h"
+#include "pyramid_detector.h"
+#include "detection_gate.h"
+#include "nvs_storage.h"
 #include <WiFi.h>
 #include <WebServer.h>
+#include "esp_heap_caps.h"
 
 // ========================================
 // CONFIGURATION
 // ========================================
 #define SERIAL_BAUD 115200
-#define MAX_YUV_BUFFER_SIZE 38400  // 160x120x2 pixels for YUV422
+#define MAX_STREAM_CLIENTS 2       // Concurrent /yuv/stream viewers
+#define STREAM_BOUNDARY "yuvframe"
+#define STREAM_KEYFRAME_INTERVAL 30  // Default for /yuv/stream?codec=delta
+#define PREVIEW_MAX_COLORS 8       // Masks per /preview request
+#define FRAME_MEMORY_RESERVE (512 * 1024)  // PSRAM kept for everything not sized by the frame
 
 // ========================================
 // GLOBAL STATE
 // ========================================
 WebServer server(80);
 
-// YUV Image Buffer
+// YUV Image Buffer, double buffered: capture fills back without any lock,
+// then swaps it with front; readers only ever copy front. Both are sized
+// for the current resolution (applyResolution()).
 struct YUVImageBuffer {
-  uint8_t yuv_data[MAX_YUV_BUFFER_SIZE];
+  uint8_t* front;
+  uint8_t* back;
+  size_t capacity;
   int width;
   int height;
   bool data_ready;
   unsigned long last_update;
+  uint32_t frame_seq;
 } yuv_buffer = {0};
 
+// frame_mutex guards the swap and readers' copies of front;
+// capture_mutex is held from esp_camera_fb_get() until the frame is returned,
+// keeping the two writers (capture task, serial CAPTURE) apart and the
+// sensor idle while applyResolution() restarts it
+SemaphoreHandle_t frame_mutex = NULL;
+SemaphoreHandle_t capture_mutex = NULL;
+
+// Capture loop timing on core 0, reported by the serial STATUS command
+struct FrameTiming {
+  uint32_t count;
+  double mean_ms;
+  double m2;             // Sum of squared deviations (Welford)
+  float min_ms;
+  float max_ms;
+  unsigned long last_us;
+  
+  void reset() {
+    count = 0;
+    mean_ms = m2 = 0;
+    min_ms = 1e9f;
+    max_ms = 0;
+    last_us = 0;
+  }
+  
+  // Called once per stored frame
+  void tick(unsigned long now_us) {
+    if (last_us != 0) {
+      float ms = (now_us - last_us) / 1000.0f;
+      count++;
+      double d = ms - mean_ms;
+      mean_ms += d / count;
+      m2 += d * (ms - mean_ms);
+      if (ms < min_ms) min_ms = ms;
+      if (ms > max_ms) max_ms = ms;
+    }
+    last_us = now_us;
+  }
+  
+  float jitterMs() const {
+    return count > 1 ? sqrt(m2 / (count - 1)) : 0.0f;
+  }
+} frame_timing;
+volatile bool frame_timing_reset = true;
+
+// Frame buffers live in PSRAM when available
+uint8_t* allocFrame(size_t size) {
+  uint8_t* buffer = (uint8_t*)ps_malloc(size);
+  return buffer ? buffer : (uint8_t*)malloc(size);
+}
+
+// A consumer's private copy of the newest frame. Only the owning task
+// touches it, so it can follow resolution changes without further locking.
+struct FrameCopy {
+  uint8_t* data;
+  size_t capacity;
+  bool out_of_memory;    // The last fit() failed; copies stop until one succeeds
+  
+  // Exactly size bytes, reallocated when the frame size changed
+  bool fit(size_t size) {
+    if (data && capacity == size) return true;
+    free(data);
+    data = allocFrame(size);
+    capacity = data ? size : 0;
+    out_of_memory = data == nullptr;
+    return data != nullptr;
+  }
+};
+
+// HTTP handlers send from their own copy so capture never waits on Wi-Fi
+FrameCopy http_frame = {};
+FrameCopy stream_frame = {};
+
+// Coarse-to-fine detector for /preview?pyramid=N (HTTP task only)
+PyramidDetector preview_pyramid;
+
+// Reuses full-resolution /preview detections of regions that did not change
+// since the last request (HTTP task only)
+DetectionGate preview_gate;
+
+// /preview blob results, reused across requests (HTTP task only)
+DetectionResults preview_results;
+
+// /preview without set: the whole frame as a one-region compiled set, kept
+// so the gate's cache survives between requests (HTTP task only)
+std::shared_ptr<const CompiledRegionSet> preview_full_frame;
+
+// /yuv/stream connections handed from the web server to the stream task
+struct StreamRequest {
+  WiFiClient* client;
+  bool delta;               // Keyframe + delta coded (frame_codec.h) instead of raw
+  int keyframe_interval;
+};
+QueueHandle_t stream_queue = NULL;
+TaskHandle_t stream_task = NULL;
+
+// One encoder per viewer slot; each keeps the reference its viewer decodes against
+FrameEncoder stream_encoders[MAX_STREAM_CLIENTS];
+
+// WebSocket push channel (port 81) for frames, masks and blobs
+WsChannel ws_channel;
+FrameCopy ws_frame = {};
+TaskHandle_t ws_task = NULL;
+
+// Web server (port 80) runs in its own task
+TaskHandle_t http_task = NULL;
+
+// Colors and region sets kept in NVS across reboots (POST /config)
+NvsStorage config_storage;
+ConfigStore config_store(&config_storage);
+
 // Wi-Fi Configuration - UPDATE THESE
 const char* ssid = "YOUR_WIFI_SSID";
 const char* password = "YOUR_WIFI_PASSWORD";
@@ -29,34 +156,334 @@ const char* password = "YOUR_WIFI_PASSWORD";
 // ========================================
 // CAMERA FUNCTIONS
 // ========================================
+// Copy a camera frame into yuv_buffer. The caller holds capture_mutex and
+// returns fb. Readers are only held off for the pointer swap, never for the copy.
+bool storeFrame(camera_fb_t* fb) {
+  if (fb->len > yuv_buffer.capacity) {
+    return false;
+  }
+  
+  int width, height;
+  getImageDimensions(&width, &height);
+  
+  memcpy(yuv_buffer.back, fb->buf, fb->len);
+  
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  uint8_t* filled = yuv_buffer.back;
+  yuv_buffer.back = yuv_buffer.front;
+  yuv_buffer.front = filled;
+  yuv_buffer.width = width;
+  yuv_buffer.height = height;
+  yuv_buffer.data_ready = true;
+  yuv_buffer.last_update = millis();
+  yuv_buffer.frame_seq++;
+  xSemaphoreGive(frame_mutex);
+  return true;
+}
+
+// Copy the newest frame if it is not *seq yet; returns its size or 0.
+// dest is resized first when the resolution changed since its last copy;
+// when that fails, dest.out_of_memory tells it apart from "no new frame".
+size_t copyLatestFrame(FrameCopy& dest, uint32_t* seq, int* width, int* height) {
+  size_t size = 0;
+  
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  if (yuv_buffer.data_ready && yuv_buffer.frame_seq != *seq) {
+    if (dest.fit(yuv_buffer.width * yuv_buffer.height * 2)) {
+      size = dest.capacity;
+      memcpy(dest.data, yuv_buffer.front, size);
+      *seq = yuv_buffer.frame_seq;
+      *width = yuv_buffer.width;
+      *height = yuv_buffer.height;
+    } else {
+      getMetrics().frames_copy_failed.add();
+    }
+  }
+  xSemaphoreGive(frame_mutex);
+  return size;
+}
+
+// Log when a task's frame copy starts or stops failing to allocate, so a
+// stalled stream or WebSocket channel says why (once, not every frame)
+void reportCopyMemory(const char* task, const FrameCopy& copy, bool* reported) {
+  if (copy.out_of_memory == *reported) return;
+  *reported = copy.out_of_memory;
+  if (copy.out_of_memory) {
+    Serial.printf("%s: no memory for a %dx%d frame copy, waiting\n", task, yuv_buffer.width, yuv_buffer.height);
+  } else {
+    Serial.printf("%s: frame copy allocated again\n", task);
+  }
+}
+
 bool captureYUVImage() {
   Serial.println("Capturing YUV image...");
   
+  xSemaphoreTake(capture_mutex, portMAX_DELAY);
   camera_fb_t* fb = captureImage();
   if (!fb) {
+    xSemaphoreGive(capture_mutex);
     Serial.println("Failed to capture image");
     return false;
   }
   
-  // Get image dimensions
-  getImageDimensions(&yuv_buffer.width, &yuv_buffer.height);
+  size_t len = fb->len;
+  bool stored = storeFrame(fb);
+  esp_camera_fb_return(fb);
+  xSemaphoreGive(capture_mutex);
   
-  if (fb->len > MAX_YUV_BUFFER_SIZE) {
-    Serial.printf("Image too large: %d bytes (max: %d)\n", fb->len, MAX_YUV_BUFFER_SIZE);
-    esp_camera_fb_return(fb);
+  if (!stored) {
+    Serial.printf("Image too large: %d bytes (max: %d)\n", (int)len, (int)yuv_buffer.capacity);
     return false;
   }
   
-  // Copy YUV data to buffer
-  memcpy(yuv_buffer.yuv_data, fb->buf, fb->len);
-  yuv_buffer.data_ready = true;
-  yuv_buffer.last_update = millis();
-  
   Serial.printf("YUV capture complete: %dx%d, %d bytes\n", 
-                yuv_buffer.width, yuv_buffer.height, fb->len);
+                yuv_buffer.width, yuv_buffer.height, (int)len);
+  return true;
+}
+
+// PSRAM everything sized by the frame needs at its peak, with every task
+// busy at once: the driver's frame buffer, the capture pair, the HTTP,
+// stream and WebSocket copies, each viewer's delta reference and output,
+// the HSV planes of the WebSocket and HTTP tasks, and the mask, labels and
+// union-find of a detection running in each of those two tasks.
+size_t frameMemoryBytes(int width, int height) {
+  size_t pixels = size_t(width) * height;
+  size_t frame = pixels * 2;               // YUV422
+  return frame * (1 + 2 + 3) +
+         frame * 2 * MAX_STREAM_CLIENTS +
+         pixels * 3 * 2 +
+         pixels * 4 * 2;
+}
+
+// Whether a frame size fits next to FRAME_MEMORY_RESERVE. With 4 MB of PSRAM
+// this stops at QVGA; CIF and VGA need a module with more.
+bool resolutionFits(const CameraResolution& resolution) {
+  return frameMemoryBytes(resolution.width, resolution.height) + FRAME_MEMORY_RESERVE <=
+         ESP.getPsramSize();
+}
+
+// Restart the sensor at another frame size and resize the capture buffers.
+// Consumers' FrameCopy buffers and the stream encoders follow on their next
+// frame; HSV workspaces are sized per frame already. Sizes that do not pass
+// resolutionFits() are refused before the sensor is touched.
+bool applyResolution(const CameraResolution& resolution) {
+  if (!resolutionFits(resolution)) return false;
+  
+  xSemaphoreTake(capture_mutex, portMAX_DELAY);
+  xSemaphoreTake(frame_mutex, portMAX_DELAY);
+  
+  const CameraResolution& previous = getResolution();
+  bool ok = reinitCamera(resolution);
+  
+  // Free first so growing never needs the old and the new pair at once
+  free(yuv_buffer.front);
+  free(yuv_buffer.back);
+  const CameraResolution& current = getResolution();
+  size_t size = current.width * current.height * 2;
+  yuv_buffer.front = allocFrame(size);
+  yuv_buffer.back = allocFrame(size);
+  if (ok && (!yuv_buffer.front || !yuv_buffer.back)) {
+    free(yuv_buffer.front);
+    free(yuv_buffer.back);
+    reinitCamera(previous);
+    size = previous.width * previous.height * 2;
+    yuv_buffer.front = allocFrame(size);
+    yuv_buffer.back = allocFrame(size);
+    ok = false;
+  }
+  yuv_buffer.capacity = (yuv_buffer.front && yuv_buffer.back) ? size : 0;
+  yuv_buffer.data_ready = false;
+  frame_timing_reset = true;
+  
+  xSemaphoreGive(frame_mutex);
+  xSemaphoreGive(capture_mutex);
+  return ok;
+}
+
+// ========================================
+// CAPTURE PIPELINE (CORE 0)
+// ========================================
+// Keeps yuv_buffer filled with the newest frame; HTTP only reads it
+void loop2() {
+  PipelineMetrics& metrics = getMetrics();
+  xSemaphoreTake(capture_mutex, portMAX_DELAY);
+  unsigned long start = micros();
+  camera_fb_t* fb = captureImage();
+  metrics.observeStage(STAGE_CAPTURE, start);
+  if (!fb) {
+    xSemaphoreGive(capture_mutex);
+    metrics.frames_capture_failed.add();
+    return;
+  }
   
+  start = micros();
+  if (storeFrame(fb)) {
+    unsigned long now = micros();
+    metrics.stage_latency[STAGE_STORE].observe(now - start);
+    metrics.frames_captured.add();
+    
+    if (frame_timing_reset) {
+      frame_timing.reset();
+      frame_timing_reset = false;
+    }
+    if (frame_timing.last_us != 0 && now != frame_timing.last_us) {
+      float fps = 1e6f / (now - frame_timing.last_us);
+      float smoothed = metrics.fps.get();
+      metrics.fps.set(smoothed == 0 ? fps : smoothed + (fps - smoothed) * 0.1f);
+    }
+    frame_timing.tick(now);
+  } else {
+    metrics.frames_too_large.add();
+  }
   esp_camera_fb_return(fb);
-  return true;
+  xSemaphoreGive(capture_mutex);
+}
+
+// ========================================
+// HTTP SERVER TASK
+// ========================================
+// handleClient() runs here rather than in loop(): handlers only copy the
+// newest frame (or hand the connection to the stream task), so a slow
+// browser delays other HTTP requests but never capture, serial commands,
+// streaming or the WebSocket channel.
+void httpTask(void* parameter) {
+  for (;;) {
+    server.handleClient();
+    vTaskDelay(1);
+  }
+}
+
+// ========================================
+// FRAME STREAMING
+// ========================================
+// Pushes every new frame to all /yuv/stream viewers as one multipart part.
+// Runs in its own task so slow viewers never block handleClient().
+void streamTask(void* parameter) {
+  StreamRequest viewers[MAX_STREAM_CLIENTS] = {};
+  uint32_t last_seq = 0;
+  bool streaming = false;   // last_seq is a frame viewers got, gaps are drops
+  bool out_of_memory = false;
+  
+  for (;;) {
+    // Adopt connections accepted by handleYUVStream()
+    StreamRequest incoming;
+    while (xQueueReceive(stream_queue, &incoming, 0) == pdTRUE) {
+      int slot = -1;
+      for (int i = 0; i < MAX_STREAM_CLIENTS && slot < 0; i++) {
+        if (!viewers[i].client) slot = i;
+      }
+      if (slot < 0) {
+        incoming.client->stop();
+        delete incoming.client;
+        continue;
+      }
+      viewers[slot] = incoming;
+      if (incoming.delta) {
+        stream_encoders[slot].setKeyframeInterval(incoming.keyframe_interval);
+        stream_encoders[slot].requestKeyframe();
+        stream_encoders[slot].resetStats();
+      }
+    }
+    
+    int active = 0;
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+      if (viewers[i].client) active++;
+    }
+    if (active == 0) {
+      streaming = false;
+      vTaskDelay(pdMS_TO_TICKS(20));
+      continue;
+    }
+    
+    int width, height;
+    uint32_t prev_seq = last_seq;
+    size_t size = copyLatestFrame(stream_frame, &last_seq, &width, &height);
+    reportCopyMemory("Stream", stream_frame, &out_of_memory);
+    if (size == 0) {
+      vTaskDelay(pdMS_TO_TICKS(out_of_memory ? 100 : 2));
+      continue;
+    }
+    if (streaming && last_seq - prev_seq > 1) {
+      getMetrics().frames_skipped_stream.add(last_seq - prev_seq - 1);
+    }
+    streaming = true;
+    
+    for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+      WiFiClient* viewer = viewers[i].client;
+      if (!viewer) continue;
+      
+      const uint8_t* body = stream_frame.data;
+      size_t body_size = size;
+      if (viewers[i].delta) {
+        unsigned long start = micros();
+        body_size = stream_encoders[i].encode(stream_frame.data, width, height, last_seq);
+        body = stream_encoders[i].data();
+        getMetrics().observeStage(STAGE_STREAM_ENCODE, start);
+      }
+      
+      char header[192];
+      int len = snprintf(header, sizeof(header),
+                         "--" STREAM_BOUNDARY "\r\n"
+                         "Content-Type: application/octet-stream\r\n"
+                         "Content-Length: %u\r\n"
+                         "X-Frame: %u\r\n"
+                         "X-Size: %dx%d\r\n"
+                         "X-Encoding: %s\r\n\r\n",
+                         (unsigned)body_size, (unsigned)last_seq, width, height,
+                         viewers[i].delta ? "delta" : "raw");
+      
+      unsigned long start = micros();
+      bool ok = body_size > 0 && viewer->connected() &&
+                viewer->write((const uint8_t*)header, len) == (size_t)len &&
+                viewer->write(body, body_size) == body_size &&
+                viewer->write((const uint8_t*)"\r\n", 2) == 2;
+      getMetrics().observeStage(STAGE_STREAM_SEND, start);
+      if (!ok) {
+        viewer->stop();
+        delete viewer;
+        viewers[i].client = nullptr;
+      }
+    }
+  }
+}
+
+// ========================================
+// WEBSOCKET PUSH
+// ========================================
+// Converts each new frame once and pushes what every WebSocket viewer asked
+// for. A threshold change republishes masks and blobs of the current frame
+// right away, so a slider move shows up without waiting for a new capture.
+void wsTask(void* parameter) {
+  uint32_t last_seq = 0;
+  HSVImage hsv;
+  bool out_of_memory = false;
+  
+  for (;;) {
+    bool changed = ws_channel.poll();
+    if (!ws_channel.hasClients()) {
+      vTaskDelay(pdMS_TO_TICKS(20));
+      continue;
+    }
+    
+    int width, height;
+    bool fresh = copyLatestFrame(ws_frame, &last_seq, &width, &height) > 0;
+    reportCopyMemory("WebSocket", ws_frame, &out_of_memory);
+    if (fresh) {
+      unsigned long start = micros();
+      hsv.clear();
+      fresh = yuv422ToHSV(ws_frame.data, width, height, hsv);
+      getMetrics().observeStage(STAGE_CONVERT, start);
+    }
+    if (!fresh && !(changed && hsv.isValid())) {
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+    
+    ConfigPin pin;   // Every mask and blob of this publish from the same thresholds
+    unsigned long start = micros();
+    ws_channel.publish(last_seq, fresh ? ws_frame.data : nullptr, hsv);
+    getMetrics().observeStage(STAGE_PUBLISH, start);
+  }
 }
 
 // ========================================
@@ -222,6 +649,32 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
         <div class="controls">
             <button onclick="captureImage()">Capture</button>
             <button onclick="toggleAuto()" id="autoBtn">Auto: OFF</button>
+            <select id="streamCodec" title="Auto mode transfer encoding">
+                <option value="raw">Raw frames</option>
+                <option value="delta">Delta frames</option>
+            </select>
+            <input type="number" id="keyInterval" value="30" min="0" max="600" title="Frames between keyframes (0 = first only)" style="width: 50px">
+            <button onclick="toggleLive()" id="liveBtn">Live: OFF</button>
+            <select id="resolution" onchange="changeResolution()" title="Sensor frame size">
+                <option>QQVGA</option>
+                <option>QCIF</option>
+                <option>HQVGA</option>
+                <option>QVGA</option>
+                <option>CIF</option>
+                <option>VGA</option>
+            </select>
+            <select id="tuneColor" onchange="colorChanged()">
+                <option>RED</option>
+                <option>GREEN</option>
+                <option>BLACK</option>
+                <option>WHITE</option>
+            </select>
+            <input type="text" id="previewSet" placeholder="Region set (device)" onchange="requestPreview()">
+            <select id="detectMode" onchange="requestPreview()" title="Blob search for the device preview">
+                <option value="0">Full resolution</option>
+                <option value="2">Pyramid 2x</option>
+                <option value="4">Pyramid 4x</option>
+            </select>
             <button onclick="resetFilters()">Reset Filters</button>
             <button onclick="addRegion()">Add Region</button>
             <button onclick="clearRegions()">Clear Regions</button>
@@ -233,19 +686,14 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 <canvas id="yuvCanvas" width="160" height="120"></canvas>
             </div>
             
-            <div class="display-panel">
-                <h3>HSV Conversion</h3>
-                <canvas id="hsvCanvas" width="160" height="120"></canvas>
-            </div>
-            
             <div class="display-panel">
                 <h3>Filtered YUV</h3>
                 <canvas id="filteredYuvCanvas" width="160" height="120"></canvas>
             </div>
             
             <div class="display-panel">
-                <h3>Filtered HSV</h3>
-                <canvas id="filteredHsvCanvas" width="160" height="120"></canvas>
+                <h3>Device Mask</h3>
+                <canvas id="maskCanvas" width="160" height="120"></canvas>
             </div>
             
             <div class="display-panel">
@@ -293,32 +741,32 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 <h4>HSV Thresholds</h4>
                 <div class="slider-row">
                     <label>H Min:</label>
-                    <input type="range" id="hMin" min="0" max="179" value="0" oninput="updateFilters()">
+                    <input type="range" id="hMin" min="0" max="179" value="0" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="hMinVal">0</span>
                 </div>
                 <div class="slider-row">
                     <label>H Max:</label>
-                    <input type="range" id="hMax" min="0" max="179" value="179" oninput="updateFilters()">
+                    <input type="range" id="hMax" min="0" max="179" value="179" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="hMaxVal">179</span>
                 </div>
                 <div class="slider-row">
                     <label>S Min:</label>
-                    <input type="range" id="sMin" min="0" max="255" value="0" oninput="updateFilters()">
+                    <input type="range" id="sMin" min="0" max="255" value="0" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="sMinVal">0</span>
                 </div>
                 <div class="slider-row">
                     <label>S Max:</label>
-                    <input type="range" id="sMax" min="0" max="255" value="255" oninput="updateFilters()">
+                    <input type="range" id="sMax" min="0" max="255" value="255" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="sMaxVal">255</span>
                 </div>
                 <div class="slider-row">
                     <label>V Min:</label>
-                    <input type="range" id="vHsvMin" min="0" max="255" value="0" oninput="updateFilters()">
+                    <input type="range" id="vHsvMin" min="0" max="255" value="0" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="vHsvMinVal">0</span>
                 </div>
                 <div class="slider-row">
                     <label>V Max:</label>
-                    <input type="range" id="vHsvMax" min="0" max="255" value="255" oninput="updateFilters()">
+                    <input type="range" id="vHsvMax" min="0" max="255" value="255" oninput="updateFilters(); sendThresholds()">
                     <span class="value" id="vHsvMaxVal">255</span>
                 </div>
             </div>
@@ -339,25 +787,31 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
     <script>
         // Canvas elements
         const yuvCanvas = document.getElementById('yuvCanvas');
-        const hsvCanvas = document.getElementById('hsvCanvas');
         const filteredYuvCanvas = document.getElementById('filteredYuvCanvas');
-        const filteredHsvCanvas = document.getElementById('filteredHsvCanvas');
+        const maskCanvas = document.getElementById('maskCanvas');
         const regionsCanvas = document.getElementById('regionsCanvas');
         
         const yuvCtx = yuvCanvas.getContext('2d');
-        const hsvCtx = hsvCanvas.getContext('2d');
         const filteredYuvCtx = filteredYuvCanvas.getContext('2d');
-        const filteredHsvCtx = filteredHsvCanvas.getContext('2d');
+        const maskCtx = maskCanvas.getContext('2d');
         const regionsCtx = regionsCanvas.getContext('2d');
         
         const status = document.getElementById('status');
         const autoBtn = document.getElementById('autoBtn');
+        const liveBtn = document.getElementById('liveBtn');
         
         let autoMode = false;
-        let autoInterval = null;
+        let streamAbort = null;
+        let liveSocket = null;
+        let deviceBlobs = [];
+        let deviceRegions = [];
+        let previewInFlight = false;
+        let thresholdsInFlight = false;
+        let thresholdsPending = false;
         let currentYuvData = null;
-        let currentHsvData = null;
         let regions = [];
+        let frameWidth = 160;
+        let frameHeight = 120;
         
         function updateStatus(msg) {
             status.textContent = msg;
@@ -380,317 +834,8 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             ];
         }
         
-        // Fast RGB to HSV conversion (matches simple_converter.h exactly)
-        function rgbToHsv(r, g, b) {
-            const minVal = Math.min(r, g, b);
-            const maxVal = Math.max(r, g, b);
-            const delta = maxVal - minVal;
-            
-            const v = maxVal;
-            const s = maxVal === 0 ? 0 : Math.floor((delta * 255) / maxVal);
-            
-            let h = 0;
-            if (delta !== 0) {
-                if (maxVal === r) {
-                    h = Math.floor((60 * (g - b)) / delta);
-                } else if (maxVal === g) {
-                    h = Math.floor(120 + (60 * (b - r)) / delta);
-                } else {
-                    h = Math.floor(240 + (60 * (r - g)) / delta);
-                }
-                if (h < 0) h += 360;
-            }
-            
-            return [Math.floor(h / 2), s, v]; // H scaled to 0-179
-        }
-        
-        // HSV to RGB for display
-        function hsvToRgb(h, s, v) {
-            h *= 2; // Scale back to 0-360
-            const sNorm = s / 255;
-            const vNorm = v / 255;
-            
-            const c = vNorm * sNorm;
-            const x = c * (1 - Math.abs(((h / 60) % 2) - 1));
-            const m = vNorm - c;
-            
-            let r, g, b;
-            if (h < 60) {
-                [r, g, b] = [c, x, 0];
-            } else if (h < 120) {
-                [r, g, b] = [x, c, 0];
-            } else if (h < 180) {
-                [r, g, b] = [0, c, x];
-            } else if (h < 240) {
-                [r, g, b] = [0, x, c];
-            } else if (h < 300) {
-                [r, g, b] = [x, 0, c];
-            } else {
-                [r, g, b] = [c, 0, x];
-            }
-            
-            return [
-                Math.round((r + m) * 255),
-                Math.round((g + m) * 255),
-                Math.round((b + m) * 255)
-            ];
-        }
-        
-        // Direct YUV422 to HSV conversion (matches simple_converter.h approach)
-        function yuv422ToHsv(yuvData) {
-            const pixels = 160 * 120;
-            const hsvData = {
-                h: new Uint8Array(pixels),
-                s: new Uint8Array(pixels),
-                v: new Uint8Array(pixels)
-            };
-            
-            let pixelIndex = 0;
-            for (let i = 0; i < yuvData.length; i += 4) {
-                const y0 = yuvData[i];
-                const u = yuvData[i + 1];
-                const y1 = yuvData[i + 2];
-                const v = yuvData[i + 3];
-                
-                // First pixel - direct YUV to HSV
-                {
-                    const c = Math.max(0, y0 - 16);
-                    const d = u - 128;
-                    const e = v - 128;
-                    
-                    let r = (298 * c + 409 * e + 128) >> 8;
-                    let g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-                    let b = (298 * c + 516 * d + 128) >> 8;
-                    
-                    r = Math.max(0, Math.min(255, r));
-                    g = Math.max(0, Math.min(255, g));
-                    b = Math.max(0, Math.min(255, b));
-                    
-                    const minVal = Math.min(r, g, b);
-                    const maxVal = Math.max(r, g, b);
-                    const delta = maxVal - minVal;
-                    
-                    hsvData.v[pixelIndex] = maxVal;
-                    
-                    if (maxVal === 0) {
-                        hsvData.h[pixelIndex] = 0;
-                        hsvData.s[pixelIndex] = 0;
-                    } else {
-                        hsvData.s[pixelIndex] = Math.floor((delta * 255) / maxVal);
-                        
-                        if (delta === 0) {
-                            hsvData.h[pixelIndex] = 0;
-                        } else {
-                            let h;
-                            if (maxVal === r) h = Math.floor((60 * (g - b)) / delta);
-                            else if (maxVal === g) h = Math.floor(120 + (60 * (b - r)) / delta);
-                            else h = Math.floor(240 + (60 * (r - g)) / delta);
-                            
-                            if (h < 0) h += 360;
-                            hsvData.h[pixelIndex] = Math.floor(h / 2);
-                        }
-                    }
-                    pixelIndex++;
-                }
-                
-                // Second pixel
-                if (pixelIndex < pixels) {
-                    const c = Math.max(0, y1 - 16);
-                    const d = u - 128;
-                    const e = v - 128;
-                    
-                    let r = (298 * c + 409 * e + 128) >> 8;
-                    let g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-                    let b = (298 * c + 516 * d + 128) >> 8;
-                    
-                    r = Math.max(0, Math.min(255, r));
-                    g = Math.max(0, Math.min(255, g));
-                    b = Math.max(0, Math.min(255, b));
-                    
-                    const minVal = Math.min(r, g, b);
-                    const maxVal = Math.max(r, g, b);
-                    const delta = maxVal - minVal;
-                    
-                    hsvData.v[pixelIndex] = maxVal;
-                    
-                    if (maxVal === 0) {
-                        hsvData.h[pixelIndex] = 0;
-                        hsvData.s[pixelIndex] = 0;
-                    } else {
-                        hsvData.s[pixelIndex] = Math.floor((delta * 255) / maxVal);
-                        
-                        if (delta === 0) {
-                            hsvData.h[pixelIndex] = 0;
-                        } else {
-                            let h;
-                            if (maxVal === r) h = Math.floor((60 * (g - b)) / delta);
-                            else if (maxVal === g) h = Math.floor(120 + (60 * (b - r)) / delta);
-                            else h = Math.floor(240 + (60 * (r - g)) / delta);
-                            
-                            if (h < 0) h += 360;
-                            hsvData.h[pixelIndex] = Math.floor(h / 2);
-                        }
-                    }
-                    pixelIndex++;
-                }
-            }
-            
-            return hsvData;
-        }
-        
-        // Get filter thresholds
-        function getFilterThresholds() {
-            return {
-                yuv: {
-                    yMin: parseInt(document.getElementById('yMin').value),
-                    yMax: parseInt(document.getElementById('yMax').value),
-                    uMin: parseInt(document.getElementById('uMin').value),
-                    uMax: parseInt(document.getElementById('uMax').value),
-                    vMin: parseInt(document.getElementById('vMin').value),
-                    vMax: parseInt(document.getElementById('vMax').value)
-                },
-                hsv: {
-                    hMin: parseInt(document.getElementById('hMin').value),
-                    hMax: parseInt(document.getElementById('hMax').value),
-                    sMin: parseInt(document.getElementById('sMin').value),
-                    sMax: parseInt(document.getElementById('sMax').value),
-                    vMin: parseInt(document.getElementById('vHsvMin').value),
-                    vMax: parseInt(document.getElementById('vHsvMax').value)
-                }
-            };
-        }
-        
-        // Update filter displays
-        function updateFilters() {
-            // Update all slider value displays
-            const sliders = ['yMin', 'yMax', 'uMin', 'uMax', 'vMin', 'vMax', 
-                           'hMin', 'hMax', 'sMin', 'sMax', 'vHsvMin', 'vHsvMax'];
-            sliders.forEach(id => {
-                document.getElementById(id + 'Val').textContent = document.getElementById(id).value;
-            });
-            
-            if (currentYuvData && currentHsvData) {
-                displayFilteredImages();
-            }
-        }
-        
-        // Display filtered images
-        function displayFilteredImages() {
-            const thresholds = getFilterThresholds();
-            const pixels = 160 * 120;
-            
-            const filteredYuvImageData = filteredYuvCtx.createImageData(160, 120);
-            const filteredHsvImageData = filteredHsvCtx.createImageData(160, 120);
-            
-            let pixelIndex = 0;
-            for (let i = 0; i < currentYuvData.length; i += 4) {
-                const y0 = currentYuvData[i];
-                const u = currentYuvData[i + 1];
-                const y1 = currentYuvData[i + 2];
-                const v = currentYuvData[i + 3];
-                
-                // First pixel
-                {
-                    const h = currentHsvData.h[pixelIndex];
-                    const s = currentHsvData.s[pixelIndex];
-                    const hsvV = currentHsvData.v[pixelIndex];
-                    
-                    const yuvMatch = (y0 >= thresholds.yuv.yMin && y0 <= thresholds.yuv.yMax &&
-                                    u >= thresholds.yuv.uMin && u <= thresholds.yuv.uMax &&
-                                    v >= thresholds.yuv.vMin && v <= thresholds.yuv.vMax);
-                    
-                    const hsvMatch = (h >= thresholds.hsv.hMin && h <= thresholds.hsv.hMax &&
-                                    s >= thresholds.hsv.sMin && s <= thresholds.hsv.sMax &&
-                                    hsvV >= thresholds.hsv.vMin && hsvV <= thresholds.hsv.vMax);
-                    
-                    const [r, g, b] = yuvToRgb(y0, u, v);
-                    const [hsvR, hsvG, hsvB] = hsvToRgb(h, s, hsvV);
-                    
-                    // YUV filter visualization
-                    const yuvIdx = pixelIndex * 4;
-                    if (yuvMatch) {
-                        filteredYuvImageData.data[yuvIdx] = r;
-                        filteredYuvImageData.data[yuvIdx + 1] = g;
-                        filteredYuvImageData.data[yuvIdx + 2] = b;
-                        filteredYuvImageData.data[yuvIdx + 3] = 255;
-                    } else {
-                        filteredYuvImageData.data[yuvIdx] = r >> 2;
-                        filteredYuvImageData.data[yuvIdx + 1] = g >> 2;
-                        filteredYuvImageData.data[yuvIdx + 2] = b >> 2;
-                        filteredYuvImageData.data[yuvIdx + 3] = 64;
-                    }
-                    
-                    // HSV filter visualization
-                    if (hsvMatch) {
-                        filteredHsvImageData.data[yuvIdx] = hsvR;
-                        filteredHsvImageData.data[yuvIdx + 1] = hsvG;
-                        filteredHsvImageData.data[yuvIdx + 2] = hsvB;
-                        filteredHsvImageData.data[yuvIdx + 3] = 255;
-                    } else {
-                        filteredHsvImageData.data[yuvIdx] = hsvR >> 2;
-                        filteredHsvImageData.data[yuvIdx + 1] = hsvG >> 2;
-                        filteredHsvImageData.data[yuvIdx + 2] = hsvB >> 2;
-                        filteredHsvImageData.data[yuvIdx + 3] = 64;
-                    }
-                    
-                    pixelIndex++;
-                }
-                
-                // Second pixel
-                if (pixelIndex < pixels) {
-                    const h = currentHsvData.h[pixelIndex];
-                    const s = currentHsvData.s[pixelIndex];
-                    const hsvV = currentHsvData.v[pixelIndex];
-                    
-                    const yuvMatch = (y1 >= thresholds.yuv.yMin && y1 <= thresholds.yuv.yMax &&
-                                    u >= thresholds.yuv.uMin && u <= thresholds.yuv.uMax &&
-                                    v >= thresholds.yuv.vMin && v <= thresholds.yuv.vMax);
-                    
-                    const hsvMatch = (h >= thresholds.hsv.hMin && h <= thresholds.hsv.hMax &&
-                                    s >= thresholds.hsv.sMin && s <= thresholds.hsv.sMax &&
-                                    hsvV >= thresholds.hsv.vMin && hsvV <= thresholds.hsv.vMax);
-                    
-                    const [r, g, b] = yuvToRgb(y1, u, v);
-                    const [hsvR, hsvG, hsvB] = hsvToRgb(h, s, hsvV);
-                    
-                    const yuvIdx = pixelIndex * 4;
-                    if (yuvMatch) {
-                        filteredYuvImageData.data[yuvIdx] = r;
-                        filteredYuvImageData.data[yuvIdx + 1] = g;
-                        filteredYuvImageData.data[yuvIdx + 2] = b;
-                        filteredYuvImageData.data[yuvIdx + 3] = 255;
-                    } else {
-                        filteredYuvImageData.data[yuvIdx] = r >> 2;
-                        filteredYuvImageData.data[yuvIdx + 1] = g >> 2;
-                        filteredYuvImageData.data[yuvIdx + 2] = b >> 2;
-                        filteredYuvImageData.data[yuvIdx + 3] = 64;
-                    }
-                    
-                    if (hsvMatch) {
-                        filteredHsvImageData.data[yuvIdx] = hsvR;
-                        filteredHsvImageData.data[yuvIdx + 1] = hsvG;
-                        filteredHsvImageData.data[yuvIdx + 2] = hsvB;
-                        filteredHsvImageData.data[yuvIdx + 3] = 255;
-                    } else {
-                        filteredHsvImageData.data[yuvIdx] = hsvR >> 2;
-                        filteredHsvImageData.data[yuvIdx + 1] = hsvG >> 2;
-                        filteredHsvImageData.data[yuvIdx + 2] = hsvB >> 2;
-                        filteredHsvImageData.data[yuvIdx + 3] = 64;
-                    }
-                    
-                    pixelIndex++;
-                }
-            }
-            
-            filteredYuvCtx.putImageData(filteredYuvImageData, 0, 0);
-            filteredHsvCtx.putImageData(filteredHsvImageData, 0, 0);
-        }
-        // Generate random YUV422 data for testing (160x120)
-        
         // Convert YUV422 to separate YUV channels (matches simple_converter.h exactly)
-        function yuv422ToYUV(yuv422Data) {
-            const width = 160;
-            const height = 120;
+        function yuv422ToYUV(yuv422Data, width, height) {
             const pixels = width * height;
             
             const yData = new Uint8Array(pixels);
@@ -719,115 +864,11 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             return { y: yData, u: uData, v: vData, width, height };
         }
         
-        // Direct YUV422 to HSV conversion (matches simple_converter.h exactly)
-        function yuv422ToHSV(yuv422Data) {
-            const width = 160;
-            const height = 120;
-            const pixels = width * height;
-            
-            const hData = new Uint8Array(pixels);
-            const sData = new Uint8Array(pixels);
-            const vData = new Uint8Array(pixels);
-            
-            for (let i = 0; i < pixels; i += 2) {
-                const yuvIdx = i * 2;
-                
-                const y0 = yuv422Data[yuvIdx];
-                const u = yuv422Data[yuvIdx + 1];
-                const y1 = yuv422Data[yuvIdx + 2];
-                const v = yuv422Data[yuvIdx + 3];
-                
-                // Process first pixel
-                {
-                    let c = y0 - 16;
-                    if (c < 0) c = 0;
-                    const d = u - 128;
-                    const e = v - 128;
-                    
-                    let r = (298 * c + 409 * e + 128) >> 8;
-                    let g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-                    let b = (298 * c + 516 * d + 128) >> 8;
-                    
-                    if (r < 0) r = 0; else if (r > 255) r = 255;
-                    if (g < 0) g = 0; else if (g > 255) g = 255;
-                    if (b < 0) b = 0; else if (b > 255) b = 255;
-                    
-                    const minVal = Math.min(r, g, b);
-                    const maxVal = Math.max(r, g, b);
-                    const delta = maxVal - minVal;
-                    
-                    vData[i] = maxVal;
-                    
-                    if (maxVal === 0) {
-                        hData[i] = 0;
-                        sData[i] = 0;
-                    } else {
-                        sData[i] = Math.floor((delta * 255) / maxVal);
-                        
-                        if (delta === 0) {
-                            hData[i] = 0;
-                        } else {
-                            let hue;
-                            if (maxVal === r) hue = Math.floor((60 * (g - b)) / delta);
-                            else if (maxVal === g) hue = 120 + Math.floor((60 * (b - r)) / delta);
-                            else hue = 240 + Math.floor((60 * (r - g)) / delta);
-                            
-                            if (hue < 0) hue += 360;
-                            hData[i] = Math.floor(hue / 2);
-                        }
-                    }
-                }
-                
-                // Process second pixel
-                if (i + 1 < pixels) {
-                    let c = y1 - 16;
-                    if (c < 0) c = 0;
-                    const d = u - 128;
-                    const e = v - 128;
-                    
-                    let r = (298 * c + 409 * e + 128) >> 8;
-                    let g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-                    let b = (298 * c + 516 * d + 128) >> 8;
-                    
-                    if (r < 0) r = 0; else if (r > 255) r = 255;
-                    if (g < 0) g = 0; else if (g > 255) g = 255;
-                    if (b < 0) b = 0; else if (b > 255) b = 255;
-                    
-                    const minVal = Math.min(r, g, b);
-                    const maxVal = Math.max(r, g, b);
-                    const delta = maxVal - minVal;
-                    
-                    vData[i + 1] = maxVal;
-                    
-                    if (maxVal === 0) {
-                        hData[i + 1] = 0;
-                        sData[i + 1] = 0;
-                    } else {
-                        sData[i + 1] = Math.floor((delta * 255) / maxVal);
-                        
-                        if (delta === 0) {
-                            hData[i + 1] = 0;
-                        } else {
-                            let hue;
-                            if (maxVal === r) hue = Math.floor((60 * (g - b)) / delta);
-                            else if (maxVal === g) hue = 120 + Math.floor((60 * (b - r)) / delta);
-                            else hue = 240 + Math.floor((60 * (r - g)) / delta);
-                            
-                            if (hue < 0) hue += 360;
-                            hData[i + 1] = Math.floor(hue / 2);
-                        }
-                    }
-                }
-            }
-            
-            return { h: hData, s: sData, v: vData, width, height };
-        }
-
         // Display YUV image as RGB
         function displayYUVImage(yuvData, canvas, ctx) {
-            const imageData = ctx.createImageData(160, 120);
+            const imageData = ctx.createImageData(yuvData.width, yuvData.height);
             
-            for (let i = 0; i < 160 * 120; i++) {
+            for (let i = 0; i < yuvData.width * yuvData.height; i++) {
                 const [r, g, b] = yuvToRgb(yuvData.y[i], yuvData.u[i], yuvData.v[i]);
                 
                 const idx = i * 4;
@@ -840,23 +881,6 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             ctx.putImageData(imageData, 0, 0);
         }
         
-        // Display HSV image as RGB
-        function displayHSVImage(hsvData, canvas, ctx) {
-            const imageData = ctx.createImageData(160, 120);
-            
-            for (let i = 0; i < 160 * 120; i++) {
-                const [r, g, b] = hsvToRgb(hsvData.h[i], hsvData.s[i], hsvData.v[i]);
-                
-                const idx = i * 4;
-                imageData.data[idx] = r;
-                imageData.data[idx + 1] = g;
-                imageData.data[idx + 2] = b;
-                imageData.data[idx + 3] = 255;
-            }
-            
-            ctx.putImageData(imageData, 0, 0);
-        }
-        
         // Get current filter thresholds
         function getFilterThresholds() {
             return {
@@ -879,38 +903,27 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             };
         }
         
-        // Display filtered images
+        // Display the YUV-filtered image; HSV matching is shown from the device mask
         function displayFilteredImages() {
-            if (!currentYuvData || !currentHsvData) return;
+            if (!currentYuvData) return;
             
             const thresholds = getFilterThresholds();
-            const pixels = 160 * 120;
+            const pixels = currentYuvData.width * currentYuvData.height;
             
-            const filteredYuvImageData = filteredYuvCtx.createImageData(160, 120);
-            const filteredHsvImageData = filteredHsvCtx.createImageData(160, 120);
+            const filteredYuvImageData = filteredYuvCtx.createImageData(currentYuvData.width, currentYuvData.height);
             
             for (let i = 0; i < pixels; i++) {
                 const y = currentYuvData.y[i];
                 const u = currentYuvData.u[i];
                 const v = currentYuvData.v[i];
-                const h = currentHsvData.h[i];
-                const s = currentHsvData.s[i];
-                const hsvV = currentHsvData.v[i];
                 
                 const yuvMatch = (y >= thresholds.yuv.yMin && y <= thresholds.yuv.yMax &&
                                 u >= thresholds.yuv.uMin && u <= thresholds.yuv.uMax &&
                                 v >= thresholds.yuv.vMin && v <= thresholds.yuv.vMax);
                 
-                const hsvMatch = (h >= thresholds.hsv.hMin && h <= thresholds.hsv.hMax &&
-                                s >= thresholds.hsv.sMin && s <= thresholds.hsv.sMax &&
-                                hsvV >= thresholds.hsv.vMin && hsvV <= thresholds.hsv.vMax);
-                
                 const [r, g, b] = yuvToRgb(y, u, v);
-                const [hsvR, hsvG, hsvB] = hsvToRgb(h, s, hsvV);
                 
                 const idx = i * 4;
-                
-                // YUV filter visualization
                 if (yuvMatch) {
                     filteredYuvImageData.data[idx] = r;
                     filteredYuvImageData.data[idx + 1] = g;
@@ -922,35 +935,21 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                     filteredYuvImageData.data[idx + 2] = b >> 2;
                     filteredYuvImageData.data[idx + 3] = 64;
                 }
-                
-                // HSV filter visualization
-                if (hsvMatch) {
-                    filteredHsvImageData.data[idx] = hsvR;
-                    filteredHsvImageData.data[idx + 1] = hsvG;
-                    filteredHsvImageData.data[idx + 2] = hsvB;
-                    filteredHsvImageData.data[idx + 3] = 255;
-                } else {
-                    filteredHsvImageData.data[idx] = hsvR >> 2;
-                    filteredHsvImageData.data[idx + 1] = hsvG >> 2;
-                    filteredHsvImageData.data[idx + 2] = hsvB >> 2;
-                    filteredHsvImageData.data[idx + 3] = 64;
-                }
             }
             
             filteredYuvCtx.putImageData(filteredYuvImageData, 0, 0);
-            filteredHsvCtx.putImageData(filteredHsvImageData, 0, 0);
         }
         
         // Display regions overlay
         function displayRegions() {
             regionsCtx.fillStyle = '#000';
-            regionsCtx.fillRect(0, 0, 160, 120);
+            regionsCtx.fillRect(0, 0, frameWidth, frameHeight);
             
             // Copy dimmed original image as background if available
             if (currentYuvData) {
-                const regionImageData = regionsCtx.createImageData(160, 120);
+                const regionImageData = regionsCtx.createImageData(currentYuvData.width, currentYuvData.height);
                 
-                for (let i = 0; i < 160 * 120; i++) {
+                for (let i = 0; i < currentYuvData.width * currentYuvData.height; i++) {
                     const [r, g, b] = yuvToRgb(currentYuvData.y[i], currentYuvData.u[i], currentYuvData.v[i]);
                     
                     const idx = i * 4;
@@ -978,6 +977,23 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 regionsCtx.font = '12px Arial';
                 regionsCtx.fillText(index.toString(), region.x + 2, region.y + 14);
             });
+            
+            // Region set and blobs as the device sees them
+            regionsCtx.strokeStyle = '#fff';
+            regionsCtx.setLineDash([2, 2]);
+            deviceRegions.forEach(region => {
+                regionsCtx.strokeRect(region.x, region.y, region.width, region.height);
+            });
+            regionsCtx.setLineDash([]);
+            
+            regionsCtx.strokeStyle = '#ff0';
+            regionsCtx.lineWidth = 1;
+            deviceBlobs.forEach(blob => {
+                const radius = Math.max(2, Math.sqrt(blob.size / Math.PI));
+                regionsCtx.beginPath();
+                regionsCtx.arc(blob.x, blob.y, radius, 0, 2 * Math.PI);
+                regionsCtx.stroke();
+            });
         }
         
         // Update filter displays
@@ -992,28 +1008,113 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             displayFilteredImages();
         }
         
-        // Capture and process image
-        async function captureImage() {
+        // Resize every panel when the device switched resolution
+        function setFrameSize(width, height) {
+            if (width === frameWidth && height === frameHeight) return;
+            frameWidth = width;
+            frameHeight = height;
+            [yuvCanvas, filteredYuvCanvas, maskCanvas, regionsCanvas].forEach(canvas => {
+                canvas.width = width;
+                canvas.height = height;
+            });
+            document.getElementById('regionW').max = width;
+            document.getElementById('regionH').max = height;
+            deviceBlobs = [];
+            deviceRegions = [];
+        }
+        
+        // "320x240" from an X-Size header, or the current size
+        function parseSize(value) {
+            const match = /(\d+)x(\d+)/.exec(value || '');
+            return match ? [parseInt(match[1]), parseInt(match[2])] : [frameWidth, frameHeight];
+        }
+        
+        // Display one raw YUV422 frame; the mask and blobs come from the device
+        function processFrame(yuv422Data, width, height) {
+            setFrameSize(width, height);
+            currentYuvData = yuv422ToYUV(yuv422Data, width, height);
+            
+            displayYUVImage(currentYuvData, yuvCanvas, yuvCtx);
+            displayFilteredImages();
+            displayRegions();
+            if (!isLive()) requestPreview();
+        }
+        
+        // ========================================
+        // DEVICE PREVIEW (/preview)
+        // ========================================
+        // [frame_id u32][width u16][height u16][color_count u8][region_count u8]
+        // regions [x,y,w,h u16], masks, [blob_count u16] blobs [region u8][color u8][x u16][y u16][size u32]
+        async function requestPreview() {
+            if (previewInFlight) return;
+            previewInFlight = true;
+            
             try {
-                updateStatus('Capturing...');
+                const params = new URLSearchParams({ colors: document.getElementById('tuneColor').value });
+                const set = document.getElementById('previewSet').value.trim();
+                if (set) params.set('set', set);
+                const pyramid = document.getElementById('detectMode').value;
+                if (pyramid !== '0') params.set('pyramid', pyramid);
                 
-                const response = await fetch("/yuv");
+                const response = await fetch(`/preview?${params}`);
                 if (!response.ok) {
                     throw new Error(`HTTP ${response.status}`);
                 }
                 
-                const yuv422Data = new Uint8Array(await response.arrayBuffer());
+                const data = await response.arrayBuffer();
+                const view = new DataView(data);
+                const width = view.getUint16(4, true);
+                const height = view.getUint16(6, true);
+                const colorCount = view.getUint8(8);
+                const regionCount = view.getUint8(9);
+                
+                let offset = 10;
+                deviceRegions = [];
+                for (let i = 0; i < regionCount; i++, offset += 8) {
+                    deviceRegions.push({
+                        x: view.getUint16(offset, true),
+                        y: view.getUint16(offset + 2, true),
+                        width: view.getUint16(offset + 4, true),
+                        height: view.getUint16(offset + 6, true)
+                    });
+                }
                 
-                // Convert to structured formats
-                currentYuvData = yuv422ToYUV(yuv422Data);
-                currentHsvData = yuv422ToHSV(yuv422Data);
+                const maskSize = Math.ceil(width * height / 8);
+                if (colorCount > 0) drawMask(new Uint8Array(data, offset, maskSize), width, height);
+                offset += colorCount * maskSize;
                 
-                // Display all images
-                displayYUVImage(currentYuvData, yuvCanvas, yuvCtx);
-                displayHSVImage(currentHsvData, hsvCanvas, hsvCtx);
-                displayFilteredImages();
+                const blobCount = view.getUint16(offset, true);
+                offset += 2;
+                deviceBlobs = [];
+                for (let i = 0; i < blobCount; i++, offset += 10) {
+                    deviceBlobs.push({
+                        x: view.getUint16(offset + 2, true),
+                        y: view.getUint16(offset + 4, true),
+                        size: view.getUint32(offset + 6, true)
+                    });
+                }
                 displayRegions();
+            
+            } catch (error) {
+                console.error("Preview failed:", error);
+                updateStatus(`Preview error: ${error.message}`);
+            } finally {
+                previewInFlight = false;
+            }
+        }
+        
+        // Capture and process image
+        async function captureImage() {
+            try {
+                updateStatus('Capturing...');
+                
+                const response = await fetch("/yuv");
+                if (!response.ok) {
+                    throw new Error(`HTTP ${response.status}`);
+                }
                 
+                const [width, height] = parseSize(response.headers.get('X-Size'));
+                processFrame(new Uint8Array(await response.arrayBuffer()), width, height);
                 updateStatus('Captured');
                 
             } catch (error) {
@@ -1021,7 +1122,203 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 updateStatus(`Error: ${error.message}`);
             }
         }
-
+        
+        // Index just past the blank line ending a part's headers, or -1
+        function findPartBody(buffer) {
+            for (let i = 0; i + 3 < buffer.length; i++) {
+                if (buffer[i] === 13 && buffer[i + 1] === 10 && buffer[i + 2] === 13 && buffer[i + 3] === 10) {
+                    return i + 4;
+                }
+            }
+            return -1;
+        }
+        
+        // Apply one keyframe / delta part (frame_codec.h) to state.frame.
+        // Returns false on malformed data or a delta without a keyframe.
+        function decodeFrame(data, state) {
+            if (data.length < 14 || data[0] !== 89 || data[1] !== 68) return false;  // 'Y' 'D'
+            
+            const key = data[2] === 0;
+            const width = data[8] | (data[9] << 8);
+            const height = data[10] | (data[11] << 8);
+            const tileW = data[12];
+            const tileH = data[13];
+            
+            if (key) {
+                if (!state.frame || state.frame.length !== width * height * 2) {
+                    state.frame = new Uint8Array(width * height * 2);
+                }
+                state.width = width;
+                state.height = height;
+            } else if (!state.frame || state.width !== width || state.height !== height) {
+                return false;
+            }
+            
+            const stride = width * 2;
+            const tilesX = Math.ceil(width / tileW);
+            const tileCount = tilesX * Math.ceil(height / tileH);
+            const tile = new Uint8Array(tileW * 2 * tileH);
+            let pos = 14 + ((tileCount + 3) >> 2);
+            
+            for (let t = 0; t < tileCount; t++) {
+                const mode = (data[14 + (t >> 2)] >> (6 - 2 * (t & 3))) & 3;
+                if (mode === 0) continue;
+                
+                const x0 = (t % tilesX) * tileW;
+                const y0 = Math.floor(t / tilesX) * tileH;
+                const rowBytes = Math.min(tileW, width - x0) * 2;
+                const rows = Math.min(tileH, height - y0);
+                const n = rowBytes * rows;
+                
+                if (mode === 1) {
+                    tile.set(data.subarray(pos, pos + n));
+                    pos += n;
+                } else {
+                    let o = 0;
+                    while (o < n && pos < data.length) {
+                        const c = data[pos++];
+                        if (c < 128) {
+                            tile.set(data.subarray(pos, pos + c + 1), o);
+                            pos += c + 1;
+                            o += c + 1;
+                        } else {
+                            tile.fill(data[pos++], o, o + c - 125);
+                            o += c - 125;
+                        }
+                    }
+                    if (o !== n) return false;
+                }
+                
+                for (let r = 0; r < rows; r++) {
+                    const dst = (y0 + r) * stride + x0 * 2;
+                    const src = r * rowBytes;
+                    if (mode === 3) {
+                        for (let b = 0; b < rowBytes; b++) {
+                            state.frame[dst + b] = (state.frame[dst + b] + tile[src + b]) & 0xFF;
+                        }
+                    } else {
+                        state.frame.set(tile.subarray(src, src + rowBytes), dst);
+                    }
+                }
+            }
+            
+            return pos === data.length;
+        }
+        
+        // Continuous frames over one connection (multipart/x-mixed-replace).
+        // Delta parts are all decoded in order; only the newest complete
+        // frame of each read is rendered.
+        async function runStream() {
+            const codec = document.getElementById('streamCodec').value;
+            const key = parseInt(document.getElementById('keyInterval').value) || 0;
+            
+            streamAbort = new AbortController();
+            const response = await fetch(`/yuv/stream?codec=${codec}&key=${key}`, { signal: streamAbort.signal });
+            if (!response.ok) {
+                throw new Error(`HTTP ${response.status}`);
+            }
+            
+            const reader = response.body.getReader();
+            const decoder = new TextDecoder();
+            const deltaState = { frame: null, width: 0, height: 0 };
+            let buffer = new Uint8Array(0);
+            let frames = 0;
+            let wireBytes = 0;
+            let parts = 0;
+            let fpsStart = performance.now();
+            
+            while (autoMode) {
+                const { value, done } = await reader.read();
+                if (done) break;
+                
+                const joined = new Uint8Array(buffer.length + value.length);
+                joined.set(buffer);
+                joined.set(value, buffer.length);
+                buffer = joined;
+                
+                let latest = null;
+                let latestSize = null;
+                for (;;) {
+                    const bodyStart = findPartBody(buffer);
+                    if (bodyStart < 0) break;
+                    
+                    const headers = decoder.decode(buffer.subarray(0, bodyStart));
+                    const match = /Content-Length:\s*(\d+)/i.exec(headers);
+                    if (!match) {
+                        buffer = buffer.subarray(bodyStart);
+                        continue;
+                    }
+                    
+                    const length = parseInt(match[1]);
+                    if (buffer.length < bodyStart + length) break;
+                    const body = buffer.subarray(bodyStart, bodyStart + length);
+                    buffer = buffer.subarray(bodyStart + length);
+                    wireBytes += length;
+                    parts++;
+                    
+                    if (/X-Encoding:\s*delta/i.test(headers)) {
+                        if (!decodeFrame(body, deltaState)) {
+                            throw new Error('Delta stream out of sync');
+                        }
+                        latest = deltaState.frame;
+                        latestSize = [deltaState.width, deltaState.height];
+                    } else {
+                        latest = body.slice();
+                        latestSize = parseSize(/X-Size:\s*(\S+)/i.exec(headers)?.[1]);
+                    }
+                }
+                
+                if (latest) {
+                    processFrame(latest, latestSize[0], latestSize[1]);
+                    frames++;
+                    
+                    const elapsed = performance.now() - fpsStart;
+                    if (elapsed >= 1000) {
+                        const kbPerFrame = wireBytes / 1024 / parts;
+                        updateStatus(`Streaming ${(frames * 1000 / elapsed).toFixed(1)} fps, ` +
+                                     `${kbPerFrame.toFixed(1)} KB/frame (${codec})`);
+                        frames = 0;
+                        wireBytes = 0;
+                        parts = 0;
+                        fpsStart = performance.now();
+                    }
+                }
+            }
+        }
+        
+        // Restart the sensor at the selected frame size. Streams and the
+        // live channel pick the new size up from their next frame.
+        async function changeResolution() {
+            const size = document.getElementById('resolution').value;
+            try {
+                updateStatus(`Switching to ${size}...`);
+                const response = await fetch('/resolution', {
+                    method: 'POST',
+                    body: new URLSearchParams({ size })
+                });
+                if (!response.ok) {
+                    throw new Error(await response.text());
+                }
+                updateStatus(`Resolution ${(await response.text()).split('\n')[0]}`);
+                if (!autoMode && !isLive()) captureImage();
+            } catch (error) {
+                console.error("Resolution change failed:", error);
+                updateStatus(`Resolution error: ${error.message}`);
+                syncResolution();
+            }
+        }
+        
+        // Select the size the device runs at
+        async function syncResolution() {
+            try {
+                const response = await fetch('/resolution');
+                if (response.ok) {
+                    document.getElementById('resolution').value = (await response.text()).split(' ')[0];
+                }
+            } catch (error) {
+                console.error("Resolution query failed:", error);
+            }
+        }
         
         // Auto capture mode
         function toggleAuto() {
@@ -1029,15 +1326,158 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             autoBtn.textContent = `Auto: ${autoMode ? 'ON' : 'OFF'}`;
             
             if (autoMode) {
-                autoInterval = setInterval(captureImage, 1000);
+                if (liveSocket) liveSocket.close();
                 updateStatus('Auto mode ON');
+                runStream().catch(error => {
+                    if (autoMode) {
+                        console.error("Stream failed:", error);
+                        updateStatus(`Error: ${error.message}`);
+                        autoMode = false;
+                        autoBtn.textContent = 'Auto: OFF';
+                    }
+                });
             } else {
-                clearInterval(autoInterval);
-                autoInterval = null;
+                if (streamAbort) streamAbort.abort();
+                streamAbort = null;
                 updateStatus('Auto mode OFF');
             }
         }
         
+        // ========================================
+        // LIVE MODE (WebSocket on port 81)
+        // ========================================
+        // The camera pushes the frame, the mask of the selected color and its
+        // blobs; HSV slider moves go back as COLOR_SET on the same socket.
+        function isLive() {
+            return liveSocket !== null && liveSocket.readyState === WebSocket.OPEN;
+        }
+        
+        function sendView() {
+            if (isLive()) {
+                liveSocket.send(`VIEW,1,1,${document.getElementById('tuneColor').value}`);
+            }
+        }
+        
+        // At most one COLOR_SET in flight; moves in between collapse into one.
+        // Over the WebSocket in live mode, otherwise POST /color and a new preview.
+        function sendThresholds() {
+            if (thresholdsInFlight) {
+                thresholdsPending = true;
+                return;
+            }
+            
+            const t = getFilterThresholds().hsv;
+            const color = document.getElementById('tuneColor').value;
+            thresholdsInFlight = true;
+            thresholdsPending = false;
+            
+            if (isLive()) {
+                liveSocket.send(`COLOR_SET,${color},${t.hMin},${t.hMax},${t.sMin},${t.sMax},${t.vMin},${t.vMax}`);
+                return;
+            }
+            
+            const body = new URLSearchParams({ name: color, t: `${t.hMin},${t.hMax},${t.sMin},${t.sMax},${t.vMin},${t.vMax}` });
+            fetch("/color", { method: "POST", body })
+                .then(() => requestPreview())
+                .catch(error => console.error("Color update failed:", error))
+                .finally(() => {
+                    thresholdsInFlight = false;
+                    if (thresholdsPending) sendThresholds();
+                });
+        }
+        
+        function colorChanged() {
+            deviceBlobs = [];
+            if (isLive()) {
+                sendView();
+            } else {
+                requestPreview();
+            }
+        }
+        
+        // 1 bpp device mask over the current frame
+        function drawMask(mask, width, height) {
+            const imageData = maskCtx.createImageData(width, height);
+            for (let i = 0; i < width * height; i++) {
+                const hit = (mask[i >> 3] >> (7 - (i & 7))) & 1;
+                const idx = i * 4;
+                if (currentYuvData && currentYuvData.y.length === width * height) {
+                    const [r, g, b] = yuvToRgb(currentYuvData.y[i], currentYuvData.u[i], currentYuvData.v[i]);
+                    imageData.data[idx] = hit ? r : r >> 2;
+                    imageData.data[idx + 1] = hit ? g : g >> 2;
+                    imageData.data[idx + 2] = hit ? b : b >> 2;
+                } else {
+                    imageData.data[idx] = imageData.data[idx + 1] = imageData.data[idx + 2] = hit ? 255 : 0;
+                }
+                imageData.data[idx + 3] = 255;
+            }
+            maskCtx.putImageData(imageData, 0, 0);
+        }
+        
+        // [type u8][color u8][frame_id u32][width u16][height u16] + body
+        function handleLiveMessage(data) {
+            const view = new DataView(data);
+            const bytes = new Uint8Array(data);
+            const type = view.getUint8(0);
+            const width = view.getUint16(6, true);
+            const height = view.getUint16(8, true);
+            const body = bytes.subarray(10);
+            
+            if (type === 1) {
+                processFrame(body, width, height);
+                updateStatus(`Live frame ${view.getUint32(2, true)}`);
+            } else if (type === 2) {
+                drawMask(body, width, height);
+            } else if (type === 3) {
+                const count = view.getUint16(10, true);
+                deviceBlobs = [];
+                for (let i = 0; i < count; i++) {
+                    const offset = 12 + i * 10;
+                    deviceBlobs.push({
+                        x: view.getUint16(offset + 2, true),
+                        y: view.getUint16(offset + 4, true),
+                        size: view.getUint32(offset + 6, true)
+                    });
+                }
+                displayRegions();
+            }
+        }
+        
+        function toggleLive() {
+            if (liveSocket) {
+                liveSocket.close();
+                return;
+            }
+            if (autoMode) toggleAuto();
+            
+            liveSocket = new WebSocket(`ws://${location.hostname}:81/`);
+            liveSocket.binaryType = 'arraybuffer';
+            liveBtn.textContent = 'Live: ON';
+            
+            liveSocket.onopen = () => {
+                updateStatus('Live mode ON');
+                sendView();
+            };
+            
+            liveSocket.onmessage = (event) => {
+                if (typeof event.data !== 'string') {
+                    handleLiveMessage(event.data);
+                    return;
+                }
+                if (event.data.startsWith('ERROR')) updateStatus(event.data);
+                thresholdsInFlight = false;
+                if (thresholdsPending) sendThresholds();
+            };
+            
+            liveSocket.onclose = () => {
+                liveSocket = null;
+                deviceBlobs = [];
+                thresholdsInFlight = thresholdsPending = false;
+                liveBtn.textContent = 'Live: OFF';
+                updateStatus('Live mode OFF');
+            };
+        }
+        
         // Reset all filters
         function resetFilters() {
             document.getElementById('yMin').value = 0;
@@ -1065,10 +1505,10 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             const height = parseInt(document.getElementById('regionH').value) || 60;
             
             // Clamp values
-            const clampedX = Math.max(0, Math.min(159, x));
-            const clampedY = Math.max(0, Math.min(119, y));
-            const clampedW = Math.max(1, Math.min(160 - clampedX, width));
-            const clampedH = Math.max(1, Math.min(120 - clampedY, height));
+            const clampedX = Math.max(0, Math.min(frameWidth - 1, x));
+            const clampedY = Math.max(0, Math.min(frameHeight - 1, y));
+            const clampedW = Math.max(1, Math.min(frameWidth - clampedX, width));
+            const clampedH = Math.max(1, Math.min(frameHeight - clampedY, height));
             
             regions.push({
                 x: clampedX,
@@ -1112,6 +1552,7 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
         
         // Initialize
         updateFilters();
+        syncResolution();
         captureImage();
     </script>
 </body>
@@ -1123,24 +1564,260 @@ void handleRoot() {
   server.send_P(200, "text/html", INDEX_HTML);
 }
 
+// No frame to send: 503 until capture stored one, 500 when the HTTP copy
+// could not be allocated (the frame size outgrew free PSRAM)
+void sendNoFrame() {
+  if (http_frame.out_of_memory) {
+    server.send(500, "text/plain", "Out of memory for the frame copy");
+  } else {
+    server.send(503, "text/plain", "No frame captured yet");
+  }
+}
+
 void handleYUV() {
-  // Capture fresh image
-  if (!captureYUVImage()) {
-    server.send(500, "text/plain", "Capture failed");
+  // Newest frame from the capture pipeline
+  uint32_t seq = 0;
+  int width, height;
+  size_t data_size = copyLatestFrame(http_frame, &seq, &width, &height);
+  if (data_size == 0) {
+    sendNoFrame();
     return;
   }
   
-  int data_size = yuv_buffer.width * yuv_buffer.height * 2;
-  
   // Send binary YUV data directly
   server.sendHeader("Access-Control-Allow-Origin", "*");
   server.sendHeader("Content-Type", "application/octet-stream");
   server.sendHeader("Content-Length", String(data_size));
   server.sendHeader("Cache-Control", "no-cache");
+  server.sendHeader("X-Size", String(width) + "x" + String(height));
+  
+  server.send_P(200, "application/octet-stream", (const char*)http_frame.data, data_size);
+}
+
+// ========================================
+// DEVICE PREVIEW
+// ========================================
+// /preview?colors=RED,GREEN[&set=name][&pyramid=2|4] runs the real thresholds
+// and CCL on the newest frame, so the page never converts or thresholds in
+// JavaScript. pyramid finds the blobs coarse-to-fine (pyramid_detector.h);
+// otherwise regions over unchanged tiles reuse their last result (detection_gate.h).
+// Response (application/octet-stream, little-endian):
+//   [frame_id u32][width u16][height u16][color_count u8][region_count u8]
+//   region_count * [x u16][y u16][w u16][h u16]   clipped to the frame
+//   color_count masks of packedMaskSize() bytes, in request order
+//   [blob_count u16] blob_count * [region u8][color u8][x u16][y u16][size u32]
+// Without set the whole frame is one region; without colors all colors are used.
+static void appendLE(std::vector<uint8_t>& out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) out.push_back((value >> (8 * i)) & 0xFF);
+}
+
+void handlePreview() {
+  uint32_t seq = 0;
+  int width, height;
+  if (copyLatestFrame(http_frame, &seq, &width, &height) == 0) {
+    sendNoFrame();
+    return;
+  }
+  
+  std::vector<std::string> names;
+  String list = server.arg("colors");
+  int start = 0;
+  while (start < (int)list.length()) {
+    int comma = list.indexOf(',', start);
+    if (comma < 0) comma = list.length();
+    if (comma > start) names.push_back(list.substring(start, comma).c_str());
+    start = comma + 1;
+  }
+  String set = server.arg("set");
+  
+  HSVImage hsv;
+  unsigned long convert_start = micros();
+  if (!yuv422ToHSV(http_frame.data, width, height, hsv)) {
+    server.send(500, "text/plain", "Out of memory");
+    return;
+  }
+  getMetrics().observeStage(STAGE_CONVERT, convert_start);
+  
+  // Names resolve to handles once per request; unknown ones keep their slot and match nothing.
+  // Masks and blobs below all use the colors and regions pinned here.
+  ConfigPin pin;
+  std::vector<ColorId> colors = names.empty() ? getColorManager().getAllColorIds() : resolveColors(names);
+  if (colors.size() > PREVIEW_MAX_COLORS) colors.resize(PREVIEW_MAX_COLORS);
+  
+  // Detected over the compiled set, like detectBlobsInto(): a blob where
+  // regions overlap is reported once
+  std::shared_ptr<const CompiledRegionSet> compiled;
+  if (set.length() == 0) {
+    if (!preview_full_frame || preview_full_frame->image_width != width ||
+        preview_full_frame->image_height != height) {
+      std::shared_ptr<CompiledRegionSet> full = std::make_shared<CompiledRegionSet>();
+      compileRegionSet({DetectionRegion(0, 0, width, height)}, width, height, *full);
+      preview_full_frame = full;
+    }
+    compiled = preview_full_frame;
+  } else if (getRegionManager().hasRegionSet(set.c_str())) {
+    compiled = getRegionManager().getCompiledRegionSet(set.c_str(), width, height);
+  }
+  
+  if (!compiled || compiled->regions.empty()) {
+    hsv.clear();
+    server.send(404, "text/plain", "Unknown region set");
+    return;
+  }
+  const std::vector<DetectionRegion>& regions = compiled->regions;
+  
+  size_t mask_size = packedMaskSize(width, height);
+  std::vector<uint8_t> payload;
+  payload.reserve(10 + regions.size() * 8 + colors.size() * mask_size + 2);
+  
+  appendLE(payload, seq, 4);
+  appendLE(payload, width, 2);
+  appendLE(payload, height, 2);
+  appendLE(payload, colors.size(), 1);
+  appendLE(payload, min(regions.size(), (size_t)255), 1);
+  for (size_t r = 0; r < regions.size() && r < 255; r++) {
+    appendLE(payload, regions[r].x, 2);
+    appendLE(payload, regions[r].y, 2);
+    appendLE(payload, regions[r].width, 2);
+    appendLE(payload, regions[r].height, 2);
+  }
+  
+  for (const auto& color : colors) {
+    payload.resize(payload.size() + mask_size);
+    buildColorMask(hsv, color, payload.data() + payload.size() - mask_size);
+  }
+  
+  unsigned long detect_start = micros();
+  int pyramid = server.arg("pyramid").toInt();
+  bool coarse = pyramid == 2 || pyramid == 4;
+  if (coarse) {
+    preview_pyramid.setFactor(pyramid);
+    coarse = preview_pyramid.setFrame(http_frame.data, width, height);
+  }
+  if (coarse) {
+    preview_pyramid.detect(*compiled, colors, preview_results);
+  } else {
+    preview_gate.update(http_frame.data, width, height);
+    preview_gate.detect(hsv, compiled, colors, preview_results);
+  }
+  getMetrics().observeStage(STAGE_DETECT, detect_start);
+  hsv.clear();
+  
+  uint16_t blob_count = preview_results.blobCount();
+  appendLE(payload, blob_count, 2);
+  preview_results.appendBinary(payload);
+  getMetrics().blobs_per_frame.observe(blob_count);
+  
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Cache-Control", "no-cache");
+  server.send_P(200, "application/octet-stream", (const char*)payload.data(), payload.size());
+}
+
+// GET /metrics  Prometheus text format: pipeline counters and histograms
+// (metrics.h) plus heap and PSRAM gauges
+void handleMetrics() {
+  String body;
+  body.reserve(8192);
+  getMetrics().render(body);
   
-  server.send_P(200, "application/octet-stream", (const char*)yuv_buffer.yuv_data, data_size);
+  char line[192];
+  const struct { const char* name; const char* help; uint32_t value; } memory[] = {
+    {"heap_free_bytes", "Free internal heap", ESP.getFreeHeap()},
+    {"heap_min_free_bytes", "Lowest free internal heap since boot", ESP.getMinFreeHeap()},
+    {"heap_largest_free_block_bytes", "Largest allocatable internal block",
+     (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)},
+    {"psram_size_bytes", "Total PSRAM", ESP.getPsramSize()},
+    {"psram_free_bytes", "Free PSRAM", ESP.getFreePsram()},
+    {"psram_largest_free_block_bytes", "Largest allocatable PSRAM block",
+     (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM)},
+  };
+  for (const auto& m : memory) {
+    snprintf(line, sizeof(line), "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s gauge\n"
+             METRICS_PREFIX "%s %u\n", m.name, m.help, m.name, m.name, (unsigned)m.value);
+    body += line;
+  }
+  
+  server.send(200, "text/plain; version=0.0.4", body);
+}
+
+// GET /resolution         current frame size and the selectable ones
+// POST /resolution size=QVGA  (or size=320x240) restart the sensor at it
+void handleResolution() {
+  if (server.method() == HTTP_POST) {
+    const CameraResolution* resolution = findResolution(server.arg("size"));
+    if (!resolution) {
+      server.send(400, "text/plain", "Unknown size");
+      return;
+    }
+    if (!resolutionFits(*resolution)) {
+      server.send(507, "text/plain", String("Not enough PSRAM for ") + resolution->name + ": needs " +
+                  (frameMemoryBytes(resolution->width, resolution->height) + FRAME_MEMORY_RESERVE) / 1024 +
+                  " KB of " + ESP.getPsramSize() / 1024);
+      return;
+    }
+    if (!applyResolution(*resolution)) {
+      server.send(500, "text/plain", "Camera restart failed");
+      return;
+    }
+  }
+  
+  // Second line: the sizes that fit this module's PSRAM
+  const CameraResolution& current = getResolution();
+  String body = String(current.name) + " " + current.width + "x" + current.height + "\n";
+  String sizes;
+  for (int i = 0; i < CAMERA_RESOLUTION_COUNT; i++) {
+    if (!resolutionFits(CAMERA_RESOLUTIONS[i])) continue;
+    if (sizes.length() > 0) sizes += ",";
+    sizes += CAMERA_RESOLUTIONS[i].name;
+  }
+  body += sizes + "\n";
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "text/plain", body);
+}
+
+// POST /color  name=RED&t=h_min,h_max,s_min,s_max,v_min,v_max  (COLOR_SET)
+void handleColorSet() {
+  int t[6];
+  String name = server.arg("name");
+  if (name.length() == 0 ||
+      sscanf(server.arg("t").c_str(), "%d,%d,%d,%d,%d,%d", &t[0], &t[1], &t[2], &t[3], &t[4], &t[5]) != 6) {
+    server.send(400, "text/plain", "Expected name and t=h_min,h_max,s_min,s_max,v_min,v_max");
+    return;
+  }
   
-  Serial.printf("Sent %d bytes YUV binary data\n", data_size);
+  getColorManager().setColor(name.c_str(), ColorThresholds(t[0], t[1], t[2], t[3], t[4], t[5]));
+  
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "text/plain", "OK");
+}
+
+// POST /config    store the current colors and region sets; setup() restores them
+// DELETE /config  forget them, the next boot starts from the defaults
+void handleConfig() {
+  bool ok = server.method() == HTTP_DELETE ? config_store.clear() : config_store.save();
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(ok ? 200 : 500, "text/plain", ok ? "OK" : "Config storage failed");
+}
+
+void handleYUVStream() {
+  WiFiClient client = server.client();
+  client.print("HTTP/1.1 200 OK\r\n"
+               "Content-Type: multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY "\r\n"
+               "Access-Control-Allow-Origin: *\r\n"
+               "Cache-Control: no-cache\r\n"
+               "Connection: close\r\n\r\n");
+  
+  // ?codec=delta[&key=N] streams keyframes + deltas instead of raw frames
+  StreamRequest request;
+  request.delta = server.arg("codec") == "delta";
+  request.keyframe_interval = server.hasArg("key") ? server.arg("key").toInt() : STREAM_KEYFRAME_INTERVAL;
+  
+  // The stream task keeps its own reference and owns the connection from here
+  request.client = new WiFiClient(client);
+  if (xQueueSend(stream_queue, &request, 0) != pdTRUE) {
+    request.client->stop();
+    delete request.client;
+  }
 }
 
 // ========================================
@@ -1157,6 +1834,20 @@ void setup() {
   }
   Serial.println("Camera OK");
   
+  // Stored colors and region sets, compiled once for the stored frame size
+  unsigned long config_start = micros();
+  if (config_store.load()) {
+    Serial.printf("Config restored in %lu us\n", micros() - config_start);
+  }
+  
+  // Capture buffers for the boot resolution; consumers size their own copies
+  frame_mutex = xSemaphoreCreateMutex();
+  capture_mutex = xSemaphoreCreateMutex();
+  yuv_buffer.capacity = getResolution().width * getResolution().height * 2;
+  yuv_buffer.front = allocFrame(yuv_buffer.capacity);
+  yuv_buffer.back = allocFrame(yuv_buffer.capacity);
+  stream_queue = xQueueCreate(MAX_STREAM_CLIENTS, sizeof(StreamRequest));
+  
   // Initialize flash
   pinMode(FLASH_GPIO_NUM, OUTPUT);
   setFlash(false);
@@ -1176,12 +1867,24 @@ void setup() {
   // Setup routes
   server.on("/", HTTP_GET, handleRoot);
   server.on("/yuv", HTTP_GET, handleYUV);
+  server.on("/yuv/stream", HTTP_GET, handleYUVStream);
+  server.on("/preview", HTTP_GET, handlePreview);
+  server.on("/color", HTTP_POST, handleColorSet);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/resolution", HTTP_ANY, handleResolution);
+  server.on("/config", HTTP_POST, handleConfig);
+  server.on("/config", HTTP_DELETE, handleConfig);
   
   server.begin();
-  Serial.println("Server started");
+  ws_channel.begin();
+  Serial.printf("Server started (WebSocket on port %d)\n", WS_PORT);
   
-  // Test capture
+  // Test capture, then keep capturing on core 0
   captureYUVImage();
+  startDualCore();
+  createPinnedTask(streamTask, "YUVStream", 4096, NULL, 1, &stream_task, 1);
+  createPinnedTask(wsTask, "WsPush", 8192, NULL, 1, &ws_task, 1);
+  createPinnedTask(httpTask, "HTTP", 8192, NULL, 1, &http_task, 1);
   Serial.println("Ready!");
 }
 
@@ -1189,8 +1892,6 @@ void setup() {
 // MAIN LOOP
 // ========================================
 void loop() {
-  server.handleClient();
-  
   // Serial commands
   if (Serial.available()) {
     String cmd = Serial.readStringUntil('\n');
@@ -1201,8 +1902,48 @@ void loop() {
       captureYUVImage();
     } else if (cmd == "STATUS") {
       Serial.printf("WiFi: %s\n", WiFi.status() == WL_CONNECTED ? "OK" : "FAIL");
-      Serial.printf("YUV: %s\n", yuv_buffer.data_ready ? "Ready" : "None");
+      Serial.printf("YUV: %s (frame %u)\n", yuv_buffer.data_ready ? "Ready" : "None",
+                    (unsigned)yuv_buffer.frame_seq);
       Serial.printf("Heap: %d bytes\n", ESP.getFreeHeap());
+      Serial.printf("Resolution: %s (%dx%d)\n", getResolution().name, getResolution().width,
+                    getResolution().height);
+      Serial.printf("Frame time: %.1f ms avg, %.2f ms jitter (stddev), %.1f..%.1f ms over %u frames\n",
+                    frame_timing.mean_ms, frame_timing.jitterMs(), frame_timing.count ? frame_timing.min_ms : 0.0f,
+                    frame_timing.max_ms, (unsigned)frame_timing.count);
+      for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+        const FrameCodecStats& codec = stream_encoders[i].stats();
+        if (codec.frames == 0) continue;
+        Serial.printf("Stream %d codec: %.1fx, %.1f KB/frame, %.0f us/frame, %u keyframes\n", i,
+                      codec.ratio(), codec.bytes_out / 1024.0 / codec.frames, codec.usPerFrame(),
+                      (unsigned)codec.keyframes);
+      }
+    } else if (cmd.startsWith("RESOLUTION")) {
+      // RESOLUTION lists the sizes, RESOLUTION QVGA switches to one
+      String name = cmd.substring(10);
+      name.trim();
+      if (name.length() == 0) {
+        Serial.printf("Resolution: %s (%dx%d)\n", getResolution().name, getResolution().width,
+                      getResolution().height);
+        for (int i = 0; i < CAMERA_RESOLUTION_COUNT; i++) {
+          const CameraResolution& res = CAMERA_RESOLUTIONS[i];
+          Serial.printf("  %s %dx%d, %u KB%s\n", res.name, res.width, res.height,
+                        (unsigned)(frameMemoryBytes(res.width, res.height) / 1024),
+                        resolutionFits(res) ? "" : " (does not fit PSRAM)");
+        }
+      } else if (!findResolution(name)) {
+        Serial.println("Unknown resolution");
+      } else if (!resolutionFits(*findResolution(name))) {
+        Serial.println("Not enough PSRAM for that resolution, unchanged");
+      } else if (applyResolution(*findResolution(name))) {
+        Serial.printf("Resolution: %s (%dx%d)\n", getResolution().name, getResolution().width,
+                      getResolution().height);
+      } else {
+        Serial.println("Camera restart failed, resolution unchanged");
+      }
+    } else if (cmd == "TIMING") {
+      // Start a new frame time measurement, e.g. before attaching a browser
+      frame_timing_reset = true;
+      Serial.println("Frame timing reset");
     } else if (cmd == "FLASH") {
       static bool flash_on = false;
       flash_on = !flash_on;
@@ -0,0 +1,263 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// ========================================
+// PIPELINE METRICS
+// ========================================
+
+// Counters, gauges and fixed-bucket histograms updated from the hot path of
+// any task on either core without locks (32-bit atomics only), and rendered
+// in Prometheus text format by /metrics.
+
+#define METRICS_PREFIX "blobcam_"
+#define METRICS_MAX_BUCKETS 12
+
+// Latency bucket bounds in microseconds (rendered as seconds)
+static const uint32_t LATENCY_BOUNDS_US[] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+
+// Blobs per detected frame
+static const uint32_t BLOB_COUNT_BOUNDS[] = {0, 1, 2, 4, 8, 16, 32, 64};
+
+class MetricCounter {
+private:
+  std::atomic<uint32_t> value;
+
+public:
+  MetricCounter() : value(0) {}
+  
+  void add(uint32_t n = 1) {
+    value.fetch_add(n, std::memory_order_relaxed);
+  }
+  
+  uint32_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+};
+
+class MetricGauge {
+private:
+  std::atomic<float> value;
+
+public:
+  MetricGauge() : value(0.0f) {}
+  
+  void set(float v) {
+    value.store(v, std::memory_order_relaxed);
+  }
+  
+  float get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+};
+
+class MetricHistogram {
+private:
+  const uint32_t* bounds;
+  int bound_count;
+  std::atomic<uint32_t> buckets[METRICS_MAX_BUCKETS + 1];   // Last one is +Inf
+  std::atomic<uint32_t> count;
+  // 64-bit sum from two 32-bit halves; the carry goes into sum_hi
+  std::atomic<uint32_t> sum_lo;
+  std::atomic<uint32_t> sum_hi;
+
+public:
+  template<size_t N>
+  MetricHistogram(const uint32_t (&upper_bounds)[N])
+    : bounds(upper_bounds), bound_count(N < METRICS_MAX_BUCKETS ? N : METRICS_MAX_BUCKETS),
+      count(0), sum_lo(0), sum_hi(0) {
+    for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+  }
+  
+  void observe(uint32_t value) {
+    int i = 0;
+    while (i < bound_count && value > bounds[i]) i++;
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    
+    uint32_t before = sum_lo.fetch_add(value, std::memory_order_relaxed);
+    if (before + value < before) sum_hi.fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+  
+  uint32_t total() const {
+    return count.load(std::memory_order_relaxed);
+  }
+  
+  uint64_t sum() const {
+    uint32_t hi, lo;
+    do {
+      hi = sum_hi.load(std::memory_order_relaxed);
+      lo = sum_lo.load(std::memory_order_relaxed);
+    } while (hi != sum_hi.load(std::memory_order_relaxed));
+    return (uint64_t(hi) << 32) | lo;
+  }
+  
+  // Cumulative buckets, _sum and _count. labels is "" or `key="value"`;
+  // scale converts recorded units to the exported unit (1e-6: us -> s).
+  void render(String& out, const char* name, const char* labels, double scale) const {
+    char line[256];
+    const char* sep = labels[0] ? "," : "";
+    uint32_t cumulative = 0;
+    
+    for (int i = 0; i <= bound_count; i++) {
+      cumulative += buckets[i].load(std::memory_order_relaxed);
+      if (i < bound_count) {
+        snprintf(line, sizeof(line), METRICS_PREFIX "%s_bucket{%s%sle=\"%g\"} %u\n",
+                 name, labels, sep, bounds[i] * scale, (unsigned)cumulative);
+      } else {
+        snprintf(line, sizeof(line), METRICS_PREFIX "%s_bucket{%s%sle=\"+Inf\"} %u\n",
+                 name, labels, sep, (unsigned)cumulative);
+      }
+      out += line;
+    }
+    
+    const char* open = labels[0] ? "{" : "";
+    const char* close = labels[0] ? "}" : "";
+    snprintf(line, sizeof(line), METRICS_PREFIX "%s_sum%s%s%s %.6f\n", name, open, labels, close, sum() * scale);
+    out += line;
+    snprintf(line, sizeof(line), METRICS_PREFIX "%s_count%s%s%s %u\n", name, open, labels, close, (unsigned)total());
+    out += line;
+  }
+};
+
+// ========================================
+// PIPELINE STAGES
+// ========================================
+
+enum MetricStage {
+  STAGE_CAPTURE,        // esp_camera_fb_get()
+  STAGE_STORE,          // Copy into the frame double buffer
+  STAGE_CONVERT,        // YUV422 -> HSV
+  STAGE_GATE,           // Per-tile frame difference before detection
+  STAGE_DETECT,         // CCL over a region set
+  STAGE_STATS,          // REGION_STATS histograms and coverage
+  STAGE_PUBLISH,        // WebSocket masks / blobs to all clients
+  STAGE_STREAM_ENCODE,  // Delta coding of one /yuv/stream part
+  STAGE_STREAM_SEND,    // Writing one /yuv/stream part
+  STAGE_COUNT
+};
+
+static const char* const STAGE_NAMES[STAGE_COUNT] = {
+  "capture", "store", "convert", "gate", "detect", "stats", "publish", "stream_encode", "stream_send"
+};
+
+struct PipelineMetrics {
+  MetricCounter frames_captured;
+  MetricCounter frames_capture_failed;   // No frame buffer from the sensor
+  MetricCounter frames_too_large;        // Did not fit the frame buffer
+  MetricCounter frames_copy_failed;      // A consumer could not allocate its frame copy
+  MetricCounter frames_skipped_stream;   // Newer frame arrived before a viewer got the last one
+  MetricGauge fps;                       // Smoothed capture rate
+  
+  MetricHistogram stage_latency[STAGE_COUNT] = {
+    MetricHistogram(LATENCY_BOUNDS_US), MetricHistogram(LATENCY_BOUNDS_US),
+    MetricHistogram(LATENCY_BOUNDS_US), MetricHistogram(LATENCY_BOUNDS_US),
+    MetricHistogram(LATENCY_BOUNDS_US), MetricHistogram(LATENCY_BOUNDS_US),
+    MetricHistogram(LATENCY_BOUNDS_US), MetricHistogram(LATENCY_BOUNDS_US),
+    MetricHistogram(LATENCY_BOUNDS_US)
+  };
+  MetricHistogram blobs_per_frame = MetricHistogram(BLOB_COUNT_BOUNDS);
+
+  MetricCounter gate_hits;               // Region / color detections reused from the cache
+  MetricCounter gate_misses;             // ... and rerun
+  MetricCounter gate_saved_ms;           // What the reused detections cost when they ran
+  MetricGauge gate_changed_tiles;        // Fraction of tiles changed in the last gated frame
+  
+  MetricCounter serial_bytes_out;        // Everything SimpleSerialSender wrote
+  MetricCounter commands;                // Command lines processed
+  MetricGauge command_queue_depth;       // Lines drained by the last processCommands()
+  
+  void observeStage(MetricStage stage, unsigned long start_us) {
+    stage_latency[stage].observe(micros() - start_us);
+  }
+  
+  // Everything above; platform gauges (heap, PSRAM) are appended by the caller
+  void render(String& out) const {
+    char line[256];
+    
+    auto counter = [&](const char* name, const char* help, uint32_t value) {
+      snprintf(line, sizeof(line), "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s counter\n"
+               METRICS_PREFIX "%s %u\n", name, help, name, name, (unsigned)value);
+      out += line;
+    };
+    auto gauge = [&](const char* name, const char* help, float value) {
+      snprintf(line, sizeof(line), "# HELP " METRICS_PREFIX "%s %s\n# TYPE " METRICS_PREFIX "%s gauge\n"
+               METRICS_PREFIX "%s %.3f\n", name, help, name, name, value);
+      out += line;
+    };
+    
+    counter("frames_captured_total", "Frames stored by the capture task", frames_captured.get());
+    out += "# HELP " METRICS_PREFIX "frames_dropped_total Frames lost before reaching a consumer\n"
+           "# TYPE " METRICS_PREFIX "frames_dropped_total counter\n";
+    snprintf(line, sizeof(line), METRICS_PREFIX "frames_dropped_total{reason=\"capture_failed\"} %u\n"
+             METRICS_PREFIX "frames_dropped_total{reason=\"too_large\"} %u\n"
+             METRICS_PREFIX "frames_dropped_total{reason=\"out_of_memory\"} %u\n"
+             METRICS_PREFIX "frames_dropped_total{reason=\"stream_skipped\"} %u\n",
+             (unsigned)frames_capture_failed.get(), (unsigned)frames_too_large.get(),
+             (unsigned)frames_copy_failed.get(),
+             (unsigned)frames_skipped_stream.get());
+    out += line;
+    gauge("fps", "Smoothed capture frame rate", fps.get());
+    
+    out += "# HELP " METRICS_PREFIX "stage_latency_seconds Time spent per pipeline stage\n"
+           "# TYPE " METRICS_PREFIX "stage_latency_seconds histogram\n";
+    for (int i = 0; i < STAGE_COUNT; i++) {
+      char labels[48];
+      snprintf(labels, sizeof(labels), "stage=\"%s\"", STAGE_NAMES[i]);
+      stage_latency[i].render(out, "stage_latency_seconds", labels, 1e-6);
+    }
+    
+    out += "# HELP " METRICS_PREFIX "blobs_per_frame Blobs found per detected frame\n"
+           "# TYPE " METRICS_PREFIX "blobs_per_frame histogram\n";
+    blobs_per_frame.render(out, "blobs_per_frame", "", 1.0);
+    
+    out += "# HELP " METRICS_PREFIX "gate_detections_total Region / color detections behind the change gate\n"
+           "# TYPE " METRICS_PREFIX "gate_detections_total counter\n";
+    snprintf(line, sizeof(line), METRICS_PREFIX "gate_detections_total{result=\"reused\"} %u\n"
+             METRICS_PREFIX "gate_detections_total{result=\"detected\"} %u\n",
+             (unsigned)gate_hits.get(), (unsigned)gate_misses.get());
+    out += line;
+    snprintf(line, sizeof(line), "# HELP " METRICS_PREFIX "gate_saved_seconds_total Detection time avoided by reuse\n"
+             "# TYPE " METRICS_PREFIX "gate_saved_seconds_total counter\n"
+             METRICS_PREFIX "gate_saved_seconds_total %.6f\n", gate_saved_ms.get() * 1e-3);
+    out += line;
+    gauge("gate_changed_tiles_ratio", "Fraction of tiles changed in the last gated frame", gate_changed_tiles.get());
+
+    counter("serial_bytes_out_total", "Bytes written by SimpleSerialSender", serial_bytes_out.get());
+    counter("commands_total", "Command lines processed", commands.get());
+    gauge("command_queue_depth", "Command lines drained by the last processCommands()", command_queue_depth.get());
+  }
+};
+
+// ========================================
+// GLOBAL ACCESS
+// ========================================
+
+inline PipelineMetrics& getMetrics() {
+  static PipelineMetrics instance;
+  return instance;
+}
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+unsigned long start = micros();
+camera_fb_t* fb = esp_camera_fb_get();
+getMetrics().observeStage(STAGE_CAPTURE, start);
+getMetrics().frames_captured.add();
+
+void handleMetrics() {
+  String body;
+  getMetrics().render(body);
+  server.send(200, "text/plain; version=0.0.4", body);
+}
+*/
+
+#endif // METRICS_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef NVS_STORAGE_H
+#define NVS_STORAGE_H
+
+#include "config_store.h"
+#include <Preferences.h>
+
+// ========================================
+// NVS CONFIGURATION STORAGE (ESP32)
+// ========================================
+
+// The configuration image as one blob in the ESP32's NVS partition, through
+// the Arduino Preferences library. NVS writes the new blob before it drops
+// the old one, so a reset in the middle of save() leaves the previous image.
+#define NVS_CONFIG_NAMESPACE "blobcam"
+#define NVS_CONFIG_KEY "config"
+
+class NvsStorage : public ConfigStorage {
+private:
+  Preferences prefs;
+  const char* name_space;
+
+public:
+  NvsStorage(const char* ns = NVS_CONFIG_NAMESPACE) : name_space(ns) {}
+  
+  bool read(std::vector<uint8_t>& out) override {
+    out.clear();
+    if (!prefs.begin(name_space, true)) return false;
+    size_t length = prefs.getBytesLength(NVS_CONFIG_KEY);
+    if (length > 0) {
+      out.resize(length);
+      if (prefs.getBytes(NVS_CONFIG_KEY, out.data(), length) != length) out.clear();
+    }
+    prefs.end();
+    return !out.empty();
+  }
+  
+  bool write(const uint8_t* data, size_t length) override {
+    if (!prefs.begin(name_space, false)) return false;
+    bool ok = prefs.putBytes(NVS_CONFIG_KEY, data, length) == length;
+    prefs.end();
+    return ok;
+  }
+  
+  bool erase() override {
+    if (!prefs.begin(name_space, false)) return false;
+    if (prefs.isKey(NVS_CONFIG_KEY)) prefs.remove(NVS_CONFIG_KEY);
+    prefs.end();
+    return true;
+  }
+};
+
+#endif // NVS_STORAGE_H
\ No newline at end of file
@@ -0,0 +1,309 @@
+#ifndef PYRAMID_DETECTOR_H
+#define PYRAMID_DETECTOR_H
+
+#include "blob_detector_ccl.h"
+#include <algorithm>
+#include <vector>
+
+// ========================================
+// COARSE-TO-FINE (PYRAMID) DETECTION
+// ========================================
+
+// Classifies one pixel pair per factor x factor cell straight from the
+// YUV422 frame, finds connected candidates on that coarse grid, and runs
+// detectSingleColorInto at full resolution only inside their dilated
+// bounding boxes. Only those windows are ever converted to HSV.
+
+// Candidate boxes grow by this many coarse cells on each side, so blob
+// edges that fell between samples are still inside the window
+#define PYRAMID_MARGIN 2
+
+// Full-resolution HSV is converted in blocks of this size, each at most once per frame
+#define PYRAMID_BLOCK 8
+
+struct PyramidStats {
+  uint32_t frames;
+  uint32_t coarse_pixels;     // Samples converted on the coarse grid
+  uint32_t fine_pixels;       // Pixels converted to HSV at full resolution
+  uint32_t labelled_pixels;   // Pixels labelled by full-resolution CCL
+  uint32_t full_pixels;       // Conversion + labelling a full-resolution pass would do
+  uint32_t windows;           // Candidate windows searched
+  
+  // Share of the full-resolution pixel work actually done
+  float workRatio() const {
+    return full_pixels ? float(coarse_pixels + fine_pixels + labelled_pixels) / full_pixels : 0.0f;
+  }
+};
+
+class PyramidDetector {
+private:
+  int factor;                     // 2 or 4
+  const uint8_t* frame;           // YUV422 of the current frame
+  int width;
+  int height;
+  
+  // Coarse grid, one HSV sample per cell
+  int coarse_w;
+  int coarse_h;
+  std::vector<uint8_t> coarse_h_data;
+  std::vector<uint8_t> coarse_s_data;
+  std::vector<uint8_t> coarse_v_data;
+  
+  // Full-size workspace; only converted blocks hold valid pixels
+  HSVImage hsv;
+  std::vector<uint8_t> converted;
+  int blocks_x;
+  
+  std::vector<uint8_t> coarse_mask;
+  std::vector<int> stack;
+  std::vector<DetectionRegion> windows;   // Of the region / color being searched
+  std::vector<Blob> region_blobs;         // Blobs of all its windows
+  PyramidStats counters;
+  
+  void convertWindow(const DetectionRegion& window) {
+    int bx0 = window.x / PYRAMID_BLOCK;
+    int by0 = window.y / PYRAMID_BLOCK;
+    int bx1 = (window.x + window.width - 1) / PYRAMID_BLOCK;
+    int by1 = (window.y + window.height - 1) / PYRAMID_BLOCK;
+    
+    for (int by = by0; by <= by1; by++) {
+      for (int bx = bx0; bx <= bx1; bx++) {
+        uint8_t& done = converted[by * blocks_x + bx];
+        if (done) continue;
+        done = 1;
+        
+        int x1 = std::min(width, (bx + 1) * PYRAMID_BLOCK);
+        int y1 = std::min(height, (by + 1) * PYRAMID_BLOCK);
+        for (int y = by * PYRAMID_BLOCK; y < y1; y++) {
+          for (int x = bx * PYRAMID_BLOCK; x < x1; x += 2) {
+            int i = y * width + x;
+            const uint8_t* p = frame + i * 2;   // Y0 U Y1 V
+            yuvPixelToHSV(p[0], p[1], p[3], hsv.h_data[i], hsv.s_data[i], hsv.v_data[i]);
+            if (x + 1 < x1) {
+              yuvPixelToHSV(p[2], p[1], p[3], hsv.h_data[i + 1], hsv.s_data[i + 1], hsv.v_data[i + 1]);
+            }
+          }
+        }
+        counters.fine_pixels += (x1 - bx * PYRAMID_BLOCK) * (y1 - by * PYRAMID_BLOCK);
+      }
+    }
+  }
+  
+  // Dilated full-resolution boxes of the coarse components inside region,
+  // into windows
+  void findWindows(const DetectionRegion& region, ColorId color, const ColorSet& colors, int min_size) {
+    int rx0 = std::max(0, region.x);
+    int ry0 = std::max(0, region.y);
+    int rx1 = std::min(width, region.x + region.width);
+    int ry1 = std::min(height, region.y + region.height);
+    windows.clear();
+    if (rx1 <= rx0 || ry1 <= ry0) return;
+    
+    // Coarse cells whose sample lies inside the region
+    int cx0 = (rx0 + factor - 1) / factor;
+    int cy0 = (ry0 + factor - 1) / factor;
+    int cx1 = std::min(coarse_w, (rx1 + factor - 1) / factor);
+    int cy1 = std::min(coarse_h, (ry1 + factor - 1) / factor);
+    
+    for (int cy = cy0; cy < cy1; cy++) {
+      for (int cx = cx0; cx < cx1; cx++) {
+        int i = cy * coarse_w + cx;
+        coarse_mask[i] = colors.matchesColor(coarse_h_data[i], coarse_s_data[i], coarse_v_data[i], color);
+      }
+    }
+    
+    // A blob of min_size pixels covers about min_size / factor^2 cells;
+    // halve that so thin or ragged blobs are not dropped here
+    int min_cells = std::max(1, min_size / (factor * factor * 2));
+    int margin = PYRAMID_MARGIN * factor;
+    
+    // 8-connected components by flood fill; visited cells are cleared
+    for (int cy = cy0; cy < cy1; cy++) {
+      for (int cx = cx0; cx < cx1; cx++) {
+        if (!coarse_mask[cy * coarse_w + cx]) continue;
+        
+        int min_x = cx, max_x = cx, min_y = cy, max_y = cy, cells = 0;
+        coarse_mask[cy * coarse_w + cx] = 0;
+        stack.assign(1, cy * coarse_w + cx);
+        while (!stack.empty()) {
+          int i = stack.back();
+          stack.pop_back();
+          int x = i % coarse_w, y = i / coarse_w;
+          cells++;
+          min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+          min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+          
+          for (int ny = std::max(cy0, y - 1); ny <= std::min(cy1 - 1, y + 1); ny++) {
+            for (int nx = std::max(cx0, x - 1); nx <= std::min(cx1 - 1, x + 1); nx++) {
+              int n = ny * coarse_w + nx;
+              if (coarse_mask[n]) {
+                coarse_mask[n] = 0;
+                stack.push_back(n);
+              }
+            }
+          }
+        }
+        if (cells < min_cells) continue;
+        
+        int x0 = std::max(rx0, min_x * factor - margin);
+        int y0 = std::max(ry0, min_y * factor - margin);
+        int x1 = std::min(rx1, (max_x + 1) * factor + margin);
+        int y1 = std::min(ry1, (max_y + 1) * factor + margin);
+        DetectionRegion window(x0, y0, x1 - x0, y1 - y0);
+        window.shape = region.shape;
+        windows.push_back(window);
+      }
+    }
+    
+    mergeSearchWindows(windows);
+  }
+  
+  // The blobs of one region and color into out, with the labelling
+  // buffers of work
+  void detectInto(const DetectionRegion& region, ColorId color, const ColorSet& colors, int min_size,
+                  LabelWorkspace& work, std::vector<Blob>& out) {
+    out.clear();
+    if (!frame || !colors.hasColor(color)) return;
+    
+    int clipped_w = std::min(width, region.x + region.width) - std::max(0, region.x);
+    int clipped_h = std::min(height, region.y + region.height) - std::max(0, region.y);
+    if (clipped_w > 0 && clipped_h > 0) counters.full_pixels += clipped_w * clipped_h;
+    
+    findWindows(region, color, colors, min_size);
+    for (const DetectionRegion& window : windows) {
+      convertWindow(window);
+      detectSingleColorInto(hsv, window, color, colors, work, work.found, min_size);
+      out.insert(out.end(), work.found.begin(), work.found.end());
+      counters.labelled_pixels += window.width * window.height;
+      counters.windows++;
+    }
+  }
+
+public:
+  PyramidDetector(int decimation = 2)
+    : factor(decimation == 4 ? 4 : 2), frame(nullptr), width(0), height(0),
+      coarse_w(0), coarse_h(0), blocks_x(0), counters() {}
+  
+  ~PyramidDetector() {
+    hsv.clear();
+  }
+  
+  PyramidDetector(const PyramidDetector&) = delete;
+  PyramidDetector& operator=(const PyramidDetector&) = delete;
+  
+  // 2 or 4; takes effect with the next setFrame()
+  void setFactor(int decimation) {
+    factor = decimation == 4 ? 4 : 2;
+  }
+  
+  int getFactor() const { return factor; }
+  
+  // Sample the coarse grid of a new frame. The frame must stay valid until
+  // the last detect() for it.
+  bool setFrame(const uint8_t* yuv422, int w, int h) {
+    if (w != width || h != height || !hsv.isValid()) {
+      hsv.clear();
+      hsv.h_data = (uint8_t*)malloc(w * h);
+      hsv.s_data = (uint8_t*)malloc(w * h);
+      hsv.v_data = (uint8_t*)malloc(w * h);
+      if (!hsv.h_data || !hsv.s_data || !hsv.v_data) {
+        hsv.clear();
+        width = height = 0;
+        return false;
+      }
+      hsv.width = width = w;
+      hsv.height = height = h;
+    }
+    
+    frame = yuv422;
+    blocks_x = (width + PYRAMID_BLOCK - 1) / PYRAMID_BLOCK;
+    converted.assign(blocks_x * ((height + PYRAMID_BLOCK - 1) / PYRAMID_BLOCK), 0);
+    
+    coarse_w = (width + factor - 1) / factor;
+    coarse_h = (height + factor - 1) / factor;
+    coarse_h_data.resize(coarse_w * coarse_h);
+    coarse_s_data.resize(coarse_w * coarse_h);
+    coarse_v_data.resize(coarse_w * coarse_h);
+    coarse_mask.assign(coarse_w * coarse_h, 0);
+    
+    // One pixel pair per cell: mean luma of the pair, its shared chroma
+    for (int cy = 0; cy < coarse_h; cy++) {
+      const uint8_t* row = frame + (cy * factor) * width * 2;
+      for (int cx = 0; cx < coarse_w; cx++) {
+        const uint8_t* p = row + (cx * factor) * 2;
+        uint8_t luma = (p[0] + p[2] + 1) >> 1;
+        int i = cy * coarse_w + cx;
+        yuvPixelToHSV(luma, p[1], p[3], coarse_h_data[i], coarse_s_data[i], coarse_v_data[i]);
+      }
+    }
+    
+    counters.frames++;
+    counters.coarse_pixels += coarse_w * coarse_h;
+    counters.full_pixels += width * height;
+    return true;
+  }
+  
+  // Same blobs as detectSingleColorCCL over region, searched only where the
+  // coarse grid saw the color
+  std::vector<Blob> detect(const DetectionRegion& region, ColorId color, int min_size = 10) {
+    LabelWorkspace work;
+    std::vector<Blob> blobs;
+    detectInto(region, color, *getColorManager().snapshot(), min_size, work, blobs);
+    return blobs;
+  }
+  
+  // Drop-in for detectBlobsInto() on the frame given to setFrame(); the
+  // labelling buffers are those of the arena
+  void detect(const std::vector<DetectionRegion>& regions, const std::vector<ColorId>& colors_to_detect,
+              DetectionResults& results, bool multi_blob_per_color = true, int min_size = 10) {
+    results.begin(regions.size(), colors_to_detect);
+    ColorSnapshot color_set = getColorManager().snapshot();
+    
+    for (size_t region_idx = 0; region_idx < regions.size(); region_idx++) {
+      for (size_t c = 0; c < colors_to_detect.size(); c++) {
+        detectInto(regions[region_idx], colors_to_detect[c], *color_set, min_size, results.workspace(),
+                   region_blobs);
+        results.setSlot(region_idx, c, region_blobs, !multi_blob_per_color);
+      }
+    }
+  }
+  
+  // Drop-in for detectBlobsInto() on a compiled set: each region is searched
+  // over the pixels it owns, so a blob in an overlap is reported once
+  void detect(const CompiledRegionSet& compiled, const std::vector<ColorId>& colors_to_detect,
+              DetectionResults& results, bool multi_blob_per_color = true, int min_size = 10) {
+    detect(compiled.owned_regions, colors_to_detect, results, multi_blob_per_color, min_size);
+  }
+  
+  // Drop-in for detectBlobsStructured() on the frame given to setFrame()
+  std::vector<RegionResults> detect(const std::vector<DetectionRegion>& regions,
+                                    const std::vector<ColorId>& colors_to_detect,
+                                    bool multi_blob_per_color = true, int min_size = 10) {
+    DetectionResults results;
+    detect(regions, colors_to_detect, results, multi_blob_per_color, min_size);
+    return results.toRegionResults();
+  }
+  
+  const PyramidStats& stats() const { return counters; }
+  
+  void resetStats() { counters = PyramidStats(); }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+PyramidDetector pyramid(4);
+DetectionResults results;   // Reused every frame
+
+void detectFrame(const uint8_t* yuv422, int width, int height) {
+  if (!pyramid.setFrame(yuv422, width, height)) return;
+  
+  std::vector<DetectionRegion> regions = {DetectionRegion(0, 0, width, height)};
+  pyramid.detect(regions, resolveColors({"RED", "GREEN"}), results);
+  
+  Serial.printf("%.0f%% of full-resolution pixel work\n", 100 * pyramid.stats().workRatio());
+}
+*/
+
+#endif // PYRAMID_DETECTOR_H
\ No newline at end of file
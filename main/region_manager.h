@@ -1,70 +1,548 @@
 #ifndef REGION_MANAGER_H
 #define REGION_MANAGER_H
 
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 // ========================================
 // DETECTION REGION STRUCTURE
 // ========================================
 
+// Regions may reach past the frame (they are clipped), but every corner
+// must lie within +-REGION_COORD_LIMIT: spans are int16_t, and a shape
+// keeps one entry per row of its box
+#define REGION_COORD_LIMIT 2048
+
+// [x0, x1) on one image row
+struct RowSpan {
+  int16_t x0, x1;
+};
+
+// The pixels of a region that is not a plain rectangle (polygon, uploaded
+// mask), as sorted disjoint spans per row in image coordinates
+struct RegionShape {
+  int y0;                       // First row
+  std::vector<int> row_first;   // Row y: spans[row_first[y - y0] .. row_first[y - y0 + 1])
+  std::vector<RowSpan> spans;
+  int pixels;
+  
+  RegionShape() : y0(0), pixels(0) {}
+  
+  int rows() const { return row_first.empty() ? 0 : row_first.size() - 1; }
+};
+
 struct DetectionRegion {
-  int x, y, width, height;
+  int x, y, width, height;                    // Bounding box
+  std::shared_ptr<const RegionShape> shape;   // Null for a rectangle
   
   DetectionRegion(int _x, int _y, int _w, int _h) : x(_x), y(_y), width(_w), height(_h) {}
   
   bool contains(int px, int py) const {
-    return px >= x && px < x + width && py >= y && py < y + height;
+    if (px < x || px >= x + width || py < y || py >= y + height) return false;
+    if (!shape) return true;
+    
+    int row = py - shape->y0;
+    if (row < 0 || row >= shape->rows()) return false;
+    for (int i = shape->row_first[row]; i < shape->row_first[row + 1]; i++) {
+      if (px >= shape->spans[i].x0 && px < shape->spans[i].x1) return true;
+    }
+    return false;
+  }
+  
+  // Pixels inside; the shape's count if it lies within the box
+  int area() const {
+    return shape ? shape->pixels : width * height;
+  }
+};
+
+// Box with corners inside +-REGION_COORD_LIMIT and no negative size
+inline bool regionBoxValid(long x, long y, long width, long height) {
+  return x >= -REGION_COORD_LIMIT && y >= -REGION_COORD_LIMIT && width >= 0 && height >= 0 &&
+         x + width <= REGION_COORD_LIMIT && y + height <= REGION_COORD_LIMIT;
+}
+
+// Part of a region clipped to the image; width / height 0 if none of it is inside
+inline DetectionRegion clipRegion(const DetectionRegion& r, int image_width, int image_height) {
+  int x0 = std::max(0, r.x);
+  int y0 = std::max(0, r.y);
+  int x1 = std::min(image_width, r.x + r.width);
+  int y1 = std::min(image_height, r.y + r.height);
+  if (x1 <= x0 || y1 <= y0) return DetectionRegion(0, 0, 0, 0);
+  DetectionRegion clipped(x0, y0, x1 - x0, y1 - y0);
+  clipped.shape = r.shape;
+  return clipped;
+}
+
+// Append the region's spans on row y, cut to its bounding box
+inline void appendRowSpans(const DetectionRegion& r, int y, std::vector<RowSpan>& out) {
+  if (r.width <= 0 || y < r.y || y >= r.y + r.height) return;
+  if (!r.shape) {
+    out.push_back({int16_t(r.x), int16_t(r.x + r.width)});
+    return;
+  }
+  
+  int row = y - r.shape->y0;
+  if (row < 0 || row >= r.shape->rows()) return;
+  for (int i = r.shape->row_first[row]; i < r.shape->row_first[row + 1]; i++) {
+    int x0 = std::max(r.x, int(r.shape->spans[i].x0));
+    int x1 = std::min(r.x + r.width, int(r.shape->spans[i].x1));
+    if (x1 > x0) out.push_back({int16_t(x0), int16_t(x1)});
+  }
+}
+
+// ========================================
+// SHAPED REGIONS
+// ========================================
+
+struct RegionPoint {
+  int x, y;
+};
+
+// Region with the box trimmed to shape's spans; width 0 if it has none
+inline DetectionRegion shapedRegion(RegionShape& shape) {
+  int x0 = 0x7FFF, x1 = -0x7FFF, first = -1, last = -1;
+  shape.pixels = 0;
+  for (int row = 0; row < shape.rows(); row++) {
+    for (int i = shape.row_first[row]; i < shape.row_first[row + 1]; i++) {
+      x0 = std::min(x0, int(shape.spans[i].x0));
+      x1 = std::max(x1, int(shape.spans[i].x1));
+      shape.pixels += shape.spans[i].x1 - shape.spans[i].x0;
+      if (first < 0) first = row;
+      last = row;
+    }
+  }
+  if (first < 0) return DetectionRegion(0, 0, 0, 0);
+  
+  DetectionRegion region(x0, shape.y0 + first, x1 - x0, last - first + 1);
+  region.shape = std::make_shared<const RegionShape>(shape);
+  return region;
+}
+
+// A pixel is inside when its center is (even-odd rule), so polygons that
+// share an edge never share a pixel. Width 0 if a point is outside
+// +-REGION_COORD_LIMIT.
+inline DetectionRegion polygonRegion(const std::vector<RegionPoint>& points) {
+  RegionShape shape;
+  if (points.size() < 3) return DetectionRegion(0, 0, 0, 0);
+  for (const RegionPoint& p : points) {
+    if (!regionBoxValid(p.x, p.y, 0, 0)) return DetectionRegion(0, 0, 0, 0);
+  }
+  
+  int min_y = points[0].y, max_y = points[0].y;
+  for (const RegionPoint& p : points) {
+    min_y = std::min(min_y, p.y);
+    max_y = std::max(max_y, p.y);
+  }
+  
+  shape.y0 = min_y;
+  std::vector<float> crossings;
+  for (int y = min_y; y < max_y; y++) {
+    shape.row_first.push_back(shape.spans.size());
+    float yc = y + 0.5f;
+    
+    crossings.clear();
+    for (size_t i = 0; i < points.size(); i++) {
+      const RegionPoint& a = points[i];
+      const RegionPoint& b = points[(i + 1) % points.size()];
+      if ((a.y <= yc) == (b.y <= yc)) continue;
+      crossings.push_back(a.x + (yc - a.y) * (b.x - a.x) / float(b.y - a.y));
+    }
+    std::sort(crossings.begin(), crossings.end());
+    
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      int x0 = int(std::ceil(crossings[i] - 0.5f));
+      int x1 = int(std::ceil(crossings[i + 1] - 0.5f));
+      if (x1 > x0) shape.spans.push_back({int16_t(x0), int16_t(x1)});
+    }
+  }
+  shape.row_first.push_back(shape.spans.size());
+  return shapedRegion(shape);
+}
+
+// From a width x height mask placed at x, y; nonzero bytes are inside.
+// Width 0 if the box is not regionBoxValid().
+inline DetectionRegion maskRegion(int x, int y, int width, int height, const uint8_t* mask) {
+  RegionShape shape;
+  if (!regionBoxValid(x, y, width, height)) return DetectionRegion(0, 0, 0, 0);
+  shape.y0 = y;
+  for (int row = 0; row < height; row++) {
+    shape.row_first.push_back(shape.spans.size());
+    const uint8_t* m = mask + row * width;
+    for (int i = 0; i < width; ) {
+      if (!m[i]) { i++; continue; }
+      int start = i;
+      while (i < width && m[i]) i++;
+      shape.spans.push_back({int16_t(x + start), int16_t(x + i)});
+    }
   }
+  shape.row_first.push_back(shape.spans.size());
+  return shapedRegion(shape);
+}
+
+// ========================================
+// COMPILED REGION SETS
+// ========================================
+
+// A region set prepared for one image size: every region clipped, the
+// union of all regions as disjoint spans per row, and per region the spans
+// it owns. A pixel covered by several regions belongs to the first of them,
+// so a blob in an overlap is reported once. Classifying pixels along the
+// union touches each pixel once, however many regions overlap there.
+struct CompiledRegionSet {
+  int image_width;
+  int image_height;
+  std::vector<DetectionRegion> regions;   // Clipped, same order and ids as the set
+  std::vector<RegionShape> owned;         // Per region, rows of its clipped box
+  std::vector<DetectionRegion> owned_regions;   // Per region, its clipped box limited to owned, for
+                                                // detectors that label one region at a time
+  std::vector<RowSpan> spans;             // Sorted by row, then x
+  std::vector<int> row_first;             // Row y: spans[row_first[y] .. row_first[y + 1])
+  int covered_pixels;                     // Pixels inside at least one region
+  int region_pixels;                      // Sum of the clipped region areas
+  
+  CompiledRegionSet() : image_width(0), image_height(0), covered_pixels(0), region_pixels(0) {}
 };
 
+// Sorted, merged union of spans
+inline void mergeSpans(std::vector<RowSpan>& spans) {
+  std::sort(spans.begin(), spans.end(), [](const RowSpan& a, const RowSpan& b) { return a.x0 < b.x0; });
+  size_t n = 0;
+  for (const RowSpan& span : spans) {
+    if (n > 0 && span.x0 <= spans[n - 1].x1) {
+      spans[n - 1].x1 = std::max(spans[n - 1].x1, span.x1);
+    } else {
+      spans[n++] = span;
+    }
+  }
+  spans.resize(n);
+}
+
+inline void compileRegionSet(const std::vector<DetectionRegion>& regions, int image_width,
+                             int image_height, CompiledRegionSet& out) {
+  out.image_width = image_width;
+  out.image_height = image_height;
+  out.regions.clear();
+  out.owned.assign(regions.size(), RegionShape());
+  out.spans.clear();
+  out.row_first.assign(image_height + 1, 0);
+  out.covered_pixels = 0;
+  out.region_pixels = 0;
+  
+  for (size_t i = 0; i < regions.size(); i++) {
+    out.regions.push_back(clipRegion(regions[i], image_width, image_height));
+    out.owned[i].y0 = out.regions[i].y;
+  }
+  
+  // Row by row: each region gets what the regions before it left over,
+  // then joins the union that later regions are cut against
+  std::vector<RowSpan> taken, mine;
+  for (int y = 0; y < image_height; y++) {
+    taken.clear();
+    for (size_t i = 0; i < out.regions.size(); i++) {
+      const DetectionRegion& r = out.regions[i];
+      if (r.width == 0 || y < r.y || y >= r.y + r.height) continue;
+      
+      RegionShape& owned = out.owned[i];
+      owned.row_first.push_back(owned.spans.size());
+      mine.clear();
+      appendRowSpans(r, y, mine);
+      
+      for (const RowSpan& span : mine) {
+        out.region_pixels += span.x1 - span.x0;
+        int x = span.x0;
+        for (const RowSpan& t : taken) {
+          if (t.x1 <= x || t.x0 >= span.x1) continue;
+          if (t.x0 > x) owned.spans.push_back({int16_t(x), t.x0});
+          x = std::max(x, int(t.x1));
+        }
+        if (x < span.x1) owned.spans.push_back({int16_t(x), span.x1});
+      }
+      for (size_t k = owned.row_first.back(); k < owned.spans.size(); k++) {
+        owned.pixels += owned.spans[k].x1 - owned.spans[k].x0;
+      }
+      
+      taken.insert(taken.end(), mine.begin(), mine.end());
+      mergeSpans(taken);
+    }
+    
+    out.row_first[y] = out.spans.size();
+    for (const RowSpan& span : taken) {
+      out.spans.push_back(span);
+      out.covered_pixels += span.x1 - span.x0;
+    }
+  }
+  out.row_first[image_height] = out.spans.size();
+  
+  for (RegionShape& owned : out.owned) {
+    owned.row_first.push_back(owned.spans.size());
+  }
+  
+  out.owned_regions.clear();
+  for (size_t i = 0; i < out.regions.size(); i++) {
+    DetectionRegion region = out.regions[i];
+    region.shape = std::make_shared<const RegionShape>(out.owned[i]);
+    out.owned_regions.push_back(region);
+  }
+}
+
+// ========================================
+// REGION SET HANDLES
+// ========================================
+
+// Small integer standing for a region set name, resolved once when a command
+// is parsed. Like color handles, a handle stays bound to its name after the
+// set is deleted and comes back to life when the name is set again.
+typedef uint8_t RegionSetId;
+
+#define REGION_SET_NONE 0xFF    // No handle: unknown name or table full
+#define REGION_SET_MAX_IDS 64   // Names ever interned
+
+// ========================================
+// REGION SET SNAPSHOTS
+// ========================================
+
+// Every region set at one moment, compiled for the image size the manager
+// was last told about. Never changed once published; like ColorSet it is
+// safe to read on any core for as long as the RegionSnapshot is held.
+class RegionSetTable {
+  friend class RegionManager;
+  friend class ConfigStore;
+  
+  struct RegionSetEntry {
+    std::string name;
+    std::vector<DetectionRegion> regions;
+    std::shared_ptr<const CompiledRegionSet> compiled;   // For image_width x image_height, shared between snapshots
+    bool defined;
+  };
+  
+  std::vector<RegionSetEntry> entries;                 // Indexed by RegionSetId
+  std::unordered_map<std::string, RegionSetId> ids;    // Name -> handle, protocol side only
+  int image_width;
+  int image_height;
+  
+  // Compile the sets that changed since the last snapshot
+  void compile() {
+    if (image_width <= 0 || image_height <= 0) return;
+    for (RegionSetEntry& entry : entries) {
+      if (!entry.defined || entry.compiled) continue;
+      std::shared_ptr<CompiledRegionSet> compiled = std::make_shared<CompiledRegionSet>();
+      compileRegionSet(entry.regions, image_width, image_height, *compiled);
+      entry.compiled = std::move(compiled);
+    }
+  }
+
+public:
+  RegionSetTable() : image_width(0), image_height(0) {}
+  
+  // Handle of a name seen before, REGION_SET_NONE otherwise
+  RegionSetId findRegionSet(const std::string& set_name) const {
+    auto it = ids.find(set_name);
+    return it != ids.end() ? it->second : REGION_SET_NONE;
+  }
+  
+  const std::string& regionSetName(RegionSetId id) const {
+    static const std::string unknown = "?";
+    return id < entries.size() ? entries[id].name : unknown;
+  }
+  
+  bool hasRegionSet(RegionSetId id) const {
+    return id < entries.size() && entries[id].defined;
+  }
+  
+  bool hasRegionSet(const std::string& set_name) const {
+    return hasRegionSet(findRegionSet(set_name));
+  }
+  
+  const std::vector<DetectionRegion>& getRegions(RegionSetId id) const {
+    static const std::vector<DetectionRegion> empty_vector;
+    return hasRegionSet(id) ? entries[id].regions : empty_vector;
+  }
+  
+  // The set compiled for this image size: the stored one, or compiled now
+  // (and not kept) for any other size. Unknown sets give an empty result.
+  std::shared_ptr<const CompiledRegionSet> getCompiledRegionSet(RegionSetId id, int width, int height) const {
+    static const std::shared_ptr<const CompiledRegionSet> empty_set = std::make_shared<CompiledRegionSet>();
+    if (!hasRegionSet(id)) return empty_set;
+    
+    const RegionSetEntry& entry = entries[id];
+    if (entry.compiled && entry.compiled->image_width == width && entry.compiled->image_height == height) {
+      return entry.compiled;
+    }
+    std::shared_ptr<CompiledRegionSet> compiled = std::make_shared<CompiledRegionSet>();
+    compileRegionSet(entry.regions, width, height, *compiled);
+    return compiled;
+  }
+  
+  int imageWidth() const { return image_width; }
+  int imageHeight() const { return image_height; }
+  
+  std::vector<std::string> getAllRegionSetNames() const {
+    std::vector<std::string> names;
+    for (const auto& entry : entries) {
+      if (entry.defined) names.push_back(entry.name);
+    }
+    return names;
+  }
+};
+
+typedef std::shared_ptr<const RegionSetTable> RegionSnapshot;
+
+// Snapshot a ConfigPin holds for this thread, null when none does
+inline const RegionSnapshot*& pinnedRegionSets() {
+  static thread_local const RegionSnapshot* pinned = nullptr;
+  return pinned;
+}
+
 // ========================================
 // REGION MANAGER CLASS
 // ========================================
 
+// Publishes RegionSetTable snapshots the way ColorThresholdManager does:
+// writers copy, change, compile and swap; readers never wait.
 class RegionManager {
 private:
-  std::unordered_map<std::string, std::vector<DetectionRegion>> region_sets;
+  RegionSnapshot current;   // Only replaced under writer
+  std::mutex writer;
+  
+  // Handle of name in table, appended there if new
+  static RegionSetId intern(RegionSetTable& table, const std::string& set_name) {
+    auto it = table.ids.find(set_name);
+    if (it != table.ids.end()) return it->second;
+    if (table.entries.size() >= REGION_SET_MAX_IDS) return REGION_SET_NONE;
+    
+    RegionSetId id = static_cast<RegionSetId>(table.entries.size());
+    table.entries.push_back({set_name, {}, nullptr, false});
+    table.ids[set_name] = id;
+    return id;
+  }
+  
+  // Called with writer held
+  std::shared_ptr<RegionSetTable> edit() const {
+    return std::make_shared<RegionSetTable>(*current);
+  }
   
+  void publish(std::shared_ptr<RegionSetTable> next) {
+    next->compile();
+    std::atomic_store(&current, RegionSnapshot(std::move(next)));
+  }
+  
+  void store(RegionSetTable& table, RegionSetId id, const std::vector<DetectionRegion>& regions) {
+    table.entries[id].regions = regions;
+    table.entries[id].compiled = nullptr;
+    table.entries[id].defined = true;
+  }
+
 public:
-  RegionManager() {}
+  RegionManager() : current(std::make_shared<RegionSetTable>()) {}
+  
+  RegionManager(const RegionManager&) = delete;
+  RegionManager& operator=(const RegionManager&) = delete;
+  
+  // The pinned snapshot inside a ConfigPin, the current one otherwise
+  RegionSnapshot snapshot() const {
+    const RegionSnapshot* pinned = pinnedRegionSets();
+    return pinned ? *pinned : std::atomic_load(&current);
+  }
+  
+  // ========================================
+  // HANDLES
+  // ========================================
+  
+  // Handle for name, reserved now if the set is not defined yet
+  RegionSetId regionSetId(const std::string& set_name) {
+    RegionSetId id = snapshot()->findRegionSet(set_name);
+    if (id != REGION_SET_NONE) return id;
+    
+    std::lock_guard<std::mutex> lock(writer);
+    if (current->findRegionSet(set_name) != REGION_SET_NONE) return current->findRegionSet(set_name);
+    if (current->entries.size() >= REGION_SET_MAX_IDS) return REGION_SET_NONE;
+    std::shared_ptr<RegionSetTable> next = edit();
+    id = intern(*next, set_name);
+    publish(std::move(next));
+    return id;
+  }
+  
+  // Handle of a name seen before, REGION_SET_NONE otherwise
+  RegionSetId findRegionSet(const std::string& set_name) const {
+    return snapshot()->findRegionSet(set_name);
+  }
+  
+  std::string regionSetName(RegionSetId id) const {
+    return snapshot()->regionSetName(id);
+  }
   
   // ========================================
   // ESSENTIAL OPERATIONS
   // ========================================
   
-  // Create/Add region set
-  void setRegionSet(const std::string& set_name, const DetectionRegion& region) {
-    region_sets[set_name] = {region};
+  // Create/Add region set; false only when the handle table is full
+  bool setRegionSet(const std::string& set_name, const DetectionRegion& region) {
+    return setRegionSet(set_name, std::vector<DetectionRegion>{region});
   }
   
-  void setRegionSet(const std::string& set_name, const std::vector<DetectionRegion>& regions) {
-    region_sets[set_name] = regions;
+  bool setRegionSet(const std::string& set_name, const std::vector<DetectionRegion>& regions) {
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<RegionSetTable> next = edit();
+    RegionSetId id = intern(*next, set_name);
+    if (id == REGION_SET_NONE) return false;
+    store(*next, id, regions);
+    publish(std::move(next));
+    return true;
   }
   
   // Edit existing region set
   bool editRegionSet(const std::string& set_name, const DetectionRegion& region) {
-    auto it = region_sets.find(set_name);
-    if (it != region_sets.end()) {
-      it->second = {region};
-      return true;
-    }
-    return false;
+    return editRegionSet(set_name, std::vector<DetectionRegion>{region});
   }
   
   bool editRegionSet(const std::string& set_name, const std::vector<DetectionRegion>& regions) {
-    auto it = region_sets.find(set_name);
-    if (it != region_sets.end()) {
-      it->second = regions;
-      return true;
-    }
-    return false;
+    std::lock_guard<std::mutex> lock(writer);
+    RegionSetId id = current->findRegionSet(set_name);
+    if (!current->hasRegionSet(id)) return false;
+    std::shared_ptr<RegionSetTable> next = edit();
+    store(*next, id, regions);
+    publish(std::move(next));
+    return true;
   }
   
   // Delete region set
   bool deleteRegionSet(const std::string& set_name) {
-    return region_sets.erase(set_name) > 0;
+    std::lock_guard<std::mutex> lock(writer);
+    RegionSetId id = current->findRegionSet(set_name);
+    if (!current->hasRegionSet(id)) return false;
+    std::shared_ptr<RegionSetTable> next = edit();
+    next->entries[id].regions.clear();
+    next->entries[id].compiled = nullptr;
+    next->entries[id].defined = false;
+    publish(std::move(next));
+    return true;
+  }
+  
+  // Image size the published sets are compiled for; a change compiles
+  // every set again
+  void setImageSize(int width, int height) {
+    std::lock_guard<std::mutex> lock(writer);
+    if (current->image_width == width && current->image_height == height) return;
+    std::shared_ptr<RegionSetTable> next = edit();
+    next->image_width = width;
+    next->image_height = height;
+    for (auto& entry : next->entries) entry.compiled = nullptr;
+    publish(std::move(next));
+  }
+  
+  // Replace every region set at once with a table built elsewhere
+  // (ConfigStore), compiled here for its own image size. Its handles
+  // replace the current ones.
+  void restore(std::shared_ptr<RegionSetTable> table) {
+    std::lock_guard<std::mutex> lock(writer);
+    for (auto& entry : table->entries) entry.compiled = nullptr;
+    publish(std::move(table));
   }
   
   // ========================================
@@ -72,28 +550,45 @@ public:
   // ========================================
   
   // Check if region set exists
+  bool hasRegionSet(RegionSetId id) const {
+    return snapshot()->hasRegionSet(id);
+  }
+  
   bool hasRegionSet(const std::string& set_name) const {
-    return region_sets.find(set_name) != region_sets.end();
+    return snapshot()->hasRegionSet(set_name);
   }
   
   // Get regions from set
-  const std::vector<DetectionRegion>& getRegions(const std::string& set_name) const {
-    auto it = region_sets.find(set_name);
-    if (it != region_sets.end()) {
-      return it->second;
+  std::vector<DetectionRegion> getRegions(RegionSetId id) const {
+    return snapshot()->getRegions(id);
+  }
+  
+  std::vector<DetectionRegion> getRegions(const std::string& set_name) const {
+    RegionSnapshot table = snapshot();
+    return table->getRegions(table->findRegionSet(set_name));
+  }
+  
+  // Regions clipped to this image size plus their per-row spans. The first
+  // request for a new size makes it the size later snapshots are compiled
+  // for; until then (and inside a ConfigPin taken before) it is compiled
+  // per call. Unknown sets give an empty result.
+  std::shared_ptr<const CompiledRegionSet> getCompiledRegionSet(RegionSetId id, int image_width, int image_height) {
+    RegionSnapshot table = snapshot();
+    if (table->imageWidth() != image_width || table->imageHeight() != image_height) {
+      setImageSize(image_width, image_height);
+      table = snapshot();
     }
-    static const std::vector<DetectionRegion> empty_vector;
-    return empty_vector;
+    return table->getCompiledRegionSet(id, image_width, image_height);
+  }
+  
+  std::shared_ptr<const CompiledRegionSet> getCompiledRegionSet(const std::string& set_name, int image_width,
+                                                                int image_height) {
+    return getCompiledRegionSet(findRegionSet(set_name), image_width, image_height);
   }
   
   // Get all region set names
   std::vector<std::string> getAllRegionSetNames() const {
-    std::vector<std::string> names;
-    names.reserve(region_sets.size());
-    for (const auto& pair : region_sets) {
-      names.push_back(pair.first);
-    }
-    return names;
+    return snapshot()->getAllRegionSetNames();
   }
 };
 
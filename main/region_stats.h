@@ -0,0 +1,289 @@
+#ifndef REGION_STATS_H
+#define REGION_STATS_H
+
+#include "simple_converter.h"
+#include "color_threshold_manager.h"
+#include "region_manager.h"
+#include <cstring>
+#include <vector>
+
+// ========================================
+// PER-REGION COLOR STATISTICS
+// ========================================
+
+// Coverage and mean color per region: every H, S and V value of a region
+// is counted and, per requested color, the matching pixels; histograms and
+// means come from the value counts once per region. Each pixel counts for
+// the region that owns it (the first one listing it), as in detection.
+//
+// On a frame that is detected anyway, pass a RegionStats vector to
+// detectBlobsInto(): the coverage is the match count its classification
+// already has and the value counts ride along on its first color pass,
+// 12-19% on top of the detection in bench/region_stats_bench.cpp.
+// computeRegionStats() below is the pass of its own for frames with no
+// detection, 34-39% of a detection there; nothing is labelled and no mask
+// is kept, and colors are tested through per-channel bit tables, so a
+// pixel costs three loads and an AND however many colors are asked for.
+
+#define STATS_BINS 16             // Histogram bins per channel (H: 180 / 16 per bin, S / V: 16 per bin)
+
+struct RegionStats {
+  uint32_t pixels;                // Pixels of the region inside the image
+  uint32_t sum_h, sum_s, sum_v;
+  uint32_t hist_h[STATS_BINS];
+  uint32_t hist_s[STATS_BINS];
+  uint32_t hist_v[STATS_BINS];
+  std::vector<uint32_t> color_pixels;   // Per requested color, in request order
+  
+  void reset(size_t colors) {
+    pixels = sum_h = sum_s = sum_v = 0;
+    memset(hist_h, 0, sizeof(hist_h));
+    memset(hist_s, 0, sizeof(hist_s));
+    memset(hist_v, 0, sizeof(hist_v));
+    color_pixels.assign(colors, 0);
+  }
+  
+  uint8_t meanH() const { return pixels ? (sum_h + pixels / 2) / pixels : 0; }
+  uint8_t meanS() const { return pixels ? (sum_s + pixels / 2) / pixels : 0; }
+  uint8_t meanV() const { return pixels ? (sum_v + pixels / 2) / pixels : 0; }
+  
+  // Share of the region's pixels matching the color_index'th color, 0..1
+  float coverage(int color_index) const {
+    return pixels ? float(color_pixels[color_index]) / pixels : 0.0f;
+  }
+};
+
+// Pixels per H, S and V value of the region being read
+struct ValueCounts {
+  std::vector<uint32_t> counts;       // H, S, V: 256 entries each
+  uint32_t pixels = 0;
+  
+  void clear() {
+    counts.assign(3 * 256, 0);
+    pixels = 0;
+  }
+  
+  void add(const uint8_t* h, const uint8_t* s, const uint8_t* v, int count) {
+    if (counts.empty()) clear();
+    uint32_t* count_h = counts.data();
+    uint32_t* count_s = count_h + 256;
+    uint32_t* count_v = count_h + 512;
+    for (int i = 0; i < count; i++) {
+      count_h[h[i]]++;
+      count_s[s[i]]++;
+      count_v[v[i]]++;
+    }
+    pixels += count;
+  }
+  
+  // Pixels, sums and histogram bins into stats, then start the next region
+  void finish(RegionStats& stats) {
+    if (counts.empty()) clear();
+    const uint32_t* count_h = counts.data();
+    const uint32_t* count_s = count_h + 256;
+    const uint32_t* count_v = count_h + 512;
+    stats.pixels = pixels;
+    for (int value = 0; value < 256; value++) {
+      stats.sum_h += value * count_h[value];
+      stats.sum_s += value * count_s[value];
+      stats.sum_v += value * count_v[value];
+      stats.hist_h[std::min(value * STATS_BINS / 180, STATS_BINS - 1)] += count_h[value];
+      stats.hist_s[value >> 4] += count_s[value];
+      stats.hist_v[value >> 4] += count_v[value];
+    }
+    clear();
+  }
+};
+
+// Value counts of every pixel on a shape's spans
+inline void addShapeValues(const HSVImage& hsv, const RegionShape& shape, ValueCounts& values) {
+  for (int row = 0; row < shape.rows(); row++) {
+    const int line = (shape.y0 + row) * hsv.width;
+    for (int i = shape.row_first[row]; i < shape.row_first[row + 1]; i++) {
+      const int idx = line + shape.spans[i].x0;
+      values.add(hsv.h_data + idx, hsv.s_data + idx, hsv.v_data + idx, shape.spans[i].x1 - shape.spans[i].x0);
+    }
+  }
+}
+
+// Bit k of h_bits[h] is set when range k admits hue h, likewise for S and
+// V; a pixel lies in range k when bit k survives the AND of its three
+// entries. Up to 64 ranges over all colors.
+struct ThresholdTable {
+  std::vector<uint64_t> h_bits;       // 256 entries each, on the heap (6 KB together)
+  std::vector<uint64_t> s_bits;
+  std::vector<uint64_t> v_bits;
+  std::vector<uint64_t> color_bits;   // Ranges of each color, in request order
+  
+  // What the table was built from, for update()
+  std::vector<ColorId> built_colors;
+  uint32_t built_version = 0;
+  bool built = false;
+  bool usable = false;
+  
+  // Rebuild only when the colors or any threshold changed since the last
+  // call; false if the colors have more than 64 ranges between them
+  bool update(const ColorSet& set, const std::vector<ColorId>& colors) {
+    if (!built || set.version() != built_version || colors != built_colors) {
+      usable = build(set, colors);
+      built_colors = colors;
+      built_version = set.version();
+      built = true;
+    }
+    return usable;
+  }
+  
+  // False if the colors have more than 64 ranges between them
+  bool build(const ColorSet& set, const std::vector<ColorId>& colors) {
+    h_bits.assign(256, 0);
+    s_bits.assign(256, 0);
+    v_bits.assign(256, 0);
+    color_bits.assign(colors.size(), 0);
+    
+    int bit = 0;
+    for (size_t c = 0; c < colors.size(); c++) {
+      if (!set.hasColor(colors[c])) continue;
+      for (const ColorThresholds& t : set.getThresholds(colors[c])) {
+        if (bit == 64) return false;
+        uint64_t mask = uint64_t(1) << bit++;
+        for (int h = 0; h < 256; h++) if (t.containsHue(h)) h_bits[h] |= mask;
+        for (int s = t.s_min; s <= t.s_max; s++) s_bits[s] |= mask;
+        for (int v = t.v_min; v <= t.v_max; v++) v_bits[v] |= mask;
+        color_bits[c] |= mask;
+      }
+    }
+    return true;
+  }
+};
+
+// What computeRegionStats() keeps between frames: the threshold table,
+// rebuilt only when a color changes, and the per-value counts of the
+// region being read. A caller that computes statistics every frame keeps
+// one next to its RegionStats vector.
+struct RegionStatsWorkspace {
+  ThresholdTable table;
+  ValueCounts values;
+};
+
+// Statistics of every region of a compiled set, in region order, read
+// along the spans each region owns. out keeps its capacity across frames.
+inline void computeRegionStats(const HSVImage& hsv, const CompiledRegionSet& compiled,
+                               const std::vector<ColorId>& colors, std::vector<RegionStats>& out,
+                               RegionStatsWorkspace& work) {
+  out.resize(compiled.regions.size());
+  for (RegionStats& stats : out) stats.reset(colors.size());
+  
+  if (!hsv.isValid() || compiled.image_width != hsv.width || compiled.image_height != hsv.height) return;
+  
+  ColorSnapshot snapshot = getColorManager().snapshot();
+  const ColorSet& color_set = *snapshot;
+  const ThresholdTable& table = work.table;
+  const bool use_table = work.table.update(color_set, colors);
+  
+  for (size_t region_idx = 0; region_idx < compiled.regions.size(); region_idx++) {
+    const RegionShape& owned = compiled.owned[region_idx];
+    RegionStats& stats = out[region_idx];
+    addShapeValues(hsv, owned, work.values);
+    work.values.finish(stats);
+    if (colors.empty()) continue;
+    
+    for (int row = 0; row < owned.rows(); row++) {
+      const int line = (owned.y0 + row) * hsv.width;
+      for (int i = owned.row_first[row]; i < owned.row_first[row + 1]; i++) {
+        for (int idx = line + owned.spans[i].x0; idx < line + owned.spans[i].x1; idx++) {
+          uint8_t h = hsv.h_data[idx], s = hsv.s_data[idx], v = hsv.v_data[idx];
+          if (use_table) {
+            uint64_t in = table.h_bits[h] & table.s_bits[s] & table.v_bits[v];
+            if (!in) continue;
+            for (size_t c = 0; c < colors.size(); c++) stats.color_pixels[c] += (in & table.color_bits[c]) != 0;
+          } else {
+            for (size_t c = 0; c < colors.size(); c++) stats.color_pixels[c] += color_set.matchesColor(h, s, v, colors[c]);
+          }
+        }
+      }
+    }
+  }
+}
+
+inline void computeRegionStats(const HSVImage& hsv, const CompiledRegionSet& compiled,
+                               const std::vector<ColorId>& colors, std::vector<RegionStats>& out) {
+  RegionStatsWorkspace work;
+  computeRegionStats(hsv, compiled, colors, out, work);
+}
+
+inline void computeRegionStats(const HSVImage& hsv, RegionSetId region_set,
+                               const std::vector<ColorId>& colors, std::vector<RegionStats>& out,
+                               RegionStatsWorkspace& work) {
+  if (!getRegionManager().hasRegionSet(region_set)) {
+    out.clear();
+    return;
+  }
+  
+  std::shared_ptr<const CompiledRegionSet> compiled =
+    getRegionManager().getCompiledRegionSet(region_set, hsv.width, hsv.height);
+  computeRegionStats(hsv, *compiled, colors, out, work);
+}
+
+inline void computeRegionStats(const HSVImage& hsv, RegionSetId region_set,
+                               const std::vector<ColorId>& colors, std::vector<RegionStats>& out) {
+  RegionStatsWorkspace work;
+  computeRegionStats(hsv, region_set, colors, out, work);
+}
+
+// Bytes of one binary record with this many colors
+inline size_t regionStatsRecordSize(size_t colors) {
+  return 8 + 3 * STATS_BINS * 2 + colors * 2;
+}
+
+// One record per region, little endian:
+//   [pixels u32][mean H u8][mean S u8][mean V u8][0 u8]
+//   [H histogram 16 x u16][S histogram 16 x u16][V histogram 16 x u16]
+//   [coverage u16 per color]
+// Histogram bins and coverage are shares of the region's pixels, 65535 = all.
+inline void appendRegionStatsBinary(const std::vector<RegionStats>& stats, std::vector<uint8_t>& out) {
+  for (const RegionStats& r : stats) {
+    size_t start = out.size();
+    out.resize(start + regionStatsRecordSize(r.color_pixels.size()));
+    uint8_t* p = out.data() + start;
+    
+    p[0] = r.pixels & 0xFF; p[1] = (r.pixels >> 8) & 0xFF;
+    p[2] = (r.pixels >> 16) & 0xFF; p[3] = r.pixels >> 24;
+    p[4] = r.meanH();
+    p[5] = r.meanS();
+    p[6] = r.meanV();
+    p[7] = 0;
+    p += 8;
+    
+    auto share = [&](uint32_t count) {
+      uint16_t value = r.pixels ? uint16_t((uint64_t(count) * 65535 + r.pixels / 2) / r.pixels) : 0;
+      p[0] = value & 0xFF;
+      p[1] = value >> 8;
+      p += 2;
+    };
+    for (int b = 0; b < STATS_BINS; b++) share(r.hist_h[b]);
+    for (int b = 0; b < STATS_BINS; b++) share(r.hist_s[b]);
+    for (int b = 0; b < STATS_BINS; b++) share(r.hist_v[b]);
+    for (uint32_t count : r.color_pixels) share(count);
+  }
+}
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+std::vector<RegionStats> stats;     // Reused every frame
+RegionStatsWorkspace stats_work;    // Threshold table survives until a color changes
+RegionSetId bins = getRegionManager().regionSetId("bins");
+std::vector<ColorId> colors = resolveColors({"RED", "GREEN"});
+
+void onFrame(const HSVImage& hsv) {
+  computeRegionStats(hsv, bins, colors, stats, stats_work);
+  for (size_t r = 0; r < stats.size(); r++) {
+    Serial.printf("bin %u: %.0f%% RED, %.0f%% GREEN, mean HSV %u,%u,%u\n", (unsigned)r,
+                  100 * stats[r].coverage(0), 100 * stats[r].coverage(1),
+                  stats[r].meanH(), stats[r].meanS(), stats[r].meanV());
+  }
+}
+*/
+
+#endif // REGION_STATS_H
\ No newline at end of file
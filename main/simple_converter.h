@@ -292,4 +292,42 @@ inline bool yuv422ToHSV(const uint8_t* yuv422_data, int width, int height, HSVIm
   return true;
 }
 
+/**
+ * Single pixel YUV to HSV, the same integer math as yuv422ToHSV
+ * For code that only converts parts of a frame
+ */
+inline void yuvPixelToHSV(uint8_t y, uint8_t u, uint8_t v, uint8_t& h_out, uint8_t& s_out, uint8_t& v_out) {
+  int c = y - 16; if (c < 0) c = 0;
+  int d = u - 128;
+  int e = v - 128;
+  
+  int r = (298 * c + 409 * e + 128) >> 8;
+  int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
+  int b = (298 * c + 516 * d + 128) >> 8;
+  
+  if (r < 0) r = 0; else if (r > 255) r = 255;
+  if (g < 0) g = 0; else if (g > 255) g = 255;
+  if (b < 0) b = 0; else if (b > 255) b = 255;
+  
+  uint8_t min_val = (r < g) ? ((r < b) ? r : b) : ((g < b) ? g : b);
+  uint8_t max_val = (r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b);
+  
+  v_out = max_val;
+  h_out = 0;
+  s_out = 0;
+  if (max_val == 0) return;
+  
+  uint8_t delta = max_val - min_val;
+  s_out = (delta * 255) / max_val;
+  if (delta == 0) return;
+  
+  int hue;
+  if (max_val == r) hue = (60 * (g - b)) / delta;
+  else if (max_val == g) hue = 120 + (60 * (b - r)) / delta;
+  else hue = 240 + (60 * (r - g)) / delta;
+  
+  if (hue < 0) hue += 360;
+  h_out = hue / 2;
+}
+
 #endif // SIMPLE_CONVERTER_H
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define SIMPLE_SERIAL_COMM_H
 
 #include <Arduino.h>
+#include "transport.h"
+#include "metrics.h"
 
 // ========================================
 // SIMPLE GENERIC SENDER
@@ -9,10 +11,16 @@
 
 class SimpleSerialSender {
 private:
-  HardwareSerial* serial;
+  UartTransport uart;
+  Transport* serial;
   
 public:
-  SimpleSerialSender(HardwareSerial* ser = &Serial) : serial(ser) {}
+  SimpleSerialSender(HardwareSerial* ser = &Serial) : uart(ser), serial(&uart) {}
+  SimpleSerialSender(Transport* transport) : serial(transport) {}
+  
+  // serial may point at our own uart
+  SimpleSerialSender(const SimpleSerialSender&) = delete;
+  SimpleSerialSender& operator=(const SimpleSerialSender&) = delete;
   
   void begin(unsigned long baud = 115200) {
     serial->begin(baud);
@@ -21,29 +29,30 @@ public:
   // Send any printable data
   template<typename T>
   void send(const T& data) {
-    serial->println(data);
+    getMetrics().serial_bytes_out.add(serial->println(data));
   }
   
   // Send multiple values separated by delimiter
   template<typename T>
   void send(const T& data, const char* delimiter) {
-    serial->print(data);
-    serial->print(delimiter);
+    size_t sent = serial->print(data);
+    sent += serial->print(delimiter);
+    getMetrics().serial_bytes_out.add(sent);
   }
   
   // Send end marker
   void endTransmission() {
-    serial->println("END");
+    getMetrics().serial_bytes_out.add(serial->println("END"));
   }
   
   // Send raw bytes
   void sendBytes(const uint8_t* data, size_t length) {
-    serial->write(data, length);
+    getMetrics().serial_bytes_out.add(serial->write(data, length));
   }
   
   // Send string
   void sendString(const String& str) {
-    serial->println(str);
+    getMetrics().serial_bytes_out.add(serial->println(str));
   }
 };
 
@@ -51,13 +60,24 @@ public:
 // SIMPLE GENERIC RECEIVER
 // ========================================
 
+// Longest line the receiver assembles; a longer one is dropped whole
+#define SERIAL_MAX_LINE 16384
+
 class SimpleSerialReceiver {
 private:
-  HardwareSerial* serial;
+  UartTransport uart;
+  Transport* serial;
   String last_received;
+  String partial;         // Bytes of a line whose '\n' has not arrived yet
+  bool overflow = false;  // partial hit SERIAL_MAX_LINE; drop up to '\n'
   
 public:
-  SimpleSerialReceiver(HardwareSerial* ser = &Serial) : serial(ser) {}
+  SimpleSerialReceiver(HardwareSerial* ser = &Serial) : uart(ser), serial(&uart) {}
+  SimpleSerialReceiver(Transport* transport) : serial(transport) {}
+  
+  // serial may point at our own uart
+  SimpleSerialReceiver(const SimpleSerialReceiver&) = delete;
+  SimpleSerialReceiver& operator=(const SimpleSerialReceiver&) = delete;
   
   void begin(unsigned long baud = 115200) {
     serial->begin(baud);
@@ -68,20 +88,39 @@ public:
     return serial->available() > 0;
   }
   
-  // Receive a line of data (blocks until received or timeout)
+  // Take the bytes already buffered, without blocking. Returns true once
+  // a whole line has arrived (see getString()); a line still missing its
+  // '\n' is kept for the next call instead of being returned cut short.
+  bool pollLine() {
+    while (serial->available() > 0) {
+      int c = serial->read();
+      if (c < 0) break;
+      if (c == '\n') {
+        bool dropped = overflow;
+        overflow = false;
+        if (dropped) {
+          partial = "";
+          continue;
+        }
+        last_received = partial;
+        last_received.trim();
+        partial = "";
+        return true;
+      }
+      if (partial.length() < SERIAL_MAX_LINE) partial += char(c);
+      else overflow = true;
+    }
+    return false;
+  }
+  
+  // Receive a line of data (blocks until a whole line arrives or timeout)
   bool receiveLine(unsigned long timeout_ms = 1000) {
     unsigned long start_time = millis();
     
-    while (!serial->available() && (millis() - start_time < timeout_ms)) {
+    while (!pollLine()) {
+      if (millis() - start_time >= timeout_ms) return false;
       delay(1);
     }
-    
-    if (!serial->available()) {
-      return false;
-    }
-    
-    last_received = serial->readStringUntil('\n');
-    last_received.trim();
     return true;
   }
   
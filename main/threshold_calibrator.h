@@ -0,0 +1,170 @@
+#ifndef THRESHOLD_CALIBRATOR_H
+#define THRESHOLD_CALIBRATOR_H
+
+#include "blob_detector_ccl.h"
+#include <vector>
+
+// ========================================
+// AUTOMATIC THRESHOLD CALIBRATION
+// ========================================
+
+// Samples the pixels of a region set over a few frames into 2D H x S and
+// H x V histograms, then picks the narrowest ranges that still hold a given
+// share of the samples. Hue is treated as a circle: when the narrowest arc
+// crosses 179 -> 0, the range wraps (h_min > h_max), the way RED is
+// defined. S and V are chosen from the samples inside the hue arc only, so
+// a grey or dark background at the region's edge does not widen them.
+
+#define CALIB_H_BIN 2             // Hue per bin (90 bins over 0..179)
+#define CALIB_SV_BIN 8            // Saturation / value per bin (32 bins)
+#define CALIB_H_BINS (180 / CALIB_H_BIN)
+#define CALIB_SV_BINS (256 / CALIB_SV_BIN)
+#define CALIB_DEFAULT_FRAMES 10
+#define CALIB_DEFAULT_KEEP_PCT 95 // Share of the samples the ranges must hold
+
+class ThresholdCalibrator {
+private:
+  RegionSetId region_set;
+  int frames_left;
+  int keep_pct;
+  uint32_t samples;
+  std::vector<uint32_t> hs_hist;    // h_bin * CALIB_SV_BINS + s_bin
+  std::vector<uint32_t> hv_hist;    // h_bin * CALIB_SV_BINS + v_bin
+  
+  // Narrowest run of bins [first, first + length) holding at least target
+  // samples; with circular the run may wrap past the last bin
+  static void narrowest(const uint32_t* hist, int bins, uint32_t target, bool circular,
+                        int& first, int& length) {
+    first = 0;
+    length = bins;
+    for (int start = 0; start < bins; start++) {
+      if (hist[start] == 0) continue;   // A tightest run never starts on an empty bin
+      uint32_t sum = 0;
+      int limit = circular ? bins : bins - start;
+      for (int n = 1; n <= limit && n < length; n++) {
+        sum += hist[(start + n - 1) % bins];
+        if (sum >= target) {
+          first = start;
+          length = n;
+          break;
+        }
+      }
+    }
+  }
+
+public:
+  ThresholdCalibrator()
+    : region_set(REGION_SET_NONE), frames_left(0), keep_pct(CALIB_DEFAULT_KEEP_PCT), samples(0) {}
+  
+  ThresholdCalibrator(const ThresholdCalibrator&) = delete;
+  ThresholdCalibrator& operator=(const ThresholdCalibrator&) = delete;
+  
+  // Start sampling; any calibration in progress is dropped
+  void begin(RegionSetId set_id, int frames = CALIB_DEFAULT_FRAMES, int keep = CALIB_DEFAULT_KEEP_PCT) {
+    region_set = set_id;
+    frames_left = std::max(1, frames);
+    keep_pct = std::min(100, std::max(50, keep));
+    samples = 0;
+    hs_hist.assign(CALIB_H_BINS * CALIB_SV_BINS, 0);
+    hv_hist.assign(CALIB_H_BINS * CALIB_SV_BINS, 0);
+  }
+  
+  void cancel() {
+    frames_left = 0;
+  }
+  
+  bool isActive() const { return frames_left > 0; }
+  
+  RegionSetId regionSet() const { return region_set; }
+  
+  uint32_t sampleCount() const { return samples; }
+  
+  // Sample every pixel of the region set once (overlaps count once).
+  // Returns true when this was the last frame needed.
+  bool addFrame(const HSVImage& hsv) {
+    if (frames_left == 0 || !hsv.isValid() || !getRegionManager().hasRegionSet(region_set)) return false;
+    
+    std::shared_ptr<const CompiledRegionSet> pinned =
+      getRegionManager().getCompiledRegionSet(region_set, hsv.width, hsv.height);
+    const CompiledRegionSet& compiled = *pinned;
+    for (int y = 0; y < hsv.height; y++) {
+      for (int i = compiled.row_first[y]; i < compiled.row_first[y + 1]; i++) {
+        const RowSpan& span = compiled.spans[i];
+        for (int idx = y * hsv.width + span.x0; idx < y * hsv.width + span.x1; idx++) {
+          int h_bin = std::min(hsv.h_data[idx], uint8_t(179)) / CALIB_H_BIN;
+          hs_hist[h_bin * CALIB_SV_BINS + hsv.s_data[idx] / CALIB_SV_BIN]++;
+          hv_hist[h_bin * CALIB_SV_BINS + hsv.v_data[idx] / CALIB_SV_BIN]++;
+        }
+      }
+    }
+    samples += compiled.covered_pixels;
+    return --frames_left == 0;
+  }
+  
+  // One range holding keep_pct of the samples, h_min > h_max when the hue
+  // arc wraps. False if nothing was sampled.
+  bool finish(std::vector<ColorThresholds>& out) const {
+    out.clear();
+    if (samples == 0) return false;
+    
+    // Hue: narrowest arc of the H marginal
+    uint32_t h_hist[CALIB_H_BINS] = {0};
+    for (int h = 0; h < CALIB_H_BINS; h++) {
+      for (int s = 0; s < CALIB_SV_BINS; s++) h_hist[h] += hs_hist[h * CALIB_SV_BINS + s];
+    }
+    uint32_t target = (uint64_t(samples) * keep_pct + 99) / 100;
+    int h_first, h_len;
+    narrowest(h_hist, CALIB_H_BINS, target, true, h_first, h_len);
+    
+    // Saturation and value: narrowest intervals of the samples inside the hue arc
+    uint32_t s_hist[CALIB_SV_BINS] = {0};
+    uint32_t v_hist[CALIB_SV_BINS] = {0};
+    uint32_t in_arc = 0;
+    for (int n = 0; n < h_len; n++) {
+      int h = (h_first + n) % CALIB_H_BINS;
+      for (int b = 0; b < CALIB_SV_BINS; b++) {
+        s_hist[b] += hs_hist[h * CALIB_SV_BINS + b];
+        v_hist[b] += hv_hist[h * CALIB_SV_BINS + b];
+      }
+      in_arc += h_hist[h];
+    }
+    uint32_t arc_target = (uint64_t(in_arc) * keep_pct + 99) / 100;
+    int s_first, s_len;
+    narrowest(s_hist, CALIB_SV_BINS, arc_target, false, s_first, s_len);
+    int v_first, v_len;
+    narrowest(v_hist, CALIB_SV_BINS, arc_target, false, v_first, v_len);
+    
+    uint8_t s_min = s_first * CALIB_SV_BIN, s_max = (s_first + s_len) * CALIB_SV_BIN - 1;
+    uint8_t v_min = v_first * CALIB_SV_BIN, v_max = (v_first + v_len) * CALIB_SV_BIN - 1;
+    uint8_t h_min = h_first * CALIB_H_BIN;
+    uint8_t h_max = ((h_first + h_len) * CALIB_H_BIN - 1) % 180;
+    
+    if (h_len == CALIB_H_BINS) {
+      out.push_back(ColorThresholds(0, 179, s_min, s_max, v_min, v_max));
+    } else {
+      out.push_back(ColorThresholds(h_min, h_max, s_min, s_max, v_min, v_max));
+    }
+    return true;
+  }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+ThresholdCalibrator calibrator;
+
+void startCalibration() {
+  // Hold the part inside the "probe" regions for about a second
+  calibrator.begin(getRegionManager().findRegionSet("probe"), 10);
+}
+
+void onFrame(const HSVImage& hsv) {
+  if (calibrator.isActive() && calibrator.addFrame(hsv)) {
+    std::vector<ColorThresholds> ranges;
+    if (calibrator.finish(ranges)) getColorManager().setColor("PART", ranges);
+  }
+}
+*/
+
+#endif // THRESHOLD_CALIBRATOR_H
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <Arduino.h>
+
+// ========================================
+// BYTE TRANSPORT INTERFACE
+// ========================================
+
+// A bidirectional byte link. It is an Arduino Stream, so print/println,
+// readStringUntil and readBytes work unchanged on top of it; begin() is the
+// only addition. Implementations: UartTransport below, and FdTransport
+// (bench/host/fd_transport.h) for ptys, pipes and sockets on Linux.
+class Transport : public Stream {
+public:
+  virtual ~Transport() {}
+  
+  // Open the link; baud may be ignored (or simulated) by non-UART links
+  virtual void begin(unsigned long baud) = 0;
+  
+  using Print::write;
+};
+
+// ========================================
+// ARDUINO UART TRANSPORT
+// ========================================
+
+class UartTransport : public Transport {
+private:
+  HardwareSerial* serial;
+
+public:
+  UartTransport(HardwareSerial* ser = nullptr) : serial(ser) {}
+  
+  void begin(unsigned long baud) override {
+    serial->begin(baud);
+  }
+  
+  int available() override {
+    return serial->available();
+  }
+  
+  int read() override {
+    return serial->read();
+  }
+  
+  int peek() override {
+    return serial->peek();
+  }
+  
+  size_t write(uint8_t c) override {
+    return serial->write(c);
+  }
+  
+  size_t write(const uint8_t* data, size_t length) override {
+    return serial->write(data, length);
+  }
+  
+  void flush() override {
+    serial->flush();
+  }
+};
+
+#endif // TRANSPORT_H
\ No newline at end of file
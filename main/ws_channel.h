@@ -0,0 +1,480 @@
+#ifndef WS_CHANNEL_H
+#define WS_CHANNEL_H
+
+#include <WiFi.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+#include "blob_detector_ccl.h"
+#include <string>
+#include <vector>
+
+// ========================================
+// WEBSOCKET PUSH CHANNEL
+// ========================================
+
+#define WS_PORT 81
+#define WS_MAX_CLIENTS 2
+#define WS_MAX_VIEW_COLORS 4
+#define WS_RX_BUFFER 256          // Largest accepted client frame, and upgrade request line
+#define WS_HANDSHAKE_TIMEOUT 500  // ms from accept to the end of the upgrade request
+
+// Binary messages (server -> browser), one WebSocket frame each.
+// Every message starts with a 10 byte little-endian header:
+//   [type u8][color u8][frame_id u32][width u16][height u16]
+// followed by
+//   WS_MSG_FRAME  raw YUV422, width * height * 2 bytes (color unused)
+//   WS_MSG_MASK   1 bpp row-major mask, MSB first, (width * height + 7) / 8 bytes;
+//                 color = index into the client's VIEW list
+//   WS_MSG_BLOBS  count u16, then count * [color u8][pad u8][x u16][y u16][size u32]
+// Masks and blobs recomputed after a threshold change repeat the frame id of
+// the frame they were computed on.
+#define WS_MSG_FRAME 1
+#define WS_MSG_MASK  2
+#define WS_MSG_BLOBS 3
+#define WS_HEADER_SIZE 10
+#define WS_BLOB_SIZE 10
+
+// Text messages (browser -> server), answered with OK or ERROR: ...
+//   VIEW,<frame 0|1>,<blobs 0|1>[,color...]   what this client receives
+//   COLOR_SET,name,h_min,h_max,s_min,s_max,v_min,v_max
+//   COLOR_SET2,name + 12 threshold values
+//   COLOR_SETN,name,h_min:h_max:s_min:s_max:v_min:v_max,...
+
+struct WsClient {
+  WiFiClient conn;
+  bool active;
+  bool upgraded;                     // 101 sent; until then rx holds the request line being read
+  unsigned long accepted_ms;
+  String key;                        // Sec-WebSocket-Key of the upgrade request
+  bool want_frame;
+  bool want_blobs;
+  std::vector<ColorId> colors;       // Masks (and blobs) in this order
+  uint8_t rx[WS_RX_BUFFER];
+  size_t rx_len;
+  
+  WsClient() : active(false), upgraded(false), accepted_ms(0), want_frame(false), want_blobs(false),
+               rx_len(0) {}
+};
+
+class WsChannel {
+private:
+  WiFiServer listener;
+  WsClient clients[WS_MAX_CLIENTS];
+  bool thresholds_changed;
+  
+  // Per-publish caches, shared by all clients viewing the same color. The
+  // first cached_count entries are live; the others keep their buffers for
+  // the next publish.
+  size_t cached_count;
+  std::vector<ColorId> cached_colors;
+  std::vector<std::vector<uint8_t>> cached_masks;
+  std::vector<std::vector<Blob>> cached_blobs;
+  std::vector<bool> cached_detected;
+  std::vector<uint8_t> blob_payload;
+  LabelWorkspace work;
+  
+  static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+  }
+  
+  static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+  }
+  
+  // ========================================
+  // HANDSHAKE
+  // ========================================
+  
+  // Take the part of the HTTP upgrade request that has arrived, a line at a
+  // time, without waiting for the rest; answer 101 after its blank line.
+  // False drops the connection: no key, or not complete within
+  // WS_HANDSHAKE_TIMEOUT.
+  static bool readHandshake(WsClient& client) {
+    while (client.conn.available() > 0) {
+      int c = client.conn.read();
+      if (c < 0) break;
+      if (c != '\n') {
+        if (client.rx_len < WS_RX_BUFFER - 1) client.rx[client.rx_len++] = c;   // Longer lines keep their start
+        continue;
+      }
+      
+      client.rx[client.rx_len] = 0;
+      client.rx_len = 0;
+      String line((const char*)client.rx);
+      line.trim();
+      if (line.length() == 0) {
+        if (client.key.length() == 0 || !handshake(client.conn, client.key)) return false;
+        client.upgraded = true;
+        client.key = "";
+        return true;
+      }
+      
+      String lower = line;
+      lower.toLowerCase();
+      if (lower.startsWith("sec-websocket-key:")) {
+        client.key = line.substring(18);
+        client.key.trim();
+      }
+    }
+    return millis() - client.accepted_ms < WS_HANDSHAKE_TIMEOUT;
+  }
+  
+  // Answer the upgrade request carrying key with 101
+  static bool handshake(WiFiClient& conn, const String& key) {
+    static const char* GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    
+    String source = key + GUID;
+    uint8_t digest[20];
+    mbedtls_sha1((const uint8_t*)source.c_str(), source.length(), digest);
+    
+    uint8_t accept[32];
+    size_t accept_len = 0;
+    if (mbedtls_base64_encode(accept, sizeof(accept) - 1, &accept_len, digest, sizeof(digest)) != 0) {
+      return false;
+    }
+    accept[accept_len] = 0;
+    
+    conn.print("HTTP/1.1 101 Switching Protocols\r\n"
+               "Upgrade: websocket\r\n"
+               "Connection: Upgrade\r\n"
+               "Sec-WebSocket-Accept: ");
+    conn.print((const char*)accept);
+    conn.print("\r\n\r\n");
+    conn.setNoDelay(true);
+    return true;
+  }
+  
+  void acceptClients() {
+    WiFiClient incoming = listener.available();
+    if (!incoming) return;
+    
+    int slot = -1;
+    for (int i = 0; i < WS_MAX_CLIENTS && slot < 0; i++) {
+      if (!clients[i].active) slot = i;
+    }
+    if (slot < 0) {
+      incoming.stop();
+      return;
+    }
+    
+    // The upgrade request is read by poll() as it arrives
+    clients[slot] = WsClient();
+    clients[slot].conn = incoming;
+    clients[slot].active = true;
+    clients[slot].accepted_ms = millis();
+  }
+  
+  void drop(WsClient& client) {
+    client.conn.stop();
+    client = WsClient();
+  }
+  
+  // ========================================
+  // OUTGOING FRAMES
+  // ========================================
+  
+  // One unfragmented, unmasked frame made of head + body
+  static bool sendFrame(WiFiClient& conn, uint8_t opcode, const uint8_t* head, size_t head_len,
+                        const uint8_t* body, size_t body_len) {
+    size_t length = head_len + body_len;
+    uint8_t prefix[10];
+    size_t prefix_len = 2;
+    prefix[0] = 0x80 | opcode;
+    if (length < 126) {
+      prefix[1] = length;
+    } else if (length <= 0xFFFF) {
+      prefix[1] = 126;
+      prefix[2] = length >> 8;
+      prefix[3] = length & 0xFF;
+      prefix_len = 4;
+    } else {
+      prefix[1] = 127;
+      for (int i = 0; i < 8; i++) prefix[2 + i] = (uint64_t(length) >> (8 * (7 - i))) & 0xFF;
+      prefix_len = 10;
+    }
+    
+    return conn.write(prefix, prefix_len) == prefix_len &&
+           (head_len == 0 || conn.write(head, head_len) == head_len) &&
+           (body_len == 0 || conn.write(body, body_len) == body_len);
+  }
+  
+  static bool sendText(WiFiClient& conn, const char* text) {
+    return sendFrame(conn, 0x1, nullptr, 0, (const uint8_t*)text, strlen(text));
+  }
+  
+  static bool sendMessage(WiFiClient& conn, uint8_t type, uint8_t color, uint32_t frame_id,
+                          int width, int height, const uint8_t* body, size_t body_len) {
+    uint8_t header[WS_HEADER_SIZE];
+    header[0] = type;
+    header[1] = color;
+    putU32(header + 2, frame_id);
+    putU16(header + 6, width);
+    putU16(header + 8, height);
+    return sendFrame(conn, 0x2, header, sizeof(header), body, body_len);
+  }
+  
+  // ========================================
+  // INCOMING FRAMES
+  // ========================================
+  
+  // Handle one text command; returns the reply
+  const char* handleText(WsClient& client, char* text) {
+    char* tokens[16];
+    int count = 0;
+    for (char* tok = strtok(text, ","); tok && count < 16; tok = strtok(nullptr, ",")) {
+      tokens[count++] = tok;
+    }
+    if (count == 0) return "ERROR: Empty command";
+    
+    if (strcmp(tokens[0], "VIEW") == 0) {
+      if (count < 3) return "ERROR: VIEW needs: frame,blobs[,colors]";
+      if (count - 3 > WS_MAX_VIEW_COLORS) return "ERROR: Too many colors";
+      std::vector<ColorId> colors;
+      for (int i = 3; i < count; i++) {
+        ColorId color = getColorManager().findColor(tokens[i]);
+        if (color == COLOR_NONE) return "ERROR: Unknown color";
+        colors.push_back(color);
+      }
+      client.want_frame = atoi(tokens[1]) != 0;
+      client.want_blobs = atoi(tokens[2]) != 0;
+      client.colors.swap(colors);
+      thresholds_changed = true;   // New view: send masks for the current frame
+      return "OK";
+    }
+    
+    if (strcmp(tokens[0], "COLOR_SET") == 0) {
+      if (count < 8) return "ERROR: COLOR_SET needs: name,h_min,h_max,s_min,s_max,v_min,v_max";
+      ColorThresholds threshold(atoi(tokens[2]), atoi(tokens[3]), atoi(tokens[4]),
+                                atoi(tokens[5]), atoi(tokens[6]), atoi(tokens[7]));
+      if (!getColorManager().setColor(std::string(tokens[1]), threshold)) return "ERROR: Too many colors";
+      thresholds_changed = true;
+      return "OK";
+    }
+    
+    if (strcmp(tokens[0], "COLOR_SET2") == 0) {
+      if (count < 14) return "ERROR: COLOR_SET2 needs: name + 12 threshold values";
+      std::vector<ColorThresholds> thresholds = {
+        ColorThresholds(atoi(tokens[2]), atoi(tokens[3]), atoi(tokens[4]),
+                        atoi(tokens[5]), atoi(tokens[6]), atoi(tokens[7])),
+        ColorThresholds(atoi(tokens[8]), atoi(tokens[9]), atoi(tokens[10]),
+                        atoi(tokens[11]), atoi(tokens[12]), atoi(tokens[13]))
+      };
+      if (!getColorManager().setColor(std::string(tokens[1]), thresholds)) return "ERROR: Too many colors";
+      thresholds_changed = true;
+      return "OK";
+    }
+    
+    if (strcmp(tokens[0], "COLOR_SETN") == 0) {
+      std::vector<ColorThresholds> thresholds;
+      ColorThresholds box;
+      for (int i = 2; i < count && parseColorBox(tokens[i], box); i++) thresholds.push_back(box);
+      if (thresholds.empty() || int(thresholds.size()) != count - 2) return "ERROR: COLOR_SETN needs: name,h_min:h_max:s_min:s_max:v_min:v_max,...";
+      if (!getColorManager().setColor(std::string(tokens[1]), thresholds)) return "ERROR: Too many colors";
+      thresholds_changed = true;
+      return "OK";
+    }
+    
+    return "ERROR: Unknown command";
+  }
+  
+  // Consume complete frames from the receive buffer; false drops the client
+  bool readFrames(WsClient& client) {
+    while (client.conn.available() && client.rx_len < WS_RX_BUFFER) {
+      int n = client.conn.read(client.rx + client.rx_len, WS_RX_BUFFER - client.rx_len);
+      if (n <= 0) break;
+      client.rx_len += n;
+    }
+    
+    for (;;) {
+      if (client.rx_len < 2) return true;
+      
+      uint8_t opcode = client.rx[0] & 0x0F;
+      bool masked = client.rx[1] & 0x80;
+      size_t length = client.rx[1] & 0x7F;
+      size_t pos = 2;
+      if (length == 126) {
+        if (client.rx_len < 4) return true;
+        length = (client.rx[2] << 8) | client.rx[3];
+        pos = 4;
+      } else if (length == 127) {
+        return false;   // Never needed for commands
+      }
+      
+      // Browsers always mask; the whole frame has to fit the buffer
+      if (!masked || pos + 4 + length > WS_RX_BUFFER) return false;
+      if (client.rx_len < pos + 4 + length) return true;
+      
+      const uint8_t* mask = client.rx + pos;
+      uint8_t* payload = client.rx + pos + 4;
+      for (size_t i = 0; i < length; i++) payload[i] ^= mask[i & 3];
+      
+      bool ok = true;
+      if (opcode == 0x1) {
+        char text[WS_RX_BUFFER];
+        memcpy(text, payload, length);
+        text[length] = 0;
+        ok = sendText(client.conn, handleText(client, text));
+      } else if (opcode == 0x8) {
+        sendFrame(client.conn, 0x8, nullptr, 0, nullptr, 0);
+        return false;
+      } else if (opcode == 0x9) {
+        ok = sendFrame(client.conn, 0xA, nullptr, 0, payload, length);
+      }
+      if (!ok) return false;
+      
+      size_t used = pos + 4 + length;
+      memmove(client.rx, client.rx + used, client.rx_len - used);
+      client.rx_len -= used;
+    }
+  }
+  
+  // ========================================
+  // MASKS AND BLOBS
+  // ========================================
+  
+  int cacheIndex(ColorId color, const HSVImage& hsv, bool need_blobs) {
+    int index = -1;
+    for (size_t i = 0; i < cached_count && index < 0; i++) {
+      if (cached_colors[i] == color) index = i;
+    }
+    
+    if (index < 0) {
+      index = cached_count++;
+      if (cached_colors.size() < cached_count) {
+        cached_colors.push_back(color);
+        cached_masks.push_back({});
+        cached_blobs.push_back({});
+        cached_detected.push_back(false);
+      }
+      cached_colors[index] = color;
+      cached_detected[index] = false;
+      cached_masks[index].resize(packedMaskSize(hsv.width, hsv.height));
+      buildColorMask(hsv, color, cached_masks[index].data());
+    }
+    
+    if (need_blobs && !cached_detected[index]) {
+      detectSingleColorInto(hsv, DetectionRegion(0, 0, hsv.width, hsv.height), color,
+                            *getColorManager().snapshot(), work, cached_blobs[index]);
+      cached_detected[index] = true;
+    }
+    return index;
+  }
+  
+  bool sendBlobs(WsClient& client, uint32_t frame_id, const HSVImage& hsv) {
+    blob_payload.assign(2, 0);
+    uint16_t count = 0;
+    
+    for (size_t c = 0; c < client.colors.size(); c++) {
+      int index = cacheIndex(client.colors[c], hsv, true);
+      for (const auto& blob : cached_blobs[index]) {
+        if (count == 0xFFFF) break;
+        uint8_t entry[WS_BLOB_SIZE];
+        entry[0] = c;
+        entry[1] = 0;
+        putU16(entry + 2, blob.center_x);
+        putU16(entry + 4, blob.center_y);
+        putU32(entry + 6, blob.pixel_count);
+        blob_payload.insert(blob_payload.end(), entry, entry + WS_BLOB_SIZE);
+        count++;
+      }
+    }
+    putU16(blob_payload.data(), count);
+    
+    return sendMessage(client.conn, WS_MSG_BLOBS, 0, frame_id, hsv.width, hsv.height,
+                       blob_payload.data(), blob_payload.size());
+  }
+
+public:
+  WsChannel(uint16_t port = WS_PORT) : listener(port), thresholds_changed(false), cached_count(0) {}
+  
+  void begin() {
+    listener.begin();
+    listener.setNoDelay(true);
+  }
+  
+  // Accept connections and handle incoming commands. Returns true once after
+  // any client changed thresholds or its view, so the caller can publish the
+  // current frame again instead of waiting for the next one.
+  bool poll() {
+    acceptClients();
+    
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+      WsClient& client = clients[i];
+      if (!client.active) continue;
+      bool ok = client.conn.connected() && (client.upgraded ? readFrames(client) : readHandshake(client));
+      if (!ok) drop(client);
+    }
+    
+    bool changed = thresholds_changed;
+    thresholds_changed = false;
+    return changed;
+  }
+  
+  bool hasClients() const {
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+      if (clients[i].upgraded) return true;
+    }
+    return false;
+  }
+  
+  // Send every client what its VIEW asks for. yuv is the raw frame, or
+  // nullptr when only masks and blobs are recomputed for the same frame.
+  // Each mask / blob list is computed once per call, however many clients use it.
+  void publish(uint32_t frame_id, const uint8_t* yuv, const HSVImage& hsv) {
+    cached_count = 0;
+    
+    for (int i = 0; i < WS_MAX_CLIENTS; i++) {
+      WsClient& client = clients[i];
+      if (!client.upgraded) continue;
+      
+      bool ok = true;
+      if (yuv && client.want_frame) {
+        ok = sendMessage(client.conn, WS_MSG_FRAME, 0, frame_id, hsv.width, hsv.height,
+                         yuv, hsv.width * hsv.height * 2);
+      }
+      
+      for (size_t c = 0; ok && c < client.colors.size(); c++) {
+        int index = cacheIndex(client.colors[c], hsv, false);
+        ok = sendMessage(client.conn, WS_MSG_MASK, c, frame_id, hsv.width, hsv.height,
+                         cached_masks[index].data(), cached_masks[index].size());
+      }
+      
+      if (ok && client.want_blobs) ok = sendBlobs(client, frame_id, hsv);
+      if (!ok) drop(client);
+    }
+  }
+};
+
+// ========================================
+// USAGE EXAMPLE
+// ========================================
+/*
+WsChannel channel;
+
+void setup() {
+  // after WiFi is connected
+  channel.begin();
+}
+
+void wsTask(void*) {
+  uint32_t seq = 0;
+  for (;;) {
+    bool changed = channel.poll();
+    if (copyLatestFrame(frame, &seq, &width, &height)) {
+      // convert frame to hsv, then
+      channel.publish(seq, frame, hsv);
+    } else if (changed) {
+      channel.publish(seq, nullptr, hsv);   // new thresholds, same frame
+    }
+  }
+}
+
+Browser:
+  const ws = new WebSocket(`ws://${location.hostname}:81/`);
+  ws.binaryType = 'arraybuffer';
+  ws.onopen = () => ws.send('VIEW,1,1,RED');
+  slider.oninput = () => ws.send('COLOR_SET,RED,0,10,50,255,50,255');
+*/
+
+#endif // WS_CHANNEL_H
\ No newline at end of file